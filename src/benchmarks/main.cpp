@@ -0,0 +1,456 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+/*
+ * Headless benchmark of the audio engine.
+ *
+ * Each song of the corpus is rendered in a number of scenarios using
+ * the FakeDriver, which calls audioEngine_process() back to back in
+ * the calling thread. Since all randomness of the engine is based on
+ * rand(), runs using the same seed render the very same notes.
+ *
+ * The results are written as JSON so they can be compared between
+ * releases.
+ */
+
+#include <core/AudioEngine/AudioEngine.h>
+#include <core/AudioEngine/EngineMetrics.h>
+#include <core/Basics/Instrument.h>
+#include <core/Basics/InstrumentList.h>
+#include <core/Basics/Note.h>
+#include <core/Basics/Pattern.h>
+#include <core/Basics/PatternList.h>
+#include <core/Basics/Song.h>
+#include <core/CoreActionController.h>
+#include <core/Helpers/Filesystem.h>
+#include <core/Hydrogen.h>
+#include <core/IO/FakeDriver.h>
+#include <core/Preferences/Preferences.h>
+#include <core/Sampler/Interpolation.h>
+#include <core/Sampler/Sampler.h>
+#include <core/Version.h>
+#include <core/config.h>
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <vector>
+
+using namespace H2Core;
+
+/*
+ * Every allocation done by the process - including the sampler worker
+ * threads - is counted to spot allocations in the realtime path.
+ */
+static std::atomic<unsigned long long> nAllocations( 0 );
+
+void* operator new( std::size_t nSize )
+{
+	++nAllocations;
+	void* p = std::malloc( nSize > 0 ? nSize : 1 );
+	if ( p == nullptr ) {
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+void* operator new[]( std::size_t nSize )
+{
+	return operator new( nSize );
+}
+
+void operator delete( void* p ) noexcept
+{
+	std::free( p );
+}
+
+void operator delete[]( void* p ) noexcept
+{
+	std::free( p );
+}
+
+void operator delete( void* p, std::size_t ) noexcept
+{
+	std::free( p );
+}
+
+void operator delete[]( void* p, std::size_t ) noexcept
+{
+	std::free( p );
+}
+
+struct Scenario {
+	QString sName;
+	Interpolation::InterpolateMode interpolateMode;
+	/** Alters the freshly loaded song before it is set.*/
+	std::function<void(std::shared_ptr<Song>)> prepare;
+};
+
+static void enableFilters( std::shared_ptr<Song> pSong )
+{
+	InstrumentList* pInstrumentList = pSong->getInstrumentList();
+	for ( int ii = 0; ii < pInstrumentList->size(); ++ii ) {
+		auto pInstrument = pInstrumentList->get( ii );
+		pInstrument->set_filter_active( true );
+		pInstrument->set_filter_cutoff( 0.5 );
+		pInstrument->set_filter_resonance( 0.5 );
+	}
+}
+
+/** Adds a note of each instrument on every 16th of every pattern. The
+ * velocities cycle through the whole range to hit all layers.*/
+static void densifyPatterns( std::shared_ptr<Song> pSong )
+{
+	const int nStep = MAX_NOTES / 16;
+	InstrumentList* pInstrumentList = pSong->getInstrumentList();
+	PatternList* pPatternList = pSong->getPatternList();
+	for ( int nPattern = 0; nPattern < pPatternList->size(); ++nPattern ) {
+		Pattern* pPattern = pPatternList->get( nPattern );
+		for ( int nPos = 0; nPos < pPattern->get_length(); nPos += nStep ) {
+			for ( int ii = 0; ii < pInstrumentList->size(); ++ii ) {
+				float fVelocity = 0.1 + 0.9 * ( ( nPos / nStep + ii ) % 8 ) / 7.0;
+				pPattern->insert_note( new Note( pInstrumentList->get( ii ), nPos,
+												 fVelocity, 0.f, -1, 0 ) );
+			}
+		}
+	}
+}
+
+static std::vector<Scenario> createScenarios()
+{
+	const auto linear = Interpolation::InterpolateMode::Linear;
+	auto plain = []( std::shared_ptr<Song> ) {};
+	auto humanize = []( float fValue ) {
+		return [=]( std::shared_ptr<Song> pSong ) {
+			pSong->setHumanizeTimeValue( fValue );
+			pSong->setHumanizeVelocityValue( fValue );
+		};
+	};
+
+	return {
+		{ "plain", linear, plain },
+		{ "interpolation-cosine", Interpolation::InterpolateMode::Cosine, plain },
+		{ "interpolation-third", Interpolation::InterpolateMode::Third, plain },
+		{ "interpolation-cubic", Interpolation::InterpolateMode::Cubic, plain },
+		{ "interpolation-hermite", Interpolation::InterpolateMode::Hermite, plain },
+		{ "filters", linear, enableFilters },
+		{ "humanize-0.25", linear, humanize( 0.25 ) },
+		{ "humanize-0.50", linear, humanize( 0.5 ) },
+		{ "humanize-1.00", linear, humanize( 1.0 ) },
+		{ "dense", linear, densifyPatterns },
+		{ "dense-filters", linear, []( std::shared_ptr<Song> pSong ) {
+				densifyPatterns( pSong );
+				enableFilters( pSong );
+			} },
+	};
+}
+
+struct Options {
+	int nCycles;
+	int nWarmupCycles;
+	unsigned nSeed;
+};
+
+/** Measurements of a single cycle.*/
+struct Cycle {
+	int64_t nDurationNs;
+	unsigned long long nAllocations;
+	int nVoices;
+};
+
+/**
+ * Renders @a sSongPath in @a scenario.
+ *
+ * \return Results or an empty object if the song could not be
+ * rendered.
+ */
+static QJsonObject runBenchmark( const QString& sSongPath, const Scenario& scenario,
+								 const Options& options )
+{
+	Hydrogen* pHydrogen = Hydrogen::get_instance();
+	AudioEngine* pAudioEngine = pHydrogen->getAudioEngine();
+	FakeDriver* pDriver = dynamic_cast<FakeDriver*>( pAudioEngine->getAudioDriver() );
+	if ( pDriver == nullptr ) {
+		___ERRORLOG( "FakeDriver not running" );
+		return QJsonObject();
+	}
+
+	srand( options.nSeed );
+
+	std::shared_ptr<Song> pSong = Song::load( sSongPath );
+	if ( pSong == nullptr ) {
+		___ERRORLOG( QString( "Unable to load song [%1]" ).arg( sSongPath ) );
+		return QJsonObject();
+	}
+	scenario.prepare( pSong );
+
+	pHydrogen->setSong( pSong );
+	pSong->setMode( Song::Mode::Song );
+	// Renders the song over and over till enough cycles are done.
+	pSong->setIsLoopEnabled( true );
+	pAudioEngine->getSampler()->setInterpolateMode( scenario.interpolateMode );
+	pAudioEngine->setOfflineMode( true );
+	pHydrogen->getCoreActionController()->locateToFrame( 0 );
+
+	// Stored up front to not allocate while rendering.
+	const int nTotalCycles = options.nWarmupCycles + options.nCycles;
+	std::vector<Cycle> cycles( nTotalCycles );
+	int nCycle = 0;
+	int64_t nCycleStart = 0;
+	unsigned long long nCycleAllocations = 0;
+
+	pDriver->setCycleCallback( [&]() {
+		const int64_t nNow = EngineMetrics::now();
+		const unsigned long long nNowAllocations = nAllocations;
+		Cycle& cycle = cycles[ nCycle ];
+		cycle.nDurationNs = nNow - nCycleStart;
+		cycle.nAllocations = nNowAllocations - nCycleAllocations;
+		cycle.nVoices = pAudioEngine->getSampler()->getPlayingNotesNumber();
+		++nCycle;
+		nCycleStart = EngineMetrics::now();
+		nCycleAllocations = nAllocations;
+		return nCycle < nTotalCycles;
+	} );
+
+	nCycleStart = EngineMetrics::now();
+	nCycleAllocations = nAllocations;
+	pAudioEngine->play();
+
+	pDriver->setCycleCallback( nullptr );
+	pAudioEngine->setOfflineMode( false );
+	pAudioEngine->getSampler()->setInterpolateMode( Interpolation::InterpolateMode::Linear );
+
+	if ( nCycle < nTotalCycles ) {
+		___ERRORLOG( QString( "Song [%1] stopped after %2 cycles" )
+					 .arg( sSongPath ).arg( nCycle ) );
+		return QJsonObject();
+	}
+
+	// Only the measured cycles are evaluated.
+	std::vector<int64_t> durations;
+	int64_t nTotalNs = 0;
+	int64_t nMaxNs = 0;
+	unsigned long long nTotalAllocations = 0;
+	unsigned long long nMaxAllocations = 0;
+	long long nTotalVoices = 0;
+	int nMaxVoices = 0;
+	for ( int ii = options.nWarmupCycles; ii < nTotalCycles; ++ii ) {
+		const Cycle& cycle = cycles[ ii ];
+		durations.push_back( cycle.nDurationNs );
+		nTotalNs += cycle.nDurationNs;
+		nMaxNs = std::max( nMaxNs, cycle.nDurationNs );
+		nTotalAllocations += cycle.nAllocations;
+		nMaxAllocations = std::max( nMaxAllocations, cycle.nAllocations );
+		nTotalVoices += cycle.nVoices;
+		nMaxVoices = std::max( nMaxVoices, cycle.nVoices );
+	}
+	std::sort( durations.begin(), durations.end() );
+	auto percentileUs = [&]( double fPercentile ) {
+		int nIndex = std::min( static_cast<int>( fPercentile * durations.size() ),
+							   static_cast<int>( durations.size() ) - 1 );
+		return durations[ nIndex ] / 1000.0;
+	};
+
+	const double fFrames = static_cast<double>( options.nCycles ) * pDriver->getBufferSize();
+	const double fAudioNs = fFrames / pDriver->getSampleRate() * 1e9;
+	const double fRealtimeFactor = nTotalNs > 0 ? fAudioNs / nTotalNs : 0;
+	const double fMeanVoices = static_cast<double>( nTotalVoices ) / options.nCycles;
+	// The audio thread and all sampler workers render voices.
+	const int nCores = 1 + Preferences::get_instance()->m_nSamplerWorkerThreads;
+
+	QJsonObject result;
+	result[ "song" ] = QFileInfo( sSongPath ).fileName();
+	result[ "scenario" ] = scenario.sName;
+	result[ "cycles" ] = options.nCycles;
+	result[ "ns_per_frame" ] = nTotalNs / fFrames;
+	result[ "realtime_factor" ] = fRealtimeFactor;
+	result[ "cycle_mean_us" ] = nTotalNs / 1000.0 / options.nCycles;
+	result[ "cycle_p50_us" ] = percentileUs( 0.5 );
+	result[ "cycle_p99_us" ] = percentileUs( 0.99 );
+	result[ "cycle_max_us" ] = nMaxNs / 1000.0;
+	result[ "voices_mean" ] = fMeanVoices;
+	result[ "voices_max" ] = nMaxVoices;
+	// Voices which could be rendered in realtime on a single core.
+	result[ "voices_per_core" ] = fMeanVoices * fRealtimeFactor / nCores;
+	result[ "allocations_per_cycle" ] = static_cast<double>( nTotalAllocations ) / options.nCycles;
+	result[ "allocations_max" ] = static_cast<double>( nMaxAllocations );
+	return result;
+}
+
+/** \return Songs found in @a sDir.*/
+static QStringList songsIn( const QString& sDir )
+{
+	QStringList songs;
+	QDir dir( sDir );
+	for ( const auto& sFile : dir.entryList( QStringList() << "*.h2song", QDir::Files, QDir::Name ) ) {
+		songs << dir.absoluteFilePath( sFile );
+	}
+	return songs;
+}
+
+int main( int argc, char** argv )
+{
+	QCoreApplication app( argc, argv );
+
+	QCommandLineParser parser;
+	parser.setApplicationDescription( "Renders songs using the FakeDriver and reports the performance of the audio engine as JSON." );
+	QCommandLineOption cyclesOption( QStringList() << "c" << "cycles", "Number of measured cycles per run (default: 2000)", "Cycles", "2000" );
+	QCommandLineOption warmupOption( QStringList() << "w" << "warmup", "Number of cycles rendered before measuring (default: 100)", "Cycles", "100" );
+	QCommandLineOption bufferSizeOption( QStringList() << "b" << "buffer-size", "Frames per cycle (default: 1024)", "Frames", "1024" );
+	QCommandLineOption threadsOption( QStringList() << "t" << "threads", "Number of sampler worker threads (default: 0)", "Threads", "0" );
+	QCommandLineOption seedOption( QStringList() << "s" << "seed", "Seed of the random number generator (default: 1)", "Seed", "1" );
+	QCommandLineOption scenarioOption( QStringList() << "S" << "scenario", "Only run scenarios containing this string. May be given more than once.", "Name" );
+	QCommandLineOption outputOption( QStringList() << "o" << "output", "Write the results to this file instead of stdout", "File" );
+	QCommandLineOption listOption( QStringList() << "l" << "list", "List all scenarios and exit" );
+	QCommandLineOption verboseOption( QStringList() << "V" << "verbose", "Level, if present, may be None, Error, Warning, Info, Debug or 0xHHHH", "Level" );
+	parser.addHelpOption();
+	parser.addOption( cyclesOption );
+	parser.addOption( warmupOption );
+	parser.addOption( bufferSizeOption );
+	parser.addOption( threadsOption );
+	parser.addOption( seedOption );
+	parser.addOption( scenarioOption );
+	parser.addOption( outputOption );
+	parser.addOption( listOption );
+	parser.addOption( verboseOption );
+	parser.addPositionalArgument( "songs", "Songs to render. Defaults to the demo songs and the songs of the functional tests.", "[songs...]" );
+	parser.process( app );
+
+	std::vector<Scenario> scenarios;
+	const QStringList scenarioFilters = parser.values( scenarioOption );
+	for ( const auto& scenario : createScenarios() ) {
+		bool bSelected = scenarioFilters.isEmpty();
+		for ( const auto& sFilter : scenarioFilters ) {
+			bSelected = bSelected || scenario.sName.contains( sFilter );
+		}
+		if ( bSelected ) {
+			scenarios.push_back( scenario );
+		}
+	}
+	if ( parser.isSet( listOption ) ) {
+		for ( const auto& scenario : scenarios ) {
+			std::cout << scenario.sName.toLocal8Bit().constData() << std::endl;
+		}
+		return 0;
+	}
+
+	Options options;
+	options.nCycles = std::max( parser.value( cyclesOption ).toInt(), 1 );
+	options.nWarmupCycles = std::max( parser.value( warmupOption ).toInt(), 0 );
+	options.nSeed = parser.value( seedOption ).toUInt();
+	const int nBufferSize = parser.value( bufferSizeOption ).toInt();
+	if ( nBufferSize <= 0 ) {
+		std::cerr << "Invalid buffer size" << std::endl;
+		return 1;
+	}
+
+	// Source tree to take the default corpus and the data from.
+	QString sSourceDir = qgetenv( "H2_HOME" );
+	if ( sSourceDir.isEmpty() ) {
+		sSourceDir = H2_BENCHMARK_SOURCE_DIR;
+	}
+
+	QStringList songs = parser.positionalArguments();
+	if ( songs.isEmpty() ) {
+		songs << songsIn( sSourceDir + "/data/demo_songs" )
+			  << songsIn( sSourceDir + "/src/tests/data/functional" );
+	}
+	if ( songs.isEmpty() ) {
+		std::cerr << "No songs found. Consider setting the H2_HOME environment variable." << std::endl;
+		return 1;
+	}
+
+	unsigned logLevelOpt = Logger::Error;
+	if ( parser.isSet( verboseOption ) ) {
+		logLevelOpt = parser.value( verboseOption ).isEmpty() ?
+			( Logger::Error | Logger::Warning ) :
+			Logger::parse_log_level( parser.value( verboseOption ).toLocal8Bit() );
+	}
+	Logger* pLogger = Logger::bootstrap( logLevelOpt );
+	Base::bootstrap( pLogger, false );
+	Filesystem::bootstrap( pLogger, sSourceDir + "/data/" );
+
+	Preferences::create_instance();
+	Preferences* pPref = Preferences::get_instance();
+	pPref->m_sAudioDriver = "Fake";
+	pPref->m_nBufferSize = nBufferSize;
+	pPref->m_nSamplerWorkerThreads = std::max( parser.value( threadsOption ).toInt(), 0 );
+	// Caching would make the loading time vary between runs, which
+	// is not measured anyway, and write to the user's cache.
+	pPref->m_bUseSampleCache = false;
+
+	Hydrogen::create_instance();
+	AudioOutput* pDriver = Hydrogen::get_instance()->getAudioEngine()->getAudioDriver();
+
+	QJsonArray results;
+	for ( const auto& sSong : songs ) {
+		for ( const auto& scenario : scenarios ) {
+			___INFOLOG( QString( "Running [%1] on [%2]" ).arg( scenario.sName ).arg( sSong ) );
+			QJsonObject result = runBenchmark( sSong, scenario, options );
+			if ( ! result.isEmpty() ) {
+				results.append( result );
+			}
+		}
+	}
+
+	QJsonObject report;
+	report[ "version" ] = QString::fromStdString( get_version() );
+	report[ "buffer_size" ] = static_cast<int>( pDriver->getBufferSize() );
+	report[ "sample_rate" ] = static_cast<int>( pDriver->getSampleRate() );
+	report[ "sampler_worker_threads" ] = pPref->m_nSamplerWorkerThreads;
+	report[ "seed" ] = static_cast<int>( options.nSeed );
+	report[ "warmup_cycles" ] = options.nWarmupCycles;
+	report[ "results" ] = results;
+	const QByteArray json = QJsonDocument( report ).toJson();
+
+	if ( parser.isSet( outputOption ) ) {
+		QFile file( parser.value( outputOption ) );
+		if ( ! file.open( QIODevice::WriteOnly ) || file.write( json ) != json.size() ) {
+			std::cerr << "Unable to write " << parser.value( outputOption ).toLocal8Bit().constData() << std::endl;
+			return 1;
+		}
+	} else {
+		std::cout << json.constData();
+	}
+
+	Hydrogen* pHydrogen = Hydrogen::get_instance();
+	if ( pHydrogen->getAudioEngine()->getState() == AudioEngine::State::Playing ) {
+		pHydrogen->sequencer_stop();
+	}
+	delete pHydrogen;
+	delete Preferences::get_instance();
+	delete Logger::get_instance();
+
+	return 0;
+}
@@ -20,7 +20,12 @@
  *
  */
 
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
 #include <QLibraryInfo>
+#include <QProcess>
+#include <QTextStream>
 #include <QThread>
 #include <core/config.h>
 #include <core/Version.h>
@@ -44,8 +49,12 @@
 #include <core/Sampler/Interpolation.h>
 #include <core/Helpers/Filesystem.h>
 
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
 #include <iostream>
 #include <signal.h>
+#include <vector>
 
 using namespace H2Core;
 
@@ -69,6 +78,14 @@ static struct option long_opts[] = {
 	{"help", 0, nullptr, 'h'},
 	{"install", required_argument, nullptr, 'i'},
 	{"drumkit", required_argument, nullptr, 'k'},
+	{"batch", required_argument, nullptr, 'B'},
+	{"jobs", required_argument, nullptr, 'j'},
+	{"batch-part", required_argument, nullptr, 'P'},
+	{"compression", required_argument, nullptr, 'C'},
+	{"dither", 0, nullptr, 'D'},
+	{"export-threads", required_argument, nullptr, 'T'},
+	{"sample-cache", 0, nullptr, 'c'},
+	{"metrics", required_argument, nullptr, 'M'},
 	{nullptr, 0, nullptr, 0},
 };
 
@@ -106,10 +123,162 @@ void show_playlist (uint active )
 	std::cout << std::endl;
 }
 
+/** Export of a single song in batch mode.*/
+struct BatchJob {
+	QString sSong;
+	/** The format is derived from the extension, as for --outfile.*/
+	QString sOutfile;
+	int nRate;
+	short nBits;
+};
+
+/**
+ * Reads a batch manifest. Each line holds a job consisting of the
+ * song, the output file, and optionally the sample rate and the
+ * sample depth, separated by tabs. Empty lines and lines starting
+ * with '#' are ignored. Relative paths are resolved against the
+ * folder of the manifest.
+ */
+bool readBatchManifest( const QString& sManifest, int nRate, short nBits, std::vector<BatchJob>& jobs )
+{
+	QFile file( sManifest );
+	if ( ! file.open( QIODevice::ReadOnly | QIODevice::Text ) ) {
+		std::cerr << "Unable to open batch manifest " << sManifest.toLocal8Bit().constData() << std::endl;
+		return false;
+	}
+
+	QDir manifestDir = QFileInfo( sManifest ).absoluteDir();
+	QTextStream stream( &file );
+	int nLine = 0;
+	while ( ! stream.atEnd() ) {
+		QString sLine = stream.readLine();
+		++nLine;
+		if ( sLine.trimmed().isEmpty() || sLine.trimmed().startsWith( '#' ) ) {
+			continue;
+		}
+
+		QStringList fields = sLine.split( '\t' );
+		if ( fields.size() < 2 || fields.size() > 4 ) {
+			std::cerr << "Invalid job in line " << nLine << " of batch manifest" << std::endl;
+			return false;
+		}
+
+		BatchJob job;
+		job.sSong = manifestDir.absoluteFilePath( fields[ 0 ].trimmed() );
+		job.sOutfile = manifestDir.absoluteFilePath( fields[ 1 ].trimmed() );
+		job.nRate = fields.size() > 2 ? fields[ 2 ].trimmed().toInt() : nRate;
+		job.nBits = fields.size() > 3 ? fields[ 3 ].trimmed().toShort() : nBits;
+		if ( job.nRate <= 0 || job.nBits <= 0 ) {
+			std::cerr << "Invalid rate or depth in line " << nLine << " of batch manifest" << std::endl;
+			return false;
+		}
+		jobs.push_back( job );
+	}
+	return true;
+}
+
+/**
+ * Exports the jobs @a nPart, @a nPart + @a nParts, ... one after
+ * another using the already running engine. Preferences, drivers,
+ * and plugins are thus set up only once for all of them.
+ *
+ * \return Number of failed jobs.
+ */
+int runBatch( const std::vector<BatchJob>& jobs, int nPart, int nParts )
+{
+	Hydrogen* pHydrogen = Hydrogen::get_instance();
+	EventQueue* pQueue = EventQueue::get_instance();
+	int nFailed = 0;
+
+	for ( int nJob = nPart; nJob < jobs.size() && ! quit; nJob += nParts ) {
+		const BatchJob& job = jobs[ nJob ];
+		const QString sPrefix = QString( "[%1/%2] " ).arg( nJob + 1 ).arg( jobs.size() );
+		const auto start = std::chrono::steady_clock::now();
+
+		std::shared_ptr<Song> pSong = Song::load( job.sSong );
+		if ( pSong == nullptr ) {
+			std::cerr << sPrefix.toLocal8Bit().constData() << "Unable to load "
+					  << job.sSong.toLocal8Bit().constData() << std::endl;
+			++nFailed;
+			continue;
+		}
+		pHydrogen->setSong( pSong );
+
+		InstrumentList *pInstrumentList = pSong->getInstrumentList();
+		for (auto i = 0; i < pInstrumentList->size(); i++) {
+			pInstrumentList->get(i)->set_currently_exported( true );
+		}
+
+		if ( ! pHydrogen->startExportSession( job.nRate, job.nBits ) ) {
+			std::cerr << sPrefix.toLocal8Bit().constData() << "Unable to export "
+					  << job.sSong.toLocal8Bit().constData() << std::endl;
+			++nFailed;
+			continue;
+		}
+		pHydrogen->startExportSong( job.sOutfile );
+		std::cout << sPrefix.toLocal8Bit().constData() << job.sSong.toLocal8Bit().constData()
+				  << " -> " << job.sOutfile.toLocal8Bit().constData() << std::endl;
+
+		// Progress is reported in steps of 10% to keep the output of
+		// several workers readable.
+		int nReported = 0;
+		bool bDone = false;
+		while ( ! bDone ) {
+			Event event = pQueue->pop_event();
+			if ( event.type == EVENT_PROGRESS ) {
+				if ( event.value >= 100 ) {
+					bDone = true;
+				} else if ( event.value / 10 > nReported ) {
+					nReported = event.value / 10;
+					std::cout << sPrefix.toLocal8Bit().constData() << event.value << "%" << std::endl;
+				}
+			} else if ( event.type == EVENT_NONE ) {
+				Sleeper::msleep( 10 );
+			}
+		}
+		pHydrogen->stopExportSession();
+
+		const double fSeconds = std::chrono::duration<double>(
+			std::chrono::steady_clock::now() - start ).count();
+		std::cout << sPrefix.toLocal8Bit().constData() << "DONE in " << fSeconds << " s" << std::endl;
+	}
+
+	return nFailed;
+}
+
+/**
+ * Runs @a nWorkers copies of h2cli, each exporting a part of the
+ * batch manifest, and waits for all of them to finish.
+ *
+ * \return Number of failed workers.
+ */
+int spawnBatchWorkers( const QString& sProgram, const QStringList& arguments, int nWorkers )
+{
+	std::vector<QProcess*> workers;
+	for ( int ii = 0; ii < nWorkers; ++ii ) {
+		QProcess* pWorker = new QProcess();
+		pWorker->setProcessChannelMode( QProcess::ForwardedChannels );
+		pWorker->start( sProgram, QStringList( arguments )
+						<< "--batch-part" << QString( "%1:%2" ).arg( ii ).arg( nWorkers ) );
+		workers.push_back( pWorker );
+	}
+
+	int nFailed = 0;
+	for ( auto pWorker : workers ) {
+		if ( ! pWorker->waitForFinished( -1 ) ||
+			 pWorker->exitStatus() != QProcess::NormalExit || pWorker->exitCode() != 0 ) {
+			++nFailed;
+		}
+		delete pWorker;
+	}
+	return nFailed;
+}
+
 #define NELEM(a) ( sizeof(a)/sizeof((a)[0]) )
 
 int main(int argc, char *argv[])
 {
+	int nReturnValue = 0;
 	try {
 		// Options...
 		char *cp;
@@ -141,6 +310,15 @@ int main(int argc, char *argv[])
 		short bits = 16;
 		int rate = 44100;
 		short interpolation = 0;
+		QString sBatchManifest;
+		int nBatchJobs = 1;
+		int nBatchPart = 0;
+		int nBatchParts = 1;
+		float fCompressionLevel = -1;
+		bool bDither = false;
+		int nExportThreads = -1;
+		bool bSampleCache = false;
+		QString sMetricsFile;
 #ifdef H2CORE_HAVE_JACKSESSION
 		QString sessionId;
 #endif
@@ -176,6 +354,36 @@ int main(int argc, char *argv[])
 			case 'b':
 				bits = strtol(optarg, nullptr, 10);
 				break;
+			case 'B':
+				sBatchManifest = QString::fromLocal8Bit(optarg);
+				break;
+			case 'j':
+				nBatchJobs = std::max( static_cast<int>( strtol(optarg, nullptr, 10) ), 1 );
+				break;
+			case 'P':
+				// Used internally to hand a part of the batch to a
+				// worker process.
+				if ( sscanf( optarg, "%d:%d", &nBatchPart, &nBatchParts ) != 2 ||
+					 nBatchParts < 1 || nBatchPart < 0 || nBatchPart >= nBatchParts ) {
+					nBatchPart = 0;
+					nBatchParts = 1;
+				}
+				break;
+			case 'C':
+				fCompressionLevel = std::min( std::max( strtof(optarg, nullptr), 0.0f ), 1.0f );
+				break;
+			case 'D':
+				bDither = true;
+				break;
+			case 'T':
+				nExportThreads = std::max( static_cast<int>( strtol(optarg, nullptr, 10) ), 0 );
+				break;
+			case 'c':
+				bSampleCache = true;
+				break;
+			case 'M':
+				sMetricsFile = QString::fromLocal8Bit(optarg);
+				break;
 			case 'v':
 				showVersionOpt = true;
 				break;
@@ -199,12 +407,58 @@ int main(int argc, char *argv[])
 			exit(0);
 		}
 
-		showInfo();
+		if ( nBatchParts == 1 ) {
+			showInfo();
+		}
 		if ( showHelpOpt ) {
 			showUsage();
 			exit(0);
 		}
 
+		std::vector<BatchJob> batchJobs;
+		if ( ! sBatchManifest.isEmpty() ) {
+			if ( ! readBatchManifest( sBatchManifest, rate, bits, batchJobs ) ) {
+				return 1;
+			}
+
+			// Each worker is a separate process with its own engine
+			// exporting every n-th job.
+			nBatchJobs = std::min( nBatchJobs, static_cast<int>( batchJobs.size() ) );
+			if ( nBatchJobs > 1 ) {
+				QStringList arguments;
+				arguments << "--batch" << sBatchManifest
+						  << "--rate" << QString::number( rate )
+						  << "--bits" << QString::number( bits )
+						  << QString( "--verbose=%1" ).arg( logLevelOpt );
+				if ( ! sSelectedDriver.isEmpty() ) {
+					arguments << "--driver" << sSelectedDriver;
+				}
+				if ( fCompressionLevel >= 0 ) {
+					arguments << "--compression" << QString::number( fCompressionLevel );
+				}
+				if ( bDither ) {
+					arguments << "--dither";
+				}
+				if ( nExportThreads >= 0 ) {
+					arguments << "--export-threads" << QString::number( nExportThreads );
+				}
+				if ( bSampleCache ) {
+					arguments << "--sample-cache";
+				}
+				if ( ! sMetricsFile.isEmpty() ) {
+					arguments << "--metrics" << sMetricsFile;
+				}
+
+				const auto start = std::chrono::steady_clock::now();
+				const int nFailed = spawnBatchWorkers( QString::fromLocal8Bit( argv[0] ), arguments, nBatchJobs );
+				const double fSeconds = std::chrono::duration<double>(
+					std::chrono::steady_clock::now() - start ).count();
+				std::cout << "Exported " << batchJobs.size() << " songs using " << nBatchJobs
+						  << " workers in " << fSeconds << " s" << std::endl;
+				return nFailed > 0 ? 1 : 0;
+			}
+		}
+
 		// Man your battle stations... this is not a drill.
 		Logger* logger = Logger::bootstrap( Logger::parse_log_level( logLevelOpt ) );
 		Base::bootstrap( logger, logger->should_log( Logger::Debug ) );
@@ -230,6 +484,36 @@ int main(int argc, char *argv[])
 			exit(0);
 		}
 
+		// The encoder settings only apply to this run.
+		const float fOldCompressionLevel = preferences->m_fExportCompressionLevel;
+		const bool bOldExportDither = preferences->m_bExportDither;
+		const int nOldExportWorkerThreads = preferences->m_nExportWorkerThreads;
+		if ( fCompressionLevel >= 0 ) {
+			preferences->m_fExportCompressionLevel = fCompressionLevel;
+		}
+		if ( bDither ) {
+			preferences->m_bExportDither = true;
+		}
+		if ( nExportThreads >= 0 ) {
+			preferences->m_nExportWorkerThreads = nExportThreads;
+		}
+
+		// Songs sharing a drumkit - both within this process and
+		// across the workers of a batch - map the decoded samples
+		// from the persistent cache instead of decoding them again.
+		const bool bOldUseSampleCache = preferences->m_bUseSampleCache;
+		if ( bSampleCache ) {
+			preferences->m_bUseSampleCache = true;
+		}
+
+		// Batch exports do not need an audio device at all.
+		const QString sOldAudioDriver = preferences->m_sAudioDriver;
+		if ( ! sBatchManifest.isEmpty() ) {
+			if ( sSelectedDriver.isEmpty() ) {
+				preferences->m_sAudioDriver = "Fake";
+			}
+		}
+
 		if (sSelectedDriver == "auto") {
 			preferences->m_sAudioDriver = "Auto";
 		}
@@ -326,7 +610,7 @@ int main(int argc, char *argv[])
 				/* Try load last song */
 				bool restoreLastSong = preferences->isRestoreLastSongEnabled();
 				QString filename = preferences->getLastSongFilename();
-				if ( restoreLastSong && ( !filename.isEmpty() )) {
+				if ( restoreLastSong && ( !filename.isEmpty() ) && sBatchManifest.isEmpty() ) {
 					pSong = Song::load( filename );
 				}
 			}
@@ -377,7 +661,23 @@ int main(int argc, char *argv[])
 
 		
 		bool ExportMode = false;
-		if ( ! outFilename.isEmpty() ) {
+		if ( ! sBatchManifest.isEmpty() ) {
+			const auto start = std::chrono::steady_clock::now();
+			const int nFailed = runBatch( batchJobs, nBatchPart, nBatchParts );
+			if ( nBatchParts == 1 ) {
+				const double fSeconds = std::chrono::duration<double>(
+					std::chrono::steady_clock::now() - start ).count();
+				std::cout << "Exported " << batchJobs.size() - nFailed << " of "
+						  << batchJobs.size() << " songs in " << fSeconds << " s" << std::endl;
+			}
+			nReturnValue = std::min( nFailed, 255 );
+			quit = true;
+
+			if ( sSelectedDriver.isEmpty() ) {
+				preferences->m_sAudioDriver = sOldAudioDriver;
+			}
+		}
+		else if ( ! outFilename.isEmpty() ) {
 			InstrumentList *pInstrumentList = pSong->getInstrumentList();
 			for (auto i = 0; i < pInstrumentList->size(); i++) {
 				pInstrumentList->get(i)->set_currently_exported( true );
@@ -443,7 +743,19 @@ int main(int argc, char *argv[])
 		pSong = nullptr;
 		delete pPlaylist;
 
+		if ( ! sMetricsFile.isEmpty() ) {
+			// Each worker of a batch writes its own file.
+			if ( nBatchParts > 1 ) {
+				sMetricsFile.append( QString( ".%1" ).arg( nBatchPart ) );
+			}
+			pHydrogen->getAudioEngine()->getMetrics().writeToFile( sMetricsFile );
+		}
+
 		delete pQueue;
+		preferences->m_fExportCompressionLevel = fOldCompressionLevel;
+		preferences->m_bExportDither = bOldExportDither;
+		preferences->m_nExportWorkerThreads = nOldExportWorkerThreads;
+		preferences->m_bUseSampleCache = bOldUseSampleCache;
 		preferences->savePreferences();
 		delete pHydrogen;
 		delete preferences;
@@ -467,7 +779,7 @@ int main(int argc, char *argv[])
 		std::cerr << "[main] Unknown exception X-(" << std::endl;
 	}
 
-	return 0;
+	return nReturnValue;
 }
 
 /* Show some information */
@@ -497,6 +809,16 @@ void showUsage()
 	std::cout << "   -o, --outfile FILE - Output to file (export)" << std::endl;
 	std::cout << "   -r, --rate RATE - Set bitrate while exporting file" << std::endl;
 	std::cout << "   -b, --bits BITS - Set bits depth while exporting file" << std::endl;
+	std::cout << "   -B, --batch FILE - Export all jobs listed in FILE, one per line:" << std::endl;
+	std::cout << "       SONG<tab>OUTFILE[<tab>RATE[<tab>BITS]]" << std::endl;
+	std::cout << "   -j, --jobs N - Number of processes exporting the batch concurrently" << std::endl;
+	std::cout << "   -C, --compression LEVEL - FLAC/Ogg compression level while exporting," << std::endl;
+	std::cout << "       from 0 (fastest) to 1 (smallest). Defaults to the one of libsndfile" << std::endl;
+	std::cout << "   -D, --dither - Dither when exporting to 8, 16, or 24 bit" << std::endl;
+	std::cout << "   -T, --export-threads N - Number of additional threads rendering the" << std::endl;
+	std::cout << "       instruments of an export in parallel" << std::endl;
+	std::cout << "   -c, --sample-cache - Map decoded samples from the sample cache for this run" << std::endl;
+	std::cout << "   -M, --metrics FILE - Write timing statistics of the audio engine to FILE on exit" << std::endl;
 	std::cout << "   -k, --kit drumkit_name - Load a drumkit at startup" << std::endl;
 	std::cout << "   -i, --install FILE - install a drumkit (*.h2drumkit)" << std::endl;
 	std::cout << "   -I, --interpolate INT - Interpolation" << std::endl;
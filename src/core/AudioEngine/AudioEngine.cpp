@@ -40,6 +40,7 @@
 #include <core/Basics/InstrumentList.h>
 #include <core/Basics/InstrumentLayer.h>
 #include <core/Basics/InstrumentComponent.h>
+#include <core/Basics/PreparedDrumkit.h>
 #include <core/Sampler/Sampler.h>
 #include <core/Helpers/Filesystem.h>
 
@@ -87,20 +88,16 @@ inline float getGaussian( float z )
 	return x1 * w * z + 0.0; // tunable
 }
 
-
-/** Gets the current time.
- * \return Current time obtained by gettimeofday()*/
-inline timeval currentTime2()
-{
-	struct timeval now;
-	gettimeofday( &now, nullptr );
-	return now;
-}
-
 AudioEngine::AudioEngine()
 		: TransportInfo()
 		, m_pSampler( nullptr )
 		, m_pSynth( nullptr )
+		, m_pNotePool( nullptr )
+		, m_pNoteScheduler( nullptr )
+		, m_commandQueue( 1024 )
+		, m_garbageNotes( 1024 )
+		, m_pPendingDrumkit( nullptr )
+		, m_bOfflineMode( false )
 		, m_fElapsedTime( 0 )
 		, m_pAudioDriver( nullptr )
 		, m_pMidiDriver( nullptr )
@@ -110,6 +107,7 @@ AudioEngine::AudioEngine()
 		, m_nPatternStartTick( -1 )
 		, m_nPatternTickPosition( 0 )
 		, m_nSongSizeInTicks( 0 )
+		, m_bSongCompilationRequested( false )
 		, m_nRealtimeFrames( 0 )
 		, m_nAddRealtimeNoteTickPosition( 0 )
 		, m_fMasterPeak_L( 0.0f )
@@ -123,7 +121,12 @@ AudioEngine::AudioEngine()
 		, m_fNextBpm( 120 )
 {
 
-	m_pSampler = new Sampler;
+	// Besides the notes currently rendered by the Sampler the pool
+	// has to cover the ones already queued for the upcoming cycles.
+	m_pNotePool = new NotePool( 2 * Preferences::get_instance()->m_nMaxNotes );
+	m_pNoteScheduler = new NoteScheduler( 64, 2 * Preferences::get_instance()->m_nMaxNotes );
+	m_dueNotes.reserve( 2 * Preferences::get_instance()->m_nMaxNotes );
+	m_pSampler = new Sampler( m_pNotePool );
 	m_pSynth = new Synth;
 	
 	m_pEventQueue = EventQueue::get_instance();
@@ -145,6 +148,8 @@ AudioEngine::AudioEngine()
 	m_pPlayingPatterns->setNeedsLock( true );
 	m_pNextPatterns = new PatternList();
 	m_pNextPatterns->setNeedsLock( true );
+	m_pCompiledSong = new CompiledSong();
+	m_songCompiler.start( [this]() { compileSongLoop(); } );
 	
 	m_AudioProcessCallback = &audioEngine_process;
 
@@ -156,6 +161,7 @@ AudioEngine::AudioEngine()
 
 AudioEngine::~AudioEngine()
 {
+	m_songCompiler.stop();
 	stopAudioDrivers();
 	if ( getState() != State::Initialized ) {
 		___ERRORLOG( "Error the audio engine is not in State::Initialized" );
@@ -179,9 +185,14 @@ AudioEngine::~AudioEngine()
 	delete m_pNextPatterns;
 	m_pNextPatterns = nullptr;
 
+	delete m_pCompiledSong;
+	m_pCompiledSong = nullptr;
+
 	m_pMetronomeInstrument = nullptr;
 
 	this->unlock();
+
+	collectGarbage();
 	
 #ifdef H2CORE_HAVE_LADSPA
 	delete Effects::get_instance();
@@ -190,6 +201,8 @@ AudioEngine::~AudioEngine()
 //	delete Sequencer::get_instance();
 	delete m_pSampler;
 	delete m_pSynth;
+	delete m_pNoteScheduler;
+	delete m_pNotePool;
 }
 
 Sampler* AudioEngine::getSampler() const
@@ -204,6 +217,12 @@ Synth* AudioEngine::getSynth() const
 	return m_pSynth;
 }
 
+NotePool* AudioEngine::getNotePool() const
+{
+	assert(m_pNotePool);
+	return m_pNotePool;
+}
+
 void AudioEngine::lock( const char* file, unsigned int line, const char* function )
 {
 	#ifdef H2CORE_HAVE_DEBUG
@@ -468,6 +487,11 @@ void AudioEngine::clearAudioBuffers( uint32_t nFrames )
 	}
 #endif
 
+	auto pDiskWriterDriver = dynamic_cast<DiskWriterDriver*>( m_pAudioDriver );
+	if ( pDiskWriterDriver != nullptr ) {
+		pDiskWriterDriver->clearStemBuffers( nFrames );
+	}
+
 	mx.unlock();
 
 #ifdef H2CORE_HAVE_LADSPA
@@ -643,6 +667,9 @@ void AudioEngine::setAudioDriver( AudioOutput* pAudioDriver ) {
 
 	m_pAudioDriver = pAudioDriver;
 
+	// The buckets of the scheduler cover one cycle each.
+	m_pNoteScheduler->setBucketSize( m_pAudioDriver->getBufferSize() );
+
 	// change the current audio engine state
 	Hydrogen* pHydrogen = Hydrogen::get_instance();
 	std::shared_ptr<Song> pSong = pHydrogen->getSong();
@@ -699,6 +726,9 @@ void AudioEngine::stopAudioDrivers()
 
 	this->lock( RIGHT_HERE );
 
+	// Without a driver nobody would pick up the remaining commands.
+	processCommands();
+
 	// change the current audio engine state
 	m_state = State::Initialized;
 	m_pEventQueue->push_event( EVENT_STATE, static_cast<int>(State::Initialized) );
@@ -881,9 +911,13 @@ void AudioEngine::processPlayNotes( unsigned long nframes )
 	AutomationPath *vp = pSong->getVelocityAutomationPath();
 	
 
-	// reading from m_songNoteQueue
-	while ( !m_songNoteQueue.empty() ) {
-		Note *pNote = m_songNoteQueue.top();
+	// All notes starting - taking negative humanize delays into
+	// account - before the end of the current cycle. Positive delays
+	// are handled by the Sampler.
+	m_pNoteScheduler->popDue( static_cast<long long>( framepos ) + nframes,
+							  getTickSize(), m_dueNotes );
+
+	for ( Note* pNote : m_dueNotes ) {
 
 		float velocity_adjustment = 1.0f;
 		if ( pHydrogen->getMode() == Song::Mode::Song ) {
@@ -891,98 +925,75 @@ void AudioEngine::processPlayNotes( unsigned long nframes )
 			velocity_adjustment = vp->get_value(fPos);
 		}
 
-		// verifico se la nota rientra in questo ciclo
-		unsigned int noteStartInFrames =
-			(int)( pNote->get_position() * getTickSize() );
-
-		// if there is a negative Humanize delay, take into account so
-		// we don't miss the time slice.  ignore positive delay, or we
-		// might end the queue processing prematurely based on NoteQueue
-		// placement.  the sampler handles positive delay.
-		if (pNote->get_humanize_delay() < 0) {
-			noteStartInFrames += pNote->get_humanize_delay();
-		}
-
-		// m_nTotalFrames <= NotePos < m_nTotalFrames + bufferSize
-		bool isNoteStart = ( ( noteStartInFrames >= framepos )
-							 && ( noteStartInFrames < ( framepos + nframes ) ) );
-		bool isOldNote = noteStartInFrames < framepos;
-
-		if ( isNoteStart || isOldNote ) {
-			// Humanize - Velocity parameter
-			pNote->set_velocity( pNote->get_velocity() * velocity_adjustment );
-
-			/* Check if the current note has probability != 1
-			 * If yes remove call random function to dequeue or not the note
-			 */
-			float fNoteProbability = pNote->get_probability();
-			if ( fNoteProbability != 1. ) {
-				if ( fNoteProbability < (float) rand() / (float) RAND_MAX ) {
-					m_songNoteQueue.pop();
-					pNote->get_instrument()->dequeue();
-					continue;
-				}
+		// Humanize - Velocity parameter
+		pNote->set_velocity( pNote->get_velocity() * velocity_adjustment );
+
+		/* Check if the current note has probability != 1
+		 * If yes remove call random function to dequeue or not the note
+		 */
+		float fNoteProbability = pNote->get_probability();
+		if ( fNoteProbability != 1. ) {
+			if ( fNoteProbability < (float) rand() / (float) RAND_MAX ) {
+				pNote->get_instrument()->dequeue();
+				m_pNotePool->release( pNote );
+				continue;
 			}
+		}
 
-			if ( pSong->getHumanizeVelocityValue() != 0 ) {
-				float random = pSong->getHumanizeVelocityValue() * getGaussian( 0.2 );
-				pNote->set_velocity(
-							pNote->get_velocity()
-							+ ( random
-								- ( pSong->getHumanizeVelocityValue() / 2.0 ) )
-							);
-				if ( pNote->get_velocity() > 1.0 ) {
-					pNote->set_velocity( 1.0 );
-				} else if ( pNote->get_velocity() < 0.0 ) {
-					pNote->set_velocity( 0.0 );
-				}
+		if ( pSong->getHumanizeVelocityValue() != 0 ) {
+			float random = pSong->getHumanizeVelocityValue() * getGaussian( 0.2 );
+			pNote->set_velocity(
+						pNote->get_velocity()
+						+ ( random
+							- ( pSong->getHumanizeVelocityValue() / 2.0 ) )
+						);
+			if ( pNote->get_velocity() > 1.0 ) {
+				pNote->set_velocity( 1.0 );
+			} else if ( pNote->get_velocity() < 0.0 ) {
+				pNote->set_velocity( 0.0 );
 			}
+		}
 
-			// Offset + Random Pitch ;)
-			float fPitch = pNote->get_pitch() + pNote->get_instrument()->get_pitch_offset();
-			/* Check if the current instrument has random picth factor != 0.
-			 * If yes add a gaussian perturbation to the pitch
-			 */
-			float fRandomPitchFactor = pNote->get_instrument()->get_random_pitch_factor();
-			if ( fRandomPitchFactor != 0. ) {
-				fPitch += getGaussian( 0.4 ) * fRandomPitchFactor;
-			}
-			pNote->set_pitch( fPitch );
-
-
-			/*
-			 * Check if the current instrument has the property "Stop-Note" set.
-			 * If yes, a NoteOff note is generated automatically after each note.
-			 */
-			auto  noteInstrument = pNote->get_instrument();
-			if ( noteInstrument->is_stop_notes() ){
-				Note *pOffNote = new Note( noteInstrument,
-										   0.0,
-										   0.0,
-										   0.0,
-										   -1,
-										   0 );
+		// Offset + Random Pitch ;)
+		float fPitch = pNote->get_pitch() + pNote->get_instrument()->get_pitch_offset();
+		/* Check if the current instrument has random picth factor != 0.
+		 * If yes add a gaussian perturbation to the pitch
+		 */
+		float fRandomPitchFactor = pNote->get_instrument()->get_random_pitch_factor();
+		if ( fRandomPitchFactor != 0. ) {
+			fPitch += getGaussian( 0.4 ) * fRandomPitchFactor;
+		}
+		pNote->set_pitch( fPitch );
+
+
+		/*
+		 * Check if the current instrument has the property "Stop-Note" set.
+		 * If yes, a NoteOff note is generated automatically after each note.
+		 */
+		auto  noteInstrument = pNote->get_instrument();
+		if ( noteInstrument->is_stop_notes() ){
+			Note *pOffNote = m_pNotePool->acquire( noteInstrument,
+												   0.0,
+												   0.0,
+												   0.0,
+												   -1,
+												   0 );
+			if ( pOffNote != nullptr ) {
 				pOffNote->set_note_off( true );
 				pHydrogen->getAudioEngine()->getSampler()->noteOn( pOffNote );
-				delete pOffNote;
-			}
-
-			m_pSampler->noteOn( pNote );
-			m_songNoteQueue.pop(); // rimuovo la nota dalla lista di note
-			pNote->get_instrument()->dequeue();
-			// raise noteOn event
-			int nInstrument = pSong->getInstrumentList()->index( pNote->get_instrument() );
-			if( pNote->get_note_off() ){
-				delete pNote;
+				m_pNotePool->release( pOffNote );
 			}
+		}
 
-			m_pEventQueue->push_event( EVENT_NOTEON, nInstrument );
-			
-			continue;
-		} else {
-			// this note will not be played
-			break;
+		m_pSampler->noteOn( pNote );
+		pNote->get_instrument()->dequeue();
+		// raise noteOn event
+		int nInstrument = pSong->getInstrumentList()->index( pNote->get_instrument() );
+		if( pNote->get_note_off() ){
+			m_pNotePool->release( pNote );
 		}
+
+		m_pEventQueue->push_event( EVENT_NOTEON, nInstrument );
 	}
 }
 
@@ -1037,24 +1048,20 @@ void AudioEngine::processTransport( unsigned nFrames )
 
 void AudioEngine::clearNoteQueue()
 {
-	// delete all copied notes in the song notes queue
-	while (!m_songNoteQueue.empty()) {
-		m_songNoteQueue.top()->get_instrument()->dequeue();
-		delete m_songNoteQueue.top();
-		m_songNoteQueue.pop();
-	}
-
-	// delete all copied notes in the midi notes queue
-	for ( unsigned i = 0; i < m_midiNoteQueue.size(); ++i ) {
-		delete m_midiNoteQueue[i];
+	// delete all copied and MIDI notes still scheduled
+	m_pNoteScheduler->popAll( m_dueNotes );
+	for ( Note* pNote : m_dueNotes ) {
+		pNote->get_instrument()->dequeue();
+		m_pNotePool->release( pNote );
 	}
-	m_midiNoteQueue.clear();
+	m_dueNotes.clear();
 }
 
 int AudioEngine::audioEngine_process( uint32_t nframes, void* /*arg*/ )
 {
 	AudioEngine* pAudioEngine = Hydrogen::get_instance()->getAudioEngine();
-	timeval startTimeval = currentTime2();
+	EngineMetrics& metrics = pAudioEngine->m_metrics;
+	const int64_t nCycleStart = EngineMetrics::now();
 
 	// Resetting all audio output buffers with zeros.
 	pAudioEngine->clearAudioBuffers( nframes );
@@ -1075,6 +1082,9 @@ int AudioEngine::audioEngine_process( uint32_t nframes, void* /*arg*/ )
 		fSlackTime = 0.0;
 	}
 
+	metrics.beginCycle( static_cast<int64_t>( pAudioEngine->m_fMaxProcessTime * 1000000 ) );
+	int64_t nStageStart = EngineMetrics::now();
+
 	/*
 	 * The "try_lock" was introduced for Bug #164 (Deadlock after during
 	 * alsa driver shutdown). The try_lock *should* only fail in rare circumstances
@@ -1083,9 +1093,16 @@ int AudioEngine::audioEngine_process( uint32_t nframes, void* /*arg*/ )
 	 * writer driver to repeat the processing of the current data.
 	 */
 				
-	if ( !pAudioEngine->tryLockFor( std::chrono::microseconds( (int)(1000.0*fSlackTime) ),
+	if ( pAudioEngine->m_bOfflineMode ) {
+		// There is no deadline to meet.
+		pAudioEngine->lock( RIGHT_HERE );
+	}
+	else if ( !pAudioEngine->tryLockFor( std::chrono::microseconds( (int)(1000.0*fSlackTime) ),
 							  RIGHT_HERE ) ) {
 		___ERRORLOG( QString( "Failed to lock audioEngine in allowed %1 ms, missed buffer" ).arg( fSlackTime ) );
+		metrics.record( EngineMetrics::STAGE_LOCK_WAIT, nStageStart );
+		metrics.missedBuffer();
+		metrics.endCycle( nCycleStart, pAudioEngine->m_bOfflineMode );
 
 		if ( dynamic_cast<DiskWriterDriver*>(pAudioEngine->m_pAudioDriver) != nullptr ) {
 			return 2;	// inform the caller that we could not aquire the lock
@@ -1094,6 +1111,12 @@ int AudioEngine::audioEngine_process( uint32_t nframes, void* /*arg*/ )
 		return 0;
 	}
 
+	nStageStart = metrics.record( EngineMetrics::STAGE_LOCK_WAIT, nStageStart );
+
+	// Apply all requests of other threads first so e.g. previewed
+	// notes are rendered in this very cycle.
+	pAudioEngine->processCommands();
+
 	if ( pAudioEngine->getState() != AudioEngine::State::Ready &&
 		 pAudioEngine->getState() != AudioEngine::State::Playing ) {
 		pAudioEngine->unlock();
@@ -1115,6 +1138,7 @@ int AudioEngine::audioEngine_process( uint32_t nframes, void* /*arg*/ )
 
 	// Check whether the tick size has changed.
 	pAudioEngine->processCheckBPMChanged();
+	nStageStart = metrics.record( EngineMetrics::STAGE_TRANSPORT, nStageStart );
 
 	bool bSendPatternChange = false;
 	// always update note queue.. could come from pattern or realtime input
@@ -1140,31 +1164,37 @@ int AudioEngine::audioEngine_process( uint32_t nframes, void* /*arg*/ )
 
 	// play all notes
 	pAudioEngine->processPlayNotes( nframes );
+	nStageStart = metrics.record( EngineMetrics::STAGE_NOTE_QUEUE, nStageStart );
 
 	float *pBuffer_L = pAudioEngine->m_pAudioDriver->getOut_L(),
 		*pBuffer_R = pAudioEngine->m_pAudioDriver->getOut_R();
 	assert( pBuffer_L != nullptr && pBuffer_R != nullptr );
 
+	// The Sampler and the Synth render using a snapshot of the
+	// engine state taken once per cycle.
+	pAudioEngine->m_engineContext.update( pAudioEngine, pSong.get(), Preferences::get_instance(),
+										  pHydrogen->getIsExportSessionActive() );
+
 	// SAMPLER
-	pAudioEngine->getSampler()->process( nframes, pSong );
+	pAudioEngine->getSampler()->process( nframes, pAudioEngine->m_engineContext );
 	float* out_L = pAudioEngine->getSampler()->m_pMainOut_L;
 	float* out_R = pAudioEngine->getSampler()->m_pMainOut_R;
 	for ( unsigned i = 0; i < nframes; ++i ) {
 		pBuffer_L[ i ] += out_L[ i ];
 		pBuffer_R[ i ] += out_R[ i ];
 	}
+	metrics.setActiveVoices( pAudioEngine->getSampler()->getPlayingNotesNumber() );
+	nStageStart = metrics.record( EngineMetrics::STAGE_SAMPLER, nStageStart );
 
 	// SYNTH
-	pAudioEngine->getSynth()->process( nframes );
+	pAudioEngine->getSynth()->process( nframes, pAudioEngine->m_engineContext );
 	out_L = pAudioEngine->getSynth()->m_pOut_L;
 	out_R = pAudioEngine->getSynth()->m_pOut_R;
 	for ( unsigned i = 0; i < nframes; ++i ) {
 		pBuffer_L[ i ] += out_L[ i ];
 		pBuffer_R[ i ] += out_R[ i ];
 	}
-
-	timeval renderTime_end = currentTime2();
-	timeval ladspaTime_start = renderTime_end;
+	nStageStart = metrics.record( EngineMetrics::STAGE_SYNTH, nStageStart );
 
 #ifdef H2CORE_HAVE_LADSPA
 	// Process LADSPA FX
@@ -1193,10 +1223,10 @@ int AudioEngine::audioEngine_process( uint32_t nframes, void* /*arg*/ )
 					pAudioEngine->m_fFXPeak_R[nFX] = buf_R[ i ];
 				}
 			}
+			nStageStart = metrics.record( EngineMetrics::STAGE_LADSPA_FX + nFX, nStageStart );
 		}
 	}
 #endif
-	timeval ladspaTime_end = currentTime2();
 
 
 	// update master peaks
@@ -1234,21 +1264,18 @@ int AudioEngine::audioEngine_process( uint32_t nframes, void* /*arg*/ )
 		pAudioEngine->updateElapsedTime( nframes, pAudioEngine->m_pAudioDriver->getSampleRate() );
 	}
 
-	timeval finishTimeval = currentTime2();
+	metrics.record( EngineMetrics::STAGE_PEAKS, nStageStart );
 	pAudioEngine->m_fProcessTime =
-			( finishTimeval.tv_sec - startTimeval.tv_sec ) * 1000.0
-			+ ( finishTimeval.tv_usec - startTimeval.tv_usec ) / 1000.0;
+		metrics.endCycle( nCycleStart, pAudioEngine->m_bOfflineMode ) / 1000000.0;
 
 #ifdef CONFIG_DEBUG
-	if ( pAudioEngine->m_fProcessTime > m_fMaxProcessTime ) {
-		___WARNINGLOG( "" );
-		___WARNINGLOG( "----XRUN----" );
+	// The duration of the individual stages is available through
+	// getMetrics().
+	if ( ! pAudioEngine->m_bOfflineMode &&
+		 pAudioEngine->m_fProcessTime > pAudioEngine->m_fMaxProcessTime ) {
 		___WARNINGLOG( QString( "XRUN of %1 msec (%2 > %3)" )
-					   .arg( ( m_fProcessTime - pAudioEngine->m_fMaxProcessTime ) )
-					   .arg( m_fProcessTime ).arg( pAudioEngine->m_fMaxProcessTime ) );
-		___WARNINGLOG( QString( "Ladspa process time = %1" ).arg( fLadspaTime ) );
-		___WARNINGLOG( "------------" );
-		___WARNINGLOG( "" );
+					   .arg( ( pAudioEngine->m_fProcessTime - pAudioEngine->m_fMaxProcessTime ) )
+					   .arg( pAudioEngine->m_fProcessTime ).arg( pAudioEngine->m_fMaxProcessTime ) );
 		// raise xRun event
 		EventQueue::get_instance()->push_event( EVENT_XRUN, -1 );
 	}
@@ -1265,7 +1292,15 @@ int AudioEngine::audioEngine_process( uint32_t nframes, void* /*arg*/ )
 void AudioEngine::setSong( std::shared_ptr<Song> pNewSong )
 {
 	___WARNINGLOG( QString( "Set song: %1" ).arg( pNewSong->getName() ) );
-	
+
+	// The render plans are compiled within the process cycle.
+	InstrumentList* pInstrumentList = pNewSong->getInstrumentList();
+	for ( int ii = 0; ii < pInstrumentList->size(); ++ii ) {
+		auto pInstr = pInstrumentList->get( ii );
+		pInstr->getRenderPlan()->reserve( std::max( pInstr->get_components()->size(),
+													pNewSong->getComponents()->size() ) );
+	}
+
 	this->lock( RIGHT_HERE );
 
 	// check current state
@@ -1285,6 +1320,8 @@ void AudioEngine::setSong( std::shared_ptr<Song> pNewSong )
 		m_pPlayingPatterns->add( pNewSong->getPatternList()->get( 0 ) );
 	}
 
+	m_pCompiledSong->compile( pNewSong->getPatternGroupVector() );
+
 #ifdef H2CORE_HAVE_JACK
 	Hydrogen::get_instance()->renameJackPorts( pNewSong );
 #endif
@@ -1323,8 +1360,12 @@ void AudioEngine::removeSong()
 		return;
 	}
 
+	// Pattern indices of pending commands refer to the old song.
+	processCommands();
+
 	m_pPlayingPatterns->clear();
 	m_pNextPatterns->clear();
+	m_pCompiledSong->clear();
 	clearNoteQueue();
 	m_pSampler->stopPlayingNotes();
 
@@ -1375,23 +1416,12 @@ int AudioEngine::updateNoteQueue( unsigned nFrames )
 	// A tick is the most fine-grained time scale within Hydrogen.
 	for ( int tick = tickNumber_start; tick < tickNumber_end; tick++ ) {
 		
-		// MIDI events now get put into the `m_songNoteQueue` as well,
-		// based on their timestamp (which is given in terms of its
-		// transport position and not in terms of the date-time as
-		// above).
-		while ( m_midiNoteQueue.size() > 0 ) {
-			Note *pNote = m_midiNoteQueue[0];
-			if ( pNote->get_position() > tick ) break;
-
-			m_midiNoteQueue.pop_front();
-			pNote->get_instrument()->enqueue();
-			m_songNoteQueue.push( pNote );
-		}
-
 		if (  getState() != State::Playing ) {
 			// only keep going if we're playing
 			continue;
 		}
+
+		bool bColumnCompiled = false;
 		
 		//////////////////////////////////////////////////////////////
 		// SONG MODE
@@ -1456,17 +1486,39 @@ int AudioEngine::updateNoteQueue( unsigned nFrames )
 				}
 			}
 			
-			// Obtain the current PatternList and use it to overwrite
-			// the on in `m_pPlayingPatterns.
-			// TODO: Why overwriting it for each and every tick
-			//       without check if it did changed? This is highly
-			//       inefficient.
+			// Select the compiled version of the current column. In
+			// case its patterns were altered, it is rebuilt by
+			// #m_songCompiler and the notes are read from the
+			// patterns directly in the meantime.
 			PatternList *pPatternList = ( *( pSong->getPatternGroupVector() ) )[m_nColumn];
-			m_pPlayingPatterns->clear();
-			for ( int i=0; i< pPatternList->size(); ++i ) {
-				Pattern* pPattern = pPatternList->get(i);
-				m_pPlayingPatterns->add( pPattern );
-				pPattern->extand_with_flattened_virtual_patterns( m_pPlayingPatterns );
+			bColumnCompiled = m_pCompiledSong->selectColumn( m_nColumn, pPatternList );
+
+			if ( bColumnCompiled ) {
+				// `m_pPlayingPatterns` is only overwritten if it does
+				// not correspond to the current column anymore.
+				const std::vector<Pattern*>& columnPatterns = m_pCompiledSong->getPatterns();
+				bool bPlayingPatternsChanged =
+					m_pPlayingPatterns->size() != static_cast<int>( columnPatterns.size() );
+				for ( int i = 0; ! bPlayingPatternsChanged && i < m_pPlayingPatterns->size(); ++i ) {
+					bPlayingPatternsChanged = m_pPlayingPatterns->get( i ) != columnPatterns[ i ];
+				}
+				if ( bPlayingPatternsChanged ) {
+					m_pPlayingPatterns->clear();
+					for ( const auto& pPattern : columnPatterns ) {
+						m_pPlayingPatterns->add( pPattern );
+					}
+				}
+			} else {
+				if ( ! m_bSongCompilationRequested.exchange( true ) ) {
+					m_songCompiler.wakeUp();
+				}
+
+				m_pPlayingPatterns->clear();
+				for ( int i = 0; i < pPatternList->size(); ++i ) {
+					Pattern* pPattern = pPatternList->get( i );
+					m_pPlayingPatterns->add( pPattern );
+					pPattern->extand_with_flattened_virtual_patterns( m_pPlayingPatterns );
+				}
 			}
 		}
 		
@@ -1535,6 +1587,15 @@ int AudioEngine::updateNoteQueue( unsigned nFrames )
 			}
 		}
 
+		// A drumkit prepared ahead of time is swapped in right before
+		// the notes of the next pattern are queued.
+		if ( m_nPatternTickPosition == 0 ) {
+			PreparedDrumkit* pDrumkit = takePendingDrumkit();
+			if ( pDrumkit != nullptr ) {
+				pDrumkit->swapIn( pSong );
+			}
+		}
+
 		//////////////////////////////////////////////////////////////
 		// Metronome
 		// Only trigger the metronome at a predefined rate.
@@ -1561,22 +1622,39 @@ int AudioEngine::updateNoteQueue( unsigned nFrames )
 				m_pMetronomeInstrument->set_volume(
 							Preferences::get_instance()->m_fMetronomeVolume
 							);
-				Note *pMetronomeNote = new Note( m_pMetronomeInstrument,
-												 tick,
-												 fVelocity,
-												 0.f, // pan
-												 -1,
-												 fPitch
-												 );
-				m_pMetronomeInstrument->enqueue();
-				m_songNoteQueue.push( pMetronomeNote );
+				Note *pMetronomeNote = m_pNotePool->acquire( m_pMetronomeInstrument,
+															 tick,
+															 fVelocity,
+															 0.f, // pan
+															 -1,
+															 fPitch
+															 );
+				if ( pMetronomeNote != nullptr ) {
+					if ( m_pNoteScheduler->push( pMetronomeNote, getTickSize() ) ) {
+						m_pMetronomeInstrument->enqueue();
+					} else {
+						m_pNotePool->release( pMetronomeNote );
+					}
+				}
 			}
 		}
 
 		//////////////////////////////////////////////////////////////
 		// Update the notes queue.
 		// 
-		if ( m_pPlayingPatterns->size() != 0 ) {
+		if ( pHydrogen->getMode() == Song::Mode::Song && bColumnCompiled ) {
+			// Walk all notes of the current column located at the
+			// current tick.
+			const std::vector<CompiledSong::Event>& events = m_pCompiledSong->getEvents();
+			for ( int nEvent = m_pCompiledSong->seek( m_nPatternTickPosition );
+				  nEvent < static_cast<int>( events.size() )
+					  && events[ nEvent ].nTick == m_nPatternTickPosition;
+				  ++nEvent ) {
+				queuePatternNote( events[ nEvent ].pNote, tick, fTickSize,
+								  nLeadLagFactor, pSong );
+			}
+		}
+		else if ( m_pPlayingPatterns->size() != 0 ) {
 			for ( unsigned nPat = 0 ;
 				  nPat < m_pPlayingPatterns->size() ;
 				  ++nPat ) {
@@ -1586,71 +1664,12 @@ int AudioEngine::updateNoteQueue( unsigned nFrames )
 
 				// Perform a loop over all notes, which are enclose
 				// the position of the current tick, using a constant
-				// iterator (notes won't be altered!). After some
-				// humanization was applied to onset of each note, it
-				// will be added to `m_songNoteQueue` for playback.
+				// iterator (notes won't be altered!).
 				FOREACH_NOTE_CST_IT_BOUND(notes,it,m_nPatternTickPosition) {
 					Note *pNote = it->second;
 					if ( pNote ) {
-						pNote->set_just_recorded( false );
-						
-						/** Time Offset in frames (relative to sample rate)
-						*	Sum of 3 components: swing, humanized timing, lead_lag
-						*/
-						int nOffset = 0;
-
-					   /** Swing 16ths //
-						* delay the upbeat 16th-notes by a constant (manual) offset
-						*/
-						if ( ( ( m_nPatternTickPosition % ( MAX_NOTES / 16 ) ) == 0 )
-							 && ( ( m_nPatternTickPosition % ( MAX_NOTES / 8 ) ) != 0 ) ) {
-							/* TODO: incorporate the factor MAX_NOTES / 32. either in Song::m_fSwingFactor
-							* or make it a member variable.
-							* comment by oddtime:
-							* 32 depends on the fact that the swing is applied to the upbeat 16th-notes.
-							* (not to upbeat 8th-notes as in jazz swing!).
-							* however 32 could be changed but must be >16, otherwise the max delay is too long and
-							* the swing note could be played after the next downbeat!
-							*/
-							nOffset += (int) ( ( (float) MAX_NOTES / 32. ) * fTickSize * pSong->getSwingFactor() );
-						}
-
-						/* Humanize - Time parameter //
-						* Add a random offset to each note. Due to
-						* the nature of the Gaussian distribution,
-						* the factor Song::__humanize_time_value will
-						* also scale the variance of the generated
-						* random variable.
-						*/
-						if ( pSong->getHumanizeTimeValue() != 0 ) {
-							nOffset += ( int )(
-										getGaussian( 0.3 )
-										* pSong->getHumanizeTimeValue()
-										* m_nMaxTimeHumanize
-										);
-						}
-
-						// Lead or Lag - timing parameter //
-						// Add a constant offset to all notes.
-						nOffset += (int) ( pNote->get_lead_lag() * nLeadLagFactor );
-
-						// No note is allowed to start prior to the
-						// beginning of the song.
-						if((tick == 0) && (nOffset < 0)) {
-							nOffset = 0;
-						}
-						
-						// Generate a copy of the current note, assign
-						// it the new offset, and push it to the list
-						// of all notes, which are about to be played
-						// back.
-						// Why a copy? because it has the new offset (including swing and random timing) in its
-						// humanized delay, and tick position is expressed referring to start time (and not pattern).
-						Note *pCopiedNote = new Note( pNote );
-						pCopiedNote->set_position( tick );
-						pCopiedNote->set_humanize_delay( nOffset );
-						pNote->get_instrument()->enqueue();
-						m_songNoteQueue.push( pCopiedNote );
+						queuePatternNote( pNote, tick, fTickSize,
+										  nLeadLagFactor, pSong );
 					}
 				}
 			}
@@ -1665,6 +1684,79 @@ int AudioEngine::updateNoteQueue( unsigned nFrames )
 	return 0;
 }
 
+void AudioEngine::queuePatternNote( Note* pNote, int nTick, float fTickSize,
+									int nLeadLagFactor,
+									const std::shared_ptr<Song>& pSong )
+{
+	pNote->set_just_recorded( false );
+	
+	/** Time Offset in frames (relative to sample rate)
+	*	Sum of 3 components: swing, humanized timing, lead_lag
+	*/
+	int nOffset = 0;
+
+	/** Swing 16ths //
+	* delay the upbeat 16th-notes by a constant (manual) offset
+	*/
+	if ( ( ( m_nPatternTickPosition % ( MAX_NOTES / 16 ) ) == 0 )
+		 && ( ( m_nPatternTickPosition % ( MAX_NOTES / 8 ) ) != 0 ) ) {
+		/* TODO: incorporate the factor MAX_NOTES / 32. either in Song::m_fSwingFactor
+		* or make it a member variable.
+		* comment by oddtime:
+		* 32 depends on the fact that the swing is applied to the upbeat 16th-notes.
+		* (not to upbeat 8th-notes as in jazz swing!).
+		* however 32 could be changed but must be >16, otherwise the max delay is too long and
+		* the swing note could be played after the next downbeat!
+		*/
+		nOffset += (int) ( ( (float) MAX_NOTES / 32. ) * fTickSize * pSong->getSwingFactor() );
+	}
+
+	/* Humanize - Time parameter //
+	* Add a random offset to each note. Due to
+	* the nature of the Gaussian distribution,
+	* the factor Song::__humanize_time_value will
+	* also scale the variance of the generated
+	* random variable.
+	*/
+	if ( pSong->getHumanizeTimeValue() != 0 ) {
+		nOffset += ( int )(
+					getGaussian( 0.3 )
+					* pSong->getHumanizeTimeValue()
+					* m_nMaxTimeHumanize
+					);
+	}
+
+	// Lead or Lag - timing parameter //
+	// Add a constant offset to all notes.
+	nOffset += (int) ( pNote->get_lead_lag() * nLeadLagFactor );
+
+	// No note is allowed to start prior to the
+	// beginning of the song.
+	if((nTick == 0) && (nOffset < 0)) {
+		nOffset = 0;
+	}
+	
+	// Generate a copy of the current note, assign
+	// it the new offset, and push it to the list
+	// of all notes, which are about to be played
+	// back.
+	// Why a copy? because it has the new offset (including swing and random timing) in its
+	// humanized delay, and tick position is expressed referring to start time (and not pattern).
+	Note *pCopiedNote = m_pNotePool->acquire( pNote );
+	if ( pCopiedNote == nullptr ) {
+		// The pool is exhausted. The note is dropped instead of
+		// allocating a new one.
+		return;
+	}
+	pCopiedNote->set_position( nTick );
+	pCopiedNote->set_humanize_delay( nOffset );
+	if ( m_pNoteScheduler->push( pCopiedNote, getTickSize() ) ) {
+		pNote->get_instrument()->enqueue();
+	} else {
+		m_pNotePool->release( pCopiedNote );
+	}
+}
+
 int AudioEngine::getColumnForTick( int nTick, bool bLoopMode, int* pPatternStartTick ) const
 {
 	Hydrogen* pHydrogen = Hydrogen::get_instance();
@@ -1778,21 +1870,238 @@ void AudioEngine::noteOn( Note *note )
 	if ( ( getState() != State::Playing ) && ( getState() != State::Ready ) ) {
 		___ERRORLOG( QString( "Error the audio engine is not in State::Ready or State::Playing but [%1]" )
 					 .arg( static_cast<int>( getState() ) ) );
+		m_pNotePool->release( note );
+		return;
+	}
+
+	// The note will be released by the audio thread.
+	if ( ! note->is_pooled() ) {
+		Note* pPooledNote = m_pNotePool->acquire( note );
 		delete note;
+		note = pPooledNote;
+		if ( note == nullptr ) {
+			___ERRORLOG( "Note pool exhausted" );
+			return;
+		}
+	}
+
+	// MIDI notes carry their transport position and are scheduled
+	// right away along with the song notes.
+	if ( m_pNoteScheduler->push( note, getTickSize() ) ) {
+		note->get_instrument()->enqueue();
+	} else {
+		___ERRORLOG( "Note scheduler full" );
+		m_pNotePool->release( note );
+	}
+}
+
+void AudioEngine::previewNote( Note* pNote )
+{
+	pushCommand( { Command::Type::SamplerNoteOn, pNote, 0 } );
+}
+
+void AudioEngine::previewNoteOff( Note* pNote )
+{
+	pushCommand( { Command::Type::SamplerNoteOff, pNote, 0 } );
+}
+
+void AudioEngine::midiKeyboardNoteOff( int nKey )
+{
+	pushCommand( { Command::Type::MidiKeyboardNoteOff, nullptr, nKey } );
+}
+
+void AudioEngine::midiNoteOff( Note* pNote, int nKey, long nLength,
+								unsigned long nNoteOnTick )
+{
+	pushCommand( { Command::Type::MidiNoteOff, pNote, nKey, nLength, nNoteOnTick } );
+}
+
+void AudioEngine::toggleNextPattern( int nPattern )
+{
+	pushCommand( { Command::Type::ToggleNextPattern, nullptr, nPattern } );
+}
+
+void AudioEngine::setOnlyNextPattern( int nPattern )
+{
+	pushCommand( { Command::Type::SetOnlyNextPattern, nullptr, nPattern } );
+}
+
+void AudioEngine::setOfflineMode( bool bOffline )
+{
+	m_bOfflineMode = bOffline;
+	m_pSampler->setOfflineMode( bOffline );
+}
+
+void AudioEngine::setPendingDrumkit( PreparedDrumkit* pDrumkit )
+{
+	m_pPendingDrumkit = pDrumkit;
+}
+
+PreparedDrumkit* AudioEngine::takePendingDrumkit()
+{
+	return m_pPendingDrumkit.exchange( nullptr );
+}
+
+void AudioEngine::pushCommand( const Command& command )
+{
+	collectGarbage();
+
+	// The state is only used as a hint. In case the driver is
+	// stopped right after pushing, stopAudioDrivers() applies the
+	// remaining commands.
+	if ( ( getState() == State::Ready || getState() == State::Playing ) &&
+		 m_commandQueue.push( command ) ) {
 		return;
 	}
 
-	m_midiNoteQueue.push_back( note );
+	this->lock( RIGHT_HERE );
+	processCommand( command );
+	this->unlock();
+
+	collectGarbage();
+}
+
+void AudioEngine::processCommands()
+{
+	Command command;
+	while ( m_commandQueue.pop( &command ) ) {
+		processCommand( command );
+	}
+}
+
+void AudioEngine::processCommand( const Command& command )
+{
+	switch ( command.type ) {
+	case Command::Type::SamplerNoteOn: {
+		Note* pNote = command.pNote;
+		// Notes created by other threads are rendered using a pooled
+		// copy and deleted by them, so the Sampler does not free
+		// them on the audio thread.
+		if ( ! pNote->is_pooled() && ! pNote->get_note_off() ) {
+			Note* pPooledNote = m_pNotePool->acquire( pNote );
+			if ( pPooledNote == nullptr ) {
+				// The pool is exhausted. The note is dropped instead
+				// of allocating a new one.
+				if ( ! m_garbageNotes.push( pNote ) ) {
+					m_pNotePool->release( pNote );
+				}
+				break;
+			}
+			if ( m_garbageNotes.push( pNote ) ) {
+				pNote = pPooledNote;
+			} else {
+				m_pNotePool->release( pPooledNote );
+			}
+		}
+		m_pSampler->noteOn( pNote );
+		// The Sampler only keeps notes it has to render.
+		if ( pNote->get_note_off() &&
+			 ! m_garbageNotes.push( pNote ) ) {
+			m_pNotePool->release( pNote );
+		}
+		break;
+	}
+
+	case Command::Type::SamplerNoteOff:
+		m_pSampler->noteOff( command.pNote );
+		if ( ! m_garbageNotes.push( command.pNote ) ) {
+			m_pNotePool->release( command.pNote );
+		}
+		break;
+
+	case Command::Type::MidiKeyboardNoteOff:
+		m_pSampler->midiKeyboardNoteOff( command.nValue );
+		break;
+
+	case Command::Type::MidiNoteOff: {
+		auto pInstr = command.pNote->get_instrument();
+		if ( m_pSampler->isInstrumentPlaying( pInstr ) ) {
+			if ( command.nValue != -1 ) {
+				m_pSampler->midiKeyboardNoteOff( command.nValue );
+			} else {
+				m_pSampler->noteOn( command.pNote );
+			}
+
+			if ( command.nLength != -1 ) {
+				m_pSampler->setPlayingNotelength( pInstr, command.nLength,
+												  command.nNoteOnTick );
+			}
+		}
+		if ( ! m_garbageNotes.push( command.pNote ) ) {
+			m_pNotePool->release( command.pNote );
+		}
+		break;
+	}
+
+	case Command::Type::ToggleNextPattern:
+	case Command::Type::SetOnlyNextPattern: {
+		Hydrogen* pHydrogen = Hydrogen::get_instance();
+		std::shared_ptr<Song> pSong = pHydrogen->getSong();
+		if ( pSong == nullptr || pHydrogen->getMode() != Song::Mode::Pattern ) {
+			___ERRORLOG( "can't set next pattern in song mode" );
+			m_pNextPatterns->clear();
+			break;
+		}
+
+		PatternList* pPatternList = pSong->getPatternList();
+		int nPattern = command.nValue;
+		if ( nPattern < 0 || nPattern >= pPatternList->size() ) {
+			___ERRORLOG( QString( "pos not in patternList range. pos=%1 patternListSize=%2" )
+						 .arg( nPattern ).arg( pPatternList->size() ) );
+			m_pNextPatterns->clear();
+			break;
+		}
+		Pattern* pPattern = pPatternList->get( nPattern );
+
+		if ( command.type == Command::Type::ToggleNextPattern ) {
+			// If the pattern is already in #m_pNextPatterns, it will
+			// be removed from the latter and del() returns a pointer
+			// to the very pattern.
+			if ( m_pNextPatterns->del( pPattern ) == nullptr ) {
+				m_pNextPatterns->add( pPattern );
+			}
+		} else {
+			// Clear the list of all patterns scheduled to be
+			// processed next and fill them with those currently
+			// played.
+			m_pNextPatterns->clear();
+			for ( int ii = 0; ii < m_pPlayingPatterns->size(); ++ii ) {
+				m_pNextPatterns->add( m_pPlayingPatterns->get( ii ) );
+			}
+			m_pNextPatterns->add( pPattern );
+		}
+		// The GUI does not wait for the command to be applied.
+		m_pEventQueue->push_event( EVENT_PATTERN_CHANGED, -1 );
+		break;
+	}
+	}
+}
+
+void AudioEngine::collectGarbage()
+{
+	Note* pNote;
+	while ( m_garbageNotes.pop( &pNote ) ) {
+		delete pNote;
+	}
 }
 
-bool AudioEngine::compare_pNotes::operator()(Note* pNote1, Note* pNote2)
+void AudioEngine::compileSongLoop()
 {
-	return (pNote1->get_humanize_delay() +
-			pNote1->get_position() *
-			Hydrogen::get_instance()->getAudioEngine()->getTickSize()) >
-		   (pNote2->get_humanize_delay() +
-			pNote2->get_position() *
-			Hydrogen::get_instance()->getAudioEngine()->getTickSize());
+	while ( ! m_songCompiler.isQuitting() ) {
+		if ( ! m_bSongCompilationRequested.exchange( false ) ) {
+			m_songCompiler.wait();
+			continue;
+		}
+
+		if ( ! m_songCompiler.lock( this ) ) {
+			return;
+		}
+		std::shared_ptr<Song> pSong = Hydrogen::get_instance()->getSong();
+		if ( pSong != nullptr ) {
+			m_pCompiledSong->compile( pSong->getPatternGroupVector() );
+		}
+		this->unlock();
+	}
 }
 
 void AudioEngine::play() {
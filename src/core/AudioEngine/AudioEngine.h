@@ -30,6 +30,13 @@
 #include <core/Synth/Synth.h>
 #include <core/Basics/Note.h>
 #include <core/AudioEngine/TransportInfo.h>
+#include <core/AudioEngine/NotePool.h>
+#include <core/AudioEngine/NoteScheduler.h>
+#include <core/AudioEngine/CompiledSong.h>
+#include <core/AudioEngine/EngineContext.h>
+#include <core/AudioEngine/EngineMetrics.h>
+#include <core/Helpers/BackgroundWorker.h>
+#include <core/Helpers/LockFreeQueue.h>
 #include <core/CoreActionController.h>
 
 #include <core/IO/AudioOutput.h>
@@ -37,6 +44,7 @@
 #include <core/IO/DiskWriterDriver.h>
 #include <core/IO/FakeDriver.h>
 
+#include <atomic>
 #include <memory>
 #include <string>
 #include <cassert>
@@ -67,6 +75,7 @@ namespace H2Core
 	class EventQueue;
 	class PatternList;
 	class Drumkit;
+	class PreparedDrumkit;
 	class Song;
 	
 /**
@@ -213,8 +222,78 @@ public:
 	 * AudioEngine lock.
 	 */
 	void			assertLocked( );
+	/**
+	 * Schedules @a note for playback. Must be called while holding
+	 * the AudioEngine lock.
+	 *
+	 * Notes not created by #m_pNotePool are copied into a pooled
+	 * one and deleted right away so the audio thread never frees
+	 * them.
+	 */
 	void			noteOn( Note *note );
-	
+
+	/**
+	 * Plays back @a pNote right away using the Sampler, e.g. when
+	 * previewing an instrument in the GUI or on incoming MIDI
+	 * messages.
+	 *
+	 * The note is handed to the audio thread via #m_commandQueue
+	 * and the caller does not have to (and must not) lock the
+	 * AudioEngine. Ownership of @a pNote is passed to the engine,
+	 * including note-off notes.
+	 */
+	void			previewNote( Note* pNote );
+	/** Releases all notes of the instrument of @a pNote. Takes
+	 * ownership of @a pNote. See previewNote().*/
+	void			previewNoteOff( Note* pNote );
+	/** Releases all notes triggered by MIDI key @a nKey. See
+	 * previewNote().*/
+	void			midiKeyboardNoteOff( int nKey );
+	/**
+	 * Handles an incoming MIDI note-off message on the audio thread.
+	 *
+	 * Only in case the instrument of @a pNote is still playing, its
+	 * notes - or those triggered by MIDI key @a nKey if not -1 - are
+	 * released and, if @a nLength is not -1, the length of the
+	 * corresponding note in the current pattern is set to @a
+	 * nLength ticks (see Sampler::setPlayingNotelength()).
+	 *
+	 * Takes ownership of the note-off note @a pNote. See
+	 * previewNote().
+	 */
+	void			midiNoteOff( Note* pNote, int nKey, long nLength,
+								 unsigned long nNoteOnTick );
+	/**
+	 * Adds the pattern at position @a nPattern in the pattern list
+	 * of the current Song to #m_pNextPatterns or removes it in case
+	 * it is already present.
+	 *
+	 * Applied asynchronously by the audio thread. The caller must
+	 * not hold the AudioEngine lock.
+	 */
+	void			toggleNextPattern( int nPattern );
+	/**
+	 * Replaces #m_pNextPatterns by the currently playing patterns
+	 * and the pattern at position @a nPattern. See
+	 * toggleNextPattern().
+	 */
+	void			setOnlyNextPattern( int nPattern );
+	/**
+	 * Lets the audio thread swap @a pDrumkit into the current Song
+	 * at the beginning of the next pattern (see
+	 * PreparedDrumkit::swapIn()). Only a single kit may be pending
+	 * at a time.
+	 *
+	 * The caller keeps ownership of @a pDrumkit and has to retrieve
+	 * it using takePendingDrumkit() in case it was not swapped in,
+	 * e.g. since the transport was stopped.
+	 */
+	void			setPendingDrumkit( PreparedDrumkit* pDrumkit );
+	/** \return Kit set using setPendingDrumkit() and not swapped in
+	 * yet or nullptr. Must be called while holding the AudioEngine
+	 * lock.*/
+	PreparedDrumkit*	takePendingDrumkit();
+
 	/**
 	 * Main audio processing function called by the audio drivers whenever
 	 * there is work to do.
@@ -282,6 +361,8 @@ public:
 	Sampler*		getSampler() const;
 	/** \return #m_pSynth */
 	Synth*			getSynth() const;
+	/** \return #m_pNotePool */
+	NotePool*		getNotePool() const;
 
 	/** \return #m_fElapsedTime */
 	float			getElapsedTime() const;	
@@ -354,6 +435,23 @@ public:
 
 	float			getProcessTime() const;
 	float			getMaxProcessTime() const;
+	/** Timing statistics of the process cycles. Can be read and
+	 * reset from any thread.*/
+	EngineMetrics&	getMetrics();
+
+	/**
+	 * Whether audio is rendered offline, i.e. while exporting.
+	 *
+	 * In offline mode audioEngine_process() waits for the
+	 * AudioEngine lock instead of dropping the buffer and the
+	 * Sampler waits for streamed sample data instead of rendering
+	 * silence. Rendering can thus be faster than real time without
+	 * losing any output.
+	 *
+	 * Must only be changed while no audio driver is running.
+	 */
+	void			setOfflineMode( bool bOffline );
+	bool			isOfflineMode() const;
 
 	int				getPatternTickPosition() const;
 
@@ -472,6 +570,43 @@ private:
 	inline void			processTransport( unsigned nFrames );
 
 	void			clearNoteQueue();
+
+	/** Request passed from other threads to the audio thread.*/
+	struct Command {
+		enum class Type {
+			SamplerNoteOn,
+			SamplerNoteOff,
+			MidiKeyboardNoteOff,
+			ToggleNextPattern,
+			SetOnlyNextPattern,
+			MidiNoteOff
+		};
+		Type type;
+		Note* pNote;
+		int nValue;
+		/** Recorded note length in ticks of MidiNoteOff. -1 if
+		 * nothing is recorded.*/
+		long nLength;
+		unsigned long nNoteOnTick;
+	};
+	/**
+	 * Hands @a command to the audio thread.
+	 *
+	 * In case the engine does not process audio right now or
+	 * #m_commandQueue is full, the AudioEngine is locked and the
+	 * command is applied directly.
+	 */
+	void			pushCommand( const Command& command );
+	/** Applies all commands in #m_commandQueue. Must only be
+	 * called while holding the AudioEngine lock.*/
+	void			processCommands();
+	void			processCommand( const Command& command );
+	/** Deletes all notes handed back by the audio thread via
+	 * #m_garbageNotes.*/
+	void			collectGarbage();
+	/** Loop of #m_songCompiler updating #m_pCompiledSong whenever
+	 * the audio thread requests it.*/
+	void			compileSongLoop();
 	/** Clear all audio buffers.
 	 */
 	void			clearAudioBuffers( uint32_t nFrames );	
@@ -491,11 +626,11 @@ private:
 	 */
 	AudioOutput*	createDriver( const QString& sDriver );
 	/**
-	 * Takes all notes from the current patterns, from the MIDI queue
-	 * #m_midiNoteQueue, and those triggered by the metronome and pushes
-	 * them onto #m_songNoteQueue for playback.
+	 * Takes all notes from the current patterns and those triggered by
+	 * the metronome and pushes them onto #m_pNoteScheduler for
+	 * playback. MIDI notes are pushed directly by noteOn().
 	 *
-	 * Apart from the MIDI queue, the extraction of all notes will be
+	 * The extraction of all notes will be
 	 * based on their position measured in ticks. Since Hydrogen does
 	 * support humanization, which also involves triggering a Note
 	 * earlier or later than its actual position, the loop over all ticks
@@ -514,6 +649,17 @@ private:
 	 * cycle.
 	 */
 	int				updateNoteQueue( unsigned nFrames );
+	/**
+	 * Pushes a copy of the pattern note @a pNote onto
+	 * #m_pNoteScheduler after applying swing, humanization, and
+	 * lead-lag.
+	 *
+	 * \param pNote Note stored within one of the playing patterns.
+	 * \param nTick Transport position the copy will be placed at.
+	 */
+	void			queuePatternNote( Note* pNote, int nTick, float fTickSize,
+									  int nLeadLagFactor,
+									  const std::shared_ptr<Song>& pSong );
 	
 	/** Increments #m_fElapsedTime at the end of a process cycle.
 	 *
@@ -572,6 +718,42 @@ private:
 	Sampler* 			m_pSampler;
 	/** Local instance of the Synth. */
 	Synth* 				m_pSynth;
+	/** State of the engine the current cycle is rendered with. Only
+	 * accessed by the audio thread.*/
+	EngineContext		m_engineContext;
+	/** See getMetrics().*/
+	EngineMetrics		m_metrics;
+	/**
+	 * Notes copied into #m_pNoteScheduler are taken from and
+	 * eventually returned to this pool. Its capacity is twice
+	 * Preferences::m_nMaxNotes at the time the AudioEngine is
+	 * created.
+	 */
+	NotePool*			m_pNotePool;
+	/**
+	 * Holds all notes - song, metronome, and MIDI ones - about to be
+	 * played back ordered by their start frame.
+	 */
+	NoteScheduler*		m_pNoteScheduler;
+	/** Notes due in the current cycle. Reused in processPlayNotes()
+	 * to avoid allocations.*/
+	std::vector<Note*>	m_dueNotes;
+	/**
+	 * Requests of the GUI, OSC, and MIDI threads drained at the
+	 * beginning of each process cycle. This way previewing notes and
+	 * toggling patterns does not compete with audioEngine_process()
+	 * for the AudioEngine lock.
+	 */
+	LockFreeQueue<Command>	m_commandQueue;
+	/**
+	 * Note-off notes already handled by the audio thread. They are
+	 * deleted by the next thread pushing a command instead of
+	 * within the audio thread.
+	 */
+	LockFreeQueue<Note*>	m_garbageNotes;
+	/** Kit to swap in at the beginning of the next pattern. See
+	 * setPendingDrumkit().*/
+	std::atomic<PreparedDrumkit*>	m_pPendingDrumkit;
 
 	/**
 	 * Pointer to the current instance of the audio driver.
@@ -664,6 +846,9 @@ private:
 	// max ms usable in process with no xrun
 	float				m_fMaxProcessTime;
 
+	/** See setOfflineMode().*/
+	bool				m_bOfflineMode;
+
 	// updated in audioEngine_updateNoteQueue()
 	struct timeval		m_currentTickTime;
 
@@ -700,6 +885,17 @@ private:
 	 * PatternList containing all Patterns currently played back.
 	 */
 	PatternList*		m_pPlayingPatterns;
+	/**
+	 * Notes of all columns of the current song resolved into flat
+	 * arrays. Used in Song::Mode::Song instead of looking up the
+	 * notes of every pattern in #m_pPlayingPatterns on each tick.
+	 */
+	CompiledSong*		m_pCompiledSong;
+	/** Compiles #m_pCompiledSong outside of the audio thread.*/
+	BackgroundWorker	m_songCompiler;
+	/** Set by the audio thread in case the current column of
+	 * #m_pCompiledSong is outdated.*/
+	std::atomic<bool>	m_bSongCompilationRequested;
 
 	/**
 	 * Variable keeping track of the transport position in realtime.
@@ -724,15 +920,6 @@ private:
 	
 	audioProcessCallback m_AudioProcessCallback;
 	
-	/// Song Note FIFO
-	// overload the > operator of Note objects for priority_queue
-	struct compare_pNotes {
-		bool operator() (Note* pNote1, Note* pNote2);
-	};
-
-	std::priority_queue<Note*, std::deque<Note*>, compare_pNotes > m_songNoteQueue;
-	std::deque<Note*>	m_midiNoteQueue;	///< Midi Note FIFO
-	
 	/**
 	 * Pointer to the metronome.
 	 *
@@ -819,6 +1006,10 @@ inline float AudioEngine::getMasterPeak_R() const {
 	return m_fMasterPeak_R;
 }
 
+inline bool AudioEngine::isOfflineMode() const {
+	return m_bOfflineMode;
+}
+
 inline float AudioEngine::getProcessTime() const {
 	return m_fProcessTime;
 }
@@ -827,6 +1018,10 @@ inline float AudioEngine::getMaxProcessTime() const {
 	return m_fMaxProcessTime;
 }
 
+inline EngineMetrics& AudioEngine::getMetrics() {
+	return m_metrics;
+}
+
 inline const struct timeval& AudioEngine::getCurrentTickTime() const {
 	return m_currentTickTime;
 }
@@ -0,0 +1,172 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#include <core/AudioEngine/CompiledSong.h>
+#include <core/Basics/Pattern.h>
+#include <core/Basics/PatternList.h>
+
+#include <algorithm>
+
+namespace H2Core
+{
+
+static bool compareEventTick( const CompiledSong::Event& event, int nTick )
+{
+	return event.nTick < nTick;
+}
+
+CompiledSong::CompiledSong()
+	: m_nCurrentColumn( -1 )
+	, m_nCursor( 0 )
+	, m_emptyColumn()
+{
+}
+
+CompiledSong::~CompiledSong()
+{
+}
+
+void CompiledSong::compile( std::vector<PatternList*>* pColumns )
+{
+	m_columns.resize( pColumns->size() );
+	for ( int ii = 0; ii < static_cast<int>( pColumns->size() ); ++ii ) {
+		PatternList* pColumn = ( *pColumns )[ ii ];
+		if ( pColumn != nullptr && ! isUpToDate( m_columns[ ii ], pColumn ) ) {
+			compileColumn( &m_columns[ ii ], pColumn );
+		}
+	}
+
+	// The current column is selected again during the next tick.
+	m_nCurrentColumn = -1;
+	m_nCursor = 0;
+}
+
+bool CompiledSong::selectColumn( int nColumn, PatternList* pColumn )
+{
+	if ( nColumn < 0 || pColumn == nullptr ||
+		 nColumn >= static_cast<int>( m_columns.size() ) ||
+		 ! isUpToDate( m_columns[ nColumn ], pColumn ) ) {
+		m_nCurrentColumn = -1;
+		m_nCursor = 0;
+		return false;
+	}
+
+	if ( nColumn != m_nCurrentColumn ) {
+		m_nCurrentColumn = nColumn;
+		m_nCursor = 0;
+	}
+
+	return true;
+}
+
+int CompiledSong::seek( int nTick )
+{
+	const std::vector<Event>& events = getEvents();
+	auto start = events.begin() + std::min( m_nCursor, static_cast<int>( events.size() ) );
+
+	if ( start != events.begin() && ( start - 1 )->nTick >= nTick ) {
+		// Relocation within the column.
+		start = events.begin();
+	}
+
+	m_nCursor = std::lower_bound( start, events.end(), nTick, compareEventTick ) - events.begin();
+	return m_nCursor;
+}
+
+void CompiledSong::clear()
+{
+	m_columns.clear();
+	m_nCurrentColumn = -1;
+	m_nCursor = 0;
+}
+
+bool CompiledSong::isUpToDate( const Column& column, PatternList* pColumn ) const
+{
+	if ( ! column.bCompiled || column.nDeletions != Pattern::get_deletions() ||
+		 static_cast<int>( column.columnPatterns.size() ) != pColumn->size() ) {
+		return false;
+	}
+
+	for ( int ii = 0; ii < pColumn->size(); ++ii ) {
+		if ( column.columnPatterns[ ii ] != pColumn->get( ii ) ) {
+			return false;
+		}
+	}
+
+	// No pattern was deleted since the compilation. All of them can
+	// thus still be accessed.
+	for ( int ii = 0; ii < static_cast<int>( column.patterns.size() ); ++ii ) {
+		if ( column.patterns[ ii ]->get_revision() != column.revisions[ ii ] ) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void CompiledSong::compileColumn( Column* pColumn, PatternList* pColumnPatterns )
+{
+	pColumn->nDeletions = Pattern::get_deletions();
+	pColumn->columnPatterns.clear();
+	pColumn->patterns.clear();
+	pColumn->revisions.clear();
+	pColumn->events.clear();
+
+	auto addPattern = [&]( Pattern* pPattern ) {
+		if ( std::find( pColumn->patterns.begin(), pColumn->patterns.end(),
+						pPattern ) == pColumn->patterns.end() ) {
+			pColumn->patterns.push_back( pPattern );
+			pColumn->revisions.push_back( pPattern->get_revision() );
+		}
+	};
+
+	for ( int ii = 0; ii < pColumnPatterns->size(); ++ii ) {
+		Pattern* pPattern = pColumnPatterns->get( ii );
+		pColumn->columnPatterns.push_back( pPattern );
+		if ( pPattern == nullptr ) {
+			continue;
+		}
+
+		addPattern( pPattern );
+		for ( const auto& pVirtualPattern : *pPattern->get_flattened_virtual_patterns() ) {
+			addPattern( pVirtualPattern );
+		}
+	}
+
+	for ( const auto& pPattern : pColumn->patterns ) {
+		FOREACH_NOTE_CST_IT_BEGIN_END( pPattern->get_notes(), it ) {
+			if ( it->second != nullptr ) {
+				pColumn->events.push_back( { it->first, it->second } );
+			}
+		}
+	}
+
+	// Stable to retain the order of the patterns for notes sharing
+	// the same tick.
+	std::stable_sort( pColumn->events.begin(), pColumn->events.end(),
+					  []( const Event& a, const Event& b ) {
+						  return a.nTick < b.nTick;
+					  } );
+
+	pColumn->bCompiled = true;
+}
+
+};
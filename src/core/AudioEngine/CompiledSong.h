@@ -0,0 +1,165 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+#ifndef COMPILED_SONG_H
+#define COMPILED_SONG_H
+
+#include <core/Object.h>
+
+#include <vector>
+
+namespace H2Core
+{
+
+class Note;
+class Pattern;
+class PatternList;
+
+/**
+ * Flat representation of the pattern group vector of a Song used
+ * by AudioEngine::updateNoteQueue() in song mode.
+ *
+ * For each column all patterns - including the flattened virtual
+ * ones - are resolved once and their notes are stored in a single
+ * array sorted by tick. Playing a column thus boils down to
+ * advancing a cursor through this array instead of rebuilding the
+ * list of playing patterns and looking up each of their note maps on
+ * every tick.
+ *
+ * Compiling allocates and is thus never done by the audio thread.
+ * compile() is called by other threads holding the AudioEngine lock
+ * and builds all columns whose patterns or whose patterns'
+ * Pattern::get_revision() changed. selectColumn() only checks whether
+ * the current column is still up to date. If it is not, the
+ * AudioEngine falls back to reading the notes from the patterns
+ * directly until the column was compiled again.
+ *
+ * Like #AudioEngine::m_pPlayingPatterns the compiled song must only
+ * be accessed while holding the AudioEngine lock.
+ *
+ * \ingroup docCore docAudioEngine
+ */
+class CompiledSong : public H2Core::Object<CompiledSong>
+{
+	H2_OBJECT(CompiledSong)
+public:
+	struct Event {
+		/** Position relative to the beginning of the column.*/
+		int nTick;
+		/** Note as stored in the pattern.*/
+		Note* pNote;
+	};
+
+	CompiledSong();
+	~CompiledSong();
+
+	/**
+	 * Compiles all columns in @a pColumns which changed since their
+	 * last compilation.
+	 *
+	 * Allocates and must thus not be called by the audio thread.
+	 *
+	 * \param pColumns Pattern group vector of the current Song.
+	 */
+	void compile( std::vector<PatternList*>* pColumns );
+
+	/**
+	 * Makes @a nColumn the current column. Neither compiles nor
+	 * allocates.
+	 *
+	 * \param nColumn Index of the column within the pattern group
+	 * vector.
+	 * \param pColumn Patterns contained in column @a nColumn.
+	 *
+	 * \return true if the column is compiled and up to date. If not,
+	 * no column is selected and both getPatterns() and getEvents()
+	 * are empty.
+	 */
+	bool selectColumn( int nColumn, PatternList* pColumn );
+
+	/** All patterns played in the current column in the same order
+	 * as they would have been added to
+	 * #AudioEngine::m_pPlayingPatterns. */
+	const std::vector<Pattern*>& getPatterns() const;
+
+	/** Events of the current column sorted by tick. Notes at the
+	 * same tick keep the order of getPatterns() and of the note
+	 * maps of the individual patterns.*/
+	const std::vector<Event>& getEvents() const;
+
+	/**
+	 * \return Index of the first event in getEvents() located at or
+	 * after @a nTick.
+	 *
+	 * Subsequent calls with increasing ticks just advance a cursor.
+	 * Only jumps backwards require a binary search.
+	 */
+	int seek( int nTick );
+
+	/** Drops all compiled columns, e.g. when the song changes.*/
+	void clear();
+
+private:
+	struct Column {
+		bool bCompiled = false;
+		/** Pattern::get_deletions() at the time of compilation.*/
+		unsigned nDeletions = 0;
+		/** Patterns directly contained in the column.*/
+		std::vector<Pattern*> columnPatterns;
+		/** #columnPatterns and their flattened virtual patterns.*/
+		std::vector<Pattern*> patterns;
+		/** Pattern::get_revision() of each of #patterns at the time
+		 * of compilation.*/
+		std::vector<unsigned> revisions;
+		std::vector<Event> events;
+	};
+
+	bool isUpToDate( const Column& column, PatternList* pColumn ) const;
+	void compileColumn( Column* pColumn, PatternList* pColumnPatterns );
+
+	std::vector<Column> m_columns;
+	/** Index of the current column. -1 if none was selected yet.*/
+	int m_nCurrentColumn;
+	/** Index into the events of the current column.*/
+	int m_nCursor;
+
+	/** Returned in case no column was selected yet.*/
+	const Column m_emptyColumn;
+};
+
+inline const std::vector<Pattern*>& CompiledSong::getPatterns() const
+{
+	if ( m_nCurrentColumn < 0 ) {
+		return m_emptyColumn.patterns;
+	}
+	return m_columns[ m_nCurrentColumn ].patterns;
+}
+
+inline const std::vector<CompiledSong::Event>& CompiledSong::getEvents() const
+{
+	if ( m_nCurrentColumn < 0 ) {
+		return m_emptyColumn.events;
+	}
+	return m_columns[ m_nCurrentColumn ].events;
+}
+
+};
+
+#endif
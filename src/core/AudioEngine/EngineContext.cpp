@@ -0,0 +1,97 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#include <core/AudioEngine/EngineContext.h>
+#include <core/AudioEngine/AudioEngine.h>
+#include <core/Basics/Instrument.h>
+#include <core/Basics/InstrumentList.h>
+#include <core/Basics/Song.h>
+#include <core/IO/DiskWriterDriver.h>
+#include <core/IO/JackAudioDriver.h>
+#include <core/Preferences/Preferences.h>
+
+namespace H2Core
+{
+
+EngineContext::EngineContext()
+	: pAudioEngine( nullptr )
+	, pAudioDriver( nullptr )
+	, pMidiOutput( nullptr )
+	, pSong( nullptr )
+	, nSampleRate( 0 )
+	, bIsExportSessionActive( false )
+	, bIsAnyInstrumentSoloed( false )
+	, nMaxNotes( 0 )
+	, nMaxNotesPerInstrument( 0 )
+	, nMaxNotesPerMuteGroup( 0 )
+	, voiceStealingPolicy( VoiceAllocator::Policy::oldest )
+	, pMetrics( nullptr )
+	, pTrackOutDriver( nullptr )
+	, pStemDriver( nullptr )
+	, bTrackOutPostFader( false )
+{
+}
+
+void EngineContext::update( AudioEngine* pAudioEngine, Song* pSong, const Preferences* pPref,
+							bool bIsExportSessionActive )
+{
+	this->pAudioEngine = pAudioEngine;
+	this->pSong = pSong;
+	pAudioDriver = pAudioEngine->getAudioDriver();
+	pMidiOutput = pAudioEngine->getMidiOutDriver();
+	nSampleRate = pAudioDriver != nullptr ? pAudioDriver->getSampleRate() : 0;
+	this->bIsExportSessionActive = bIsExportSessionActive;
+	nMaxNotes = pPref->m_nMaxNotes;
+	nMaxNotesPerInstrument = pPref->m_nMaxNotesPerInstrument;
+	nMaxNotesPerMuteGroup = pPref->m_nMaxNotesPerMuteGroup;
+	voiceStealingPolicy = pPref->m_voiceStealingPolicy;
+	pMetrics = &pAudioEngine->getMetrics();
+
+	bIsAnyInstrumentSoloed = false;
+	if ( pSong != nullptr ) {
+		InstrumentList* pInstrList = pSong->getInstrumentList();
+		for ( int i = 0; i < pInstrList->size(); i++ ) {
+			if ( pInstrList->get( i )->is_soloed() ) {
+				bIsAnyInstrumentSoloed = true;
+				break;
+			}
+		}
+	}
+
+	pTrackOutDriver = nullptr;
+#ifdef H2CORE_HAVE_JACK
+	if ( pPref->m_bJackTrackOuts ) {
+		pTrackOutDriver = dynamic_cast<JackAudioDriver*>( pAudioDriver );
+	}
+#endif
+	bTrackOutPostFader = pPref->m_JackTrackOutputMode ==
+		Preferences::JackTrackOutputMode::postFader;
+
+	pStemDriver = dynamic_cast<DiskWriterDriver*>( pAudioDriver );
+	if ( pStemDriver != nullptr ) {
+		bTrackOutPostFader = pStemDriver->getStemsPostFader();
+		if ( ! pStemDriver->hasStems() ) {
+			pStemDriver = nullptr;
+		}
+	}
+}
+
+};
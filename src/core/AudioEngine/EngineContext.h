@@ -0,0 +1,109 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#ifndef H2C_ENGINE_CONTEXT_H
+#define H2C_ENGINE_CONTEXT_H
+
+#include <core/Sampler/VoiceAllocator.h>
+
+namespace H2Core
+{
+
+class AudioEngine;
+class AudioOutput;
+class DiskWriterDriver;
+class EngineMetrics;
+class JackAudioDriver;
+class MidiOutput;
+class Preferences;
+class Song;
+
+/**
+ * State of the engine a single cycle is rendered with.
+ *
+ * It is assembled by the AudioEngine at the beginning of each cycle
+ * and handed to the Sampler and the Synth explicitly. This way they
+ * neither have to reach back to the Hydrogen and Preferences
+ * singletons nor cast the audio driver for every note. All members
+ * remain unchanged while rendering and may be read by the helper
+ * threads of the VoiceRenderPool as well.
+ *
+ * The context does not own anything. It is kept by the AudioEngine
+ * in between cycles and must not extend the lifetime of e.g. the
+ * Song, which would otherwise be destroyed within the audio thread
+ * once it was replaced.
+ *
+ * \ingroup docCore docAudioEngine
+ */
+struct EngineContext {
+	EngineContext();
+
+	/**
+	 * Takes a snapshot of @a pAudioEngine rendering @a pSong.
+	 *
+	 * Called by the audio thread while holding the engine lock.
+	 *
+	 * \param pPref Settings the cycle is rendered with.
+	 * \param bIsExportSessionActive See
+	 * Hydrogen::getIsExportSessionActive().
+	 */
+	void update( AudioEngine* pAudioEngine, Song* pSong, const Preferences* pPref,
+				 bool bIsExportSessionActive );
+
+	AudioEngine* pAudioEngine;
+	AudioOutput* pAudioDriver;
+	/** nullptr if no MIDI output is active.*/
+	MidiOutput* pMidiOutput;
+	/** Only valid while the cycle is rendered.*/
+	Song* pSong;
+	/** Sample rate of #pAudioDriver.*/
+	unsigned nSampleRate;
+
+	/** See Hydrogen::getIsExportSessionActive().*/
+	bool bIsExportSessionActive;
+	/** Whether at least one instrument of #pSong is soloed.*/
+	bool bIsAnyInstrumentSoloed;
+	/** Preferences::m_nMaxNotes.*/
+	int nMaxNotes;
+	/** Preferences::m_nMaxNotesPerInstrument.*/
+	int nMaxNotesPerInstrument;
+	/** Preferences::m_nMaxNotesPerMuteGroup.*/
+	int nMaxNotesPerMuteGroup;
+	/** Preferences::m_voiceStealingPolicy.*/
+	VoiceAllocator::Policy voiceStealingPolicy;
+	/** Statistics of the engine. Only to be written by the audio
+	 * thread.*/
+	EngineMetrics* pMetrics;
+
+	/** #pAudioDriver in case it is a JackAudioDriver providing
+	 * per-track outputs and nullptr otherwise.*/
+	JackAudioDriver* pTrackOutDriver;
+	/** #pAudioDriver in case it is a DiskWriterDriver writing
+	 * stems and nullptr otherwise.*/
+	DiskWriterDriver* pStemDriver;
+	/** Whether the per-track outputs or stems are rendered
+	 * post-fader.*/
+	bool bTrackOutPostFader;
+};
+
+};
+
+#endif // H2C_ENGINE_CONTEXT_H
@@ -0,0 +1,234 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#include <core/AudioEngine/EngineMetrics.h>
+
+#include <QFile>
+#include <QTextStream>
+
+#include <algorithm>
+
+namespace H2Core
+{
+
+double EngineMetrics::StageSnapshot::percentileUs( double fPercentile ) const
+{
+	if ( nCount == 0 ) {
+		return 0;
+	}
+	const double fThreshold = nCount * fPercentile / 100.0;
+	uint64_t nSum = 0;
+	for ( int ii = 0; ii < nBuckets; ++ii ) {
+		nSum += buckets[ ii ];
+		if ( nSum >= fThreshold ) {
+			// The maximum is more precise than the bound of the last
+			// bucket.
+			return std::min( static_cast<double>( uint64_t( 1 ) << ii ), nMaxNs / 1000.0 );
+		}
+	}
+	return nMaxNs / 1000.0;
+}
+
+double EngineMetrics::StageSnapshot::meanUs() const
+{
+	return nCount > 0 ? nTotalNs / 1000.0 / nCount : 0;
+}
+
+EngineMetrics::EngineMetrics()
+	: m_bResetRequested( false )
+{
+	clear();
+}
+
+QString EngineMetrics::getStageName( int nStage )
+{
+	switch ( nStage ) {
+	case STAGE_CYCLE:
+		return "cycle";
+	case STAGE_LOCK_WAIT:
+		return "lock_wait";
+	case STAGE_TRANSPORT:
+		return "transport";
+	case STAGE_NOTE_QUEUE:
+		return "note_queue";
+	case STAGE_SAMPLER:
+		return "sampler";
+	case STAGE_SYNTH:
+		return "synth";
+	case STAGE_PEAKS:
+		return "peaks";
+	default:
+		return QString( "ladspa_fx_%1" ).arg( nStage - STAGE_LADSPA_FX );
+	}
+}
+
+void EngineMetrics::clear()
+{
+	for ( auto& histogram : m_stages ) {
+		histogram.nCount.store( 0, std::memory_order_relaxed );
+		histogram.nTotalNs.store( 0, std::memory_order_relaxed );
+		histogram.nMaxNs.store( 0, std::memory_order_relaxed );
+		for ( auto& bucket : histogram.buckets ) {
+			bucket.store( 0, std::memory_order_relaxed );
+		}
+	}
+	m_nCycles.store( 0, std::memory_order_relaxed );
+	m_nXRuns.store( 0, std::memory_order_relaxed );
+	m_nMissedBuffers.store( 0, std::memory_order_relaxed );
+	m_nVoicesStolen.store( 0, std::memory_order_relaxed );
+	m_nActiveVoices.store( 0, std::memory_order_relaxed );
+	m_nMaxActiveVoices.store( 0, std::memory_order_relaxed );
+	m_nDeadlineNs.store( 0, std::memory_order_relaxed );
+}
+
+void EngineMetrics::beginCycle( int64_t nDeadlineNs )
+{
+	if ( m_bResetRequested.exchange( false, std::memory_order_acquire ) ) {
+		clear();
+	}
+	m_nDeadlineNs.store( nDeadlineNs, std::memory_order_relaxed );
+}
+
+int64_t EngineMetrics::record( int nStage, int64_t nStart )
+{
+	const int64_t nNow = now();
+	const uint64_t nDuration = std::max( nNow - nStart, int64_t( 0 ) );
+
+	Histogram& histogram = m_stages[ nStage ];
+	add( histogram.nCount, 1 );
+	add( histogram.nTotalNs, nDuration );
+	if ( nDuration > histogram.nMaxNs.load( std::memory_order_relaxed ) ) {
+		histogram.nMaxNs.store( nDuration, std::memory_order_relaxed );
+	}
+
+	int nBucket = 0;
+	for ( uint64_t nUs = nDuration / 1000; nUs > 0 && nBucket < nBuckets - 1; nUs >>= 1 ) {
+		++nBucket;
+	}
+	add( histogram.buckets[ nBucket ], 1 );
+
+	return nNow;
+}
+
+int64_t EngineMetrics::endCycle( int64_t nStart, bool bOffline )
+{
+	const int64_t nDuration = record( STAGE_CYCLE, nStart ) - nStart;
+	add( m_nCycles, 1 );
+	if ( ! bOffline && nDuration > static_cast<int64_t>( m_nDeadlineNs.load( std::memory_order_relaxed ) ) ) {
+		add( m_nXRuns, 1 );
+	}
+	return nDuration;
+}
+
+void EngineMetrics::missedBuffer()
+{
+	add( m_nMissedBuffers, 1 );
+}
+
+void EngineMetrics::voicesStolen( int nVoices )
+{
+	add( m_nVoicesStolen, nVoices );
+}
+
+void EngineMetrics::setActiveVoices( int nVoices )
+{
+	m_nActiveVoices.store( nVoices, std::memory_order_relaxed );
+	if ( nVoices > m_nMaxActiveVoices.load( std::memory_order_relaxed ) ) {
+		m_nMaxActiveVoices.store( nVoices, std::memory_order_relaxed );
+	}
+}
+
+EngineMetrics::Snapshot EngineMetrics::snapshot() const
+{
+	Snapshot snapshot;
+	for ( int nStage = 0; nStage < nStages; ++nStage ) {
+		const Histogram& histogram = m_stages[ nStage ];
+		StageSnapshot& stage = snapshot.stages[ nStage ];
+		stage.nCount = histogram.nCount.load( std::memory_order_relaxed );
+		stage.nTotalNs = histogram.nTotalNs.load( std::memory_order_relaxed );
+		stage.nMaxNs = histogram.nMaxNs.load( std::memory_order_relaxed );
+		for ( int ii = 0; ii < nBuckets; ++ii ) {
+			stage.buckets[ ii ] = histogram.buckets[ ii ].load( std::memory_order_relaxed );
+		}
+	}
+	snapshot.nCycles = m_nCycles.load( std::memory_order_relaxed );
+	snapshot.nXRuns = m_nXRuns.load( std::memory_order_relaxed );
+	snapshot.nMissedBuffers = m_nMissedBuffers.load( std::memory_order_relaxed );
+	snapshot.nVoicesStolen = m_nVoicesStolen.load( std::memory_order_relaxed );
+	snapshot.nActiveVoices = m_nActiveVoices.load( std::memory_order_relaxed );
+	snapshot.nMaxActiveVoices = m_nMaxActiveVoices.load( std::memory_order_relaxed );
+	snapshot.nDeadlineNs = m_nDeadlineNs.load( std::memory_order_relaxed );
+	return snapshot;
+}
+
+void EngineMetrics::reset()
+{
+	m_bResetRequested.store( true, std::memory_order_release );
+}
+
+QString EngineMetrics::toString( const Snapshot& snapshot )
+{
+	QString sReport;
+	QTextStream stream( &sReport );
+
+	stream << "cycles\t" << snapshot.nCycles << "\n"
+		   << "xruns\t" << snapshot.nXRuns << "\n"
+		   << "missed_buffers\t" << snapshot.nMissedBuffers << "\n"
+		   << "voices_stolen\t" << snapshot.nVoicesStolen << "\n"
+		   << "active_voices\t" << snapshot.nActiveVoices << "\n"
+		   << "max_active_voices\t" << snapshot.nMaxActiveVoices << "\n"
+		   << "deadline_us\t" << snapshot.nDeadlineNs / 1000.0 << "\n";
+
+	// All durations are given in microseconds, the histogram as
+	// counts of the buckets described in EngineMetrics::nBuckets.
+	stream << "# stage\tcount\tmean\tp50\tp99\tmax\thistogram\n";
+	for ( int nStage = 0; nStage < nStages; ++nStage ) {
+		const StageSnapshot& stage = snapshot.stages[ nStage ];
+		if ( stage.nCount == 0 && nStage >= STAGE_LADSPA_FX ) {
+			continue;
+		}
+		stream << getStageName( nStage ) << "\t" << stage.nCount
+			   << "\t" << stage.meanUs()
+			   << "\t" << stage.percentileUs( 50 )
+			   << "\t" << stage.percentileUs( 99 )
+			   << "\t" << stage.nMaxNs / 1000.0 << "\t";
+		for ( int ii = 0; ii < nBuckets; ++ii ) {
+			stream << ( ii > 0 ? "," : "" ) << stage.buckets[ ii ];
+		}
+		stream << "\n";
+	}
+
+	return sReport;
+}
+
+bool EngineMetrics::writeToFile( const QString& sPath ) const
+{
+	QFile file( sPath );
+	if ( ! file.open( QIODevice::WriteOnly | QIODevice::Text ) ) {
+		ERRORLOG( QString( "Unable to write engine metrics to [%1]" ).arg( sPath ) );
+		return false;
+	}
+	QTextStream stream( &file );
+	stream << toString( snapshot() );
+	return true;
+}
+
+};
@@ -0,0 +1,175 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#ifndef H2C_ENGINE_METRICS_H
+#define H2C_ENGINE_METRICS_H
+
+#include <core/config.h>
+#include <core/Object.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace H2Core
+{
+
+/**
+ * Always-on timing and load statistics of the audio engine.
+ *
+ * The audio thread records the duration of each stage of a process
+ * cycle into a histogram with power-of-two microsecond buckets and
+ * updates a number of counters. Recording only consists of relaxed
+ * stores to atomics owned exclusively by the audio thread. It
+ * neither locks nor allocates and is therefore done in all builds.
+ *
+ * Other threads obtain a consistent-enough copy using snapshot() and
+ * may export it using toString() or writeToFile(), e.g. triggered via
+ * OSC or by `h2cli --metrics`. reset() is carried out by the audio
+ * thread at the beginning of its next cycle.
+ *
+ * \ingroup docCore docAudioEngine
+ */
+class EngineMetrics : public H2Core::Object<EngineMetrics>
+{
+	H2_OBJECT(EngineMetrics)
+public:
+	/** Parts of AudioEngine::audioEngine_process() timed separately.*/
+	enum Stage {
+		/** Whole cycle including waiting for the engine lock.*/
+		STAGE_CYCLE = 0,
+		/** Waiting for the engine lock.*/
+		STAGE_LOCK_WAIT,
+		/** Commands of other threads, transport, and tempo changes.*/
+		STAGE_TRANSPORT,
+		/** Updating the note queue and starting due notes.*/
+		STAGE_NOTE_QUEUE,
+		STAGE_SAMPLER,
+		STAGE_SYNTH,
+		/** Master and component peak metering.*/
+		STAGE_PEAKS,
+		/** First of #MAX_FX stages, one for each LADSPA slot.*/
+		STAGE_LADSPA_FX
+	};
+	static constexpr int nStages = STAGE_LADSPA_FX + MAX_FX;
+	/** Bucket 0 holds durations below 1 us, bucket n > 0 those in
+	 * [2^(n-1), 2^n) us. The last one holds all longer ones.*/
+	static constexpr int nBuckets = 24;
+
+	struct StageSnapshot {
+		uint64_t nCount;
+		uint64_t nTotalNs;
+		uint64_t nMaxNs;
+		uint64_t buckets[ nBuckets ];
+
+		/** \return Upper bound in microseconds of the bucket
+		 * containing the @a fPercentile (0 - 100) of all recorded
+		 * durations.*/
+		double percentileUs( double fPercentile ) const;
+		double meanUs() const;
+	};
+
+	struct Snapshot {
+		StageSnapshot stages[ nStages ];
+		/** Cycles rendered or dropped.*/
+		uint64_t nCycles;
+		/** Cycles exceeding the duration of the buffer. Not counted
+		 * while rendering offline.*/
+		uint64_t nXRuns;
+		/** Cycles dropped since the engine lock could not be
+		 * obtained in time.*/
+		uint64_t nMissedBuffers;
+		/** Notes stopped because Preferences::m_nMaxNotes was
+		 * exceeded.*/
+		uint64_t nVoicesStolen;
+		int nActiveVoices;
+		int nMaxActiveVoices;
+		/** Duration of a buffer in the last cycle.*/
+		uint64_t nDeadlineNs;
+	};
+
+	EngineMetrics();
+
+	/** \return Monotonic time in nanoseconds.*/
+	static int64_t now() {
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch() ).count();
+	}
+	static QString getStageName( int nStage );
+
+	/** Called by the audio thread at the beginning of each cycle.*/
+	void beginCycle( int64_t nDeadlineNs );
+	/**
+	 * Records the time passed since @a nStart for @a nStage.
+	 *
+	 * \return The current time, which can be used as start of the
+	 * next stage.
+	 */
+	int64_t record( int nStage, int64_t nStart );
+	/** Counts the cycle which started at @a nStart and returns its
+	 * duration in nanoseconds.*/
+	int64_t endCycle( int64_t nStart, bool bOffline );
+	void missedBuffer();
+	void voicesStolen( int nVoices );
+	void setActiveVoices( int nVoices );
+
+	/** May be called from any thread.*/
+	Snapshot snapshot() const;
+	/** Discards all values recorded so far. May be called from any
+	 * thread.*/
+	void reset();
+
+	/** \return Human and machine readable report of @a snapshot with
+	 * one line per stage or counter.*/
+	static QString toString( const Snapshot& snapshot );
+	/** Writes toString() of the current snapshot() to @a sPath.*/
+	bool writeToFile( const QString& sPath ) const;
+
+private:
+	struct Histogram {
+		std::atomic<uint64_t> nCount;
+		std::atomic<uint64_t> nTotalNs;
+		std::atomic<uint64_t> nMaxNs;
+		std::atomic<uint64_t> buckets[ nBuckets ];
+	};
+
+	/** Only the audio thread writes, so no read-modify-write
+	 * operations are required.*/
+	static void add( std::atomic<uint64_t>& value, uint64_t nDelta ) {
+		value.store( value.load( std::memory_order_relaxed ) + nDelta,
+					 std::memory_order_relaxed );
+	}
+	void clear();
+
+	Histogram m_stages[ nStages ];
+	std::atomic<uint64_t> m_nCycles;
+	std::atomic<uint64_t> m_nXRuns;
+	std::atomic<uint64_t> m_nMissedBuffers;
+	std::atomic<uint64_t> m_nVoicesStolen;
+	std::atomic<int> m_nActiveVoices;
+	std::atomic<int> m_nMaxActiveVoices;
+	std::atomic<uint64_t> m_nDeadlineNs;
+	std::atomic<bool> m_bResetRequested;
+};
+
+};
+
+#endif // H2C_ENGINE_METRICS_H
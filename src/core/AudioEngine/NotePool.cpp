@@ -0,0 +1,107 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#include <core/AudioEngine/NotePool.h>
+#include <core/Basics/Adsr.h>
+#include <core/Basics/Note.h>
+
+namespace H2Core
+{
+
+NotePool::NotePool( int nCapacity )
+	: m_freeNotes( nCapacity )
+	, m_nAvailable( 0 )
+{
+	m_notes.reserve( nCapacity );
+
+	for ( int ii = 0; ii < nCapacity; ++ii ) {
+		Note* pNote = new Note( nullptr, 0, 0, 0, -1, 0 );
+		pNote->m_bPooled = true;
+		// Allocate everything a recycled note will need right away.
+		pNote->__adsr = std::make_shared<ADSR>();
+		pNote->__layers_selected.reserve( MAX_COMPONENTS );
+		m_notes.push_back( pNote );
+		m_freeNotes.push( pNote );
+	}
+	m_nAvailable = nCapacity;
+}
+
+NotePool::~NotePool()
+{
+	if ( getAvailable() != getCapacity() ) {
+		WARNINGLOG( QString( "[%1] notes still in use" )
+					.arg( getCapacity() - getAvailable() ) );
+	}
+
+	for ( auto pNote : m_notes ) {
+		delete pNote;
+	}
+}
+
+Note* NotePool::pop()
+{
+	Note* pNote = nullptr;
+	if ( ! m_freeNotes.pop( &pNote ) ) {
+		return nullptr;
+	}
+	m_nAvailable.fetch_sub( 1 );
+	return pNote;
+}
+
+Note* NotePool::acquire( Note* pOther )
+{
+	Note* pNote = pop();
+	if ( pNote != nullptr ) {
+		pNote->copy_from( pOther );
+	}
+	return pNote;
+}
+
+Note* NotePool::acquire( std::shared_ptr<Instrument> pInstrument, int nPosition, float fVelocity,
+						 float fPan, int nLength, float fPitch )
+{
+	Note* pNote = pop();
+	if ( pNote != nullptr ) {
+		pNote->reset( pInstrument, nPosition, fVelocity, fPan, nLength, fPitch );
+	}
+	return pNote;
+}
+
+void NotePool::release( Note* pNote )
+{
+	if ( pNote == nullptr ) {
+		return;
+	}
+
+	if ( ! pNote->is_pooled() ) {
+		delete pNote;
+		return;
+	}
+
+	// Drop the reference to the instrument right away so a pooled
+	// note does not keep a removed instrument alive.
+	pNote->__instrument = nullptr;
+	// The queue holds all notes of the pool. Pushing never fails.
+	m_freeNotes.push( pNote );
+	m_nAvailable.fetch_add( 1 );
+}
+
+};
@@ -0,0 +1,100 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+#ifndef NOTE_POOL_H
+#define NOTE_POOL_H
+
+#include <core/Object.h>
+#include <core/Helpers/LockFreeQueue.h>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace H2Core
+{
+
+class Note;
+class Instrument;
+
+/**
+ * Fixed set of Note instances recycled by the AudioEngine and the
+ * Sampler.
+ *
+ * All notes are created up front. Afterwards acquire() and release()
+ * only move pointers between the pool and its users, and recycled
+ * notes reuse their envelope and layer information. Once the pool is
+ * exhausted, acquire() fails instead of allocating and the note is
+ * not played. release() accepts both kinds of notes and also ones
+ * created by other parts of Hydrogen using new. The latter are
+ * deleted and must thus not be released by the audio thread.
+ *
+ * The free notes are kept in a LockFreeQueue. Both acquire() and
+ * release() can therefore be called by any thread without holding
+ * the AudioEngine lock.
+ *
+ * \ingroup docCore docAudioEngine
+ */
+class NotePool : public H2Core::Object<NotePool>
+{
+	H2_OBJECT(NotePool)
+public:
+	/**
+	 * \param nCapacity Number of notes to create.
+	 */
+	NotePool( int nCapacity );
+	~NotePool();
+
+	/** \return Copy of @a pOther or nullptr in case the pool is
+	 * exhausted. */
+	Note* acquire( Note* pOther );
+	/** \return Note constructed using the provided arguments or
+	 * nullptr in case the pool is exhausted. */
+	Note* acquire( std::shared_ptr<Instrument> pInstrument, int nPosition, float fVelocity,
+				   float fPan, int nLength, float fPitch );
+	/**
+	 * Returns @a pNote to the pool or deletes it in case it was not
+	 * created by it.
+	 */
+	void release( Note* pNote );
+
+	int getCapacity() const {
+		return m_notes.size();
+	}
+	/** Number of pooled notes not handed out right now.*/
+	int getAvailable() const {
+		return m_nAvailable.load();
+	}
+
+private:
+	/** \return Free note or nullptr.*/
+	Note* pop();
+
+	/** All notes owned by the pool.*/
+	std::vector<Note*> m_notes;
+	/** Subset of #m_notes ready to be handed out.*/
+	LockFreeQueue<Note*> m_freeNotes;
+	/** Number of notes in #m_freeNotes.*/
+	std::atomic<int> m_nAvailable;
+};
+
+};
+
+#endif
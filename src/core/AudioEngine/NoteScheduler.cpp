@@ -0,0 +1,267 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#include <core/AudioEngine/NoteScheduler.h>
+#include <core/Basics/Note.h>
+
+#include <algorithm>
+
+namespace H2Core
+{
+
+NoteScheduler::NoteScheduler( int nBuckets, int nCapacity )
+	: m_nLateEntries( -1 )
+	, m_nFreeEntries( -1 )
+	, m_nNextSlot( 0 )
+	, m_bCursorValid( false )
+	, m_nBucketSize( 1024 )
+	, m_fTickSize( 0 )
+	, m_nSize( 0 )
+	, m_nSequence( 0 )
+{
+	m_buckets.resize( std::max( nBuckets, 1 ), -1 );
+	m_entries.resize( std::max( nCapacity, 1 ) );
+	for ( int ii = static_cast<int>( m_entries.size() ) - 1; ii >= 0; --ii ) {
+		freeEntry( ii );
+	}
+	m_scratch.reserve( m_entries.size() );
+}
+
+NoteScheduler::~NoteScheduler()
+{
+	if ( m_nSize != 0 ) {
+		WARNINGLOG( QString( "[%1] notes still scheduled" ).arg( m_nSize ) );
+	}
+}
+
+bool NoteScheduler::compareEntries( const Entry& a, const Entry& b )
+{
+	if ( a.nOnset != b.nOnset ) {
+		return a.nOnset < b.nOnset;
+	}
+	return a.nSequence < b.nSequence;
+}
+
+long long NoteScheduler::slotOf( long long nFrame ) const
+{
+	if ( nFrame >= 0 ) {
+		return nFrame / m_nBucketSize;
+	}
+	return -( ( -nFrame - 1 ) / m_nBucketSize ) - 1;
+}
+
+void NoteScheduler::computeFrames( Entry* pEntry ) const
+{
+	Note* pNote = pEntry->pNote;
+	long long nPosition = static_cast<int>( pNote->get_position() * m_fTickSize );
+
+	pEntry->nOnset = nPosition + pNote->get_humanize_delay();
+
+	// Negative humanize delays have to be taken into account so we
+	// don't miss the time slice. Positive ones are handled by the
+	// Sampler.
+	pEntry->nStart = nPosition + std::min( pNote->get_humanize_delay(), 0 );
+}
+
+void NoteScheduler::insert( int nIndex )
+{
+	Entry& entry = m_entries[ nIndex ];
+	long long nSlot = slotOf( entry.nStart );
+	if ( m_bCursorValid && nSlot < m_nNextSlot ) {
+		entry.nNext = m_nLateEntries;
+		m_nLateEntries = nIndex;
+		return;
+	}
+
+	long long nBuckets = m_buckets.size();
+	int& nHead = m_buckets[ ( ( nSlot % nBuckets ) + nBuckets ) % nBuckets ];
+	entry.nNext = nHead;
+	nHead = nIndex;
+}
+
+void NoteScheduler::freeEntry( int nIndex )
+{
+	m_entries[ nIndex ].pNote = nullptr;
+	m_entries[ nIndex ].nNext = m_nFreeEntries;
+	m_nFreeEntries = nIndex;
+}
+
+bool NoteScheduler::push( Note* pNote, float fTickSize )
+{
+	if ( m_nFreeEntries == -1 ) {
+		return false;
+	}
+
+	if ( fTickSize != m_fTickSize ) {
+		m_fTickSize = fTickSize;
+		reschedule();
+	}
+
+	int nIndex = m_nFreeEntries;
+	Entry& entry = m_entries[ nIndex ];
+	m_nFreeEntries = entry.nNext;
+
+	entry.pNote = pNote;
+	entry.nSequence = m_nSequence++;
+	computeFrames( &entry );
+	insert( nIndex );
+	++m_nSize;
+	return true;
+}
+
+void NoteScheduler::drainBucket( long long nSlot, long long nEndFrame )
+{
+	long long nBuckets = m_buckets.size();
+	int* pLink = &m_buckets[ ( ( nSlot % nBuckets ) + nBuckets ) % nBuckets ];
+
+	// Order within the bucket does not matter since the sequence
+	// numbers are used for sorting afterwards.
+	while ( *pLink != -1 ) {
+		int nIndex = *pLink;
+		Entry& entry = m_entries[ nIndex ];
+		if ( entry.nStart < nEndFrame ) {
+			*pLink = entry.nNext;
+			m_scratch.push_back( entry );
+			freeEntry( nIndex );
+		} else {
+			pLink = &entry.nNext;
+		}
+	}
+}
+
+void NoteScheduler::popDue( long long nEndFrame, float fTickSize, std::vector<Note*>& notes )
+{
+	notes.clear();
+
+	if ( fTickSize != m_fTickSize ) {
+		m_fTickSize = fTickSize;
+		reschedule();
+	}
+
+	m_scratch.clear();
+
+	long long nEndSlot = slotOf( nEndFrame - 1 );
+	long long nBuckets = m_buckets.size();
+
+	if ( ! m_bCursorValid || nEndSlot - m_nNextSlot + 1 >= nBuckets ) {
+		// Either the first call or transport jumped ahead by more
+		// than a whole turn of the ring.
+		for ( long long nSlot = 0; nSlot < nBuckets; ++nSlot ) {
+			drainBucket( nSlot, nEndFrame );
+		}
+	} else {
+		// In case transport moved backwards there is nothing to do
+		// since all remaining notes start past the old position.
+		for ( long long nSlot = m_nNextSlot; nSlot <= nEndSlot; ++nSlot ) {
+			drainBucket( nSlot, nEndFrame );
+		}
+	}
+
+	// The last bucket might still contain notes starting after
+	// nEndFrame.
+	m_nNextSlot = nEndSlot;
+	m_bCursorValid = true;
+
+	// Notes pushed behind the cursor. If transport moved backwards,
+	// e.g. by relocating or by starting playback at a position prior
+	// to the one realtime notes were played at, they are not
+	// necessarily due yet and go back into the ring instead. Since
+	// they start at or after nEndFrame, insert() does not add them to
+	// the late entries again.
+	int nIndex = m_nLateEntries;
+	m_nLateEntries = -1;
+	while ( nIndex != -1 ) {
+		int nNext = m_entries[ nIndex ].nNext;
+		if ( m_entries[ nIndex ].nStart < nEndFrame ) {
+			m_scratch.push_back( m_entries[ nIndex ] );
+			freeEntry( nIndex );
+		} else {
+			insert( nIndex );
+		}
+		nIndex = nNext;
+	}
+
+	std::sort( m_scratch.begin(), m_scratch.end(), compareEntries );
+	for ( const auto& entry : m_scratch ) {
+		notes.push_back( entry.pNote );
+	}
+	m_nSize -= m_scratch.size();
+	m_scratch.clear();
+}
+
+void NoteScheduler::popAll( std::vector<Note*>& notes )
+{
+	notes.clear();
+	for ( auto& nHead : m_buckets ) {
+		while ( nHead != -1 ) {
+			int nIndex = nHead;
+			nHead = m_entries[ nIndex ].nNext;
+			notes.push_back( m_entries[ nIndex ].pNote );
+			freeEntry( nIndex );
+		}
+	}
+	while ( m_nLateEntries != -1 ) {
+		int nIndex = m_nLateEntries;
+		m_nLateEntries = m_entries[ nIndex ].nNext;
+		notes.push_back( m_entries[ nIndex ].pNote );
+		freeEntry( nIndex );
+	}
+
+	m_nSize = 0;
+	m_bCursorValid = false;
+}
+
+void NoteScheduler::setBucketSize( int nFrames )
+{
+	if ( nFrames <= 0 || nFrames == m_nBucketSize ) {
+		return;
+	}
+
+	m_nBucketSize = nFrames;
+	reschedule();
+}
+
+void NoteScheduler::reschedule()
+{
+	// Collect all entries in a single list first.
+	int nPending = m_nLateEntries;
+	m_nLateEntries = -1;
+	for ( auto& nHead : m_buckets ) {
+		while ( nHead != -1 ) {
+			int nIndex = nHead;
+			nHead = m_entries[ nIndex ].nNext;
+			m_entries[ nIndex ].nNext = nPending;
+			nPending = nIndex;
+		}
+	}
+
+	// All notes end up in the ring again and the first subsequent
+	// popDue() has to scan it completely.
+	m_bCursorValid = false;
+	while ( nPending != -1 ) {
+		int nIndex = nPending;
+		nPending = m_entries[ nIndex ].nNext;
+		computeFrames( &m_entries[ nIndex ] );
+		insert( nIndex );
+	}
+}
+
+};
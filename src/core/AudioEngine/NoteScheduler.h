@@ -0,0 +1,167 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+#ifndef NOTE_SCHEDULER_H
+#define NOTE_SCHEDULER_H
+
+#include <core/Object.h>
+
+#include <vector>
+
+namespace H2Core
+{
+
+class Note;
+
+/**
+ * Calendar queue holding all notes scheduled for playback.
+ *
+ * Notes are sorted into a ring of buckets according to the frame
+ * they start at. Each bucket covers getBucketSize() frames, which
+ * the AudioEngine keeps equal to the size of the audio period. Thus,
+ * push() is O(1) and popDue() only has to look at the buckets
+ * covering the current period, regardless of how many notes are
+ * queued for later.
+ *
+ * The start frame of a note is its position times the tick size
+ * plus its humanize delay - only if the latter is negative. This
+ * matches the criterion used by AudioEngine::processPlayNotes() to
+ * decide whether a note has to be played in the current cycle. All
+ * notes are rescheduled whenever the tick size changes.
+ *
+ * All entries are allocated in the constructor and linked into the
+ * buckets by index. Neither push() nor popDue() nor rescheduling
+ * allocate. The bucket size is set by the AudioEngine whenever the
+ * audio driver changes.
+ *
+ * The scheduler does not own the notes it holds. It does not lock
+ * either and has to be accessed while holding the AudioEngine lock.
+ *
+ * \ingroup docCore docAudioEngine
+ */
+class NoteScheduler : public H2Core::Object<NoteScheduler>
+{
+	H2_OBJECT(NoteScheduler)
+public:
+	/**
+	 * \param nBuckets Number of buckets in the ring. The scheduler
+	 * is most efficient if all notes lie within nBuckets audio
+	 * periods from the current position.
+	 * \param nCapacity Maximum number of notes held at once.
+	 */
+	NoteScheduler( int nBuckets, int nCapacity );
+	~NoteScheduler();
+
+	/**
+	 * Adds @a pNote using the current tick size @a fTickSize.
+	 *
+	 * \return false in case the scheduler already holds as many
+	 * notes as it has capacity for. @a pNote is not added then.
+	 */
+	bool push( Note* pNote, float fTickSize );
+
+	/**
+	 * Moves all notes starting prior to @a nEndFrame into @a
+	 * notes.
+	 *
+	 * They are ordered by their actual onset, which takes positive
+	 * humanize delays into account as well. Notes with equal onset
+	 * are returned in the order they were pushed.
+	 *
+	 * \param nEndFrame First frame past the current audio period.
+	 * \param fTickSize Current tick size.
+	 * \param notes Cleared first.
+	 */
+	void popDue( long long nEndFrame, float fTickSize, std::vector<Note*>& notes );
+
+	/** Moves all notes into @a notes in no particular order. */
+	void popAll( std::vector<Note*>& notes );
+
+	bool isEmpty() const {
+		return m_nSize == 0;
+	}
+	int size() const {
+		return m_nSize;
+	}
+
+	int getBucketSize() const {
+		return m_nBucketSize;
+	}
+	/** Changes the number of frames covered by a bucket and
+	 * reschedules all notes accordingly. Intended to be called
+	 * whenever the buffer size of the audio driver changes and not
+	 * within the process cycle.*/
+	void setBucketSize( int nFrames );
+
+private:
+	struct Entry {
+		Note* pNote;
+		/** Frame the note is due at.*/
+		long long nStart;
+		/** Frame the note actually starts at. Used for sorting.*/
+		long long nOnset;
+		/** Insertion order. Used for sorting.*/
+		unsigned nSequence;
+		/** Index of the next entry in the same list. -1 ends the
+		 * list.*/
+		int nNext;
+	};
+
+	static bool compareEntries( const Entry& a, const Entry& b );
+
+	/** Absolute index of the bucket holding @a nFrame.*/
+	long long slotOf( long long nFrame ) const;
+	void computeFrames( Entry* pEntry ) const;
+	/** Links the entry at @a nIndex into its bucket.*/
+	void insert( int nIndex );
+	/** Returns the entry at @a nIndex to #m_nFreeEntries.*/
+	void freeEntry( int nIndex );
+	/** Moves all entries of the bucket of @a nSlot starting before @a
+	 * nEndFrame into #m_scratch.*/
+	void drainBucket( long long nSlot, long long nEndFrame );
+	/** Recomputes the frames of all notes and rebuilds the ring.*/
+	void reschedule();
+
+	/** Storage of all entries.*/
+	std::vector<Entry> m_entries;
+	/** Index of the first entry of each bucket.*/
+	std::vector<int> m_buckets;
+	/** First of the entries pushed into buckets which were already
+	 * drained.*/
+	int m_nLateEntries;
+	/** First unused entry.*/
+	int m_nFreeEntries;
+	/** Entries due in the current cycle. Reserved for all entries.*/
+	std::vector<Entry> m_scratch;
+
+	/** Lowest slot which might still contain notes not returned by
+	 * popDue(). Only valid if #m_bCursorValid is true.*/
+	long long m_nNextSlot;
+	bool m_bCursorValid;
+
+	int m_nBucketSize;
+	float m_fTickSize;
+	int m_nSize;
+	unsigned m_nSequence;
+};
+
+};
+
+#endif
@@ -24,9 +24,65 @@
 
 #include "ExponentialTables.h"
 
+#include <algorithm>
+#include <cmath>
+
 namespace H2Core
 {
 
+/**
+ * Tables of ExponentialTables.h with the division done by
+ * compute_exponant() folded into each entry. Looking up a curve value
+ * then takes a single multiplication, which allows the loops of
+ * ADSR::get_values() to be vectorized.
+ */
+struct ExponantSlopes {
+	static constexpr int nSize = sizeof( concave_exponant_table ) / sizeof( float );
+	static_assert( nSize == sizeof( convex_exponant_table ) / sizeof( float ),
+				   "Both curves have to use the same resolution" );
+
+	float concave[ nSize ];
+	float convex[ nSize ];
+
+	ExponantSlopes() {
+		for ( int ii = 0; ii < nSize; ++ii ) {
+			const float fBucket = static_cast<float>( ii + 1 ) / nSize;
+			concave[ ii ] = concave_exponant_table[ ii ] / fBucket;
+			convex[ ii ] = convex_exponant_table[ ii ] / fBucket;
+		}
+	}
+};
+
+static const ExponantSlopes exponantSlopes;
+
+/** Same as compute_exponant() using a table of ExponantSlopes.*/
+inline static float lookup_exponant( float fInput, const float* pSlopes )
+{
+	const int nIndex = std::min( std::max( static_cast<int>( fInput * ExponantSlopes::nSize ), 0 ),
+								 ExponantSlopes::nSize - 1 );
+	return pSlopes[ nIndex ] * fInput;
+}
+
+/**
+ * Number of frames starting at @a fTicks which are rendered before
+ * the tick count, increased by @a fStep each frame, passes @a fEnd.
+ *
+ * \param bInclusive Whether the state is left once the tick count is
+ * larger than @a fEnd (like ATTACK, DECAY, and RELEASE) or already
+ * once it reaches it (like FADE_OUT).
+ */
+inline static int segment_length( float fTicks, float fEnd, float fStep, int nMaxFrames,
+								  bool bInclusive )
+{
+	if ( fStep <= 0 ) {
+		return nMaxFrames;
+	}
+	const double fFrames = ( static_cast<double>( fEnd ) - fTicks ) / fStep;
+	double fLength = bInclusive ? std::floor( fFrames ) + 1 : std::ceil( fFrames );
+	fLength = std::max( fLength, 1.0 );
+	return fLength < nMaxFrames ? static_cast<int>( fLength ) : nMaxFrames;
+}
+
 
 inline static float linear_interpolation( float fVal_A, float fVal_B, double fVal )
 {
@@ -68,6 +124,7 @@ ADSR::ADSR( unsigned int attack, unsigned int decay, float sustain, unsigned int
 	__decay( decay ),
 	__sustain( sustain ),
 	__release( release ),
+	__fade_out( 0 ),
 	__state( ATTACK ),
 	__ticks( 0.0 ),
 	__value( 0.0 ),
@@ -81,6 +138,7 @@ ADSR::ADSR( const std::shared_ptr<ADSR> other ) :
 	__decay( other->__decay ),
 	__sustain( other->__sustain ),
 	__release( other->__release ),
+	__fade_out( other->__fade_out ),
 	__state( other->__state ),
 	__ticks( other->__ticks ),
 	__value( other->__value ),
@@ -139,6 +197,15 @@ float ADSR::get_value( float step )
 		}
 		break;
 
+	case FADE_OUT:
+		__value = linear_interpolation( __release_value, 0.0, ( __ticks * 1.0 / __fade_out ) );
+		__ticks += step;
+		if ( __ticks >= __fade_out ) {
+			__state = IDLE;
+			__ticks = 0;
+		}
+		break;
+
 	case IDLE:
 	default:
 		__value = 0;
@@ -147,6 +214,102 @@ float ADSR::get_value( float step )
 	return __value;
 }
 
+void ADSR::get_values( float* pValues, int nFrames, float fStep )
+{
+	int nFrame = 0;
+	while ( nFrame < nFrames ) {
+		const int nRemaining = nFrames - nFrame;
+		float* pSegment = pValues + nFrame;
+		const float fTicks = __ticks;
+		int nLength = nRemaining;
+
+		switch ( __state ) {
+		case ATTACK: {
+			nLength = segment_length( fTicks, __attack, fStep, nRemaining, true );
+			if ( __attack == 0 ) {
+				std::fill( pSegment, pSegment + nLength, 1.0f );
+			} else {
+				const float fScale = 1.0f / __attack;
+				for ( int ii = 0; ii < nLength; ++ii ) {
+					pSegment[ ii ] = lookup_exponant( ( fTicks + ii * fStep ) * fScale,
+													  exponantSlopes.convex );
+				}
+			}
+			__ticks += nLength * fStep;
+			if ( __ticks > __attack ) {
+				__state = DECAY;
+				__ticks = 0;
+			}
+			break;
+		}
+
+		case DECAY: {
+			nLength = segment_length( fTicks, __decay, fStep, nRemaining, true );
+			if ( __decay == 0 ) {
+				std::fill( pSegment, pSegment + nLength, __sustain );
+			} else {
+				const float fScale = 1.0f / __decay;
+				const float fRange = 1 - __sustain;
+				for ( int ii = 0; ii < nLength; ++ii ) {
+					pSegment[ ii ] = lookup_exponant( 1 - ( fTicks + ii * fStep ) * fScale,
+													  exponantSlopes.concave ) * fRange + __sustain;
+				}
+			}
+			__ticks += nLength * fStep;
+			if ( __ticks > __decay ) {
+				__state = SUSTAIN;
+				__ticks = 0;
+			}
+			break;
+		}
+
+		case SUSTAIN:
+			std::fill( pSegment, pSegment + nLength, __sustain );
+			break;
+
+		case RELEASE: {
+			if ( __release < 256 ) {
+				__release = 256;
+			}
+			nLength = segment_length( fTicks, __release, fStep, nRemaining, true );
+			const float fScale = 1.0f / __release;
+			for ( int ii = 0; ii < nLength; ++ii ) {
+				pSegment[ ii ] = lookup_exponant( 1 - ( fTicks + ii * fStep ) * fScale,
+												  exponantSlopes.concave ) * __release_value;
+			}
+			__ticks += nLength * fStep;
+			if ( __ticks > __release ) {
+				__state = IDLE;
+				__ticks = 0;
+			}
+			break;
+		}
+
+		case FADE_OUT: {
+			nLength = segment_length( fTicks, __fade_out, fStep, nRemaining, false );
+			const float fDecrement = __release_value * fStep / __fade_out;
+			const float fStart = __release_value * ( 1 - fTicks / __fade_out );
+			for ( int ii = 0; ii < nLength; ++ii ) {
+				pSegment[ ii ] = fStart - ii * fDecrement;
+			}
+			__ticks += nLength * fStep;
+			if ( __ticks >= __fade_out ) {
+				__state = IDLE;
+				__ticks = 0;
+			}
+			break;
+		}
+
+		case IDLE:
+		default:
+			std::fill( pSegment, pSegment + nLength, 0.0f );
+		}
+
+		__value = pSegment[ nLength - 1 ];
+		nFrame += nLength;
+	}
+}
+
 void ADSR::attack()
 {
 	__state = ATTACK;
@@ -156,13 +319,22 @@ void ADSR::attack()
 float ADSR::release()
 {
 	if ( __state == IDLE ) return 0;
-	if ( __state == RELEASE ) return __value;
+	if ( __state == RELEASE || __state == FADE_OUT ) return __value;
 	__release_value = __value;
 	__state = RELEASE;
 	__ticks = 0;
 	return __release_value;
 }
 
+void ADSR::fade_out( unsigned int nTicks )
+{
+	if ( __state == IDLE || __state == FADE_OUT ) return;
+	__release_value = __value;
+	__fade_out = std::max( nTicks, 1u );
+	__state = FADE_OUT;
+	__ticks = 0;
+}
+
 QString ADSR::toQString( const QString& sPrefix, bool bShort ) const {
 	QString s = Base::sPrintIndention;
 	QString sOutput;
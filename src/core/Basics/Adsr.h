@@ -51,6 +51,17 @@ class ADSR : public Object<ADSR>
 		/** copy constructor */
 		ADSR( const std::shared_ptr<ADSR> other );
 
+		/** possible states */
+		enum ADSRState {
+			ATTACK=0,
+			DECAY,
+			SUSTAIN,
+			RELEASE,
+			/** Short linear fade entered using fade_out().*/
+			FADE_OUT,
+			IDLE
+		};
+
 		/** destructor */
 		~ADSR();
 
@@ -92,6 +103,17 @@ class ADSR : public Object<ADSR>
 		 * \param step the increment to be added to __ticks
 		 */
 		float get_value( float step );
+		/**
+		 * Computes the values of @a nFrames consecutive frames at
+		 * once. Equivalent to calling get_value() @a nFrames times
+		 * but the block is split at the transitions between the
+		 * states and each segment is computed without any branching.
+		 *
+		 * \param pValues Buffer receiving @a nFrames values.
+		 * \param nFrames Number of frames.
+		 * \param fStep The increment added to __ticks per frame.
+		 */
+		void get_values( float* pValues, int nFrames, float fStep );
 		/**
 		 * sets state to RELEASE,
 		 * returns 0 if the state is IDLE,
@@ -99,6 +121,17 @@ class ADSR : public Object<ADSR>
 		 * set state to RELEASE, save __release_value and return it.
 		 * */
 		float release();
+		/**
+		 * sets state to FADE_OUT, which lowers the current value
+		 * linearly to zero within @a nTicks, regardless of the
+		 * release duration. Used to stop voices without a click.
+		 */
+		void fade_out( unsigned int nTicks );
+
+		/** __state accessor */
+		ADSRState get_state() const;
+		/** value computed by the last get_value() call */
+		float get_current_value() const;
 
 		/** Formatted string version for debugging purposes.
 		 * \param sPrefix String prefix which will be added in front of
@@ -114,14 +147,7 @@ class ADSR : public Object<ADSR>
 		unsigned int __decay;		///< Decay tick count
 		float __sustain;			///< Sustain level
 		unsigned int __release;		///< Release tick count
-		/** possible states */
-		enum ADSRState {
-			ATTACK=0,
-			DECAY,
-			SUSTAIN,
-			RELEASE,
-			IDLE
-		};
+		unsigned int __fade_out;	///< Fade out tick count
 		ADSRState __state;      ///< current state
 		float __ticks;          ///< current tick count
 		float __value;          ///< current value
@@ -171,6 +197,16 @@ inline unsigned int ADSR::get_release()
 	return __release;
 }
 
+inline ADSR::ADSRState ADSR::get_state() const
+{
+	return __state;
+}
+
+inline float ADSR::get_current_value() const
+{
+	return __value;
+}
+
 };
 
 #endif // H2C_ADRS_H
@@ -410,7 +410,11 @@ bool Drumkit::save_samples( const QString& dk_dir, bool overwrite )
 							}
 						}
 
-						pLayer->get_sample()->set_filename( dst );
+						// The sample might be shared with other layers
+						// (see SamplePool), which keep the original file.
+						auto pSample = std::make_shared<Sample>( pLayer->get_sample() );
+						pSample->set_filename( dst );
+						pLayer->set_sample( pSample );
 
 						if( !Filesystem::file_copy( src, dst ) ) {
 							return false;
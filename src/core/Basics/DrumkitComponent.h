@@ -26,6 +26,7 @@
 #include <cassert>
 #include <inttypes.h>
 #include <core/Object.h>
+#include <core/Basics/InstrumentComponent.h>
 
 namespace H2Core
 {
@@ -73,6 +74,10 @@ class DrumkitComponent : public H2Core::Object<DrumkitComponent>
 		void						set_outs( int nBufferPos, float valL, float valR );
 		float						get_out_L( int nBufferPos );
 		float						get_out_R( int nBufferPos );
+		/** Raw access to the output buffers, e.g. to mix a whole
+		 * block into them at once.*/
+		float*						get_out_buffer_L();
+		float*						get_out_buffer_R();
 		/** Formatted string version for debugging purposes.
 		 * \param sPrefix String prefix which will be added in front of
 		 * every new line
@@ -115,6 +120,7 @@ inline const QString& DrumkitComponent::get_name() const
 inline void DrumkitComponent::set_id( const int id )
 {
 	__id = id;
+	InstrumentComponent::touch();
 }
 
 inline int DrumkitComponent::get_id() const
@@ -172,6 +178,16 @@ inline float DrumkitComponent::get_peak_r() const
 	return __peak_r;
 }
 
+inline float* DrumkitComponent::get_out_buffer_L()
+{
+	return __out_L;
+}
+
+inline float* DrumkitComponent::get_out_buffer_R()
+{
+	return __out_R;
+}
+
 inline void DrumkitComponent::set_outs( int nBufferPos, float valL, float valR )
 {
 	__out_L[nBufferPos] += valL;
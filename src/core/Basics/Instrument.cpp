@@ -28,6 +28,8 @@
 #include <core/AudioEngine/AudioEngine.h>
 
 #include <core/Helpers/Xml.h>
+#include <core/Helpers/SampleLoader.h>
+#include <core/Helpers/SamplePool.h>
 
 #include <core/Basics/Adsr.h>
 #include <core/Basics/Sample.h>
@@ -36,6 +38,7 @@
 #include <core/Basics/InstrumentList.h>
 #include <core/Basics/InstrumentComponent.h>
 #include <core/Basics/InstrumentLayer.h>
+#include <core/Sampler/RenderPlan.h>
 #include <core/Sampler/Sampler.h>
 
 namespace H2Core
@@ -73,6 +76,7 @@ Instrument::Instrument( const int id, const QString& name, std::shared_ptr<ADSR>
 	, __apply_velocity( true )
 	, __current_instr_for_export(false)
 	, m_bHasMissingSamples( false )
+	, m_pRenderPlan( new RenderPlan() )
 {
 	if ( __adsr == nullptr ) {
 		__adsr = std::make_shared<ADSR>();
@@ -123,6 +127,7 @@ Instrument::Instrument( std::shared_ptr<Instrument> other )
 	, __is_metronome_instrument(false)
 	, __apply_velocity( other->get_apply_velocity() )
 	, __current_instr_for_export(false)
+	, m_pRenderPlan( new RenderPlan() )
 {
 	for ( int i=0; i<MAX_FX; i++ ) {
 		__fx_level[i] = other->get_fx_level( i );
@@ -137,6 +142,7 @@ Instrument::Instrument( std::shared_ptr<Instrument> other )
 Instrument::~Instrument()
 {
 	delete __components;
+	delete m_pRenderPlan;
 }
 
 std::shared_ptr<Instrument> Instrument::load_instrument( const QString& drumkit_name, const QString& instrument_name, Filesystem::Lookup lookup )
@@ -146,19 +152,15 @@ std::shared_ptr<Instrument> Instrument::load_instrument( const QString& drumkit_
 	return pInstrument;
 }
 
-void Instrument::load_from( Drumkit* pDrumkit, std::shared_ptr<Instrument> pInstrument, bool is_live )
+void Instrument::load_from( Drumkit* pDrumkit, std::shared_ptr<Instrument> pInstrument, bool is_live,
+							const SampleLoader* pSampleLoader )
 {
 	AudioEngine* pAudioEngine = Hydrogen::get_instance()->getAudioEngine();
 
-	if ( is_live ) {
-		pAudioEngine->lock( RIGHT_HERE );
-	}
-	
-	this->get_components()->clear();
-	
-	if ( is_live ) {
-		pAudioEngine->unlock();
-	}
+	// The new components are assembled without holding the lock since
+	// they are not visible to the audio thread until being swapped in
+	// below.
+	std::vector<std::shared_ptr<InstrumentComponent>> components;
 
 	set_missing_samples( false );
 
@@ -166,51 +168,39 @@ void Instrument::load_from( Drumkit* pDrumkit, std::shared_ptr<Instrument> pInst
 		auto pMyComponent = std::make_shared<InstrumentComponent>( pSrcComponent->get_drumkit_componentID() );
 		pMyComponent->set_gain( pSrcComponent->get_gain() );
 
-		this->get_components()->push_back( pMyComponent );
+		components.push_back( pMyComponent );
 
 		for ( int i = 0; i < InstrumentComponent::getMaxLayers(); i++ ) {
 			auto src_layer = pSrcComponent->get_layer( i );
-			auto my_layer = pMyComponent->get_layer( i );
 
 			if( src_layer == nullptr ) {
-				if ( is_live ) {
-					pAudioEngine->lock( RIGHT_HERE );
-				}
 				pMyComponent->set_layer( nullptr, i );
-				if ( is_live ) {
-					pAudioEngine->unlock();
-				}
 			} else {
 				QString sample_path =  pDrumkit->get_path() + "/" + src_layer->get_sample()->get_filename();
-				auto pSample = Sample::load( sample_path );
+				std::shared_ptr<Sample> pSample;
+				if ( pSampleLoader != nullptr ) {
+					pSample = pSampleLoader->getSample( sample_path );
+				} else {
+					pSample = SamplePool::load( sample_path );
+				}
 				if ( pSample == nullptr ) {
 					_ERRORLOG( QString( "Error loading sample %1. Creating a new empty layer." ).arg( sample_path ) );
 					set_missing_samples( true );
-					if ( is_live ) {
-						pAudioEngine->lock( RIGHT_HERE );
-					}
 					pMyComponent->set_layer( nullptr, i );
-					
-					if ( is_live ) {
-						pAudioEngine->unlock();
-					}
 				} else {
-					if ( is_live ) {
-						pAudioEngine->lock( RIGHT_HERE );
-					}
 					pMyComponent->set_layer( std::make_shared<InstrumentLayer>( src_layer, pSample ), i );
-					if ( is_live ) {
-						pAudioEngine->unlock();
-					}
 				}
 			}
-			my_layer = nullptr;
 		}
 	}
+	m_pRenderPlan->reserve( components.size() );
 	if ( is_live ) {
 		pAudioEngine->lock( RIGHT_HERE );
 	}
 
+	// The previous components are released once `components` goes
+	// out of scope, after the AudioEngine was unlocked.
+	this->get_components()->swap( components );
 	this->set_id( pInstrument->get_id() );
 	this->set_name( pInstrument->get_name() );
 	this->set_drumkit_name( pDrumkit->get_name() );
@@ -324,16 +314,45 @@ std::shared_ptr<Instrument> Instrument::load_from( XMLNode* node, const QString&
 	return pInstrument;
 }
 
+void Instrument::take_over( std::shared_ptr<Instrument> pInstrument )
+{
+	__components->swap( *pInstrument->get_components() );
+	__adsr.swap( pInstrument->__adsr );
+	__name.swap( pInstrument->__name );
+	__drumkit_name.swap( pInstrument->__drumkit_name );
+	set_missing_samples( pInstrument->has_missing_samples() );
+	set_gain( pInstrument->get_gain() );
+	set_volume( pInstrument->get_volume() );
+	setPan( pInstrument->getPan() );
+	set_filter_active( pInstrument->is_filter_active() );
+	set_filter_cutoff( pInstrument->get_filter_cutoff() );
+	set_filter_resonance( pInstrument->get_filter_resonance() );
+	set_pitch_offset( pInstrument->get_pitch_offset() );
+	set_random_pitch_factor( pInstrument->get_random_pitch_factor() );
+	set_muted( pInstrument->is_muted() );
+	set_mute_group( pInstrument->get_mute_group() );
+	set_midi_out_channel( pInstrument->get_midi_out_channel() );
+	set_midi_out_note( pInstrument->get_midi_out_note() );
+	set_stop_notes( pInstrument->is_stop_notes() );
+	set_sample_selection_alg( pInstrument->sample_selection_alg() );
+	set_hihat_grp( pInstrument->get_hihat_grp() );
+	set_lower_cc( pInstrument->get_lower_cc() );
+	set_higher_cc( pInstrument->get_higher_cc() );
+	set_apply_velocity( pInstrument->get_apply_velocity() );
+}
+
 void Instrument::load_samples()
 {
+	SampleLoader sampleLoader;
 	for ( auto& pComponent : *get_components() ) {
 		for ( int i = 0; i < InstrumentComponent::getMaxLayers(); i++ ) {
 			auto pLayer = pComponent->get_layer( i );
 			if( pLayer ) {
-				pLayer->load_sample();
+				sampleLoader.add( pLayer );
 			}
 		}
 	}
+	sampleLoader.run();
 }
 
 void Instrument::unload_samples()
@@ -44,6 +44,8 @@ class Drumkit;
 class DrumkitComponent;
 class InstrumentLayer;
 class InstrumentComponent;
+class RenderPlan;
+class SampleLoader;
 
 
 /**
@@ -97,13 +99,28 @@ class Instrument : public H2Core::Object<Instrument>
 		 * \param drumkit the drumkit the instrument belongs to
 		 * \param instrument to load samples and members from
 		 * \param is_live is it performed while playing
+		 * \param pSampleLoader If provided, the samples are taken
+		 * from it instead of being loaded. They have to be registered
+		 * using SampleLoader::add( Drumkit*, std::shared_ptr<Instrument> ).
 		 */
-		void load_from( Drumkit* drumkit, std::shared_ptr<Instrument> instrument, bool is_live = true );
+		void load_from( Drumkit* drumkit, std::shared_ptr<Instrument> instrument, bool is_live = true,
+						const SampleLoader* pSampleLoader = nullptr );
+
+		/**
+		 * Swaps the components, the ADSR, and the names of this
+		 * instrument with those of @a pInstrument and copies all
+		 * remaining parameters but the id.
+		 *
+		 * Neither allocates nor frees any memory and may thus be
+		 * called by the audio thread. The previous components end up
+		 * in @a pInstrument and are freed along with it.
+		 */
+		void take_over( std::shared_ptr<Instrument> pInstrument );
 
 		/**
 		 * Calls the InstrumentLayer::load_sample() member
 		 * function of all layers of each component of the
-		 * Instrument.
+		 * Instrument using a SampleLoader.
 		 */
 		void load_samples();
 		/**
@@ -286,6 +303,10 @@ class Instrument : public H2Core::Object<Instrument>
 
 		bool has_missing_samples() const { return m_bHasMissingSamples; }
 		void set_missing_samples( bool bHasMissingSamples ) { m_bHasMissingSamples = bHasMissingSamples; }
+
+		/** Cached by the Sampler. Must only be accessed by the audio
+		 * thread.*/
+		RenderPlan* getRenderPlan() const { return m_pRenderPlan; }
 		/** Formatted string version for debugging purposes.
 		 * \param sPrefix String prefix which will be added in front of
 		 * every new line
@@ -324,7 +345,7 @@ class Instrument : public H2Core::Object<Instrument>
 		bool					__soloed;				///< is the instrument in solo mode?
 		bool					__muted;				///< is the instrument muted?
 		int						__mute_group;			///< mute group of the instrument
-		int						__queued;				///< count the number of notes queued within Sampler::__playing_notes_queue or std::priority_queue m_songNoteQueue
+		int						__queued;				///< count the number of notes queued within Sampler::__playing_notes_queue or AudioEngine::m_pNoteScheduler
 		float					__fx_level[MAX_FX];		///< Ladspa FX level array
 		int						__hihat_grp;			///< the instrument is part of a hihat
 		int						__lower_cc;				///< lower cc level
@@ -335,6 +356,7 @@ class Instrument : public H2Core::Object<Instrument>
 		bool					__apply_velocity;				///< change the sample gain based on velocity
 		bool					__current_instr_for_export;		///< is the instrument currently being exported?
 		bool 					m_bHasMissingSamples;	///< does the instrument have missing sample files?
+		RenderPlan*				m_pRenderPlan;	///< see getRenderPlan()
 };
 
 // DEFINITIONS
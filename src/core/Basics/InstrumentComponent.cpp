@@ -41,6 +41,7 @@ namespace H2Core
 {
 
 int InstrumentComponent::m_nMaxLayers;
+std::atomic<unsigned> InstrumentComponent::__revision( 0 );
 
 InstrumentComponent::InstrumentComponent( int related_drumkit_componentID )
 	: __related_drumkit_componentID( related_drumkit_componentID )
@@ -78,6 +79,7 @@ void InstrumentComponent::set_layer( std::shared_ptr<InstrumentLayer> layer, int
 {
 	assert( idx >= 0 && idx < m_nMaxLayers );
 	__layers[ idx ] = layer;
+	touch();
 }
 
 void InstrumentComponent::setMaxLayers( int layers )
@@ -23,6 +23,7 @@
 #ifndef H2C_INSTRUMENTCOMPONENT_H
 #define H2C_INSTRUMENTCOMPONENT_H
 
+#include <atomic>
 #include <cassert>
 #include <vector>
 #include <core/Object.h>
@@ -64,6 +65,18 @@ class InstrumentComponent : public H2Core::Object<InstrumentComponent>
 		static int			getMaxLayers();
 		/** @param layers Sets #m_nMaxLayers.*/
 		static void			setMaxLayers( int layers );
+
+		/**
+		 * Global revision of all components and their layers. It
+		 * is incremented whenever a layer is replaced, the velocity
+		 * range of a layer changes, or a component gets related to
+		 * a different drumkit component. Used by the Sampler to tell
+		 * whether the RenderPlan of an instrument is still up to
+		 * date.
+		 */
+		static unsigned		get_revision();
+		///< increment #__revision
+		static void			touch();
 		/** Formatted string version for debugging purposes.
 		 * \param sPrefix String prefix which will be added in front of
 		 * every new line
@@ -90,6 +103,7 @@ class InstrumentComponent : public H2Core::Object<InstrumentComponent>
 		 * Preferences::Preferences(): 16. */
 		static int			m_nMaxLayers;
 		std::vector<std::shared_ptr<InstrumentLayer>>	__layers;
+		static std::atomic<unsigned>	__revision;		///< see get_revision()
 };
 
 // DEFINITIONS
@@ -98,6 +112,7 @@ class InstrumentComponent : public H2Core::Object<InstrumentComponent>
 inline void InstrumentComponent::set_drumkit_componentID( int related_drumkit_componentID )
 {
 	__related_drumkit_componentID = related_drumkit_componentID;
+	touch();
 }
 /** Returns the component ID of the drumkit.
  * \return #__related_drumkit_componentID */
@@ -116,6 +131,16 @@ inline float InstrumentComponent::get_gain() const
 	return __gain;
 }
 
+inline unsigned InstrumentComponent::get_revision()
+{
+	return __revision.load();
+}
+
+inline void InstrumentComponent::touch()
+{
+	__revision.fetch_add( 1 );
+}
+
 inline std::shared_ptr<InstrumentLayer> InstrumentComponent::operator[]( int idx )
 {
 	assert( idx >= 0 && idx < m_nMaxLayers );
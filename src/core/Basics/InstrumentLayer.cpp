@@ -67,7 +67,7 @@ void InstrumentLayer::set_sample( std::shared_ptr<Sample> sample )
 void InstrumentLayer::load_sample()
 {
 	if( __sample ) {
-		__sample->load();
+		__sample->load( true );
 	}
 }
 
@@ -25,6 +25,7 @@
 
 #include <memory>
 #include <core/Object.h>
+#include <core/Basics/InstrumentComponent.h>
 
 namespace H2Core
 {
@@ -148,6 +149,7 @@ namespace H2Core
 	inline void InstrumentLayer::set_start_velocity( float start )
 	{
 		__start_velocity = start;
+		InstrumentComponent::touch();
 	}
 
 	inline float InstrumentLayer::get_start_velocity() const
@@ -158,6 +160,7 @@ namespace H2Core
 	inline void InstrumentLayer::set_end_velocity( float end )
 	{
 		__end_velocity = end;
+		InstrumentComponent::touch();
 	}
 
 	inline float InstrumentLayer::get_end_velocity() const
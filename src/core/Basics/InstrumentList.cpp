@@ -24,6 +24,7 @@
 
 #include <core/Helpers/Xml.h>
 #include <core/Basics/Instrument.h>
+#include <core/Helpers/SampleLoader.h>
 
 #include <set>
 
@@ -49,9 +50,11 @@ InstrumentList::~InstrumentList()
 
 void InstrumentList::load_samples()
 {
+	SampleLoader sampleLoader;
 	for( int i=0; i<__instruments.size(); i++ ) {
-		__instruments[i]->load_samples();
+		sampleLoader.add( __instruments[i] );
 	}
+	sampleLoader.run();
 }
 
 void InstrumentList::unload_samples()
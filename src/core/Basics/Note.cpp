@@ -52,29 +52,14 @@ Note::Note( std::shared_ptr<Instrument> instrument, int position, float velocity
 	  __cut_off( 1.0 ),
 	  __resonance( 0.0 ),
 	  __humanize_delay( 0 ),
-	  __bpfb_l( 0.0 ),
-	  __bpfb_r( 0.0 ),
-	  __lpfb_l( 0.0 ),
-	  __lpfb_r( 0.0 ),
 	  __pattern_idx( 0 ),
 	  __midi_msg( -1 ),
 	  __note_off( false ),
 	  __just_recorded( false ),
-	  __probability( 1.0f )
+	  __probability( 1.0f ),
+	  m_bPooled( false )
 {
-	if ( __instrument != nullptr ) {
-		__adsr = __instrument->copy_adsr();
-		__instrument_id = __instrument->get_id();
-
-		for ( const auto& pCompo : *__instrument->get_components() ) {
-
-			SelectedLayerInfo *sampleInfo = new SelectedLayerInfo;
-			sampleInfo->SelectedLayer = -1;
-			sampleInfo->SamplePosition = 0;
-
-			__layers_selected[ pCompo->get_drumkit_componentID() ] = sampleInfo;
-		}
-	}
+	init_instrument_state();
 
 	setPan( pan ); // this checks the boundaries
 }
@@ -96,33 +81,95 @@ Note::Note( Note* other, std::shared_ptr<Instrument> instrument )
 	  __cut_off( other->get_cut_off() ),
 	  __resonance( other->get_resonance() ),
 	  __humanize_delay( other->get_humanize_delay() ),
-	  __bpfb_l( other->get_bpfb_l() ),
-	  __bpfb_r( other->get_bpfb_r() ),
-	  __lpfb_l( other->get_lpfb_l() ),
-	  __lpfb_r( other->get_lpfb_r() ),
 	  __pattern_idx( other->get_pattern_idx() ),
 	  __midi_msg( other->get_midi_msg() ),
 	  __note_off( other->get_note_off() ),
 	  __just_recorded( other->get_just_recorded() ),
-	  __probability( other->get_probability() )
+	  __probability( other->get_probability() ),
+	  m_bPooled( false )
 {
 	if ( instrument != nullptr ) __instrument = instrument;
-	if ( __instrument != nullptr ) {
+	init_instrument_state();
+}
+
+Note::~Note()
+{
+}
+
+void Note::init_instrument_state()
+{
+	__layers_selected.clear();
+	if ( __instrument == nullptr ) {
+		return;
+	}
+
+	if ( __adsr == nullptr ) {
 		__adsr = __instrument->copy_adsr();
-		__instrument_id = __instrument->get_id();
+	} else {
+		*__adsr = *__instrument->get_adsr();
+	}
+	__instrument_id = __instrument->get_id();
 
-		for ( const auto& pCompo : *__instrument->get_components() ) {
-			SelectedLayerInfo *sampleInfo = new SelectedLayerInfo;
-			sampleInfo->SelectedLayer = -1;
-			sampleInfo->SamplePosition = 0;
+	for ( const auto& pCompo : *__instrument->get_components() ) {
+		SelectedLayerInfo sampleInfo;
+		sampleInfo.SelectedLayer = -1;
+		sampleInfo.SamplePosition = 0;
+		sampleInfo.pStream = nullptr;
+		sampleInfo.bConverted = false;
 
-			__layers_selected[ pCompo->get_drumkit_componentID() ] = sampleInfo;
-		}
+		__layers_selected.push_back( std::make_pair( pCompo->get_drumkit_componentID(), sampleInfo ) );
 	}
 }
 
-Note::~Note()
+void Note::copy_from( Note* pOther )
 {
+	__instrument = pOther->get_instrument();
+	__instrument_id = 0;
+	__specific_compo_id = -1;
+	__position = pOther->get_position();
+	__velocity = pOther->get_velocity();
+	m_fPan = pOther->getPan();
+	__length = pOther->get_length();
+	__pitch = pOther->get_pitch();
+	__key = pOther->get_key();
+	__octave = pOther->get_octave();
+	__lead_lag = pOther->get_lead_lag();
+	__cut_off = pOther->get_cut_off();
+	__resonance = pOther->get_resonance();
+	__humanize_delay = pOther->get_humanize_delay();
+	__pattern_idx = pOther->get_pattern_idx();
+	__midi_msg = pOther->get_midi_msg();
+	__note_off = pOther->get_note_off();
+	__just_recorded = pOther->get_just_recorded();
+	__probability = pOther->get_probability();
+
+	init_instrument_state();
+}
+
+void Note::reset( std::shared_ptr<Instrument> instrument, int position, float velocity, float pan, int length, float pitch )
+{
+	__instrument = instrument;
+	__instrument_id = 0;
+	__specific_compo_id = -1;
+	__position = position;
+	__velocity = velocity;
+	__length = length;
+	__pitch = pitch;
+	__key = C;
+	__octave = P8;
+	__lead_lag = 0.0;
+	__cut_off = 1.0;
+	__resonance = 0.0;
+	__humanize_delay = 0;
+	__pattern_idx = 0;
+	__midi_msg = -1;
+	__note_off = false;
+	__just_recorded = false;
+	__probability = 1.0f;
+
+	init_instrument_state();
+
+	setPan( pan ); // this checks the boundaries
 }
 
 static inline float check_boundary( float v, float min, float max )
@@ -259,10 +306,6 @@ QString Note::toQString( const QString& sPrefix, bool bShort ) const {
 			.append( QString( "%1%2resonance: %3\n" ).arg( sPrefix ).arg( s ).arg( __resonance ) )
 			.append( QString( "%1%2humanize_delay: %3\n" ).arg( sPrefix ).arg( s ).arg( __humanize_delay ) )
 			.append( QString( "%1%2key: %3\n" ).arg( sPrefix ).arg( s ).arg( __key ) )
-			.append( QString( "%1%2bpfb_l: %3\n" ).arg( sPrefix ).arg( s ).arg( __bpfb_l ) )
-			.append( QString( "%1%2bpfb_r: %3\n" ).arg( sPrefix ).arg( s ).arg( __bpfb_r ) )
-			.append( QString( "%1%2lpfb_l: %3\n" ).arg( sPrefix ).arg( s ).arg( __lpfb_l ) )
-			.append( QString( "%1%2lpfb_r: %3\n" ).arg( sPrefix ).arg( s ).arg( __lpfb_r ) )
 			.append( QString( "%1%2pattern_idx: %3\n" ).arg( sPrefix ).arg( s ).arg( __pattern_idx ) )
 			.append( QString( "%1%2midi_msg: %3\n" ).arg( sPrefix ).arg( s ).arg( __midi_msg ) )
 			.append( QString( "%1%2note_off: %3\n" ).arg( sPrefix ).arg( s ).arg( __note_off ) )
@@ -275,8 +318,8 @@ QString Note::toQString( const QString& sPrefix, bool bShort ) const {
 			sOutput.append( QString( "%1%2%3 : selected layer: %4, sample position: %5\n" )
 							.arg( sPrefix ).arg( s + s )
 							.arg( ll.first )
-							.arg( ll.second->SelectedLayer )
-							.arg( ll.second->SamplePosition ) );
+							.arg( ll.second.SelectedLayer )
+							.arg( ll.second.SamplePosition ) );
 		}
 	} else {
 
@@ -296,10 +339,6 @@ QString Note::toQString( const QString& sPrefix, bool bShort ) const {
 			.append( QString( ", resonance: %1" ).arg( __resonance ) )
 			.append( QString( ", humanize_delay: %1" ).arg( __humanize_delay ) )
 			.append( QString( ", key: %1" ).arg( __key ) )
-			.append( QString( ", bpfb_l: %1" ).arg( __bpfb_l ) )
-			.append( QString( ", bpfb_r: %1" ).arg( __bpfb_r ) )
-			.append( QString( ", lpfb_l: %1" ).arg( __lpfb_l ) )
-			.append( QString( ", lpfb_r: %1" ).arg( __lpfb_r ) )
 			.append( QString( ", pattern_idx: %1" ).arg( __pattern_idx ) )
 			.append( QString( ", midi_msg: %1" ).arg( __midi_msg ) )
 			.append( QString( ", note_off: %1" ).arg( __note_off ) )
@@ -310,8 +349,8 @@ QString Note::toQString( const QString& sPrefix, bool bShort ) const {
 		for ( auto ll : __layers_selected ) {
 			sOutput.append( QString( "%1 : selected layer: %2, sample position: %3" )
 							.arg( ll.first )
-							.arg( ll.second->SelectedLayer )
-							.arg( ll.second->SamplePosition ) );
+							.arg( ll.second.SelectedLayer )
+							.arg( ll.second.SamplePosition ) );
 		}
 	}
 	return sOutput;
@@ -24,6 +24,8 @@
 #define H2C_NOTE_H
 
 #include <memory>
+#include <utility>
+#include <vector>
 
 #include <core/Object.h>
 #include <core/Basics/Instrument.h>
@@ -56,10 +58,43 @@ class XMLNode;
 class ADSR;
 class Instrument;
 class InstrumentList;
+struct SampleStream;
+
+/** State of the resonant low pass filter of a single component of a
+ * note, see VoiceFilter.*/
+struct FilterState {
+	float fLowPass_L = 0;
+	float fLowPass_R = 0;
+	float fBandPass_L = 0;
+	float fBandPass_R = 0;
+	/** Coefficients the last block was filtered with. Negative in
+	 * case no block was filtered yet.*/
+	float fCutoff = -1;
+	float fResonance = -1;
+	/** Whether the filter was still ringing after the block of the
+	 * current cycle. Reset by Sampler::renderNote().*/
+	bool bSustain = false;
+
+	/** Tail detector. Whether the energy stored in the filter
+	 * exceeds -60 dB.*/
+	bool isRinging() const {
+		return fLowPass_L * fLowPass_L + fLowPass_R * fLowPass_R +
+			fBandPass_L * fBandPass_L + fBandPass_R * fBandPass_R > 1e-6f;
+	}
+};
 
 struct SelectedLayerInfo {
 	int SelectedLayer;		///< selected layer during layer selection
 	float SamplePosition;	///< place marker for overlapping process() cycles
+	SampleStream* pStream;	///< disk stream of the selected sample, see SampleStreamer
+	bool bConverted;		///< whether the sample converted to the driver's sample rate is played, see SampleConverter
+	FilterState filter;		///< resonant filter state of the component
+
+	/** Whether the Sampler did already render frames of the
+	 * selected sample.*/
+	bool isStarted() const {
+		return SamplePosition != 0;
+	}
 };
 
 /**
@@ -95,6 +130,25 @@ class Note : public H2Core::Object<Note>
 		/** destructor */
 		~Note();
 
+		/**
+		 * Turns the note into a copy of @a pOther.
+		 *
+		 * Equivalent to Note( Note*, std::shared_ptr<Instrument> )
+		 * but reuses the envelope and layer information already
+		 * allocated by this note. Used by NotePool to recycle notes.
+		 */
+		void copy_from( Note* pOther );
+		/**
+		 * Re-initializes the note.
+		 *
+		 * Equivalent to the corresponding constructor but reuses the
+		 * envelope and layer information already allocated by this
+		 * note. Used by NotePool to recycle notes.
+		 */
+		void reset( std::shared_ptr<Instrument> instrument, int position, float velocity, float pan, int length, float pitch );
+		/** Whether the note is owned by a NotePool.*/
+		bool is_pooled() const;
+
 		/*
 		 * save the note within the given XMLNode
 		 * \param node the XMLNode to feed
@@ -209,8 +263,13 @@ class Note : public H2Core::Object<Note>
 
 		/*
 		 * selected sample
+		 * \return nullptr if the instrument of the note did not have
+		 * a component with ID @a CompoID at the time the note was
+		 * created.
 		 * */
 		SelectedLayerInfo* get_layer_selected( int CompoID );
+		/** \return #__layers_selected */
+		std::vector< std::pair< int, SelectedLayerInfo > >* get_layers_selected();
 
 
 		void set_probability( float value );
@@ -227,15 +286,8 @@ class Note : public H2Core::Object<Note>
 		float get_cut_off() const;
 		/** #__resonance accessor */
 		float get_resonance() const;
-		/** #__bpfb_l accessor */
-		float get_bpfb_l() const;
-		/** #__bpfb_r accessor */
-		float get_bpfb_r() const;
-		/** #__lpfb_l accessor */
-		float get_lpfb_l() const;
-		/** #__lpfb_r accessor */
-		float get_lpfb_r() const;
-		/** Filter output is sustaining note */
+		/** Filter output is sustaining note. Whether
+		 * FilterState::bSustain is set for any component.*/
 		bool filter_sustain() const;
 		/** #__key accessor */
 		Key get_key();
@@ -297,12 +349,6 @@ class Note : public H2Core::Object<Note>
 		/** Return true if two notes match in instrument, key and octave. */
 		bool match( const Note *pNote ) const;
 
-		/**
-		 * compute left and right output based on filters
-		 * \param val_l the left channel value
-		 * \param val_r the right channel value
-		 */
-		void compute_lr_values( float* val_l, float* val_r );
 		/** Formatted string version for debugging purposes.
 		 * \param sPrefix String prefix which will be added in front of
 		 * every new line
@@ -320,6 +366,15 @@ class Note : public H2Core::Object<Note>
 		}
 
 	private:
+		friend class NotePool;
+
+		/**
+		 * Copies the envelope of #__instrument and sets up
+		 * #__layers_selected for all its components. An already
+		 * existing #__adsr is overwritten instead of replaced.
+		 */
+		void init_instrument_state();
+
 		std::shared_ptr<Instrument>		__instrument;   ///< the instrument to be played by this note
 		int				__instrument_id;        ///< the id of the instrument played by this note
 		int				__specific_compo_id;    ///< play a specific component, -1 if playing all
@@ -335,16 +390,16 @@ class Note : public H2Core::Object<Note>
 		float			__cut_off;            ///< filter cutoff [0;1]
 		float			__resonance;          ///< filter resonant frequency [0;1]
 		int				__humanize_delay;       ///< used in "humanize" function
-		std::map< int, SelectedLayerInfo* > __layers_selected;
-		float			__bpfb_l;             ///< left band pass filter buffer
-		float			__bpfb_r;             ///< right band pass filter buffer
-		float			__lpfb_l;             ///< left low pass filter buffer
-		float			__lpfb_r;             ///< right low pass filter buffer
+		/** Layer information per drumkit component ID. Stored by
+		 * value and searched linearly since instruments only have a
+		 * handful of components.*/
+		std::vector< std::pair< int, SelectedLayerInfo > > __layers_selected;
 		int				__pattern_idx;          ///< index of the pattern holding this note for undo actions
 		int				__midi_msg;             ///< TODO
 		bool			__note_off;            ///< note type on|off
 		bool			__just_recorded;       ///< used in record+delete
 		float			__probability;        ///< note probability
+		bool			m_bPooled;		///< whether the note is owned by a NotePool
 		static const char* __key_str[]; ///< used to build QString from #__key an #__octave
 };
 
@@ -477,7 +532,22 @@ inline void Note::set_probability( float value )
 
 inline SelectedLayerInfo* Note::get_layer_selected( int CompoID )
 {
-	return __layers_selected[ CompoID ];
+	for ( auto& layer : __layers_selected ) {
+		if ( layer.first == CompoID ) {
+			return &layer.second;
+		}
+	}
+	return nullptr;
+}
+
+inline std::vector< std::pair< int, SelectedLayerInfo > >* Note::get_layers_selected()
+{
+	return &__layers_selected;
+}
+
+inline bool Note::is_pooled() const
+{
+	return m_bPooled;
 }
 
 inline void Note::set_humanize_delay( int value )
@@ -500,31 +570,14 @@ inline float Note::get_resonance() const
 	return __resonance;
 }
 
-inline float Note::get_bpfb_l() const
-{
-	return __bpfb_l;
-}
-
-inline float Note::get_bpfb_r() const
-{
-	return __bpfb_r;
-}
-
-inline float Note::get_lpfb_l() const
-{
-	return __lpfb_l;
-}
-
-inline float Note::get_lpfb_r() const
-{
-	return __lpfb_r;
-}
-
 inline bool Note::filter_sustain() const
 {
-	const double fLimit = 0.001;
-	return ( fabs( __lpfb_l ) > fLimit || fabs( __lpfb_r ) > fLimit ||
-			 fabs( __bpfb_l ) > fLimit || fabs( __bpfb_r ) > fLimit );
+	for ( const auto& layer : __layers_selected ) {
+		if ( layer.second.filter.bSustain ) {
+			return true;
+		}
+	}
+	return false;
 }
 
 inline Note::Key Note::get_key()
@@ -583,25 +636,6 @@ inline bool Note::match( const Note *pNote ) const
 	return match( pNote->__instrument, pNote->__key, pNote->__octave );
 }
 
-inline void Note::compute_lr_values( float* val_l, float* val_r )
-{
-	/* TODO ???
-	if( !has_instrument() ) {
-		*val_l = 0.0f;
-		*val_r = 0.0f;
-		return;
-	}
-	*/
-	float cut_off = __instrument->get_filter_cutoff();
-	float resonance = __instrument->get_filter_resonance();
-	__bpfb_l  =  resonance * __bpfb_l  + cut_off * ( *val_l - __lpfb_l );
-	__lpfb_l +=  cut_off   * __bpfb_l;
-	__bpfb_r  =  resonance * __bpfb_r  + cut_off * ( *val_r - __lpfb_r );
-	__lpfb_r +=  cut_off   * __bpfb_r;
-	*val_l = __lpfb_l;
-	*val_r = __lpfb_r;
-}
-
 };
 
 #endif // H2C_NOTE_H
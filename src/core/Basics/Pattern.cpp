@@ -36,6 +36,9 @@
 namespace H2Core
 {
 
+std::atomic<unsigned> Pattern::__last_revision( 0 );
+std::atomic<unsigned> Pattern::__deletions( 0 );
+
 Pattern::Pattern( const QString& name, const QString& info, const QString& category, int length, int denominator )
 	: __length( length )
 	, __denominator( denominator)
@@ -43,6 +46,7 @@ Pattern::Pattern( const QString& name, const QString& info, const QString& categ
 	, __info( info )
 	, __category( category )
 {
+	touch();
 }
 
 Pattern::Pattern( Pattern* other )
@@ -55,10 +59,12 @@ Pattern::Pattern( Pattern* other )
 	FOREACH_NOTE_CST_IT_BEGIN_END( other->get_notes(),it ) {
 		__notes.insert( std::make_pair( it->first, new Note( it->second ) ) );
 	}
+	touch();
 }
 
 Pattern::~Pattern()
 {
+	__deletions.fetch_add( 1 );
 	for( notes_cst_it_t it=__notes.begin(); it!=__notes.end(); it++ ) {
 		delete it->second;
 	}
@@ -208,6 +214,7 @@ void Pattern::remove_note( Note* note )
 			break;
 		}
 	}
+	touch();
 }
 
 bool Pattern::references( std::shared_ptr<Instrument> instr )
@@ -241,6 +248,7 @@ void Pattern::purge_instrument( std::shared_ptr<Instrument> instr )
 		}
 	}
 	if ( locked ) {
+		touch();
 		Hydrogen::get_instance()->getAudioEngine()->unlock();
 		while ( slate.size() ) {
 			delete slate.front();
@@ -272,6 +280,7 @@ void Pattern::flattened_virtual_patterns_compute()
 			__flattened_virtual_patterns.insert( *it1 );
 		}
 	}
+	touch();
 }
 
 void Pattern::extand_with_flattened_virtual_patterns( PatternList* patterns )
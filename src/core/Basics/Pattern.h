@@ -25,6 +25,7 @@
 
 #include <set>
 #include <memory>
+#include <atomic>
 #include <core/Object.h>
 #include <core/Basics/Note.h>
 
@@ -188,6 +189,18 @@ class Pattern : public H2Core::Object<Pattern>
 		 */
 		void extand_with_flattened_virtual_patterns( PatternList* patterns );
 
+		/**
+		 * Revision of the pattern. It changes whenever its notes or
+		 * its virtual patterns change. Revisions are unique among
+		 * all patterns, so a new pattern never reuses the one of a
+		 * deleted pattern. Used by the AudioEngine to tell whether
+		 * its CompiledSong is still up to date.
+		 */
+		unsigned get_revision() const;
+		/** Number of patterns deleted so far. Compiled data
+		 * referencing patterns has to be dropped once it changes.*/
+		static unsigned get_deletions();
+
 		/**
 		 * save the pattern within the given XMLNode
 		 * \param node the XMLNode to feed
@@ -213,6 +226,11 @@ class Pattern : public H2Core::Object<Pattern>
 		notes_t __notes;                                        ///< a multimap (hash with possible multiple values for one key) of note
 		virtual_patterns_t __virtual_patterns;                  ///< a list of patterns directly referenced by this one
 		virtual_patterns_t __flattened_virtual_patterns;        ///< the complete list of virtual patterns
+		unsigned __revision;                                    ///< see get_revision()
+		static std::atomic<unsigned> __last_revision;           ///< most recent revision handed out
+		static std::atomic<unsigned> __deletions;               ///< see get_deletions()
+		///< assign a new revision
+		void touch();
 		/**
 		 * load a pattern from an XMLNode
 		 * \param node the XMLDode to read from
@@ -301,9 +319,25 @@ inline const Pattern::virtual_patterns_t* Pattern::get_flattened_virtual_pattern
 	return &__flattened_virtual_patterns;
 }
 
+inline unsigned Pattern::get_revision() const
+{
+	return __revision;
+}
+
+inline unsigned Pattern::get_deletions()
+{
+	return __deletions.load();
+}
+
+inline void Pattern::touch()
+{
+	__revision = __last_revision.fetch_add( 1 ) + 1;
+}
+
 inline void Pattern::insert_note( Note* note )
 {
 	__notes.insert( std::make_pair( note->get_position(), note ) );
+	touch();
 }
 
 inline bool Pattern::virtual_patterns_empty() const
@@ -314,22 +348,26 @@ inline bool Pattern::virtual_patterns_empty() const
 inline void Pattern::virtual_patterns_clear()
 {
 	__virtual_patterns.clear();
+	touch();
 }
 
 inline void Pattern::virtual_patterns_add( Pattern* pattern )
 {
 	__virtual_patterns.insert( pattern );
+	touch();
 }
 
 inline void Pattern::virtual_patterns_del( Pattern* pattern )
 {
 	virtual_patterns_cst_it_t it = __virtual_patterns.find( pattern );
 	if ( it!=__virtual_patterns.end() ) __virtual_patterns.erase( it );
+	touch();
 }
 
 inline void Pattern::flattened_virtual_patterns_clear()
 {
 	__flattened_virtual_patterns.clear();
+	touch();
 }
 
 };
@@ -0,0 +1,100 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#include <core/Basics/PreparedDrumkit.h>
+#include <core/Basics/Drumkit.h>
+#include <core/Basics/DrumkitComponent.h>
+#include <core/Basics/Instrument.h>
+#include <core/Basics/InstrumentList.h>
+#include <core/Basics/Song.h>
+#include <core/Helpers/SampleLoader.h>
+
+#include <algorithm>
+#include <cassert>
+
+namespace H2Core
+{
+
+PreparedDrumkit::PreparedDrumkit()
+	: m_bIsUserDrumkit( false )
+	, m_bSwappedIn( false )
+{
+}
+
+PreparedDrumkit::~PreparedDrumkit()
+{
+	for ( auto& pComponent : m_components ) {
+		delete pComponent;
+	}
+}
+
+std::shared_ptr<PreparedDrumkit> PreparedDrumkit::load( Drumkit* pDrumkit, SampleLoader* pSampleLoader )
+{
+	InstrumentList* pInstrList = pDrumkit->get_instruments();
+	for ( unsigned nInstr = 0; nInstr < pInstrList->size(); ++nInstr ) {
+		pSampleLoader->add( pDrumkit, pInstrList->get( nInstr ) );
+	}
+	if ( ! pSampleLoader->run() ) {
+		return nullptr;
+	}
+
+	std::shared_ptr<PreparedDrumkit> pPrepared( new PreparedDrumkit() );
+	pPrepared->m_sName = pDrumkit->get_name();
+	pPrepared->m_bIsUserDrumkit = pDrumkit->isUserDrumkit();
+
+	for ( const auto& pSrcComponent : *pDrumkit->get_components() ) {
+		DrumkitComponent* pComponent = new DrumkitComponent( pSrcComponent->get_id(), pSrcComponent->get_name() );
+		pComponent->load_from( pSrcComponent, false );
+		pPrepared->m_components.push_back( pComponent );
+	}
+
+	for ( unsigned nInstr = 0; nInstr < pInstrList->size(); ++nInstr ) {
+		auto pInstr = std::make_shared<Instrument>();
+		pInstr->load_from( pDrumkit, pInstrList->get( nInstr ), false, pSampleLoader );
+		pPrepared->m_instruments.push_back( pInstr );
+	}
+
+	return pPrepared;
+}
+
+void PreparedDrumkit::swapIn( std::shared_ptr<Song> pSong )
+{
+	assert( ! m_bSwappedIn );
+
+	pSong->getComponents()->swap( m_components );
+
+	// Instruments removed from the song in the meantime are skipped.
+	InstrumentList* pSongInstrList = pSong->getInstrumentList();
+	const int nInstruments = std::min( static_cast<int>( m_instruments.size() ),
+									   pSongInstrList->size() );
+	for ( int nInstr = 0; nInstr < nInstruments; ++nInstr ) {
+		auto pSongInstr = pSongInstrList->get( nInstr );
+		// Instruments added to the song directly are already up to
+		// date.
+		if ( pSongInstr != m_instruments[ nInstr ] ) {
+			pSongInstr->take_over( m_instruments[ nInstr ] );
+		}
+	}
+
+	m_bSwappedIn = true;
+}
+
+};
@@ -0,0 +1,127 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#ifndef H2C_PREPARED_DRUMKIT_H
+#define H2C_PREPARED_DRUMKIT_H
+
+#include <core/Object.h>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace H2Core
+{
+
+class Drumkit;
+class DrumkitComponent;
+class Instrument;
+class SampleLoader;
+class Song;
+
+/**
+ * A Drumkit with all its samples decoded and its components and
+ * instruments assembled, ready to be swapped into a Song.
+ *
+ * Preparing a kit neither touches the song nor the audio engine and
+ * can thus be done ahead of time in any thread. The swap itself,
+ * swapIn(), only exchanges pointers and is cheap enough to be done
+ * by the audio thread. Afterwards the object holds the previous
+ * components and samples of the song, which are freed along with it.
+ *
+ * \ingroup docCore
+ */
+class PreparedDrumkit : public H2Core::Object<PreparedDrumkit>
+{
+	H2_OBJECT(PreparedDrumkit)
+public:
+	/**
+	 * Decodes all samples of @a pDrumkit using @a pSampleLoader.
+	 *
+	 * \return nullptr if the decoding was cancelled using
+	 * SampleLoader::cancel().
+	 */
+	static std::shared_ptr<PreparedDrumkit> load( Drumkit* pDrumkit, SampleLoader* pSampleLoader );
+	~PreparedDrumkit();
+
+	const QString& getName() const;
+	bool isUserDrumkit() const;
+
+	/** \return Number of instruments of the kit.*/
+	int getInstrumentCount() const;
+	/** \return Instrument @a nIdx of the kit. Instruments not present
+	 * in the song yet may be added to its InstrumentList directly
+	 * before calling swapIn().*/
+	std::shared_ptr<Instrument> getInstrument( int nIdx ) const;
+
+	/**
+	 * Swaps the components of the kit into @a pSong and lets the
+	 * first getInstrumentCount() instruments of the song take over
+	 * the corresponding ones of the kit (see Instrument::take_over()).
+	 *
+	 * The InstrumentList of the song should already hold at least
+	 * getInstrumentCount() instruments. Has to be called while
+	 * holding the AudioEngine lock and only once.
+	 */
+	void swapIn( std::shared_ptr<Song> pSong );
+	/** \return Whether swapIn() was already called.*/
+	bool isSwappedIn() const;
+
+private:
+	PreparedDrumkit();
+
+	QString m_sName;
+	bool m_bIsUserDrumkit;
+	/** New components of the song or, after swapIn(), the previous
+	 * ones. Owned by this object.*/
+	std::vector<DrumkitComponent*> m_components;
+	std::vector<std::shared_ptr<Instrument>> m_instruments;
+	std::atomic<bool> m_bSwappedIn;
+};
+
+inline const QString& PreparedDrumkit::getName() const
+{
+	return m_sName;
+}
+
+inline bool PreparedDrumkit::isUserDrumkit() const
+{
+	return m_bIsUserDrumkit;
+}
+
+inline int PreparedDrumkit::getInstrumentCount() const
+{
+	return m_instruments.size();
+}
+
+inline std::shared_ptr<Instrument> PreparedDrumkit::getInstrument( int nIdx ) const
+{
+	return m_instruments[ nIdx ];
+}
+
+inline bool PreparedDrumkit::isSwappedIn() const
+{
+	return m_bSwappedIn;
+}
+
+};
+
+#endif // H2C_PREPARED_DRUMKIT_H
@@ -22,14 +22,18 @@
 
 
 
+#include <algorithm>
+#include <cmath>
 #include <limits>
 #include <memory>
 
 #include <core/Hydrogen.h>
 #include <core/Preferences/Preferences.h>
 #include <core/Helpers/Filesystem.h>
+#include <core/Helpers/SampleCache.h>
 #include <core/Basics/Sample.h>
 #include <core/Basics/Note.h>
+#include <core/Sampler/SampleStreamer.h>
 
 #if defined(H2CORE_HAVE_RUBBERBAND) || _DOXYGEN_
 #include <rubberband/RubberBandStretcher.h>
@@ -62,6 +66,24 @@ EnvelopePoint::EnvelopePoint( const EnvelopePoint& other ) : Object(other), fram
 }
 /* EnvelopePoint */
 
+Sample::Data::Data( float* pData_L, float* pData_R, std::shared_ptr<QFile> pCacheFile )
+	: pData_L( pData_L ),
+	  pData_R( pData_R ),
+	  pCacheFile( pCacheFile )
+{
+}
+
+Sample::Data::~Data()
+{
+	// A mapped cache entry is unmapped along with its file.
+	if ( pCacheFile == nullptr ) {
+		if ( pData_R != pData_L ) {
+			delete[] pData_R;
+		}
+		delete[] pData_L;
+	}
+}
+
 
 Sample::Sample( const QString& filepath,  int frames, int sample_rate, float* data_l, float* data_r ) 
   : __filepath( filepath ),
@@ -69,9 +91,17 @@ Sample::Sample( const QString& filepath,  int frames, int sample_rate, float* da
 	__sample_rate( sample_rate ),
 	__data_l( data_l ),
 	__data_r( data_r ),
-	__is_modified( false )
+	__is_streamed( false ),
+	__resident_frames( 0 ),
+	__is_modified( false ),
+	__conversion_rate( 0 ),
+	__conversion_request( 0 ),
+	__load_requested( false )
 {
 	assert( filepath.lastIndexOf( "/" ) >0 );
+	if ( data_l != nullptr ) {
+		__data = std::make_shared<Data>( data_l, data_r );
+	}
 }
 
 Sample::Sample( std::shared_ptr<Sample> pOther ): Object( *pOther ),
@@ -80,20 +110,30 @@ Sample::Sample( std::shared_ptr<Sample> pOther ): Object( *pOther ),
 	__sample_rate( pOther->get_sample_rate() ),
 	__data_l( nullptr ),
 	__data_r( nullptr ),
+	__is_streamed( pOther->is_streamed() ),
+	__resident_frames( pOther->get_resident_frames() ),
 	__is_modified( pOther->get_is_modified() ),
 	__loops( pOther->__loops ),
-	__rubberband( pOther->__rubberband )
+	__rubberband( pOther->__rubberband ),
+	__conversion_rate( 0 ),
+	__conversion_request( 0 ),
+	__load_requested( false )
 {
 
-	__data_l = new float[__frames];
-	__data_r = new float[__frames];
+	const int nFrames = get_resident_frames();
+	float* pData_L = new float[nFrames];
 	
 	// Since the third argument of memcpy takes the number of bytes,
 	// which are about to be copied, and the data is given in float,
 	// which are  four bytes each, the number of copied frames
-	// `__frames` has to be multiplied by four.
-	memcpy( __data_l, pOther->get_data_l(), __frames * 4 );
-	memcpy( __data_r, pOther->get_data_r(), __frames * 4 );
+	// `nFrames` has to be multiplied by four.
+	memcpy( pData_L, pOther->get_data_l(), nFrames * 4 );
+	float* pData_R = pData_L;
+	if ( ! pOther->is_mono() ) {
+		pData_R = new float[nFrames];
+		memcpy( pData_R, pOther->get_data_r(), nFrames * 4 );
+	}
+	set_data( pData_L, pData_R );
 	
 	PanEnvelope* pPan = pOther->get_pan_envelope();
 	for( int i=0; i<pPan->size(); i++ ) {
@@ -108,12 +148,69 @@ Sample::Sample( std::shared_ptr<Sample> pOther ): Object( *pOther ),
 
 Sample::~Sample()
 {
-	if ( __data_l != nullptr ) {
-		delete[] __data_l;
+	free_data();
+}
+
+void Sample::free_data()
+{
+	// Conversions still reading the data keep it alive.
+	__data = nullptr;
+	__data_l = __data_r = nullptr;
+	invalidate_conversion();
+}
+
+void Sample::set_data( float* pData_L, float* pData_R, std::shared_ptr<QFile> pCacheFile )
+{
+	assert( __data == nullptr );
+	if ( pData_L != nullptr ) {
+		__data = std::make_shared<Data>( pData_L, pData_R, pCacheFile );
+	}
+	__data_l = pData_L;
+	__data_r = pData_R;
+}
+
+void Sample::make_stereo()
+{
+	if ( ! is_mono() ) {
+		return;
 	}
-	if ( __data_r != nullptr ) {
-		delete[] __data_r;
+
+	const int nFrames = get_resident_frames();
+	float* pData_L = new float[ nFrames ];
+	float* pData_R = new float[ nFrames ];
+	memcpy( pData_L, __data_l, nFrames * sizeof( float ) );
+	memcpy( pData_R, __data_l, nFrames * sizeof( float ) );
+
+	// Also drops a mapping the data might come from.
+	free_data();
+	set_data( pData_L, pData_R );
+}
+
+void Sample::make_writable()
+{
+	if ( __data == nullptr || __data.use_count() == 1 ) {
+		return;
+	}
+
+	const int nFrames = get_resident_frames();
+	const bool bMono = is_mono();
+	float* pData_L = new float[ nFrames ];
+	float* pData_R = bMono ? pData_L : new float[ nFrames ];
+	memcpy( pData_L, __data_l, nFrames * sizeof( float ) );
+	if ( ! bMono ) {
+		memcpy( pData_R, __data_r, nFrames * sizeof( float ) );
 	}
+
+	free_data();
+	set_data( pData_L, pData_R );
+}
+
+void Sample::invalidate_conversion()
+{
+	__converted = nullptr;
+	__conversion_rate = 0;
+	// Results of conversions still in progress are dropped.
+	++__conversion_request;
 }
 
 void Sample::set_filename( const QString& filename )
@@ -124,7 +221,7 @@ void Sample::set_filename( const QString& filename )
 }
 
 
-std::shared_ptr<Sample> Sample::load( const QString& sFilepath )
+std::shared_ptr<Sample> Sample::load( const QString& sFilepath, bool bStreamable )
 {
 	std::shared_ptr<Sample> pSample;
 	
@@ -135,7 +232,7 @@ std::shared_ptr<Sample> Sample::load( const QString& sFilepath )
 
 	pSample = std::make_shared<Sample>( sFilepath );
 		
-	if( !pSample->load() ) {
+	if( !pSample->load( bStreamable ) ) {
 		pSample.reset();
 		return pSample;
 	}
@@ -145,17 +242,60 @@ std::shared_ptr<Sample> Sample::load( const QString& sFilepath )
 
 std::shared_ptr<Sample> Sample::load( const QString& filepath, const Loops& loops, const Rubberband& rubber, const VelocityEnvelope& velocity, const PanEnvelope& pan, float fBpm )
 {
+	QString sCacheKey;
+	if ( SampleCache::isEnabled() ) {
+		sCacheKey = SampleCache::getKey( filepath, loops, rubber, velocity, pan, fBpm );
+		if ( ! sCacheKey.isEmpty() ) {
+			auto pSample = std::make_shared<Sample>( filepath );
+			if ( pSample->load_from_cache( sCacheKey, true ) ) {
+				return pSample;
+			}
+		}
+	}
+
 	auto pSample = Sample::load( filepath );
 	
 	if( pSample ){
 		pSample->apply( loops, rubber, velocity, pan, fBpm );
+		if ( ! sCacheKey.isEmpty() ) {
+			pSample->store_in_cache( sCacheKey );
+		}
 	}
 
 	return pSample;
 }
 
+std::shared_ptr<Sample> Sample::create_unloaded( const QString& sFilepath )
+{
+	if( !Filesystem::file_readable( sFilepath ) ) {
+		ERRORLOG( QString( "Unable to read %1" ).arg( sFilepath ) );
+		return nullptr;
+	}
+	return std::make_shared<Sample>( sFilepath );
+}
+
+std::shared_ptr<Sample> Sample::create_unloaded( const QString& sFilepath, const Loops& loops, const Rubberband& rubber, const VelocityEnvelope& velocity, const PanEnvelope& pan )
+{
+	auto pSample = create_unloaded( sFilepath );
+	if ( pSample == nullptr ) {
+		return nullptr;
+	}
+
+	// Only the parameters are stored. They are applied by
+	// SamplePool::load() once the data is read.
+	pSample->__loops = loops;
+	pSample->__rubberband = rubber;
+	pSample->__velocity_envelope = velocity;
+	pSample->__pan_envelope = pan;
+	pSample->__is_modified = true;
+	return pSample;
+}
+
 void Sample::apply( const Loops& loops, const Rubberband& rubber, const VelocityEnvelope& velocity, const PanEnvelope& pan, float fBpm )
 {
+	make_resident();
+	// The envelopes are applied in place.
+	invalidate_conversion();
 	apply_loops( loops );
 	apply_velocity( velocity );
 	apply_pan( pan );
@@ -166,8 +306,19 @@ void Sample::apply( const Loops& loops, const Rubberband& rubber, const Velocity
 #endif
 }
 
-bool Sample::load()
+bool Sample::load( bool bStreamable )
 {
+	// Mapped entries of the SampleCache are paged in lazily and thus
+	// do not need to be streamed.
+	QString sCacheKey;
+	if ( bStreamable && SampleCache::isEnabled() ) {
+		sCacheKey = SampleCache::getKey( __filepath );
+		if ( ! sCacheKey.isEmpty() && load_from_cache( sCacheKey, false ) ) {
+			return true;
+		}
+		bStreamable = false;
+	}
+
 	// Will contain a bunch of metadata about the loaded sample.
 	SF_INFO sound_info = {0};
 
@@ -189,9 +340,21 @@ bool Sample::load()
 		sound_info.frames = ( std::numeric_limits<int>::max()/sound_info.channels );
 	}
 
+	// In streaming mode only the beginning of long samples is read.
+	// It covers the time required by the SampleStreamer to start
+	// reading the remainder once a note is played.
+	int nResidentFrames = sound_info.frames;
+	const int nPreloadMs = SampleStreamer::getPreloadMs();
+	if ( bStreamable && nPreloadMs > 0 ) {
+		long long nPreloadFrames = static_cast<long long>( nPreloadMs ) * sound_info.samplerate / 1000;
+		if ( sound_info.frames > nPreloadFrames + SampleStreamer::nStreamFrames ) {
+			nResidentFrames = nPreloadFrames;
+		}
+	}
+
 	// Create an array, which will hold the block of samples read
 	// from file.
-	float* buffer = new float[ sound_info.frames * sound_info.channels ];
+	float* buffer = new float[ nResidentFrames * sound_info.channels ];
 	
 	//memset( buffer, 0, sound_info.frames *sound_info.channels );
 	
@@ -199,7 +362,7 @@ bool Sample::load()
 	// convert the format of the underlying data on the fly. The
 	// output will be an array of floats regardless of file's
 	// encoding (e.g. 16 bit PCM).
-	sf_count_t count = sf_read_float( file, buffer, sound_info.frames * sound_info.channels );
+	sf_count_t count = sf_read_float( file, buffer, nResidentFrames * sound_info.channels );
 	if( count==0 ){
 		WARNINGLOG( QString( "%1 is an empty sample" ).arg( __filepath ) );
 	}
@@ -217,26 +380,237 @@ bool Sample::load()
 	// of the Sample class.
 	__frames = sound_info.frames;
 	__sample_rate = sound_info.samplerate;
+	__is_streamed = nResidentFrames < __frames;
+	__resident_frames = nResidentFrames;
 
 	// Split the loaded frames into left and right channel. 
 	// If only one channels was present in the underlying data,
-	// duplicate its content.
-	__data_l = new float[ sound_info.frames ];
-	__data_r = new float[ sound_info.frames ];
+	// both channels share the buffer it was read into.
 	if ( sound_info.channels == 1 ) {
-		memcpy( __data_l, buffer, __frames * sizeof( float ) );
-		memcpy( __data_r, buffer, __frames * sizeof( float ) );
-	} else if ( sound_info.channels == SAMPLE_CHANNELS ) {
-		for ( int i = 0; i < __frames; i++ ) {
-			__data_l[i] = buffer[i * SAMPLE_CHANNELS ];
-			__data_r[i] = buffer[i * SAMPLE_CHANNELS + 1 ];
+		set_data( buffer, buffer );
+	} else {
+		float* pData_L = new float[ nResidentFrames ];
+		float* pData_R = new float[ nResidentFrames ];
+		for ( int i = 0; i < nResidentFrames; i++ ) {
+			pData_L[i] = buffer[i * SAMPLE_CHANNELS ];
+			pData_R[i] = buffer[i * SAMPLE_CHANNELS + 1 ];
 		}
+		delete[] buffer;
+		set_data( pData_L, pData_R );
+	}
+
+	if ( ! sCacheKey.isEmpty() ) {
+		store_in_cache( sCacheKey );
 	}
-	delete[] buffer;
 
 	return true;
 }
 
+void Sample::make_resident()
+{
+	if ( __is_streamed ) {
+		unload();
+		load();
+	}
+}
+
+bool Sample::load_from_cache( const QString& sKey, bool bRestoreTransforms )
+{
+	SampleCache::Entry entry;
+	auto pCacheFile = SampleCache::map( sKey, &entry );
+	if ( pCacheFile == nullptr ) {
+		return false;
+	}
+
+	free_data();
+	set_data( entry.pData_L, entry.pData_R, pCacheFile );
+	__frames = entry.nFrames;
+	__sample_rate = entry.nSampleRate;
+	__is_streamed = false;
+	__resident_frames = 0;
+
+	if ( bRestoreTransforms ) {
+		__loops = entry.loops;
+		__rubberband = entry.rubberband;
+		__velocity_envelope = entry.velocityEnvelope;
+		__pan_envelope = entry.panEnvelope;
+		__is_modified = entry.bIsModified;
+	}
+	return true;
+}
+
+void Sample::store_in_cache( const QString& sKey )
+{
+	SampleCache::Entry entry;
+	entry.nFrames = __frames;
+	entry.nSampleRate = __sample_rate;
+	entry.bIsModified = __is_modified;
+	entry.loops = __loops;
+	entry.rubberband = __rubberband;
+	entry.velocityEnvelope = __velocity_envelope;
+	entry.panEnvelope = __pan_envelope;
+	entry.pData_L = __data_l;
+	entry.pData_R = __data_r;
+
+	// Switch over to the mapped data right away so it is shared with
+	// other instances loading the same sample.
+	if ( SampleCache::store( sKey, entry ) ) {
+		load_from_cache( sKey, false );
+	}
+}
+
+/** Number of zero crossings of the sinc kernel on each side of its
+ * center at the cutoff frequency.*/
+static const int nSincZeroCrossings = 16;
+/** Resolution of the tabulated kernel in steps per input frame.*/
+static const int nSincTableSteps = 512;
+/** Shape of the Kaiser window. 9 corresponds to a stopband
+ * attenuation of about 90 dB.*/
+static const double fKaiserBeta = 9.0;
+
+/** Zeroth order modified Bessel function of the first kind.*/
+static double bessel_i0( double fX )
+{
+	double fSum = 1.0;
+	double fTerm = 1.0;
+	for ( int k = 1; k < 50; ++k ) {
+		fTerm *= ( fX / ( 2.0 * k ) ) * ( fX / ( 2.0 * k ) );
+		fSum += fTerm;
+		if ( fTerm < fSum * 1e-12 ) {
+			break;
+		}
+	}
+	return fSum;
+}
+
+std::shared_ptr<Sample> Sample::convert_sample_rate( int nSampleRate ) const
+{
+	if ( __data_l == nullptr || __data_r == nullptr || __is_streamed ) {
+		return nullptr;
+	}
+
+	auto pConverted = convert_sample_rate( __filepath, __data, __frames, __sample_rate, nSampleRate );
+	if ( pConverted != nullptr ) {
+		pConverted->__is_modified = __is_modified;
+		pConverted->__loops = __loops;
+		pConverted->__rubberband = __rubberband;
+		pConverted->__velocity_envelope = __velocity_envelope;
+		pConverted->__pan_envelope = __pan_envelope;
+	}
+	return pConverted;
+}
+
+std::shared_ptr<Sample> Sample::convert_sample_rate( const QString& sFilepath,
+													 std::shared_ptr<const Data> pData,
+													 int nFrames, int nSampleRate,
+													 int nTargetSampleRate )
+{
+	if ( pData == nullptr || pData->pData_L == nullptr || pData->pData_R == nullptr ||
+		 nFrames <= 0 || nSampleRate <= 0 || nTargetSampleRate <= 0 ) {
+		return nullptr;
+	}
+	const float* pIn_L = pData->pData_L;
+	const float* pIn_R = pData->pData_R;
+
+	const double fRatio = static_cast<double>( nTargetSampleRate ) / nSampleRate;
+	const int nOutFrames = std::max( static_cast<int>( std::lround( nFrames * fRatio ) ), 1 );
+
+	// Cutoff relative to the Nyquist frequency of the input. It is
+	// placed slightly below the lower of both Nyquist frequencies to
+	// leave room for the transition band.
+	const double fCutoff = 0.95 * std::min( 1.0, fRatio );
+	// Half width of the kernel in input frames.
+	const int nHalfWidth = static_cast<int>( std::ceil( nSincZeroCrossings / fCutoff ) );
+
+	std::vector<float> kernel( nHalfWidth * nSincTableSteps + 2, 0.0f );
+	const double fWindowNorm = bessel_i0( fKaiserBeta );
+	for ( int ii = 0; ii <= nHalfWidth * nSincTableSteps; ++ii ) {
+		const double fX = static_cast<double>( ii ) / nSincTableSteps;
+		const double fArg = M_PI * fCutoff * fX;
+		const double fSinc = ii == 0 ? 1.0 : std::sin( fArg ) / fArg;
+		const double fPos = fX / nHalfWidth;
+		const double fWindow = bessel_i0( fKaiserBeta * std::sqrt( std::max( 1.0 - fPos * fPos, 0.0 ) ) ) / fWindowNorm;
+		kernel[ ii ] = static_cast<float>( fCutoff * fSinc * fWindow );
+	}
+
+	// Mono samples stay mono.
+	const bool bMono = pIn_L == pIn_R;
+	float* pData_L = new float[ nOutFrames ];
+	float* pData_R = bMono ? pData_L : new float[ nOutFrames ];
+	for ( int nFrame = 0; nFrame < nOutFrames; ++nFrame ) {
+		const double fCenter = nFrame / fRatio;
+		const int nCenter = static_cast<int>( std::floor( fCenter ) );
+		const int nFirst = std::max( nCenter - nHalfWidth + 1, 0 );
+		const int nLast = std::min( nCenter + nHalfWidth, nFrames - 1 );
+
+		double fVal_L = 0;
+		double fVal_R = 0;
+		for ( int ii = nFirst; ii <= nLast; ++ii ) {
+			const double fTablePos = std::abs( fCenter - ii ) * nSincTableSteps;
+			const int nIndex = static_cast<int>( fTablePos );
+			const double fFrac = fTablePos - nIndex;
+			const double fWeight = kernel[ nIndex ] + fFrac * ( kernel[ nIndex + 1 ] - kernel[ nIndex ] );
+			fVal_L += fWeight * pIn_L[ ii ];
+			if ( ! bMono ) {
+				fVal_R += fWeight * pIn_R[ ii ];
+			}
+		}
+		pData_L[ nFrame ] = static_cast<float>( fVal_L );
+		if ( ! bMono ) {
+			pData_R[ nFrame ] = static_cast<float>( fVal_R );
+		}
+	}
+
+	return std::make_shared<Sample>( sFilepath, nOutFrames, nTargetSampleRate, pData_L, pData_R );
+}
+
+std::shared_ptr<Sample> Sample::get_converted( int nSampleRate ) const
+{
+	if ( __converted == nullptr || __converted->get_sample_rate() != nSampleRate ) {
+		return nullptr;
+	}
+	return __converted;
+}
+
+unsigned Sample::request_conversion( int nSampleRate, bool bRestart )
+{
+	if ( __conversion_rate == nSampleRate && ! bRestart ) {
+		return 0;
+	}
+	__conversion_rate = nSampleRate;
+	if ( ++__conversion_request == 0 ) {
+		++__conversion_request;
+	}
+	return __conversion_request;
+}
+
+bool Sample::set_converted( std::shared_ptr<Sample> pConverted, unsigned nRequest )
+{
+	if ( nRequest != __conversion_request ) {
+		return false;
+	}
+	if ( pConverted == nullptr || pConverted->get_sample_rate() != __conversion_rate ) {
+		__conversion_rate = 0;
+		return false;
+	}
+	__converted = pConverted;
+	return true;
+}
+
+bool Sample::request_load()
+{
+	if ( __load_requested ) {
+		return false;
+	}
+	__load_requested = true;
+	return true;
+}
+
+void Sample::withdraw_load_request()
+{
+	__load_requested = false;
+}
+
 bool Sample::apply_loops( const Loops& lo )
 {
 	if( __loops == lo ) {
@@ -269,8 +643,10 @@ bool Sample::apply_loops( const Loops& lo )
 	int loop_length =  lo.end_frame - lo.loop_frame;
 	int new_length = full_length + loop_length * lo.count;
 
+	// Mono samples stay mono. Copying the right channel does
+	// nothing but copying the left one again.
 	float* new_data_l = new float[ new_length ];
-	float* new_data_r = new float[ new_length ];
+	float* new_data_r = is_mono() ? new_data_l : new float[ new_length ];
 
 	// copy full_length frames to new_data
 	if ( lo.mode==Loops::REVERSE && ( lo.count==0 || full_loop ) ) {
@@ -327,10 +703,8 @@ bool Sample::apply_loops( const Loops& lo )
 		assert( x==new_length );
 	}
 	__loops = lo;
-	delete[] __data_l;
-	delete[] __data_r;
-	__data_l = new_data_l;
-	__data_r = new_data_r;
+	free_data();
+	set_data( new_data_l, new_data_r );
 	__frames = new_length;
 	__is_modified = true;
 	return true;
@@ -349,6 +723,8 @@ void Sample::apply_velocity( const VelocityEnvelope& v )
 	
 	__velocity_envelope.clear();
 	if ( v.size() > 0 ) {
+		make_writable();
+		const bool bMono = is_mono();
 		float inv_resolution = __frames / 841.0F;
 		for ( int i = 1; i < v.size(); i++ ) {
 			float y = ( 91 - v[i - 1].value ) / 91.0F;
@@ -362,7 +738,9 @@ void Sample::apply_velocity( const VelocityEnvelope& v )
 			float step = ( y - k ) / length;;
 			for ( int z = start_frame ; z < end_frame; z++ ) {
 				__data_l[z] = __data_l[z] * y;
-				__data_r[z] = __data_r[z] * y;
+				if ( ! bMono ) {
+					__data_r[z] = __data_r[z] * y;
+				}
 				y-=step;
 			}
 		}
@@ -384,6 +762,9 @@ void Sample::apply_pan( const PanEnvelope& p )
 	
 	__pan_envelope.clear();
 	if ( p.size() > 0 ) {
+		// Panning does not affect both channels alike.
+		make_stereo();
+		make_writable();
 		float inv_resolution = __frames / 841.0F;
 		for ( int i = 1; i < p.size(); i++ ) {
 			float y = ( 45 - p[i - 1].value ) / 45.0F;
@@ -446,6 +827,9 @@ void Sample::apply_rubberband( const Rubberband& rb, float fBpm ) {
 	// This option will be ignored in real-time processing.
 	rubber.setExpectedInputDuration( __frames );
 
+	// Both channels are stretched alike.
+	const bool bMono = is_mono();
+
 	int retrieved = 0;
 	//int buffer_free = out_buffer_size;
 	float* out_data_l = new float[ out_buffer_size ];
@@ -570,12 +954,15 @@ void Sample::apply_rubberband( const Rubberband& rb, float fBpm ) {
 		retrieved += n;
 	}
 	
-	delete [] __data_l;
-	delete [] __data_r;
-	__data_l = new float[ retrieved ];
-	__data_r = new float[ retrieved ];
-	memcpy( __data_l, out_data_l, retrieved*sizeof( float ) );
-	memcpy( __data_r, out_data_r, retrieved*sizeof( float ) );
+	free_data();
+	float* pData_L = new float[ retrieved ];
+	memcpy( pData_L, out_data_l, retrieved*sizeof( float ) );
+	float* pData_R = pData_L;
+	if ( ! bMono ) {
+		pData_R = new float[ retrieved ];
+		memcpy( pData_R, out_data_r, retrieved*sizeof( float ) );
+	}
+	set_data( pData_L, pData_R );
 	delete [] out_data_l;
 	delete [] out_data_r;
 
@@ -597,9 +984,13 @@ bool Sample::exec_rubberband_cli( const Rubberband& rb, float fBpm )
 	}
 
 	if( rb.use ) {
-		QString outfilePath =  QDir::tempPath() + "/tmp_rb_outfile.wav";
+		// Samples are loaded in parallel by the SampleLoader. Unique
+		// file names prevent them from overwriting each other's input
+		// and output.
+		QString outfilePath = Filesystem::tmp_file_path( "tmp_rb_outfile.wav" );
 		if( !write( outfilePath ) ) {
 			ERRORLOG( "unable to write sample" );
+			QFile( outfilePath ).remove();
 			return false;
 		};
 
@@ -621,7 +1012,7 @@ bool Sample::exec_rubberband_cli( const Rubberband& rb, float fBpm )
 		QString rCs = QString( " %1" ).arg( rb.c_settings );
 		float fFrequency = Note::pitchToFrequency( ( double )rb.pitch );
 		QString rFs = QString( " %1" ).arg( fFrequency );
-		QString rubberResultPath = QDir::tempPath() + "/tmp_rb_result_file.wav";
+		QString rubberResultPath = Filesystem::tmp_file_path( "tmp_rb_result_file.wav" );
 
 		arguments << "-D" << QString( " %1" ).arg( durationtime ) 	//stretch or squash to make output file X seconds long
 		          << "--threads"					//assume multi-CPU even if only one CPU is identified
@@ -639,26 +1030,26 @@ bool Sample::exec_rubberband_cli( const Rubberband& rb, float fBpm )
 		}
 
 		delete pRubberbandProc;
+		QFile( outfilePath ).remove();
 		if ( QFile( rubberResultPath ).exists() == false ) {
 			_ERRORLOG( QString( "Rubberband reimporter File %1 not found" ).arg( rubberResultPath ) );
 			return false;
 		}
 
 		auto p_Rubberbanded = Sample::load( rubberResultPath.toLocal8Bit() );
+
+		QFile( rubberResultPath ).remove();
+
 		if( p_Rubberbanded == nullptr ) {
 			return false;
 		}
 
-		QFile( outfilePath ).remove();
-
-		QFile( rubberResultPath ).remove();
-
 		__frames = p_Rubberbanded->get_frames();
 
+		free_data();
+		__data = p_Rubberbanded->__data;
 		__data_l = p_Rubberbanded->get_data_l();
 		__data_r = p_Rubberbanded->get_data_r();
-		p_Rubberbanded->__data_l = nullptr;
-		p_Rubberbanded->__data_r = nullptr;
 
 		__is_modified = true;
 		__rubberband = rb;
@@ -681,6 +1072,7 @@ Sample::Loops::LoopMode Sample::parse_loop_mode( const QString& sMode )
 
 bool Sample::write( const QString& path, int format )
 {
+	make_resident();
 	float* obuf = new float[ SAMPLE_CHANNELS * __frames ];
 	for ( int i = 0; i < __frames; ++i ) {
 		float value_l = __data_l[i];
@@ -29,6 +29,8 @@
 
 #include <core/Object.h>
 
+class QFile;
+
 namespace H2Core
 {
 
@@ -128,6 +130,32 @@ class Sample : public H2Core::Object<Sample>
 				QString toQString( const QString& sPrefix, bool bShort ) const;
 		};
 
+		/**
+		 * Memory the audio data of a sample is held in.
+		 *
+		 * A sample never modifies data shared with someone
+		 * else but replaces it instead. Holding a reference to
+		 * it thus allows to read the data without locking the
+		 * AudioEngine, e.g. while converting it in the background
+		 * (see SampleConverter).
+		 */
+		class Data
+		{
+			public:
+				float* pData_L;         ///< left channel data
+				float* pData_R;         ///< right channel data. Equal to #pData_L for mono samples.
+				/** SampleCache entry both channels are mapped
+				 * from. nullptr if they were allocated instead.*/
+				std::shared_ptr<QFile> pCacheFile;
+				/** Takes ownership of @a pData_L and @a pData_R
+				 * unless @a pCacheFile is provided.*/
+				Data( float* pData_L, float* pData_R, std::shared_ptr<QFile> pCacheFile = nullptr );
+				/** destructor */
+				~Data();
+				Data( const Data& other ) = delete;
+				Data& operator=( const Data& other ) = delete;
+		};
+
 		/**
 		 * Sample constructor
 		 * \param filepath the path to the sample
@@ -158,14 +186,15 @@ class Sample : public H2Core::Object<Sample>
 		 * load() member on it.
 		 *
 		 * \param filepath the file to load audio data from
+		 * \param bStreamable Passed to load().
 		 *
 		 * \return Pointer to the newly initialized Sample. If
 		 * the provided @a filepath is not readable, a nullptr
 		 * is returned instead.
 		 *
-		 * \fn load(const QString& filepath)
+		 * \fn load(const QString& filepath, bool bStreamable)
 		 */
-		static std::shared_ptr<Sample> load( const QString& filepath);
+		static std::shared_ptr<Sample> load( const QString& filepath, bool bStreamable = false );
 	
 		/**
 		 * Load a sample from a file and apply the
@@ -186,6 +215,30 @@ class Sample : public H2Core::Object<Sample>
 		 */
 		static std::shared_ptr<Sample> load( const QString& filepath, const Loops& loops, const Rubberband& rubber, const VelocityEnvelope& velocity, const PanEnvelope& pan, float fBpm );
 
+		/**
+		 * Create a sample describing the file load() would read
+		 * without reading any data.
+		 *
+		 * The result is empty (see is_empty()). It has to be
+		 * replaced by the sample SamplePool::load() returns for it
+		 * before it can be played back. Used for layers a song is
+		 * not expected to play (see SampleUsage).
+		 *
+		 * \param filepath the file to load audio data from later on
+		 *
+		 * \return Pointer to the new Sample or nullptr if @a
+		 * filepath is not readable.
+		 */
+		static std::shared_ptr<Sample> create_unloaded( const QString& filepath );
+		/**
+		 * Create a sample describing the file and the
+		 * transformations load() would apply without reading any
+		 * data.
+		 *
+		 * \overload create_unloaded(const QString& filepath)
+		 */
+		static std::shared_ptr<Sample> create_unloaded( const QString& filepath, const Loops& loops, const Rubberband& rubber, const VelocityEnvelope& velocity, const PanEnvelope& pan );
+
 		/**
 		 * Load the sample stored in #__filepath into
 		 * #__data_l and #__data_r.
@@ -198,18 +251,30 @@ class Sample : public H2Core::Object<Sample>
 		 * (two per default) channels in the audio file. If
 		 * there are more, Hydrogen will _NOT_ downmix its
 		 * content but simply extract the first two channels
-		 * and display a warning message. For mono file the
-		 * same content will be assigned to both the left
-		 * (#__data_l) and right channel (#__data_r).
+		 * and display a warning message. Mono files are
+		 * stored in a single buffer both #__data_l and
+		 * #__data_r point to (see is_mono()).
 		 *
 		 * If the total number of frames in the file is larger
 		 * than the maximum value of an `int', the content is
 		 * truncated and a warning log message will be
 		 * displayed.
 		 *
-		 * \fn load()
+		 * If @a bStreamable is set and a SampleStreamer is
+		 * active, only the beginning of long samples is kept
+		 * in memory (see get_resident_frames()). The remainder
+		 * is read from disk by the SampleStreamer while the
+		 * sample is played back. This should only be used for
+		 * samples solely accessed by the Sampler.
+		 *
+		 * If @a bStreamable is set and the SampleCache is
+		 * enabled, the data is mapped from the cache instead
+		 * and stored there first if not present yet. Such
+		 * samples are never streamed.
+		 *
+		 * \fn load(bool bStreamable)
 		 */
-		bool load();
+		bool load( bool bStreamable = false );
 		/**
 		 * Flush the current content of the left and right
 		 * channel and the current metadata.
@@ -280,6 +345,12 @@ class Sample : public H2Core::Object<Sample>
 		void set_frames( int value );
 		/** \return #__frames accessor */
 		int get_frames() const;
+		/** \return Number of frames held in #__data_l and
+		 * #__data_r. Smaller than #__frames if the sample is
+		 * streamed.*/
+		int get_resident_frames() const;
+		/** \return #__is_streamed */
+		bool is_streamed() const;
 		/**
 		 * \param sampleRate Sets #__sample_rate.
 		 */
@@ -297,6 +368,18 @@ class Sample : public H2Core::Object<Sample>
 		float* get_data_l() const;
 		/** \return #__data_r*/
 		float* get_data_r() const;
+		/** \return #__data. Neither locks nor allocates.*/
+		std::shared_ptr<const Data> get_shared_data() const;
+		/**
+		 * \return Whether the sample holds a single channel.
+		 *
+		 * Mono files are not duplicated into two buffers.
+		 * Instead, #__data_r points to #__data_l, so both
+		 * channels can still be read the usual way. Only code
+		 * writing to the data has to take care of it. The
+		 * Sampler renders them using a single channel.
+		 */
+		bool is_mono() const;
 		/**
 		 * #__is_modified setter
 		 * \param value the new value for #__is_modified
@@ -312,6 +395,66 @@ class Sample : public H2Core::Object<Sample>
 		Loops get_loops() const;
 		/** \return #__rubberband parameters */
 		Rubberband get_rubberband() const;
+
+		/**
+		 * Resamples the data to @a nSampleRate using a windowed-sinc
+		 * kernel band-limited to the lower of both Nyquist
+		 * frequencies.
+		 *
+		 * Loops, envelopes, and Rubber Band parameters are taken
+		 * over as is since they were already applied to the data.
+		 *
+		 * \return New sample or nullptr if this one is empty or
+		 * streamed.
+		 */
+		std::shared_ptr<Sample> convert_sample_rate( int nSampleRate ) const;
+		/**
+		 * Resamples @a nFrames frames of @a pData recorded at @a
+		 * nSampleRate to @a nTargetSampleRate.
+		 *
+		 * Since neither the sample nor the AudioEngine are
+		 * accessed, it can be called without holding any lock.
+		 *
+		 * eturn New sample without loops, envelopes, and
+		 * Rubber Band parameters.
+		 */
+		static std::shared_ptr<Sample> convert_sample_rate( const QString& sFilepath,
+															std::shared_ptr<const Data> pData,
+															int nFrames, int nSampleRate,
+															int nTargetSampleRate );
+		/** \return Sample stored using set_converted() if it
+		 * matches @a nSampleRate and nullptr otherwise.*/
+		std::shared_ptr<Sample> get_converted( int nSampleRate ) const;
+		/**
+		 * Marks a conversion to @a nSampleRate as requested.
+		 *
+		 * \param nSampleRate Target sample rate.
+		 * \param bRestart Whether a new identifier is issued even if
+		 * such a conversion is already pending. The result of the
+		 * pending one will be dropped.
+		 *
+		 * \return Identifier to be passed to set_converted() or 0
+		 * if such a conversion was already requested.
+		 */
+		unsigned request_conversion( int nSampleRate, bool bRestart = false );
+		/**
+		 * Stores the result of the conversion requested as @a
+		 * nRequest. It is dropped in case the data was changed or
+		 * another conversion was requested in the meantime. Passing
+		 * nullptr withdraws the request.
+		 *
+		 * \return Whether @a pConverted was stored.
+		 */
+		bool set_converted( std::shared_ptr<Sample> pConverted, unsigned nRequest );
+		/**
+		 * Marks an empty sample created by create_unloaded() as
+		 * requested to be loaded by the LazySampleLoader.
+		 *
+		 * \return false if it was already requested.
+		 */
+		bool request_load();
+		/** Allows for another request_load() later on.*/
+		void withdraw_load_request();
 		/**
 		 * parse the given string and rturn the corresponding loop_mode
 		 * \param string the loop mode text to be parsed
@@ -334,31 +477,72 @@ class Sample : public H2Core::Object<Sample>
 		int					__sample_rate;       ///< samplerate for this sample
 		float*				__data_l;            ///< left channel data
 		float*				__data_r;            ///< right channel data
+		bool				__is_streamed;       ///< true if only the first #__resident_frames frames are loaded
+		int					__resident_frames;   ///< number of frames in #__data_l and #__data_r if #__is_streamed
 		bool				__is_modified;       ///< true if sample is modified
 		PanEnvelope			__pan_envelope;      ///< pan envelope vector
 		VelocityEnvelope	__velocity_envelope; ///< velocity envelope vector
 		Loops				__loops;             ///< set of loop parameters
 		Rubberband			__rubberband;        ///< set of rubberband parameters
+		/** Owner of #__data_l and #__data_r. Shared with
+		 * conversions in progress.*/
+		std::shared_ptr<Data>	__data;
+		/** Copy of the data at #__conversion_rate. Dropped
+		 * whenever the data changes.*/
+		std::shared_ptr<Sample>	__converted;
+		/** Sample rate of the last requested conversion. 0 if
+		 * there is none.*/
+		int					__conversion_rate;
+		/** Identifier of the last requested conversion.*/
+		unsigned			__conversion_request;
+		/** Whether request_load() was called.*/
+		bool				__load_requested;
 		/** loop modes string */
 		static const std::vector<QString> __loop_modes;
+
+		/** Loads the whole sample in case it is streamed.*/
+		void make_resident();
+		/** Releases #__data_l and #__data_r regardless of whether
+		 * they were allocated, mapped, or shared by a mono
+		 * sample.*/
+		void free_data();
+		/** Takes ownership of the provided channels. #__data has
+		 * to be released using free_data() beforehand.*/
+		void set_data( float* pData_L, float* pData_R, std::shared_ptr<QFile> pCacheFile = nullptr );
+		/** Gives a mono sample a separate right channel before
+		 * both channels are modified differently.*/
+		void make_stereo();
+		/** Copies #__data in case it is shared before the data
+		 * is modified in place.*/
+		void make_writable();
+		/** Drops #__converted and all pending conversions.*/
+		void invalidate_conversion();
+		/**
+		 * Maps the SampleCache entry stored for @a sKey.
+		 *
+		 * \param sKey Obtained from SampleCache::getKey().
+		 * \param bRestoreTransforms Whether the loops, rubberband,
+		 * envelopes, and modification state stored alongside the
+		 * data are taken over as well.
+		 *
+		 * \return false if there is no valid entry.
+		 */
+		bool load_from_cache( const QString& sKey, bool bRestoreTransforms );
+		/** Writes the current content of the sample to the
+		 * SampleCache and maps it from there.*/
+		void store_in_cache( const QString& sKey );
 };
 
 // DEFINITIONS
 
 inline void Sample::unload()
 {
-	if ( __data_l != nullptr ) {
-		delete [] __data_l;
-	}
-	
-	if ( __data_r != nullptr ) {
-		delete [] __data_r;
-	}
+	free_data();
 	__frames = __sample_rate = 0;
+	__is_streamed = false;
+	__resident_frames = 0;
 	/** #__is_modified = false; leave this unchanged as pan,
 	    velocity, loop and rubberband are kept unchanged */
-
-	__data_l = __data_r = nullptr;
 }
 
 inline bool Sample::is_empty() const
@@ -386,6 +570,16 @@ inline int Sample::get_frames() const
 	return __frames;
 }
 
+inline int Sample::get_resident_frames() const
+{
+	return __is_streamed ? __resident_frames : __frames;
+}
+
+inline bool Sample::is_streamed() const
+{
+	return __is_streamed;
+}
+
 inline int Sample::get_sample_rate() const
 {
 	return __sample_rate;
@@ -416,6 +610,16 @@ inline float* Sample::get_data_r() const
 	return __data_r;
 }
 
+inline std::shared_ptr<const Sample::Data> Sample::get_shared_data() const
+{
+	return __data;
+}
+
+inline bool Sample::is_mono() const
+{
+	return __data_l != nullptr && __data_l == __data_r;
+}
+
 inline void Sample::set_is_modified( bool is_modified )
 {
 	__is_modified = is_modified;
@@ -45,6 +45,9 @@
 #include <core/AutomationPathSerializer.h>
 #include <core/Helpers/Xml.h>
 #include <core/Helpers/Filesystem.h>
+#include <core/Helpers/SampleLoader.h>
+#include <core/Helpers/SamplePool.h>
+#include <core/Helpers/SampleUsage.h>
 #include <core/Hydrogen.h>
 #include <core/Sampler/Sampler.h>
 
@@ -818,6 +821,7 @@ std::shared_ptr<Song> SongReader::readSong( const QString& sFileName )
 	}
 
 	auto pPreferences = Preferences::get_instance();
+	const bool bSelectiveLoading = pPreferences->m_bSelectiveSampleLoading;
 
 	INFOLOG( "Reading " + sFilename );
 	std::shared_ptr<Song> pSong = nullptr;
@@ -1164,7 +1168,8 @@ std::shared_ptr<Song> SongReader::readSong( const QString& sFileName )
 
 						std::shared_ptr<Sample> pSample;
 						if ( !sIsModified ) {
-							pSample = Sample::load( sFilename );
+							pSample = bSelectiveLoading ? Sample::create_unloaded( sFilename )
+								: SamplePool::load( sFilename );
 						} else {
 							// FIXME, kill EnvelopePoint, create Envelope class
 							EnvelopePoint pt;
@@ -1188,7 +1193,8 @@ std::shared_ptr<Song> SongReader::readSong( const QString& sFileName )
 								panNode = panNode.nextSiblingElement( "pan" );
 							}
 
-							pSample = Sample::load( sFilename, lo, ro, velocity, pan, fBpm );
+							pSample = bSelectiveLoading ? Sample::create_unloaded( sFilename, lo, ro, velocity, pan )
+								: SamplePool::load( sFilename, lo, ro, velocity, pan, fBpm );
 						}
 						if ( pSample == nullptr ) {
 							ERRORLOG( "Error loading sample: " + sFilename + " not found" );
@@ -1252,7 +1258,8 @@ std::shared_ptr<Song> SongReader::readSong( const QString& sFileName )
 
 						std::shared_ptr<Sample> pSample = nullptr;
 						if ( !sIsModified ) {
-							pSample = Sample::load( sFilename );
+							pSample = bSelectiveLoading ? Sample::create_unloaded( sFilename )
+								: SamplePool::load( sFilename );
 						} else {
 							EnvelopePoint pt;
 
@@ -1275,7 +1282,8 @@ std::shared_ptr<Song> SongReader::readSong( const QString& sFileName )
 								panNode = panNode.nextSiblingElement( "pan" );
 							}
 
-							pSample = Sample::load( sFilename, lo, ro, velocity, pan, fBpm );
+							pSample = bSelectiveLoading ? Sample::create_unloaded( sFilename, lo, ro, velocity, pan )
+								: SamplePool::load( sFilename, lo, ro, velocity, pan, fBpm );
 						}
 						if ( pSample == nullptr ) {
 							ERRORLOG( "Error loading sample: " + sFilename + " not found" );
@@ -1554,6 +1562,16 @@ std::shared_ptr<Song> SongReader::readSong( const QString& sFileName )
 		}
 	}
 
+	if ( bSelectiveLoading ) {
+		// Layers are loaded only once the patterns and the velocity
+		// adjustments are known.
+		SampleLoader sampleLoader;
+		const SampleUsage usage( pSong );
+		const int nLeftOut = usage.addUsedLayers( pSong->getInstrumentList(), &sampleLoader, fBpm );
+		sampleLoader.run();
+		INFOLOG( QString( "%1 layers not used by the patterns are loaded on demand" ).arg( nLeftOut ) );
+	}
+
 	pSong->setFilename( sFilename );
 	pSong->setIsModified( false );
 
@@ -157,7 +157,10 @@ enum EventType {
 	EVENT_UPDATE_SONG_EDITOR,
 	/** Triggered when transport is moved into a different column
 		(either during playback or when relocated by the user)*/
-	EVENT_COLUMN_CHANGED
+	EVENT_COLUMN_CHANGED,
+	/** Percentage of the samples already loaded by the
+		H2Core::SampleLoader, e.g. while switching drumkits.*/
+	EVENT_SAMPLE_LOADING_PROGRESS
 };
 
 /** Basic building block for the communication between the core of
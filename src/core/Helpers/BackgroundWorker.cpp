@@ -0,0 +1,85 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+
+#include <core/Helpers/BackgroundWorker.h>
+#include <core/AudioEngine/AudioEngine.h>
+
+#include <chrono>
+
+namespace H2Core
+{
+
+BackgroundWorker::BackgroundWorker()
+	: m_bQuit( false )
+	, m_bWakeUp( false )
+{
+}
+
+BackgroundWorker::~BackgroundWorker()
+{
+	stop();
+}
+
+void BackgroundWorker::start( std::function<void()> loop )
+{
+	m_bQuit = false;
+	m_thread = std::thread( std::move( loop ) );
+}
+
+void BackgroundWorker::stop()
+{
+	m_bQuit = true;
+	wakeUp();
+	if ( m_thread.joinable() ) {
+		m_thread.join();
+	}
+}
+
+void BackgroundWorker::wakeUp()
+{
+	// Notifying without holding the mutex might cause the wakeup to
+	// get lost. The worker will then pick up the work after its
+	// timeout.
+	m_bWakeUp = true;
+	m_wakeUp.notify_one();
+}
+
+void BackgroundWorker::wait()
+{
+	std::unique_lock<std::mutex> lock( m_mutex );
+	m_wakeUp.wait_for( lock, std::chrono::milliseconds( 5 ), [&]() {
+		return m_bWakeUp.load() || m_bQuit.load();
+	} );
+	m_bWakeUp = false;
+}
+
+bool BackgroundWorker::lock( AudioEngine* pAudioEngine )
+{
+	while ( ! m_bQuit.load() ) {
+		if ( pAudioEngine->tryLockFor( std::chrono::milliseconds( 10 ), RIGHT_HERE ) ) {
+			return true;
+		}
+	}
+	return false;
+}
+
+};
@@ -0,0 +1,98 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+
+#ifndef H2C_BACKGROUND_WORKER_H
+#define H2C_BACKGROUND_WORKER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace H2Core
+{
+
+class AudioEngine;
+
+/**
+ * Thread doing work handed over by the audio thread.
+ *
+ * The audio thread must neither block nor allocate. It thus only
+ * pushes requests into a LockFreeQueue and calls wakeUp(), which
+ * does not lock either. The worker runs the loop passed to start()
+ * until stop() is called. Whenever it runs out of work, it calls
+ * wait() and sleeps until it is woken up again or a short timeout
+ * passes.
+ *
+ * \ingroup docCore
+ */
+class BackgroundWorker
+{
+public:
+	BackgroundWorker();
+	/** Stops the worker in case this was not done by its owner.*/
+	~BackgroundWorker();
+
+	BackgroundWorker( const BackgroundWorker& ) = delete;
+	BackgroundWorker& operator=( const BackgroundWorker& ) = delete;
+
+	/** Runs @a loop in a new thread. It has to return once
+	 * isQuitting() is true.*/
+	void start( std::function<void()> loop );
+	/** Asks the loop to return and joins the thread. Owners have to
+	 * call it before destroying the data used by the loop.*/
+	void stop();
+
+	bool isQuitting() const {
+		return m_bQuit.load();
+	}
+
+	/** Wakes up the worker. Neither locks nor allocates.*/
+	void wakeUp();
+	/** Sleeps for up to 5 ms or until wakeUp() or stop() is
+	 * called. Must only be called by the worker.*/
+	void wait();
+
+	/**
+	 * Locks @a pAudioEngine unless the worker is about to be stopped.
+	 *
+	 * Owners are often destroyed while the AudioEngine is locked.
+	 * Waiting for the lock in small steps ensures the worker can be
+	 * joined nevertheless.
+	 *
+	 * \return false if the lock could not be obtained. The loop has
+	 * to return in that case.
+	 */
+	bool lock( AudioEngine* pAudioEngine );
+
+private:
+	std::atomic<bool> m_bQuit;
+	std::atomic<bool> m_bWakeUp;
+	std::mutex m_mutex;
+	std::condition_variable m_wakeUp;
+	std::thread m_thread;
+};
+
+};
+
+#endif
@@ -47,6 +47,7 @@
 #define PLAYLISTS       "playlists/"
 #define PLUGINS         "plugins/"
 #define REPOSITORIES    "repositories/"
+#define SAMPLES         "samples/"
 #define SCRIPTS         "scripts/"
 #define SONGS           "songs/"
 #define THEMES          "themes/"
@@ -546,6 +547,10 @@ QString Filesystem::repositories_cache_dir()
 {
 	return __usr_data_path + CACHE + REPOSITORIES;
 }
+QString Filesystem::sample_cache_dir()
+{
+	return __usr_data_path + CACHE + SAMPLES;
+}
 QString Filesystem::demos_dir()
 {
 	return __sys_data_path + DEMOS;
@@ -823,6 +828,7 @@ void Filesystem::info()
 	INFOLOG( QString( "User Click file            : %1" ).arg( usr_click_file_path() ) );
 	INFOLOG( QString( "Cache dir                  : %1" ).arg( cache_dir() ) );
 	INFOLOG( QString( "Reporitories Cache dir     : %1" ).arg( repositories_cache_dir() ) );
+	INFOLOG( QString( "Sample Cache dir           : %1" ).arg( sample_cache_dir() ) );
 	INFOLOG( QString( "User drumkit dir           : %1" ).arg( usr_drumkits_dir() ) );
 	INFOLOG( QString( "Patterns dir               : %1" ).arg( patterns_dir() ) );
 	INFOLOG( QString( "Playlist dir               : %1" ).arg( playlists_dir() ) );
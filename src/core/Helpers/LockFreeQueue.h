@@ -0,0 +1,157 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#ifndef H2C_LOCK_FREE_QUEUE_H
+#define H2C_LOCK_FREE_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+namespace H2Core
+{
+
+/**
+ * Bounded first-in first-out queue which can be used by several
+ * producer and consumer threads without locking.
+ *
+ * All cells are allocated in the constructor. push() and pop() only
+ * do a compare-and-swap on the respective index and therefore never
+ * block or allocate, which makes them safe to use from within the
+ * audio thread. Each cell carries a sequence number telling whether
+ * it is ready to be written or read during the current turn of the
+ * ring.
+ *
+ * \ingroup docCore
+ */
+template <typename T>
+class LockFreeQueue
+{
+public:
+	/**
+	 * \param nCapacity Minimum number of elements the queue can
+	 * hold. It is rounded up to the next power of two.
+	 */
+	explicit LockFreeQueue( size_t nCapacity )
+		: m_nMask( roundUp( nCapacity ) - 1 )
+		, m_cells( new Cell[ m_nMask + 1 ] )
+		, m_nWritePos( 0 )
+		, m_nReadPos( 0 )
+	{
+		for ( size_t ii = 0; ii <= m_nMask; ++ii ) {
+			m_cells[ ii ].nSequence.store( ii, std::memory_order_relaxed );
+		}
+	}
+
+	LockFreeQueue( const LockFreeQueue& ) = delete;
+	LockFreeQueue& operator=( const LockFreeQueue& ) = delete;
+
+	/**
+	 * \return false if the queue is full. @a value is left untouched
+	 * in that case.
+	 */
+	bool push( const T& value )
+	{
+		size_t nPos = m_nWritePos.load( std::memory_order_relaxed );
+		Cell* pCell;
+		for ( ;; ) {
+			pCell = &m_cells[ nPos & m_nMask ];
+			size_t nSequence = pCell->nSequence.load( std::memory_order_acquire );
+			intptr_t nDiff = static_cast<intptr_t>( nSequence ) - static_cast<intptr_t>( nPos );
+			if ( nDiff == 0 ) {
+				if ( m_nWritePos.compare_exchange_weak( nPos, nPos + 1,
+														std::memory_order_relaxed ) ) {
+					break;
+				}
+			} else if ( nDiff < 0 ) {
+				return false;
+			} else {
+				nPos = m_nWritePos.load( std::memory_order_relaxed );
+			}
+		}
+
+		pCell->value = value;
+		pCell->nSequence.store( nPos + 1, std::memory_order_release );
+		return true;
+	}
+
+	/**
+	 * \return false if the queue is empty.
+	 */
+	bool pop( T* pValue )
+	{
+		size_t nPos = m_nReadPos.load( std::memory_order_relaxed );
+		Cell* pCell;
+		for ( ;; ) {
+			pCell = &m_cells[ nPos & m_nMask ];
+			size_t nSequence = pCell->nSequence.load( std::memory_order_acquire );
+			intptr_t nDiff = static_cast<intptr_t>( nSequence ) - static_cast<intptr_t>( nPos + 1 );
+			if ( nDiff == 0 ) {
+				if ( m_nReadPos.compare_exchange_weak( nPos, nPos + 1,
+													   std::memory_order_relaxed ) ) {
+					break;
+				}
+			} else if ( nDiff < 0 ) {
+				return false;
+			} else {
+				nPos = m_nReadPos.load( std::memory_order_relaxed );
+			}
+		}
+
+		// Moving the value out ensures e.g. a std::shared_ptr is not
+		// released by the next push() to this cell, which might
+		// happen within the audio thread.
+		*pValue = std::move( pCell->value );
+		pCell->nSequence.store( nPos + m_nMask + 1, std::memory_order_release );
+		return true;
+	}
+
+	size_t getCapacity() const {
+		return m_nMask + 1;
+	}
+
+private:
+	struct Cell {
+		std::atomic<size_t> nSequence;
+		T value;
+	};
+
+	static size_t roundUp( size_t nCapacity ) {
+		size_t nSize = 2;
+		while ( nSize < nCapacity ) {
+			nSize <<= 1;
+		}
+		return nSize;
+	}
+
+	const size_t m_nMask;
+	std::unique_ptr<Cell[]> m_cells;
+	/** Kept on separate cache lines to keep producers and consumers
+	 * from invalidating each other's index.*/
+	alignas( 64 ) std::atomic<size_t> m_nWritePos;
+	alignas( 64 ) std::atomic<size_t> m_nReadPos;
+};
+
+};
+
+#endif // H2C_LOCK_FREE_QUEUE_H
@@ -0,0 +1,288 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#include <core/Helpers/SampleCache.h>
+#include <core/Helpers/Filesystem.h>
+#include <core/Preferences/Preferences.h>
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+
+#include <algorithm>
+#include <cstring>
+
+namespace H2Core
+{
+
+/** Bumped whenever the layout of the entries or the way samples are
+ * decoded or transformed changes.*/
+static const quint32 nCacheVersion = 2;
+
+/** Start of each entry. It is followed by the points of the velocity
+ * and the pan envelope, stored as pairs of qint32, and the data of
+ * the left and - unless the sample is mono - the right channel
+ * starting at #nDataOffset.*/
+struct CacheHeader {
+	char sMagic[4];
+	quint32 nVersion;
+	qint32 nChannels;
+	qint32 nFrames;
+	qint32 nSampleRate;
+	qint32 nDataOffset;
+	qint32 nIsModified;
+	qint32 nLoopStartFrame;
+	qint32 nLoopLoopFrame;
+	qint32 nLoopEndFrame;
+	qint32 nLoopCount;
+	qint32 nLoopMode;
+	qint32 nRubberbandUse;
+	float fRubberbandDivider;
+	float fRubberbandPitch;
+	qint32 nRubberbandCSettings;
+	qint32 nVelocityPoints;
+	qint32 nPanPoints;
+};
+
+static const char sCacheMagic[4] = { 'H', '2', 'S', 'C' };
+
+/** Alignment of the sample data within an entry.*/
+static const qint64 nDataAlignment = 64;
+
+bool SampleCache::isEnabled()
+{
+	auto pPref = Preferences::get_instance();
+	return pPref != nullptr && pPref->m_bUseSampleCache;
+}
+
+QString SampleCache::getKey( const QString& sFilepath )
+{
+	return getKey( sFilepath, Sample::Loops(), Sample::Rubberband(),
+				   Sample::VelocityEnvelope(), Sample::PanEnvelope(), 0 );
+}
+
+QString SampleCache::getKey( const QString& sFilepath, const Sample::Loops& loops,
+							 const Sample::Rubberband& rubber,
+							 const Sample::VelocityEnvelope& velocity,
+							 const Sample::PanEnvelope& pan, float fBpm )
+{
+	QFileInfo fileInfo( sFilepath );
+	if ( ! fileInfo.exists() ) {
+		return QString();
+	}
+
+	QString sDescription = QString( "%1|%2|%3|%4|" )
+		.arg( nCacheVersion )
+		.arg( fileInfo.canonicalFilePath() )
+		.arg( fileInfo.size() )
+		.arg( fileInfo.lastModified().toMSecsSinceEpoch() );
+
+	sDescription.append( QString( "%1,%2,%3,%4,%5|" )
+						 .arg( loops.start_frame ).arg( loops.loop_frame )
+						 .arg( loops.end_frame ).arg( loops.count ).arg( loops.mode ) );
+	// The tempo does only matter in case the sample is stretched.
+	if ( rubber.use ) {
+		sDescription.append( QString( "%1,%2,%3,%4|" )
+							 .arg( rubber.divider ).arg( rubber.pitch )
+							 .arg( rubber.c_settings ).arg( fBpm ) );
+	} else {
+		sDescription.append( "|" );
+	}
+	for ( const auto& point : velocity ) {
+		sDescription.append( QString( "%1,%2;" ).arg( point.frame ).arg( point.value ) );
+	}
+	sDescription.append( "|" );
+	for ( const auto& point : pan ) {
+		sDescription.append( QString( "%1,%2;" ).arg( point.frame ).arg( point.value ) );
+	}
+
+	return QString( QCryptographicHash::hash( sDescription.toUtf8(),
+											  QCryptographicHash::Sha1 ).toHex() );
+}
+
+static QString entryPath( const QString& sKey )
+{
+	return Filesystem::sample_cache_dir() + sKey + ".h2sc";
+}
+
+std::shared_ptr<QFile> SampleCache::map( const QString& sKey, Entry* pEntry )
+{
+	auto pFile = std::make_shared<QFile>( entryPath( sKey ) );
+	if ( ! pFile->open( QIODevice::ReadOnly ) ) {
+		return nullptr;
+	}
+
+	const qint64 nSize = pFile->size();
+	if ( nSize < static_cast<qint64>( sizeof( CacheHeader ) ) ) {
+		WARNINGLOG( QString( "Invalid cache entry [%1]" ).arg( pFile->fileName() ) );
+		return nullptr;
+	}
+
+	// Since the entry is mapped privately, changes to the data - e.g.
+	// done by the SampleEditor - neither end up in the file nor in the
+	// pages shared with other processes.
+	uchar* pData = pFile->map( 0, nSize, QFileDevice::MapPrivateOption );
+	// The modification time tells evict() when the entry was used
+	// last. Access times are not updated by all file systems.
+	pFile->setFileTime( QDateTime::currentDateTimeUtc(), QFileDevice::FileModificationTime );
+	// The mapping stays valid till the QFile is destroyed.
+	pFile->close();
+	if ( pData == nullptr ) {
+		WARNINGLOG( QString( "Unable to map cache entry [%1]" ).arg( pFile->fileName() ) );
+		return nullptr;
+	}
+
+	CacheHeader header;
+	memcpy( &header, pData, sizeof( CacheHeader ) );
+
+	const qint64 nPointsEnd = sizeof( CacheHeader ) +
+		( static_cast<qint64>( header.nVelocityPoints ) + header.nPanPoints ) * 2 * sizeof( qint32 );
+	if ( memcmp( header.sMagic, sCacheMagic, sizeof( sCacheMagic ) ) != 0 ||
+		 header.nVersion != nCacheVersion ||
+		 ( header.nChannels != 1 && header.nChannels != 2 ) ||
+		 header.nFrames < 0 || header.nVelocityPoints < 0 || header.nPanPoints < 0 ||
+		 header.nDataOffset % nDataAlignment != 0 || header.nDataOffset < nPointsEnd ||
+		 header.nDataOffset + header.nChannels * static_cast<qint64>( header.nFrames ) * sizeof( float ) != nSize ) {
+		WARNINGLOG( QString( "Invalid cache entry [%1]" ).arg( pFile->fileName() ) );
+		return nullptr;
+	}
+
+	pEntry->nFrames = header.nFrames;
+	pEntry->nSampleRate = header.nSampleRate;
+	pEntry->bIsModified = header.nIsModified != 0;
+	pEntry->loops.start_frame = header.nLoopStartFrame;
+	pEntry->loops.loop_frame = header.nLoopLoopFrame;
+	pEntry->loops.end_frame = header.nLoopEndFrame;
+	pEntry->loops.count = header.nLoopCount;
+	pEntry->loops.mode = static_cast<Sample::Loops::LoopMode>( header.nLoopMode );
+	pEntry->rubberband.use = header.nRubberbandUse != 0;
+	pEntry->rubberband.divider = header.fRubberbandDivider;
+	pEntry->rubberband.pitch = header.fRubberbandPitch;
+	pEntry->rubberband.c_settings = header.nRubberbandCSettings;
+
+	const qint32* pPoints = reinterpret_cast<const qint32*>( pData + sizeof( CacheHeader ) );
+	pEntry->velocityEnvelope.clear();
+	for ( int ii = 0; ii < header.nVelocityPoints; ++ii, pPoints += 2 ) {
+		pEntry->velocityEnvelope.emplace_back( pPoints[ 0 ], pPoints[ 1 ] );
+	}
+	pEntry->panEnvelope.clear();
+	for ( int ii = 0; ii < header.nPanPoints; ++ii, pPoints += 2 ) {
+		pEntry->panEnvelope.emplace_back( pPoints[ 0 ], pPoints[ 1 ] );
+	}
+
+	pEntry->pData_L = reinterpret_cast<float*>( pData + header.nDataOffset );
+	pEntry->pData_R = header.nChannels == 1 ? pEntry->pData_L : pEntry->pData_L + header.nFrames;
+
+	return pFile;
+}
+
+bool SampleCache::store( const QString& sKey, const Entry& entry )
+{
+	if ( ! Filesystem::path_usable( Filesystem::sample_cache_dir(), true, true ) ) {
+		ERRORLOG( QString( "Sample cache [%1] is not writable" ).arg( Filesystem::sample_cache_dir() ) );
+		return false;
+	}
+
+	CacheHeader header;
+	memset( &header, 0, sizeof( CacheHeader ) );
+	memcpy( header.sMagic, sCacheMagic, sizeof( sCacheMagic ) );
+	header.nVersion = nCacheVersion;
+	header.nChannels = entry.pData_L == entry.pData_R ? 1 : 2;
+	header.nFrames = entry.nFrames;
+	header.nSampleRate = entry.nSampleRate;
+	header.nIsModified = entry.bIsModified ? 1 : 0;
+	header.nLoopStartFrame = entry.loops.start_frame;
+	header.nLoopLoopFrame = entry.loops.loop_frame;
+	header.nLoopEndFrame = entry.loops.end_frame;
+	header.nLoopCount = entry.loops.count;
+	header.nLoopMode = entry.loops.mode;
+	header.nRubberbandUse = entry.rubberband.use ? 1 : 0;
+	header.fRubberbandDivider = entry.rubberband.divider;
+	header.fRubberbandPitch = entry.rubberband.pitch;
+	header.nRubberbandCSettings = entry.rubberband.c_settings;
+	header.nVelocityPoints = entry.velocityEnvelope.size();
+	header.nPanPoints = entry.panEnvelope.size();
+
+	QByteArray points;
+	for ( const auto& envelope : { &entry.velocityEnvelope, &entry.panEnvelope } ) {
+		for ( const auto& point : *envelope ) {
+			qint32 values[2] = { point.frame, point.value };
+			points.append( reinterpret_cast<const char*>( values ), sizeof( values ) );
+		}
+	}
+
+	const qint64 nPointsEnd = sizeof( CacheHeader ) + points.size();
+	header.nDataOffset = ( nPointsEnd + nDataAlignment - 1 ) / nDataAlignment * nDataAlignment;
+
+	// QSaveFile writes to a temporary file and renames it on
+	// commit(). Other instances either see the complete entry or
+	// none at all.
+	QSaveFile file( entryPath( sKey ) );
+	if ( ! file.open( QIODevice::WriteOnly ) ) {
+		ERRORLOG( QString( "Unable to write cache entry [%1]" ).arg( file.fileName() ) );
+		return false;
+	}
+
+	const qint64 nDataSize = static_cast<qint64>( entry.nFrames ) * sizeof( float );
+	file.write( reinterpret_cast<const char*>( &header ), sizeof( CacheHeader ) );
+	file.write( points );
+	file.write( QByteArray( header.nDataOffset - nPointsEnd, 0 ) );
+	file.write( reinterpret_cast<const char*>( entry.pData_L ), nDataSize );
+	if ( header.nChannels == 2 ) {
+		file.write( reinterpret_cast<const char*>( entry.pData_R ), nDataSize );
+	}
+
+	if ( ! file.commit() ) {
+		ERRORLOG( QString( "Unable to write cache entry [%1]: %2" )
+				  .arg( file.fileName() ).arg( file.errorString() ) );
+		return false;
+	}
+
+	auto pPref = Preferences::get_instance();
+	if ( pPref != nullptr && pPref->m_nSampleCacheSizeMb > 0 ) {
+		evict( static_cast<qint64>( pPref->m_nSampleCacheSizeMb ) * 1024 * 1024 );
+	}
+	return true;
+}
+
+void SampleCache::evict( qint64 nMaxBytes )
+{
+	QDir dir( Filesystem::sample_cache_dir() );
+	// Most recently used first.
+	QFileInfoList entries = dir.entryInfoList( QStringList( "*.h2sc" ), QDir::Files, QDir::Time );
+
+	qint64 nBytes = 0;
+	for ( const auto& entry : entries ) {
+		nBytes += entry.size();
+	}
+
+	for ( auto it = entries.crbegin(); it != entries.crend() && nBytes > nMaxBytes; ++it ) {
+		if ( QFile::remove( it->absoluteFilePath() ) ) {
+			INFOLOG( QString( "Evicted cache entry [%1]" ).arg( it->fileName() ) );
+			nBytes -= it->size();
+		}
+	}
+}
+
+};
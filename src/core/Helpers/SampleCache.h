@@ -0,0 +1,122 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#ifndef H2C_SAMPLE_CACHE_H
+#define H2C_SAMPLE_CACHE_H
+
+#include <core/Object.h>
+#include <core/Basics/Sample.h>
+
+#include <memory>
+
+class QFile;
+
+namespace H2Core
+{
+
+/**
+ * Persistent cache of decoded and transformed sample data.
+ *
+ * Each entry is a file in Filesystem::sample_cache_dir() holding
+ * the deinterleaved float data of the channels of a Sample, as well
+ * as the transformations which were applied to it. It is named after
+ * a hash of the path, size, and modification time of the original
+ * file and the requested transformations. An outdated entry thus is
+ * never found again and loading a sample does not require reading
+ * the original file at all.
+ *
+ * Instead of being read, entries are mapped into memory
+ * copy-on-write. Their pages are loaded lazily from the page cache
+ * and shared between all Hydrogen instances on the same host as long
+ * as the data is not modified.
+ *
+ * The size of the cache is limited by
+ * Preferences::m_nSampleCacheSizeMb. Each time an entry is stored,
+ * the least recently used ones are removed until the cache fits.
+ * Outdated entries, which are never used again, go first this way.
+ *
+ * All members are static and may be called from any thread but the
+ * audio thread.
+ *
+ * \ingroup docCore
+ */
+class SampleCache : public H2Core::Object<SampleCache>
+{
+	H2_OBJECT(SampleCache)
+public:
+	/** Content of a cache entry.*/
+	struct Entry {
+		int nFrames;
+		int nSampleRate;
+		bool bIsModified;
+		Sample::Loops loops;
+		Sample::Rubberband rubberband;
+		Sample::VelocityEnvelope velocityEnvelope;
+		Sample::PanEnvelope panEnvelope;
+		/** Both hold #nFrames values. They are equal for mono
+		 * samples (see Sample::is_mono()).*/
+		float* pData_L;
+		float* pData_R;
+	};
+
+	/** \return Whether Preferences::m_bUseSampleCache is set.*/
+	static bool isEnabled();
+
+	/** \return Key of @a sFilepath loaded without transformations
+	 * or an empty string if the file does not exist.*/
+	static QString getKey( const QString& sFilepath );
+	/** \return Key of @a sFilepath with the provided
+	 * transformations applied (see Sample::apply()) or an empty
+	 * string if the file does not exist.*/
+	static QString getKey( const QString& sFilepath, const Sample::Loops& loops,
+						   const Sample::Rubberband& rubber,
+						   const Sample::VelocityEnvelope& velocity,
+						   const Sample::PanEnvelope& pan, float fBpm );
+
+	/**
+	 * Maps the entry stored for @a sKey into memory.
+	 *
+	 * \param sKey Obtained using getKey().
+	 * \param pEntry Filled with the content of the entry. Its data
+	 * pointers are writable and remain valid as long as the returned
+	 * file exists.
+	 *
+	 * \return nullptr if there is no valid entry for @a sKey.
+	 */
+	static std::shared_ptr<QFile> map( const QString& sKey, Entry* pEntry );
+
+	/** Writes @a entry to the cache. An existing entry for @a sKey
+	 * is replaced atomically.*/
+	static bool store( const QString& sKey, const Entry& entry );
+
+	/**
+	 * Removes the least recently mapped or stored entries until
+	 * the ones left take up at most @a nMaxBytes.
+	 *
+	 * Entries still mapped by any instance stay valid on POSIX
+	 * systems. Where they can not be removed, they are skipped.
+	 */
+	static void evict( qint64 nMaxBytes );
+};
+
+};
+
+#endif // H2C_SAMPLE_CACHE_H
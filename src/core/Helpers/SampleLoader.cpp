@@ -0,0 +1,194 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#include <core/Helpers/SampleLoader.h>
+#include <core/Helpers/SamplePool.h>
+#include <core/Basics/Drumkit.h>
+#include <core/Basics/Instrument.h>
+#include <core/Basics/InstrumentComponent.h>
+#include <core/Basics/InstrumentLayer.h>
+#include <core/Basics/Sample.h>
+#include <core/EventQueue.h>
+
+#include <algorithm>
+#include <thread>
+
+namespace H2Core
+{
+
+SampleLoader::SampleLoader( int nThreads )
+	: m_nThreads( nThreads )
+	, m_nNextJob( 0 )
+	, m_bCancelled( false )
+	, m_nFinishedJobs( 0 )
+{
+	if ( m_nThreads <= 0 ) {
+		m_nThreads = std::max( static_cast<int>( std::thread::hardware_concurrency() ), 1 );
+	}
+}
+
+SampleLoader::~SampleLoader()
+{
+}
+
+void SampleLoader::add( std::shared_ptr<InstrumentLayer> pLayer )
+{
+	if ( pLayer->get_sample() == nullptr ||
+		 ! m_layerSamples.insert( pLayer->get_sample().get() ).second ) {
+		return;
+	}
+	Job job;
+	job.pLayer = pLayer;
+	m_jobs.push_back( job );
+}
+
+void SampleLoader::addUnloaded( std::shared_ptr<InstrumentLayer> pLayer, float fBpm )
+{
+	if ( pLayer->get_sample() == nullptr ) {
+		return;
+	}
+	// Layers are not deduplicated by their sample since each of
+	// them has to be replaced. The SamplePool still loads each file
+	// only once.
+	Job job;
+	job.pLayer = pLayer;
+	job.bUnloaded = true;
+	job.fBpm = fBpm;
+	m_jobs.push_back( job );
+}
+
+void SampleLoader::add( std::shared_ptr<Instrument> pInstrument )
+{
+	for ( const auto& pComponent : *pInstrument->get_components() ) {
+		for ( int ii = 0; ii < InstrumentComponent::getMaxLayers(); ++ii ) {
+			auto pLayer = pComponent->get_layer( ii );
+			if ( pLayer != nullptr ) {
+				add( pLayer );
+			}
+		}
+	}
+}
+
+void SampleLoader::add( Drumkit* pDrumkit, std::shared_ptr<Instrument> pInstrument )
+{
+	for ( const auto& pComponent : *pInstrument->get_components() ) {
+		for ( int ii = 0; ii < InstrumentComponent::getMaxLayers(); ++ii ) {
+			auto pLayer = pComponent->get_layer( ii );
+			if ( pLayer != nullptr ) {
+				add( pDrumkit->get_path() + "/" + pLayer->get_sample()->get_filename() );
+			}
+		}
+	}
+}
+
+void SampleLoader::add( const QString& sPath )
+{
+	if ( m_pathJobs.find( sPath ) != m_pathJobs.end() ) {
+		return;
+	}
+	m_pathJobs[ sPath ] = m_jobs.size();
+
+	Job job;
+	job.sPath = sPath;
+	m_jobs.push_back( job );
+}
+
+bool SampleLoader::run()
+{
+	const int nJobs = m_jobs.size();
+	m_nNextJob = 0;
+	m_nFinishedJobs = 0;
+
+	std::vector<std::thread> workers;
+	for ( int ii = 0; ii < std::min( m_nThreads, nJobs ); ++ii ) {
+		workers.emplace_back( &SampleLoader::workerLoop, this );
+	}
+
+	// Only the calling thread reports the progress since the
+	// EventQueue does not support concurrent writers.
+	EventQueue* pEventQueue = EventQueue::get_instance();
+	int nReportedProgress = -1;
+	{
+		std::unique_lock<std::mutex> lock( m_mutex );
+		while ( true ) {
+			int nProgress = nJobs > 0 ? m_nFinishedJobs * 100 / nJobs : 100;
+			if ( nProgress != nReportedProgress && pEventQueue != nullptr ) {
+				pEventQueue->push_event( EVENT_SAMPLE_LOADING_PROGRESS, nProgress );
+				nReportedProgress = nProgress;
+			}
+			if ( m_nFinishedJobs == nJobs || m_bCancelled ) {
+				break;
+			}
+			m_jobFinished.wait( lock );
+		}
+	}
+
+	for ( auto& worker : workers ) {
+		worker.join();
+	}
+
+	return ! m_bCancelled;
+}
+
+void SampleLoader::cancel()
+{
+	std::lock_guard<std::mutex> lock( m_mutex );
+	m_bCancelled = true;
+	m_jobFinished.notify_all();
+}
+
+void SampleLoader::workerLoop()
+{
+	while ( ! m_bCancelled ) {
+		const int nJob = m_nNextJob++;
+		if ( nJob >= static_cast<int>( m_jobs.size() ) ) {
+			break;
+		}
+
+		// Each job is accessed by a single worker only.
+		Job& job = m_jobs[ nJob ];
+		if ( job.bUnloaded ) {
+			auto pSample = SamplePool::load( job.pLayer->get_sample(), job.fBpm );
+			if ( pSample != nullptr ) {
+				job.pLayer->set_sample( pSample );
+			}
+		} else if ( job.pLayer != nullptr ) {
+			job.pLayer->load_sample();
+		} else {
+			job.pSample = SamplePool::load( job.sPath );
+		}
+
+		std::lock_guard<std::mutex> lock( m_mutex );
+		++m_nFinishedJobs;
+		m_jobFinished.notify_one();
+	}
+}
+
+std::shared_ptr<Sample> SampleLoader::getSample( const QString& sPath ) const
+{
+	auto it = m_pathJobs.find( sPath );
+	if ( it == m_pathJobs.end() ) {
+		return nullptr;
+	}
+	return m_jobs[ it->second ].pSample;
+}
+
+};
@@ -0,0 +1,131 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#ifndef H2C_SAMPLE_LOADER_H
+#define H2C_SAMPLE_LOADER_H
+
+#include <core/Object.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <vector>
+
+namespace H2Core
+{
+
+class Drumkit;
+class Instrument;
+class InstrumentLayer;
+class Sample;
+
+/**
+ * Decodes a batch of samples on several threads.
+ *
+ * Samples are registered using add() and decoded by run(). Each
+ * worker decodes one sample at a time, so no more than the number
+ * of workers decode buffers exist at once. run() blocks the calling
+ * thread, which reports the progress using
+ * #EVENT_SAMPLE_LOADING_PROGRESS, until all samples are loaded or
+ * cancel() was called.
+ *
+ * \ingroup docCore
+ */
+class SampleLoader : public H2Core::Object<SampleLoader>
+{
+	H2_OBJECT(SampleLoader)
+public:
+	/**
+	 * \param nThreads Number of worker threads. If 0, one per
+	 * available core is used.
+	 */
+	explicit SampleLoader( int nThreads = 0 );
+	~SampleLoader();
+
+	/** Loads the sample of @a pLayer in place (see
+	 * InstrumentLayer::load_sample()).*/
+	void add( std::shared_ptr<InstrumentLayer> pLayer );
+	/** Replaces the empty sample of @a pLayer created by
+	 * Sample::create_unloaded() by the one SamplePool::load()
+	 * returns for it. Transformations target @a fBpm. @a pLayer
+	 * must not be used by the audio engine meanwhile.*/
+	void addUnloaded( std::shared_ptr<InstrumentLayer> pLayer, float fBpm );
+	/** Loads the samples of all layers of @a pInstrument in
+	 * place.*/
+	void add( std::shared_ptr<Instrument> pInstrument );
+	/** Loads the sample files Instrument::load_from() would use to
+	 * take over @a pInstrument of @a pDrumkit. Retrieve them using
+	 * getSample() afterwards.*/
+	void add( Drumkit* pDrumkit, std::shared_ptr<Instrument> pInstrument );
+	/** Loads the sample file @a sPath. Files registered more than
+	 * once are only loaded once.*/
+	void add( const QString& sPath );
+
+	/**
+	 * Loads all registered samples.
+	 *
+	 * \return false if the loading was cancelled.
+	 */
+	bool run();
+	/** Makes run() return as soon as the samples currently being
+	 * decoded are done. May be called from any thread.*/
+	void cancel();
+
+	/** \return Sample loaded for @a sPath or nullptr if it was not
+	 * registered or could not be loaded.*/
+	std::shared_ptr<Sample> getSample( const QString& sPath ) const;
+
+private:
+	struct Job {
+		/** Layer to load the sample of in place.*/
+		std::shared_ptr<InstrumentLayer> pLayer;
+		/** Whether the sample of #pLayer is replaced instead.*/
+		bool bUnloaded = false;
+		/** Tempo transformations of a replaced sample target.*/
+		float fBpm = 0;
+		/** File to load into #pSample otherwise.*/
+		QString sPath;
+		std::shared_ptr<Sample> pSample;
+	};
+
+	void workerLoop();
+
+	int m_nThreads;
+	std::vector<Job> m_jobs;
+	/** Position of the job for each file in #m_jobs.*/
+	std::map<QString, int> m_pathJobs;
+	/** Samples loaded in place. Layers sharing a sample are loaded
+	 * only once.*/
+	std::set<Sample*> m_layerSamples;
+
+	std::atomic<int> m_nNextJob;
+	std::atomic<bool> m_bCancelled;
+	int m_nFinishedJobs;
+	std::mutex m_mutex;
+	std::condition_variable m_jobFinished;
+};
+
+};
+
+#endif // H2C_SAMPLE_LOADER_H
@@ -0,0 +1,138 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+#include <core/Helpers/SamplePool.h>
+#include <core/Helpers/SampleCache.h>
+
+namespace H2Core
+{
+
+std::mutex SamplePool::m_mutex;
+std::map<QString, std::weak_ptr<Sample>> SamplePool::m_samples;
+unsigned long long SamplePool::m_nHits = 0;
+unsigned long long SamplePool::m_nMisses = 0;
+
+std::shared_ptr<Sample> SamplePool::load( const QString& sFilepath )
+{
+	const QString sKey = SampleCache::getKey( sFilepath );
+	if ( sKey.isEmpty() ) {
+		return Sample::load( sFilepath, true );
+	}
+
+	auto pSample = lookup( sKey );
+	if ( pSample != nullptr ) {
+		return pSample;
+	}
+
+	pSample = Sample::load( sFilepath, true );
+	if ( pSample == nullptr ) {
+		return nullptr;
+	}
+	return insert( sKey, pSample );
+}
+
+std::shared_ptr<Sample> SamplePool::load( const QString& sFilepath, const Sample::Loops& loops,
+										  const Sample::Rubberband& rubber,
+										  const Sample::VelocityEnvelope& velocity,
+										  const Sample::PanEnvelope& pan, float fBpm )
+{
+	const QString sKey = SampleCache::getKey( sFilepath, loops, rubber, velocity, pan, fBpm );
+	if ( sKey.isEmpty() ) {
+		return Sample::load( sFilepath, loops, rubber, velocity, pan, fBpm );
+	}
+
+	auto pSample = lookup( sKey );
+	if ( pSample != nullptr ) {
+		return pSample;
+	}
+
+	pSample = Sample::load( sFilepath, loops, rubber, velocity, pan, fBpm );
+	if ( pSample == nullptr ) {
+		return nullptr;
+	}
+	return insert( sKey, pSample );
+}
+
+std::shared_ptr<Sample> SamplePool::load( const std::shared_ptr<Sample>& pUnloaded, float fBpm )
+{
+	if ( ! pUnloaded->get_is_modified() ) {
+		return load( pUnloaded->get_filepath() );
+	}
+	return load( pUnloaded->get_filepath(), pUnloaded->get_loops(), pUnloaded->get_rubberband(),
+				 *pUnloaded->get_velocity_envelope(), *pUnloaded->get_pan_envelope(), fBpm );
+}
+
+std::shared_ptr<Sample> SamplePool::lookup( const QString& sKey )
+{
+	std::lock_guard<std::mutex> lock( m_mutex );
+	auto it = m_samples.find( sKey );
+	if ( it != m_samples.end() ) {
+		auto pSample = it->second.lock();
+		if ( pSample != nullptr ) {
+			++m_nHits;
+			return pSample;
+		}
+	}
+	++m_nMisses;
+	return nullptr;
+}
+
+std::shared_ptr<Sample> SamplePool::insert( const QString& sKey, std::shared_ptr<Sample> pSample )
+{
+	std::lock_guard<std::mutex> lock( m_mutex );
+	auto& pStored = m_samples[ sKey ];
+	auto pOther = pStored.lock();
+	if ( pOther != nullptr ) {
+		// Loaded concurrently by another thread.
+		return pOther;
+	}
+	pStored = pSample;
+
+	// Drop the keys of samples not in use anymore.
+	for ( auto it = m_samples.begin(); it != m_samples.end(); ) {
+		if ( it->second.expired() ) {
+			it = m_samples.erase( it );
+		} else {
+			++it;
+		}
+	}
+	return pSample;
+}
+
+SamplePool::Statistics SamplePool::getStatistics()
+{
+	Statistics statistics = { 0, 0, 0, 0 };
+
+	std::lock_guard<std::mutex> lock( m_mutex );
+	statistics.nHits = m_nHits;
+	statistics.nMisses = m_nMisses;
+	for ( const auto& [ sKey, pWeakSample ] : m_samples ) {
+		auto pSample = pWeakSample.lock();
+		if ( pSample == nullptr || pSample->get_data_l() == nullptr ) {
+			continue;
+		}
+		++statistics.nSamples;
+		const long long nChannels = pSample->is_mono() ? 1 : 2;
+		statistics.nResidentBytes += nChannels * pSample->get_resident_frames() * sizeof( float );
+	}
+	return statistics;
+}
+
+};
@@ -0,0 +1,101 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+#ifndef H2C_SAMPLE_POOL_H
+#define H2C_SAMPLE_POOL_H
+
+#include <core/Object.h>
+#include <core/Basics/Sample.h>
+
+#include <map>
+#include <memory>
+#include <mutex>
+
+namespace H2Core
+{
+
+/**
+ * Process-wide pool of loaded samples.
+ *
+ * Samples are identified by the same key used by the SampleCache:
+ * a hash of the canonical path, size, and modification time of the
+ * file and the applied transformations. Instruments, drumkits, and
+ * songs loading the same file thus share a single Sample as long as
+ * one of them still holds it. The pool itself only keeps weak
+ * references and does not extend the lifetime of any sample.
+ *
+ * Samples handed out by the pool are shared and must not be modified
+ * in place. Use the copy constructor of Sample to get a private copy
+ * instead.
+ *
+ * All members are static and may be called from any thread but the
+ * audio thread.
+ *
+ * \ingroup docCore
+ */
+class SamplePool : public H2Core::Object<SamplePool>
+{
+	H2_OBJECT(SamplePool)
+public:
+	struct Statistics {
+		/** Number of requests answered by a sample already loaded.*/
+		unsigned long long nHits;
+		/** Number of requests which had to load the sample.*/
+		unsigned long long nMisses;
+		/** Number of samples currently held by the pool.*/
+		int nSamples;
+		/** Size of the data of all samples in #nSamples which is kept
+		 * in memory.*/
+		long long nResidentBytes;
+	};
+
+	/** Shared version of Sample::load( @a sFilepath, true ).*/
+	static std::shared_ptr<Sample> load( const QString& sFilepath );
+	/** Shared version of Sample::load() applying the provided
+	 * transformations.*/
+	static std::shared_ptr<Sample> load( const QString& sFilepath, const Sample::Loops& loops,
+										 const Sample::Rubberband& rubber,
+										 const Sample::VelocityEnvelope& velocity,
+										 const Sample::PanEnvelope& pan, float fBpm );
+	/** Shared version of the sample @a pUnloaded created by
+	 * Sample::create_unloaded() describes. Its transformations are
+	 * applied targeting @a fBpm.*/
+	static std::shared_ptr<Sample> load( const std::shared_ptr<Sample>& pUnloaded, float fBpm );
+
+	static Statistics getStatistics();
+
+private:
+	/** \return Sample stored for @a sKey or nullptr if it was not
+	 * loaded or is not in use anymore.*/
+	static std::shared_ptr<Sample> lookup( const QString& sKey );
+	/** Stores @a pSample for @a sKey. If another thread stored a
+	 * sample for the same key in the meantime, that one is returned
+	 * instead.*/
+	static std::shared_ptr<Sample> insert( const QString& sKey, std::shared_ptr<Sample> pSample );
+
+	static std::mutex m_mutex;
+	static std::map<QString, std::weak_ptr<Sample>> m_samples;
+	static unsigned long long m_nHits;
+	static unsigned long long m_nMisses;
+};
+
+};
+
+#endif // H2C_SAMPLE_POOL_H
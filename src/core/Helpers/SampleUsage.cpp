@@ -0,0 +1,215 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+#include <core/Helpers/SampleUsage.h>
+#include <core/Helpers/SampleLoader.h>
+#include <core/Basics/AutomationPath.h>
+#include <core/Basics/Instrument.h>
+#include <core/Basics/InstrumentComponent.h>
+#include <core/Basics/InstrumentLayer.h>
+#include <core/Basics/InstrumentList.h>
+#include <core/Basics/Note.h>
+#include <core/Basics/Pattern.h>
+#include <core/Basics/PatternList.h>
+#include <core/Basics/Sample.h>
+#include <core/Basics/Song.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace H2Core
+{
+
+/** Number of velocities checked for falling into a hole between
+ * the layers across the whole velocity range.*/
+static const int nHoleSteps = 1024;
+
+SampleUsage::SampleUsage( std::shared_ptr<Song> pSong )
+{
+	// The velocity automation scales the velocities of all notes
+	// played in song mode. Those played in pattern mode are left
+	// as they are.
+	float fMinAutomation = 1.0;
+	float fMaxAutomation = 1.0;
+	AutomationPath* pPath = pSong->getVelocityAutomationPath();
+	if ( pPath != nullptr ) {
+		if ( pPath->empty() ) {
+			fMinAutomation = std::min( fMinAutomation, pPath->get_default() );
+			fMaxAutomation = std::max( fMaxAutomation, pPath->get_default() );
+		}
+		for ( const auto& [ fX, fY ] : *pPath ) {
+			fMinAutomation = std::min( fMinAutomation, fY );
+			fMaxAutomation = std::max( fMaxAutomation, fY );
+		}
+	}
+
+	// The humanization shifts the velocities by half its value
+	// downwards and adds a gaussian deviation of a fifth of its
+	// value. Deviations up to three times as large are covered.
+	// Notes deviating further are loaded on demand.
+	const float fHumanize = pSong->getHumanizeVelocityValue();
+	const float fLowerDeviation = fHumanize * ( 0.5 + 3 * 0.2 );
+	const float fUpperDeviation = std::max( fHumanize * ( 3 * 0.2 - 0.5 ), 0.0 );
+
+	PatternList* pPatternList = pSong->getPatternList();
+	if ( pPatternList == nullptr ) {
+		return;
+	}
+	for ( int ii = 0; ii < pPatternList->size(); ++ii ) {
+		for ( const auto& [ nPosition, pNote ] : *pPatternList->get( ii )->get_notes() ) {
+			auto pInstrument = pNote->get_instrument();
+			if ( pInstrument == nullptr ) {
+				continue;
+			}
+			const float fVelocity = pNote->get_velocity();
+			addRange( pInstrument->get_id(), pNote->get_specific_compo_id(),
+					  std::clamp( fVelocity * fMinAutomation - fLowerDeviation, 0.f, 1.f ),
+					  std::clamp( fVelocity * fMaxAutomation + fUpperDeviation, 0.f, 1.f ) );
+		}
+	}
+}
+
+SampleUsage::~SampleUsage()
+{
+}
+
+void SampleUsage::addRange( int nInstrument, int nComponent, float fMin, float fMax )
+{
+	auto& components = m_ranges[ nInstrument ];
+	auto it = components.find( nComponent );
+	if ( it == components.end() ) {
+		components[ nComponent ] = { fMin, fMax };
+	} else {
+		it->second.fMin = std::min( it->second.fMin, fMin );
+		it->second.fMax = std::max( it->second.fMax, fMax );
+	}
+}
+
+bool SampleUsage::getRange( int nInstrument, int nComponent, Range* pRange ) const
+{
+	auto instrumentIt = m_ranges.find( nInstrument );
+	if ( instrumentIt == m_ranges.end() ) {
+		return false;
+	}
+
+	bool bFound = false;
+	for ( const auto& [ nId, range ] : instrumentIt->second ) {
+		if ( nId != -1 && nId != nComponent ) {
+			continue;
+		}
+		if ( ! bFound ) {
+			*pRange = range;
+			bFound = true;
+		} else {
+			pRange->fMin = std::min( pRange->fMin, range.fMin );
+			pRange->fMax = std::max( pRange->fMax, range.fMax );
+		}
+	}
+	return bFound;
+}
+
+std::vector<bool> SampleUsage::getUsedLayers( std::shared_ptr<Instrument> pInstrument,
+											  std::shared_ptr<InstrumentComponent> pComponent ) const
+{
+	const int nMaxLayers = InstrumentComponent::getMaxLayers();
+	std::vector<bool> usedLayers( nMaxLayers, false );
+
+	Range range;
+	if ( ! getRange( pInstrument->get_id(), pComponent->get_drumkit_componentID(), &range ) ) {
+		return usedLayers;
+	}
+
+	for ( int nLayer = 0; nLayer < nMaxLayers; ++nLayer ) {
+		auto pLayer = pComponent->get_layer( nLayer );
+		if ( pLayer != nullptr && pLayer->get_start_velocity() <= range.fMax &&
+			 pLayer->get_end_velocity() >= range.fMin ) {
+			usedLayers[ nLayer ] = true;
+		}
+	}
+
+	// Velocities falling into a hole between the layers are played
+	// by the layer starting closest to them (see
+	// Sampler::renderNote()).
+	const int nSteps = std::max( static_cast<int>( std::ceil( ( range.fMax - range.fMin ) * nHoleSteps ) ), 1 );
+	for ( int nStep = 0; nStep <= nSteps; ++nStep ) {
+		const float fVelocity = range.fMin + ( range.fMax - range.fMin ) * nStep / nSteps;
+
+		bool bCovered = false;
+		float fShortestDistance = 1.0;
+		int nNearestLayer = -1;
+		for ( int nLayer = 0; nLayer < nMaxLayers; ++nLayer ) {
+			auto pLayer = pComponent->get_layer( nLayer );
+			if ( pLayer == nullptr ) {
+				continue;
+			}
+			if ( fVelocity >= pLayer->get_start_velocity() &&
+				 fVelocity <= pLayer->get_end_velocity() ) {
+				bCovered = true;
+				break;
+			}
+			const float fDistance = std::abs( pLayer->get_start_velocity() - fVelocity );
+			if ( fDistance < fShortestDistance ) {
+				fShortestDistance = fDistance;
+				nNearestLayer = nLayer;
+			}
+		}
+		if ( ! bCovered && nNearestLayer != -1 ) {
+			usedLayers[ nNearestLayer ] = true;
+		}
+	}
+
+	return usedLayers;
+}
+
+bool SampleUsage::isLayerUsed( std::shared_ptr<Instrument> pInstrument,
+							   std::shared_ptr<InstrumentComponent> pComponent, int nLayer ) const
+{
+	if ( nLayer < 0 || nLayer >= InstrumentComponent::getMaxLayers() ) {
+		return false;
+	}
+	return getUsedLayers( pInstrument, pComponent )[ nLayer ];
+}
+
+int SampleUsage::addUsedLayers( InstrumentList* pInstruments, SampleLoader* pSampleLoader,
+								float fBpm ) const
+{
+	int nLeftOut = 0;
+	for ( int ii = 0; ii < pInstruments->size(); ++ii ) {
+		auto pInstrument = pInstruments->get( ii );
+		for ( const auto& pComponent : *pInstrument->get_components() ) {
+			const auto usedLayers = getUsedLayers( pInstrument, pComponent );
+			for ( int nLayer = 0; nLayer < InstrumentComponent::getMaxLayers(); ++nLayer ) {
+				auto pLayer = pComponent->get_layer( nLayer );
+				if ( pLayer == nullptr || pLayer->get_sample() == nullptr ||
+					 ! pLayer->get_sample()->is_empty() ) {
+					continue;
+				}
+				if ( usedLayers[ nLayer ] ) {
+					pSampleLoader->addUnloaded( pLayer, fBpm );
+				} else {
+					++nLeftOut;
+				}
+			}
+		}
+	}
+	return nLeftOut;
+}
+
+};
@@ -0,0 +1,102 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+#ifndef H2C_SAMPLE_USAGE_H
+#define H2C_SAMPLE_USAGE_H
+
+#include <core/Object.h>
+
+#include <map>
+#include <memory>
+#include <vector>
+
+namespace H2Core
+{
+
+class Instrument;
+class InstrumentComponent;
+class InstrumentList;
+class SampleLoader;
+class Song;
+
+/**
+ * Layers of the instruments of a Song its patterns can select.
+ *
+ * The velocities of all notes are collected per instrument and
+ * component, widened by the velocity humanization and the range
+ * of the velocity automation of the song. A layer is considered
+ * used if its velocity range overlaps the collected one or if it
+ * is the nearest layer the Sampler falls back to for velocities
+ * falling into a hole between the layers. Layers of instruments
+ * without notes are not used at all.
+ *
+ * Layers not used can be left unloaded (see
+ * Sample::create_unloaded()) and are loaded by the
+ * LazySampleLoader once they are played nevertheless, e.g. by
+ * MIDI input or notes added later on.
+ *
+ * \ingroup docCore
+ */
+class SampleUsage : public H2Core::Object<SampleUsage>
+{
+	H2_OBJECT(SampleUsage)
+public:
+	/** Collects the notes of all patterns of @a pSong.*/
+	explicit SampleUsage( std::shared_ptr<Song> pSong );
+	~SampleUsage();
+
+	/** \return Whether the Sampler might select layer @a nLayer of
+	 * @a pComponent of @a pInstrument for a note of the song.*/
+	bool isLayerUsed( std::shared_ptr<Instrument> pInstrument,
+					  std::shared_ptr<InstrumentComponent> pComponent, int nLayer ) const;
+
+	/**
+	 * Registers all used layers of @a pInstruments holding an
+	 * unloaded sample with @a pSampleLoader (see
+	 * SampleLoader::addUnloaded()).
+	 *
+	 * \return Number of unloaded layers left out.
+	 */
+	int addUsedLayers( InstrumentList* pInstruments, SampleLoader* pSampleLoader,
+					   float fBpm ) const;
+
+private:
+	struct Range {
+		float fMin;
+		float fMax;
+	};
+
+	/** \return Used layers of @a pComponent. One entry per layer.*/
+	std::vector<bool> getUsedLayers( std::shared_ptr<Instrument> pInstrument,
+									 std::shared_ptr<InstrumentComponent> pComponent ) const;
+	/** \return false if no note of @a pInstrument may be played
+	 * by @a nComponent.*/
+	bool getRange( int nInstrument, int nComponent, Range* pRange ) const;
+	void addRange( int nInstrument, int nComponent, float fMin, float fMax );
+
+	/** Velocities of the notes per instrument and component ID
+	 * after humanization and automation. Notes without a specific
+	 * component are stored for ID -1.*/
+	std::map<int, std::map<int, Range>> m_ranges;
+};
+
+};
+
+#endif // H2C_SAMPLE_USAGE_H
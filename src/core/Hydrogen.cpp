@@ -55,6 +55,7 @@
 #include <core/Basics/InstrumentList.h>
 #include <core/Basics/InstrumentLayer.h>
 #include <core/Basics/Playlist.h>
+#include <core/Basics/PreparedDrumkit.h>
 #include <core/Basics/Sample.h>
 #include <core/Basics/AutomationPath.h>
 #include <core/Hydrogen.h>
@@ -62,6 +63,8 @@
 #include <core/Basics/PatternList.h>
 #include <core/Basics/Note.h>
 #include <core/Helpers/Filesystem.h>
+#include <core/Helpers/SampleLoader.h>
+#include <core/Helpers/SamplePool.h>
 #include <core/FX/LadspaFX.h>
 #include <core/FX/Effects.h>
 
@@ -520,65 +523,12 @@ void Hydrogen::addRealtimeNote(	int		instrument,
 
 void Hydrogen::sequencer_setNextPattern( int pos )
 {
-	AudioEngine* pAudioEngine = m_pAudioEngine;
-	
-	pAudioEngine->lock( RIGHT_HERE );
-	std::shared_ptr<Song> pSong = getSong();
-	if ( pSong != nullptr && getMode() == Song::Mode::Pattern ) {
-		PatternList* pPatternList = pSong->getPatternList();
-		
-		// Check whether `pos` is in range of the pattern list.
-		if ( ( pos >= 0 ) && ( pos < ( int )pPatternList->size() ) ) {
-			Pattern* pPattern = pPatternList->get( pos );
-			
-			// If the pattern is already in the `AudioEngine::m_pNextPatterns`, it
-			// will be removed from the latter and its `del()` method
-			// will return a pointer to the very pattern. The if
-			// clause is therefore only entered if the `pPattern` was
-			// not already present.
-			if ( pAudioEngine->getNextPatterns()->del( pPattern ) == nullptr ) {
-				pAudioEngine->getNextPatterns()->add( pPattern );
-			}
-		} else {
-			ERRORLOG( QString( "pos not in patternList range. pos=%1 patternListSize=%2" )
-					  .arg( pos ).arg( pPatternList->size() ) );
-			pAudioEngine->getNextPatterns()->clear();
-		}
-	} else {
-		ERRORLOG( "can't set next pattern in song mode" );
-		pAudioEngine->getNextPatterns()->clear();
-	}
-
-	pAudioEngine->unlock();
+	m_pAudioEngine->toggleNextPattern( pos );
 }
 
 void Hydrogen::sequencer_setOnlyNextPattern( int pos )
 {
-	AudioEngine* pAudioEngine = m_pAudioEngine;	
-	pAudioEngine->lock( RIGHT_HERE );
-	
-	std::shared_ptr<Song> pSong = getSong();
-	if ( pSong != nullptr && getMode() == Song::Mode::Pattern ) {
-		PatternList* pPatternList = pSong->getPatternList();
-		
-		// Clear the list of all patterns scheduled to be processed
-		// next and fill them with those currently played.
-		pAudioEngine->getNextPatterns()->clear( );
-		Pattern* pPattern;
-		for ( int nPattern = 0 ; nPattern < (int) pAudioEngine->getPlayingPatterns()->size() ; ++nPattern ) {
-			pPattern = pAudioEngine->getPlayingPatterns()->get( nPattern );
-			pAudioEngine->getNextPatterns()->add( pPattern );
-		}
-		
-		// Appending the requested pattern.
-		pPattern = pPatternList->get( pos );
-		pAudioEngine->getNextPatterns()->add( pPattern );
-	} else {
-		ERRORLOG( "can't set next pattern in song mode" );
-		pAudioEngine->getNextPatterns()->clear();
-	}
-	
-	pAudioEngine->unlock();
+	m_pAudioEngine->setOnlyNextPattern( pos );
 }
 
 void Hydrogen::restartDrivers()
@@ -619,6 +569,10 @@ bool Hydrogen::startExportSession(int sampleRate, int sampleDepth )
 	}
 	m_bExportSessionIsActive = true;
 	
+	// The export renders as fast as possible without dropping
+	// buffers.
+	pAudioEngine->setOfflineMode( true );
+	pAudioEngine->getSampler()->setExportWorkerThreads( Preferences::get_instance()->m_nExportWorkerThreads );
 	pAudioEngine->setAudioDriver( pNewDriver );
 	pAudioEngine->setupLadspaFX();
 
@@ -635,10 +589,104 @@ void Hydrogen::startExportSong( const QString& filename)
 	pAudioEngine->getSampler()->stopPlayingNotes();
 
 	DiskWriterDriver* pDiskWriterDriver = static_cast<DiskWriterDriver*>(pAudioEngine->getAudioDriver());
+	pDiskWriterDriver->clearStems();
 	pDiskWriterDriver->setFileName( filename );
 	pDiskWriterDriver->write();
 }
 
+/** \return Instruments of @a pSong used in at least one pattern.*/
+static std::vector<std::shared_ptr<Instrument>> exportedInstruments( std::shared_ptr<Song> pSong )
+{
+	std::vector<std::shared_ptr<Instrument>> instruments;
+	InstrumentList* pInstrumentList = pSong->getInstrumentList();
+	PatternList* pPatternList = pSong->getPatternList();
+	for ( int ii = 0; ii < pInstrumentList->size(); ++ii ) {
+		auto pInstrument = pInstrumentList->get( ii );
+		for ( int nPattern = 0; nPattern < pPatternList->size(); ++nPattern ) {
+			if ( pPatternList->get( nPattern )->references( pInstrument ) ) {
+				instruments.push_back( pInstrument );
+				break;
+			}
+		}
+	}
+	return instruments;
+}
+
+QStringList Hydrogen::getStemFilenames( const QString& sFilename, bool bComponents ) const
+{
+	std::shared_ptr<Song> pSong = getSong();
+
+	QString sBase = sFilename;
+	QString sExtension;
+	const int nDot = sFilename.lastIndexOf( '.' );
+	if ( nDot > sFilename.lastIndexOf( '/' ) ) {
+		sBase = sFilename.left( nDot );
+		sExtension = sFilename.mid( nDot );
+	}
+
+	QStringList filenames;
+	InstrumentList* pInstrumentList = pSong->getInstrumentList();
+	for ( const auto& pInstrument : exportedInstruments( pSong ) ) {
+		// Instruments sharing a name are told apart by their ID.
+		int nOccurrences = 0;
+		for ( int ii = 0; ii < pInstrumentList->size(); ++ii ) {
+			if ( pInstrumentList->get( ii )->get_name() == pInstrument->get_name() ) {
+				++nOccurrences;
+			}
+		}
+		QString sName = pInstrument->get_name();
+		if ( nOccurrences > 1 ) {
+			sName.append( QString( "_%1" ).arg( pInstrument->get_id() ) );
+		}
+		filenames << sBase + "-" + sName + sExtension;
+	}
+
+	if ( bComponents ) {
+		for ( const auto& pComponent : *pSong->getComponents() ) {
+			filenames << QString( "%1-component-%2_%3%4" ).arg( sBase )
+				.arg( pComponent->get_name() ).arg( pComponent->get_id() ).arg( sExtension );
+		}
+	}
+
+	return filenames;
+}
+
+void Hydrogen::startExportStems( const QString& sFilename, bool bMix,
+								 bool bPostFader, bool bComponents )
+{
+	std::shared_ptr<Song> pSong = getSong();
+	AudioEngine* pAudioEngine = m_pAudioEngine;
+	pAudioEngine->reset();
+	pAudioEngine->play();
+	getCoreActionController()->locateToFrame( 0 );
+	pAudioEngine->getSampler()->stopPlayingNotes();
+
+	// All instruments are rendered within the same pass.
+	InstrumentList* pInstrumentList = pSong->getInstrumentList();
+	for ( int ii = 0; ii < pInstrumentList->size(); ++ii ) {
+		pInstrumentList->get( ii )->set_currently_exported( true );
+	}
+
+	const QStringList filenames = getStemFilenames( sFilename, bComponents );
+	const auto instruments = exportedInstruments( pSong );
+
+	DiskWriterDriver* pDiskWriterDriver = static_cast<DiskWriterDriver*>(pAudioEngine->getAudioDriver());
+	pDiskWriterDriver->clearStems();
+	pDiskWriterDriver->setStemsPostFader( bPostFader );
+	int nFile = 0;
+	for ( const auto& pInstrument : instruments ) {
+		pDiskWriterDriver->addInstrumentStem( pInstrument, filenames[ nFile++ ] );
+	}
+	if ( bComponents ) {
+		for ( const auto& pComponent : *pSong->getComponents() ) {
+			pDiskWriterDriver->addComponentStem( pComponent, filenames[ nFile++ ] );
+		}
+	}
+
+	pDiskWriterDriver->setFileName( bMix ? sFilename : QString() );
+	pDiskWriterDriver->write();
+}
+
 void Hydrogen::stopExportSong()
 {
 	AudioEngine* pAudioEngine = m_pAudioEngine;
@@ -655,6 +703,8 @@ void Hydrogen::stopExportSession()
 	AudioEngine* pAudioEngine = m_pAudioEngine;
 	
  	pAudioEngine->stopAudioDrivers();
+	pAudioEngine->setOfflineMode( false );
+	pAudioEngine->getSampler()->setExportWorkerThreads( 0 );
 	
 	pAudioEngine->startAudioDrivers();
 	if ( pAudioEngine->getAudioDriver() == nullptr ) {
@@ -690,53 +740,66 @@ int Hydrogen::loadDrumkit( Drumkit *pDrumkitInfo )
 
 int Hydrogen::loadDrumkit( Drumkit *pDrumkitInfo, bool conditional )
 {
-	AudioEngine* pAudioEngine = m_pAudioEngine;
 	assert ( pDrumkitInfo );
 
-	AudioEngine::State oldAudioEngineState = pAudioEngine->getState();
-	if( pAudioEngine->getState() == AudioEngine::State::Ready ||
-		pAudioEngine->getState() == AudioEngine::State::Playing ) {
-		pAudioEngine->setState( AudioEngine::State::Prepared );
+	auto pDrumkit = prepareDrumkit( pDrumkitInfo );
+	if ( pDrumkit == nullptr ) {
+		return -1;
 	}
 
+	return commitDrumkit( pDrumkit, conditional, false );
+}
+
+std::shared_ptr<PreparedDrumkit> Hydrogen::prepareDrumkit( Drumkit *pDrumkitInfo )
+{
+	assert ( pDrumkitInfo );
 	INFOLOG( pDrumkitInfo->get_name() );
-	m_sCurrentDrumkitName = pDrumkitInfo->get_name();
-	if ( pDrumkitInfo->isUserDrumkit() ) {
-		m_currentDrumkitLookup = Filesystem::Lookup::user;
-	} else {
-		m_currentDrumkitLookup = Filesystem::Lookup::system;
+
+	// Decoding all samples does neither touch the song nor the audio
+	// engine. The current kit can still be played meanwhile and is
+	// kept in case the loading gets cancelled.
+	SampleLoader sampleLoader;
+	{
+		std::lock_guard<std::mutex> lock( m_drumkitSampleLoaderMutex );
+		m_drumkitSampleLoaders.insert( &sampleLoader );
+	}
+	auto pDrumkit = PreparedDrumkit::load( pDrumkitInfo, &sampleLoader );
+	{
+		std::lock_guard<std::mutex> lock( m_drumkitSampleLoaderMutex );
+		m_drumkitSampleLoaders.erase( &sampleLoader );
 	}
 
-	std::vector<DrumkitComponent*>* pSongCompoList= getSong()->getComponents();
-	std::vector<DrumkitComponent*>* pDrumkitCompoList = pDrumkitInfo->get_components();
-	
-	pAudioEngine->lock( RIGHT_HERE );	
-	for( auto &pComponent : *pSongCompoList ){
-		delete pComponent;
+	if ( pDrumkit == nullptr ) {
+		WARNINGLOG( QString( "Loading of drumkit [%1] cancelled" ).arg( pDrumkitInfo->get_name() ) );
 	}
-	pSongCompoList->clear();
-	pAudioEngine->unlock();
-	
-	for (std::vector<DrumkitComponent*>::iterator it = pDrumkitCompoList->begin() ; it != pDrumkitCompoList->end(); ++it) {
-		DrumkitComponent* pSrcComponent = *it;
-		DrumkitComponent* pNewComponent = new DrumkitComponent( pSrcComponent->get_id(), pSrcComponent->get_name() );
-		pNewComponent->load_from( pSrcComponent );
+	return pDrumkit;
+}
+
+int Hydrogen::commitDrumkit( std::shared_ptr<PreparedDrumkit> pDrumkit, bool conditional,
+							 bool bAtNextPattern )
+{
+	assert ( pDrumkit );
+	AudioEngine* pAudioEngine = m_pAudioEngine;
+	std::shared_ptr<Song> pSong = getSong();
 
-		pSongCompoList->push_back( pNewComponent );
+	// Only a single kit may be pending within the audio engine.
+	std::lock_guard<std::mutex> commitLock( m_drumkitCommitMutex );
+	if ( pDrumkit->isSwappedIn() ) {
+		ERRORLOG( QString( "Drumkit [%1] was already committed" ).arg( pDrumkit->getName() ) );
+		return -1;
 	}
 
+	INFOLOG( pDrumkit->getName() );
+
 	//current instrument list
-	InstrumentList *pSongInstrList = getSong()->getInstrumentList();
-	
-	//new instrument list
-	InstrumentList *pDrumkitInstrList = pDrumkitInfo->get_instruments();
+	InstrumentList *pSongInstrList = pSong->getInstrumentList();
 	
 	/*
 	 * If the old drumkit is bigger then the new drumkit,
 	 * delete all instruments with a bigger pos then
-	 * pDrumkitInstrList->size(). Otherwise the instruments
+	 * pDrumkit->getInstrumentCount(). Otherwise the instruments
 	 * from our old instrumentlist with
-	 * pos > pDrumkitInstrList->size() stay in the
+	 * pos > pDrumkit->getInstrumentCount() stay in the
 	 * new instrumentlist
 	 *
 	 * wolke: info!
@@ -753,44 +816,65 @@ int Hydrogen::loadDrumkit( Drumkit *pDrumkitInfo, bool conditional )
 	 */
 	
 	//needed for the new delete function
-	int instrumentDiff =  pSongInstrList->size() - pDrumkitInstrList->size();
+	int instrumentDiff =  pSongInstrList->size() - pDrumkit->getInstrumentCount();
 	int nMaxID = -1;
-	
-	for ( unsigned nInstr = 0; nInstr < pDrumkitInstrList->size(); ++nInstr ) {
+
+	pAudioEngine->lock( RIGHT_HERE );
+	for ( int nInstr = 0; nInstr < pDrumkit->getInstrumentCount(); ++nInstr ) {
 		std::shared_ptr<Instrument> pInstr = nullptr;
+		int nID = EMPTY_INSTR_ID;
 		if ( nInstr < pSongInstrList->size() ) {
 			//instrument exists already
 			pInstr = pSongInstrList->get( nInstr );
 			assert( pInstr );
+			nID = pInstr->get_id();
 		} else {
-			pInstr = std::make_shared<Instrument>();
-			// The instrument isn't playing yet; no need for locking
-			// :-) - Jakob Lund.  m_pAudioEngine->lock(
-			// "Hydrogen::loadDrumkit" );
+			// Instruments the song is lacking are added right
+			// away. No notes refer to them yet.
+			pInstr = pDrumkit->getInstrument( nInstr );
 			pSongInstrList->add( pInstr );
-			// m_pAudioEngine->unlock();
 		}
 
-		auto pNewInstr = pDrumkitInstrList->get( nInstr );
-		assert( pNewInstr );
-		INFOLOG( QString( "Loading instrument (%1 of %2) [%3]" )
-				 .arg( nInstr + 1 )
-				 .arg( pDrumkitInstrList->size() )
-				 .arg( pNewInstr->get_name() ) );
-
 		// Preserve instrument IDs. Where the new drumkit has more instruments than the song does, new
 		// instruments need new ids.
-		int nID = pInstr->get_id();
 		if ( nID == EMPTY_INSTR_ID ) {
 			nID = nMaxID + 1;
 		}
 		nMaxID = std::max( nID, nMaxID );
-
-		// Moved code from here right into the Instrument class - Jakob Lund.
-		pInstr->load_from( pDrumkitInfo, pNewInstr );
 		pInstr->set_id( nID );
 	}
 
+	if ( bAtNextPattern && pAudioEngine->getState() == AudioEngine::State::Playing ) {
+		pAudioEngine->setPendingDrumkit( pDrumkit.get() );
+		pAudioEngine->unlock();
+
+		while ( ! pDrumkit->isSwappedIn() ) {
+			std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+			if ( pAudioEngine->getState() != AudioEngine::State::Playing ) {
+				// The transport was stopped before reaching the next
+				// pattern.
+				pAudioEngine->lock( RIGHT_HERE );
+				if ( pAudioEngine->takePendingDrumkit() != nullptr ) {
+					pDrumkit->swapIn( pSong );
+				}
+				pAudioEngine->unlock();
+			}
+		}
+	} else {
+		// All samples are already decoded. The whole kit is swapped
+		// in at once so the audio engine does never play a mix of the
+		// old and the new one.
+		pDrumkit->swapIn( pSong );
+		pAudioEngine->unlock();
+	}
+
+	m_sCurrentDrumkitName = pDrumkit->getName();
+	if ( pDrumkit->isUserDrumkit() ) {
+		m_currentDrumkitLookup = Filesystem::Lookup::user;
+	} else {
+		m_currentDrumkitLookup = Filesystem::Lookup::system;
+	}
+
 	//wolke: new delete function
 	if ( instrumentDiff >= 0 ) {
 		for ( int i = 0; i < instrumentDiff ; i++ ){
@@ -808,8 +892,6 @@ int Hydrogen::loadDrumkit( Drumkit *pDrumkitInfo, bool conditional )
 #endif
 
 	setIsModified( true );
-
-	pAudioEngine->setState( oldAudioEngineState );
 	
 	m_pCoreActionController->initExternalControlInterfaces();
 	
@@ -824,6 +906,14 @@ int Hydrogen::loadDrumkit( Drumkit *pDrumkitInfo, bool conditional )
 	return 0;	//ok
 }
 
+void Hydrogen::cancelDrumkitLoading()
+{
+	std::lock_guard<std::mutex> lock( m_drumkitSampleLoaderMutex );
+	for ( auto& pSampleLoader : m_drumkitSampleLoaders ) {
+		pSampleLoader->cancel();
+	}
+}
+
 // This will check if an instrument has any notes
 bool Hydrogen::instrumentHasNotes( std::shared_ptr<Instrument> pInst )
 {
@@ -870,16 +960,21 @@ void Hydrogen::removeInstrument( int instrumentNumber, bool conditional )
 
 	InstrumentList* pList = pSong->getInstrumentList();
 	if ( pList->size()==1 ){
+		// Keeps the layers and their samples alive till the
+		// AudioEngine is unlocked again.
+		std::vector<std::shared_ptr<InstrumentLayer>> removedLayers;
 		m_pAudioEngine->lock( RIGHT_HERE );
 		auto pInstr = pList->get( 0 );
 		pInstr->set_name( (QString( "Instrument 1" )) );
 		for ( auto& pCompo : *pInstr->get_components() ) {
 			// remove all layers
 			for ( int nLayer = 0; nLayer < InstrumentComponent::getMaxLayers(); nLayer++ ) {
+				removedLayers.push_back( pCompo->get_layer( nLayer ) );
 				pCompo->set_layer( nullptr, nLayer );
 			}
 		}
 		m_pAudioEngine->unlock();
+		removedLayers.clear();
 		EventQueue::get_instance()->push_event( EVENT_SELECTED_INSTRUMENT_CHANGED, -1 );
 		INFOLOG("clear last instrument to empty instrument 1 instead delete the last instrument");
 		return;
@@ -1449,9 +1544,11 @@ void Hydrogen::recalculateRubberband( float fBpm ) {
 							auto pLayer = pInstrumentComponent->get_layer( nnLayer );
 							if ( pLayer != nullptr ) {
 								auto pSample = pLayer->get_sample();
-								if ( pSample != nullptr ) {
+								// Samples not loaded yet pick up the new
+								// tempo once they are.
+								if ( pSample != nullptr && ! pSample->is_empty() ) {
 									if( pSample->get_rubberband().use ) {
-										auto pNewSample = Sample::load(
+										auto pNewSample = SamplePool::load(
 																	   pSample->get_filepath(),
 																	   pSample->get_loops(),
 																	   pSample->get_rubberband(),
@@ -38,6 +38,9 @@
 #include <stdint.h> // for uint32_t et al
 #include <cassert>
 #include <memory>
+#include <mutex>
+#include <set>
+#include <QStringList>
 
 inline int randomValue( int max );
 
@@ -45,6 +48,8 @@ namespace H2Core
 {
 	class CoreActionController;
 	class AudioEngine;
+	class PreparedDrumkit;
+	class SampleLoader;
 ///
 /// Hydrogen Audio Engine.
 ///
@@ -122,11 +127,12 @@ public:
 	 * Adding and removing a Pattern from
 	 * #H2Core::AudioEngine::m_pNextPatterns.
 	 *
-	 * After locking the AudioEngine the function retrieves the
+	 * The request is passed to the audio thread via
+	 * AudioEngine::toggleNextPattern(), which retrieves the
 	 * particular pattern @a pos from the Song::m_pPatternList and
 	 * either deletes it from #H2Core::AudioEngine::m_pNextPatterns if
 	 * already present or add it to the same pattern list if not
-	 * present yet.
+	 * present yet. The caller must not hold the AudioEngine lock.
 	 *
 	 * If the Song is not in Song::PATTERN_MODE or @a pos is not
 	 * within the range of Song::m_pPatternList,
@@ -142,7 +148,8 @@ public:
 	 * Clear #H2Core::AudioEngine::m_pNextPatterns and add one
 	 * Pattern.
 	 *
-	 * After locking the AudioEngine the function clears
+	 * Within the audio thread (see
+	 * AudioEngine::setOnlyNextPattern()) the function clears
 	 * #H2Core::AudioEngine::m_pNextPatterns, fills it with all
 	 * currently played one in
 	 * #H2Core::AudioEngine::m_pPlayingPatterns, and appends the
@@ -229,11 +236,54 @@ public:
 		 * \param conditional Argument passed on as second input
 		 *   argument to removeInstrument().
 		 *
+		 * Shorthand for prepareDrumkit() followed by
+		 * commitDrumkit() swapping in the kit right away.
+		 *
 		 * \returns 0 In case something unexpected happens, it will be
-		 *   indicated with #ERRORLOG messages.
+		 *   indicated with #ERRORLOG messages. -1 if the loading was
+		 *   aborted using cancelDrumkitLoading().
 		 */
 
 		int			loadDrumkit( Drumkit *pDrumkitInfo, bool conditional );
+		/**
+		 * Decodes all samples of \a pDrumkitInfo in parallel and
+		 * assembles its components and instruments without
+		 * touching the current Song or the AudioEngine.
+		 *
+		 * Intended to load the next kit ahead of time, e.g. in a
+		 * background thread while the current one is still played.
+		 *
+		 * \returns nullptr if the loading was aborted using
+		 *   cancelDrumkitLoading().
+		 */
+		std::shared_ptr<PreparedDrumkit> prepareDrumkit( Drumkit *pDrumkitInfo );
+		/**
+		 * Swaps a kit obtained by prepareDrumkit() into the current
+		 * Song. Each kit can only be committed once.
+		 *
+		 * The song instruments keep their ids and notes but take over
+		 * the components and parameters of the corresponding kit
+		 * instruments. The previous samples are freed by the
+		 * calling thread after the AudioEngine lock was released.
+		 *
+		 * \param pDrumkit Kit to swap in.
+		 * \param conditional Argument passed on as second input
+		 *   argument to removeInstrument().
+		 * \param bAtNextPattern If set and the transport is rolling,
+		 *   the audio thread swaps in the kit at the beginning of the
+		 *   next pattern. The call blocks till then.
+		 *
+		 * \returns 0 on success and -1 if @a pDrumkit was already
+		 *   committed.
+		 */
+		int			commitDrumkit( std::shared_ptr<PreparedDrumkit> pDrumkit,
+								   bool conditional, bool bAtNextPattern );
+		/** Aborts decoding the samples of all drumkits currently
+		 * loaded by prepareDrumkit() in other threads. The current
+		 * drumkit of the song is kept in that case.
+		 *
+		 * May be called from any thread.*/
+		void			cancelDrumkitLoading();
 
 		/** Test if an Instrument has some Note in the Pattern (used to
 		    test before deleting an Instrument)*/
@@ -383,6 +433,26 @@ void			previewSample( Sample *pSample );
 	bool			startExportSession( int rate, int depth );
 	void			stopExportSession();
 	void			startExportSong( const QString& filename );
+	/**
+	 * Renders the song once and writes the signal of each instrument
+	 * holding notes - and optionally the output of each
+	 * DrumkitComponent - to a separate file. The files are named as
+	 * returned by getStemFilenames().
+	 *
+	 * Has to be called within an export session.
+	 *
+	 * \param sFilename Main mix. It determines the format of all
+	 * files.
+	 * \param bMix Whether the main mix is written as well.
+	 * \param bPostFader See DiskWriterDriver::setStemsPostFader().
+	 * \param bComponents Whether component stems are written.
+	 */
+	void			startExportStems( const QString& sFilename, bool bMix,
+									  bool bPostFader, bool bComponents );
+	/** \return Files written by startExportStems() besides the main
+	 * mix @a sFilename. Instrument stems come first in the order of
+	 * the instrument list.*/
+	QStringList		getStemFilenames( const QString& sFilename, bool bComponents ) const;
 	void			stopExportSong();
 	
 	CoreActionController* 	getCoreActionController() const;
@@ -555,6 +625,12 @@ private:
 	/** Whether the current Drumkit is located at user or system
 		level.*/
 	Filesystem::Lookup	m_currentDrumkitLookup;
+	/** Loaders decoding samples within prepareDrumkit(). Guarded
+		by #m_drumkitSampleLoaderMutex.*/
+	std::set<SampleLoader*>	m_drumkitSampleLoaders;
+	std::mutex		m_drumkitSampleLoaderMutex;
+	/** Serializes commitDrumkit().*/
+	std::mutex		m_drumkitCommitMutex;
 	
 	/// Deleting instruments too soon leads to potential crashes.
 	std::list<std::shared_ptr<Instrument>> 	__instrument_death_row; 
@@ -0,0 +1,172 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#include <core/IO/AudioFileWriter.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+namespace H2Core
+{
+
+AudioFileWriter::AudioFileWriter( SNDFILE* pFile, int nBlockFrames, int nBlocks,
+								  int nDitherBits )
+	: m_pFile( pFile )
+	, m_fDitherScale( 0 )
+	, m_nDitherSeed( 1 )
+	, m_nWriteBlock( 0 )
+	, m_nReadBlock( 0 )
+	, m_nFilledBlocks( 0 )
+	, m_bFinish( false )
+	, m_bError( false )
+{
+	m_blocks.resize( std::max( nBlocks, 1 ) );
+	for ( auto& block : m_blocks ) {
+		block.data_L.resize( nBlockFrames );
+		block.data_R.resize( nBlockFrames );
+		block.nFrames = 0;
+	}
+	m_interleaved.resize( nBlockFrames * m_blocks.size() * 2 );
+
+	// Same scaling libsndfile uses to convert floats into integers.
+	if ( nDitherBits >= 8 && nDitherBits <= 24 ) {
+		m_fDitherScale = ( 1 << ( nDitherBits - 1 ) ) - 1;
+	}
+
+	m_writerThread = std::thread( &AudioFileWriter::writerLoop, this );
+}
+
+AudioFileWriter::~AudioFileWriter()
+{
+	finish();
+}
+
+void AudioFileWriter::write( const float* pData_L, const float* pData_R, int nFrames )
+{
+	{
+		std::unique_lock<std::mutex> lock( m_mutex );
+		m_blockWritten.wait( lock, [&]() {
+			return m_nFilledBlocks < static_cast<int>( m_blocks.size() );
+		} );
+	}
+
+	// Blocks not filled yet are not accessed by the writer thread.
+	Block& block = m_blocks[ m_nWriteBlock ];
+	assert( nFrames <= static_cast<int>( block.data_L.size() ) );
+	memcpy( block.data_L.data(), pData_L, nFrames * sizeof( float ) );
+	memcpy( block.data_R.data(), pData_R, nFrames * sizeof( float ) );
+	block.nFrames = nFrames;
+	m_nWriteBlock = ( m_nWriteBlock + 1 ) % m_blocks.size();
+
+	std::lock_guard<std::mutex> lock( m_mutex );
+	++m_nFilledBlocks;
+	m_blockFilled.notify_one();
+}
+
+bool AudioFileWriter::finish()
+{
+	if ( m_writerThread.joinable() ) {
+		{
+			std::lock_guard<std::mutex> lock( m_mutex );
+			m_bFinish = true;
+			m_blockFilled.notify_one();
+		}
+		m_writerThread.join();
+	}
+	return ! m_bError;
+}
+
+void AudioFileWriter::writerLoop()
+{
+	while ( true ) {
+		int nBlocks;
+		{
+			std::unique_lock<std::mutex> lock( m_mutex );
+			m_blockFilled.wait( lock, [&]() {
+				return m_nFilledBlocks > 0 || m_bFinish;
+			} );
+			if ( m_nFilledBlocks == 0 ) {
+				break;
+			}
+			nBlocks = m_nFilledBlocks;
+		}
+
+		// All pending blocks are collected into a single chunk.
+		int nFrames = 0;
+		for ( int ii = 0; ii < nBlocks; ++ii ) {
+			const Block& block = m_blocks[ m_nReadBlock ];
+			interleave( block, m_interleaved.data() + nFrames * 2 );
+			nFrames += block.nFrames;
+			m_nReadBlock = ( m_nReadBlock + 1 ) % m_blocks.size();
+		}
+
+		// The blocks can be refilled while the chunk is encoded.
+		{
+			std::lock_guard<std::mutex> lock( m_mutex );
+			m_nFilledBlocks -= nBlocks;
+			m_blockWritten.notify_one();
+		}
+
+		if ( m_fDitherScale > 0 ) {
+			dither( m_interleaved.data(), nFrames * 2 );
+		}
+		if ( sf_writef_float( m_pFile, m_interleaved.data(), nFrames ) != nFrames ) {
+			ERRORLOG( QString( "Error during sf_writef_float: %1" ).arg( sf_strerror( m_pFile ) ) );
+			m_bError = true;
+		}
+	}
+}
+
+void AudioFileWriter::interleave( const Block& block, float* pDest )
+{
+	const float* pData_L = block.data_L.data();
+	const float* pData_R = block.data_R.data();
+	for ( int ii = 0; ii < block.nFrames; ++ii ) {
+		pDest[ ii * 2 ] = std::min( std::max( pData_L[ ii ], -1.0f ), 1.0f );
+		pDest[ ii * 2 + 1 ] = std::min( std::max( pData_R[ ii ], -1.0f ), 1.0f );
+	}
+}
+
+void AudioFileWriter::dither( float* pData, int nSamples )
+{
+	const float fScale = m_fDitherScale;
+	const float fNoiseScale = 1.0f / 16777216.0f;
+	uint32_t nSeed = m_nDitherSeed;
+	for ( int ii = 0; ii < nSamples; ++ii ) {
+		// The difference of two uniformly distributed values yields
+		// triangular noise of +/- 1 LSB.
+		nSeed = nSeed * 1664525u + 1013904223u;
+		const float fNoise1 = ( nSeed >> 8 ) * fNoiseScale;
+		nSeed = nSeed * 1664525u + 1013904223u;
+		const float fNoise2 = ( nSeed >> 8 ) * fNoiseScale;
+
+		float fValue = std::rint( pData[ ii ] * fScale + fNoise1 - fNoise2 );
+		fValue = std::min( std::max( fValue, -fScale ), fScale );
+		// Multiples of 1 / fScale are converted back by libsndfile
+		// without any further rounding.
+		pData[ ii ] = fValue / fScale;
+	}
+	m_nDitherSeed = nSeed;
+}
+
+};
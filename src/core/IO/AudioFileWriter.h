@@ -0,0 +1,122 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#ifndef H2C_AUDIO_FILE_WRITER_H
+#define H2C_AUDIO_FILE_WRITER_H
+
+#include <sndfile.h>
+
+#include <core/Object.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace H2Core
+{
+
+/**
+ * Writes stereo audio to a file on a dedicated thread.
+ *
+ * The rendered frames are copied into one of a fixed number of
+ * blocks by write() and interleaved, clipped, and encoded by the
+ * writer thread. This way rendering and encoding overlap. write()
+ * only blocks in case all blocks are still waiting to be written.
+ *
+ * The writer thread hands all blocks pending at once to libsndfile
+ * in a single call. Compressing encoders, like FLAC and Vorbis,
+ * work on larger chunks this way and falling behind the render
+ * thread results in fewer but larger writes.
+ *
+ * \ingroup docCore docAudioDriver
+ */
+class AudioFileWriter : public H2Core::Object<AudioFileWriter>
+{
+	H2_OBJECT(AudioFileWriter)
+public:
+	/**
+	 * \param pFile Stereo file opened for writing. It is not closed
+	 * by the writer.
+	 * \param nBlockFrames Maximum number of frames passed to a
+	 * single write() call.
+	 * \param nBlocks Number of blocks which can be pending at once.
+	 * \param nDitherBits If not 0, the frames are quantized to this
+	 * bit depth using triangular (TPDF) dither before being passed
+	 * to libsndfile, which then converts them losslessly. Has to
+	 * match the integer sample format of @a pFile.
+	 */
+	AudioFileWriter( SNDFILE* pFile, int nBlockFrames, int nBlocks = 16,
+					 int nDitherBits = 0 );
+	/** Calls finish().*/
+	~AudioFileWriter();
+
+	/** Queues @a nFrames frames of both channels for writing.*/
+	void write( const float* pData_L, const float* pData_R, int nFrames );
+	/**
+	 * Waits till all queued frames are written and stops the writer
+	 * thread. write() must not be called afterwards.
+	 *
+	 * \return false if writing any of the frames failed.
+	 */
+	bool finish();
+
+private:
+	struct Block {
+		std::vector<float> data_L;
+		std::vector<float> data_R;
+		int nFrames;
+	};
+
+	void writerLoop();
+	/** Interleaves and clips @a block into @a pDest.*/
+	void interleave( const Block& block, float* pDest );
+	/** Quantizes @a nSamples interleaved samples in place.*/
+	void dither( float* pData, int nSamples );
+
+	SNDFILE* m_pFile;
+	std::vector<Block> m_blocks;
+	/** Interleaved frames of all blocks being written at once.*/
+	std::vector<float> m_interleaved;
+	/** Largest value of the target bit depth or 0 if no dither is
+	 * applied.*/
+	float m_fDitherScale;
+	/** State of the noise generator used for dithering.*/
+	uint32_t m_nDitherSeed;
+
+	/** Next block to be filled by write().*/
+	int m_nWriteBlock;
+	/** Next block to be written to #m_pFile.*/
+	int m_nReadBlock;
+	/** Number of blocks filled but not written yet.*/
+	int m_nFilledBlocks;
+	bool m_bFinish;
+	bool m_bError;
+	std::mutex m_mutex;
+	std::condition_variable m_blockFilled;
+	std::condition_variable m_blockWritten;
+	std::thread m_writerThread;
+};
+
+};
+
+#endif // H2C_AUDIO_FILE_WRITER_H
@@ -27,12 +27,17 @@
 #include <core/EventQueue.h>
 #include <core/CoreActionController.h>
 #include <core/Hydrogen.h>
+#include <core/Basics/DrumkitComponent.h>
+#include <core/Basics/Instrument.h>
 #include <core/Basics/Pattern.h>
 #include <core/Basics/PatternList.h>
 #include <core/IO/DiskWriterDriver.h>
+#include <core/IO/AudioFileWriter.h>
 
 #include <pthread.h>
+#include <algorithm>
 #include <cassert>
+#include <cstring>
 
 #if defined(WIN32) || _DOXYGEN_
 #include <windows.h>
@@ -51,6 +56,44 @@ namespace H2Core
 
 pthread_t diskWriterDriverThread;
 
+/** Applies the encoder settings of @a pDriver to the freshly opened
+ * @a pFile and creates the writer feeding it.*/
+static AudioFileWriter* createWriter( DiskWriterDriver* pDriver, SNDFILE* pFile, const SF_INFO& info )
+{
+	const int nFormat = info.format & SF_FORMAT_TYPEMASK;
+	if ( ( nFormat == SF_FORMAT_FLAC || nFormat == SF_FORMAT_OGG ) &&
+		 pDriver->m_fCompressionLevel >= 0 ) {
+		// Has to be set before the first frame is written.
+		double fLevel = std::min( pDriver->m_fCompressionLevel, 1.0f );
+		if ( sf_command( pFile, SFC_SET_COMPRESSION_LEVEL, &fLevel, sizeof( double ) ) != SF_TRUE ) {
+			___WARNINGLOG( QString( "Unable to set compression level: %1" ).arg( sf_strerror( pFile ) ) );
+		}
+	}
+
+	int nDitherBits = 0;
+	if ( pDriver->m_bDither ) {
+		switch ( info.format & SF_FORMAT_SUBMASK ) {
+		case SF_FORMAT_PCM_S8:
+		case SF_FORMAT_PCM_U8:
+			nDitherBits = 8;
+			break;
+		case SF_FORMAT_PCM_16:
+			nDitherBits = 16;
+			break;
+		case SF_FORMAT_PCM_24:
+			nDitherBits = 24;
+			break;
+		default:
+			break;
+		}
+	}
+
+	// Enough blocks to cover about a second of audio keep the
+	// render thread going while a larger chunk is encoded.
+	const int nBlocks = std::max( static_cast<int>( pDriver->m_nSampleRate / std::max( pDriver->m_nBufferSize, 1u ) ), 16 );
+	return new AudioFileWriter( pFile, pDriver->m_nBufferSize, nBlocks, nDitherBits );
+}
+
 void* diskWriterDriver_thread( void* param )
 {
 	Base * __object = ( Base * )param;
@@ -64,6 +107,15 @@ void* diskWriterDriver_thread( void* param )
 
 	// always rolling, no user interaction
 	pAudioEngine->play();
+
+	// The format is derived from the extension of the main file. All
+	// stems share it. In case only stems are exported, the first one
+	// is used instead.
+	QString sFormatFilename = pDriver->m_sFilename;
+	if ( sFormatFilename.isEmpty() && pDriver->hasStems() ) {
+		sFormatFilename = pDriver->m_stems[ 0 ].sFilename;
+	}
+
 	SF_INFO soundInfo;
 	soundInfo.samplerate = pDriver->m_nSampleRate;
 //	soundInfo.frames = -1;//getNFrames();		///\todo: da terminare
@@ -72,16 +124,16 @@ void* diskWriterDriver_thread( void* param )
 	int sfformat = 0x010000; //wav format (default)
 	int bits = 0x0002; //16 bit PCM (default)
 	//sf_format switch
-	if( pDriver->m_sFilename.endsWith(".aiff") || pDriver->m_sFilename.endsWith(".AIFF") ){
+	if( sFormatFilename.endsWith(".aiff") || sFormatFilename.endsWith(".AIFF") ){
 		sfformat =  0x020000; //Apple/SGI AIFF format (big endian)
 	}
-	if( pDriver->m_sFilename.endsWith(".flac") || pDriver->m_sFilename.endsWith(".FLAC") ){
+	if( sFormatFilename.endsWith(".flac") || sFormatFilename.endsWith(".FLAC") ){
 		sfformat =  0x170000; //FLAC lossless file format
 	}
-	if( ( pDriver->m_nSampleDepth == 8 ) && ( pDriver->m_sFilename.endsWith(".aiff") || pDriver->m_sFilename.endsWith(".AIFF") ) ){
+	if( ( pDriver->m_nSampleDepth == 8 ) && ( sFormatFilename.endsWith(".aiff") || sFormatFilename.endsWith(".AIFF") ) ){
 		bits = 0x0001; //Signed 8 bit data works with aiff
 	}
-	if( ( pDriver->m_nSampleDepth == 8 ) && ( pDriver->m_sFilename.endsWith(".wav") || pDriver->m_sFilename.endsWith(".WAV") ) ){
+	if( ( pDriver->m_nSampleDepth == 8 ) && ( sFormatFilename.endsWith(".wav") || sFormatFilename.endsWith(".WAV") ) ){
 		bits = 0x0005; //Unsigned 8 bit data needed for Microsoft WAV format
 	}
 	if( pDriver->m_nSampleDepth == 16 ){
@@ -99,7 +151,7 @@ void* diskWriterDriver_thread( void* param )
 //	#ifdef HAVE_OGGVORBIS
 
 	//ogg vorbis option
-	if( pDriver->m_sFilename.endsWith( ".ogg" ) | pDriver->m_sFilename.endsWith( ".OGG" ) ) {
+	if( sFormatFilename.endsWith( ".ogg" ) | sFormatFilename.endsWith( ".OGG" ) ) {
 		soundInfo.format = SF_FORMAT_OGG | SF_FORMAT_VORBIS;
 	}
 //	#endif
@@ -138,13 +190,40 @@ void* diskWriterDriver_thread( void* param )
 
 	if ( !sf_format_check( &soundInfo ) ) {
 		__ERRORLOG( "Error in soundInfo" );
+		// Nothing will be written. Don't keep the caller waiting.
+		EventQueue::get_instance()->push_event( EVENT_PROGRESS, 100 );
 		return nullptr;
 	}
 
 
-	SNDFILE* m_file = sf_open( pDriver->m_sFilename.toLocal8Bit(), SFM_WRITE, &soundInfo );
+	// Interleaving and encoding the rendered frames is done by a
+	// separate thread for each file while the next buffers are
+	// rendered.
+	SNDFILE* m_file = nullptr;
+	AudioFileWriter* pWriter = nullptr;
+	if ( ! pDriver->m_sFilename.isEmpty() ) {
+		m_file = sf_open( pDriver->m_sFilename.toLocal8Bit(), SFM_WRITE, &soundInfo );
+		if ( m_file != nullptr ) {
+			pWriter = createWriter( pDriver, m_file, soundInfo );
+		} else {
+			__ERRORLOG( QString( "Unable to open [%1]: %2" )
+						.arg( pDriver->m_sFilename ).arg( sf_strerror( nullptr ) ) );
+		}
+	}
 
-	float *pData = new float[ pDriver->m_nBufferSize * 2 ];	// always stereo
+	std::vector<SNDFILE*> stemFiles( pDriver->m_stems.size(), nullptr );
+	std::vector<AudioFileWriter*> stemWriters( pDriver->m_stems.size(), nullptr );
+	for ( int ii = 0; ii < pDriver->m_stems.size(); ++ii ) {
+		const QString& sStemFilename = pDriver->m_stems[ ii ].sFilename;
+		SF_INFO stemInfo = soundInfo;
+		stemFiles[ ii ] = sf_open( sStemFilename.toLocal8Bit(), SFM_WRITE, &stemInfo );
+		if ( stemFiles[ ii ] != nullptr ) {
+			stemWriters[ ii ] = createWriter( pDriver, stemFiles[ ii ], stemInfo );
+		} else {
+			__ERRORLOG( QString( "Unable to open [%1]: %2" )
+						.arg( sStemFilename ).arg( sf_strerror( nullptr ) ) );
+		}
+	}
 
 	float *pData_L = pDriver->m_pOut_L;
 	float *pData_R = pDriver->m_pOut_R;
@@ -192,46 +271,56 @@ void* diskWriterDriver_thread( void* param )
 			
 			//pDriver->m_transport.m_nFrames = frameNumber;
 			
+			// In offline mode the audio engine waits for its lock
+			// instead of dropping the buffer.
 			int ret = pDriver->m_processCallback( usedBuffer, nullptr );
-			while( ret != 0) {
-				ret = pDriver->m_processCallback( usedBuffer, nullptr );
+			if ( ret != 0 ) {
+				__ERRORLOG( QString( "Unexpected return value of process callback: %1" ).arg( ret ) );
 			}
-			
-			for ( unsigned i = 0; i < usedBuffer; i++ ) {
-				if(pData_L[i] > 1){
-					pData[i * 2] = 1;
-				}
-				else if(pData_L[i] < -1){
-					pData[i * 2] = -1;
-				}else
-				{
-					pData[i * 2] = pData_L[i];
-				}
-				
-				if(pData_R[i] > 1){
-					pData[i * 2 + 1] = 1;
+
+			if ( pWriter != nullptr ) {
+				pWriter->write( pData_L, pData_R, usedBuffer );
+			}
+			for ( int ii = 0; ii < stemWriters.size(); ++ii ) {
+				if ( stemWriters[ ii ] == nullptr ) {
+					continue;
 				}
-				else if(pData_R[i] < -1){
-					pData[i * 2 + 1] = -1;
-				}else
-				{
-					pData[i * 2 + 1] = pData_R[i];
+				const auto& stem = pDriver->m_stems[ ii ];
+				if ( stem.pComponent != nullptr ) {
+					stemWriters[ ii ]->write( stem.pComponent->get_out_buffer_L(),
+											  stem.pComponent->get_out_buffer_R(), usedBuffer );
+				} else {
+					stemWriters[ ii ]->write( stem.pOut_L, stem.pOut_R, usedBuffer );
 				}
 			}
-			int res = sf_writef_float( m_file, pData, usedBuffer );
-			if ( res != ( int )usedBuffer ) {
-				__ERRORLOG( "Error during sf_write_float" );
-			}
 		}
 		
 		// this progress bar method is not exact but ok enough to give users a usable visible progress feedback
 		float fPercent = ( float )(patternPosition +1) / ( float )nColumns * 100.0;
-		EventQueue::get_instance()->push_event( EVENT_PROGRESS, ( int )fPercent );
+		// Completion is reported only after the file was closed.
+		if ( fPercent < 100 ) {
+			EventQueue::get_instance()->push_event( EVENT_PROGRESS, ( int )fPercent );
+		}
 	}
-	delete[] pData;
-	pData = nullptr;
 
-	sf_close( m_file );
+	if ( pWriter != nullptr ) {
+		if ( ! pWriter->finish() ) {
+			__ERRORLOG( QString( "Error while writing [%1]" ).arg( pDriver->m_sFilename ) );
+		}
+		delete pWriter;
+		sf_close( m_file );
+	}
+	for ( int ii = 0; ii < stemWriters.size(); ++ii ) {
+		if ( stemWriters[ ii ] == nullptr ) {
+			continue;
+		}
+		if ( ! stemWriters[ ii ]->finish() ) {
+			__ERRORLOG( QString( "Error while writing [%1]" ).arg( pDriver->m_stems[ ii ].sFilename ) );
+		}
+		delete stemWriters[ ii ];
+		sf_close( stemFiles[ ii ] );
+	}
+	EventQueue::get_instance()->push_event( EVENT_PROGRESS, 100 );
 
 	__INFOLOG( "DiskWriterDriver thread end" );
 
@@ -245,15 +334,19 @@ DiskWriterDriver::DiskWriterDriver( audioProcessCallback processCallback, unsign
 		: AudioOutput()
 		, m_nSampleRate( nSamplerate )
 		, m_nSampleDepth ( nSampleDepth )
+		, m_fCompressionLevel( Preferences::get_instance()->m_fExportCompressionLevel )
+		, m_bDither( Preferences::get_instance()->m_bExportDither )
 		, m_processCallback( processCallback )
 		, m_nBufferSize( 0 )
 		, m_pOut_L( nullptr )
-		, m_pOut_R( nullptr ) {
+		, m_pOut_R( nullptr )
+		, m_bStemsPostFader( true ) {
 }
 
 
 
 DiskWriterDriver::~DiskWriterDriver() {
+	clearStems();
 }
 
 
@@ -289,6 +382,8 @@ void DiskWriterDriver::write()
 void DiskWriterDriver::disconnect()
 {
 	INFOLOG( "" );
+	clearStems();
+
 	delete[] m_pOut_L;
 	m_pOut_L = nullptr;
 
@@ -301,4 +396,73 @@ unsigned DiskWriterDriver::getSampleRate()
 {
 	return m_nSampleRate;
 }
+
+void DiskWriterDriver::addInstrumentStem( std::shared_ptr<Instrument> pInstrument, const QString& sFilename )
+{
+	if ( m_instrumentStems.find( pInstrument->get_id() ) != m_instrumentStems.end() ) {
+		WARNINGLOG( QString( "Stem of instrument [%1] already added" ).arg( pInstrument->get_name() ) );
+		return;
+	}
+
+	Stem stem;
+	stem.sFilename = sFilename;
+	stem.pInstrument = pInstrument;
+	stem.pComponent = nullptr;
+	stem.pOut_L = new float[ m_nBufferSize ];
+	stem.pOut_R = new float[ m_nBufferSize ];
+	memset( stem.pOut_L, 0, m_nBufferSize * sizeof( float ) );
+	memset( stem.pOut_R, 0, m_nBufferSize * sizeof( float ) );
+
+	m_instrumentStems[ pInstrument->get_id() ] = m_stems.size();
+	m_stems.push_back( stem );
+}
+
+void DiskWriterDriver::addComponentStem( DrumkitComponent* pComponent, const QString& sFilename )
+{
+	Stem stem;
+	stem.sFilename = sFilename;
+	stem.pInstrument = nullptr;
+	stem.pComponent = pComponent;
+	stem.pOut_L = nullptr;
+	stem.pOut_R = nullptr;
+	m_stems.push_back( stem );
+}
+
+void DiskWriterDriver::clearStems()
+{
+	for ( auto& stem : m_stems ) {
+		delete[] stem.pOut_L;
+		delete[] stem.pOut_R;
+	}
+	m_stems.clear();
+	m_instrumentStems.clear();
+}
+
+float* DiskWriterDriver::getStemOut_L( std::shared_ptr<Instrument> pInstrument )
+{
+	auto it = m_instrumentStems.find( pInstrument->get_id() );
+	if ( it == m_instrumentStems.end() ) {
+		return nullptr;
+	}
+	return m_stems[ it->second ].pOut_L;
+}
+
+float* DiskWriterDriver::getStemOut_R( std::shared_ptr<Instrument> pInstrument )
+{
+	auto it = m_instrumentStems.find( pInstrument->get_id() );
+	if ( it == m_instrumentStems.end() ) {
+		return nullptr;
+	}
+	return m_stems[ it->second ].pOut_R;
+}
+
+void DiskWriterDriver::clearStemBuffers( unsigned nFrames )
+{
+	for ( auto& stem : m_stems ) {
+		if ( stem.pOut_L != nullptr ) {
+			memset( stem.pOut_L, 0, nFrames * sizeof( float ) );
+			memset( stem.pOut_R, 0, nFrames * sizeof( float ) );
+		}
+	}
+}
 };
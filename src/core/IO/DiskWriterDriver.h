@@ -26,6 +26,9 @@
 #include <sndfile.h>
 
 #include <inttypes.h>
+#include <map>
+#include <memory>
+#include <vector>
 
 #include <core/IO/AudioOutput.h>
 #include <core/Object.h>
@@ -33,6 +36,9 @@
 namespace H2Core
 {
 
+class DrumkitComponent;
+class Instrument;
+
 	void* diskWriterDriver_thread( void *param );
 ///
 /// Driver for export audio to disk
@@ -47,6 +53,15 @@ class DiskWriterDriver : public Object<DiskWriterDriver>, public AudioOutput
 		QString					m_sFilename;
 		unsigned				m_nBufferSize;
 		int						m_nSampleDepth;
+		/** Compression level of FLAC and Ogg/Vorbis files, from 0
+		 * (fastest, largest file) to 1 (slowest, smallest file).
+		 * Negative if not set explicitly, in which case the
+		 * default of libsndfile is used. Initialized with
+		 * Preferences::m_fExportCompressionLevel.*/
+		float					m_fCompressionLevel;
+		/** Whether 8, 16, and 24 bit PCM data is dithered.
+		 * Initialized with Preferences::m_bExportDither.*/
+		bool					m_bDither;
 		audioProcessCallback	m_processCallback;
 		float*					m_pOut_L;
 		float*					m_pOut_R;
@@ -78,8 +93,59 @@ class DiskWriterDriver : public Object<DiskWriterDriver>, public AudioOutput
 			m_sFilename = sFilename;
 		}
 
-	private:
+		/**
+		 * Writes the signal of @a pInstrument to @a sFilename while
+		 * rendering the song. All stems and the main mix are
+		 * written during the same pass of the audio engine.
+		 *
+		 * Has to be called after init() and before write().
+		 */
+		void addInstrumentStem( std::shared_ptr<Instrument> pInstrument, const QString& sFilename );
+		/** Writes the output buffers of @a pComponent (see
+		 * DrumkitComponent::get_out_buffer_L()) to @a sFilename
+		 * while rendering the song.*/
+		void addComponentStem( DrumkitComponent* pComponent, const QString& sFilename );
+		/** Removes all stems added since the last call.*/
+		void clearStems();
+		/** Whether the instrument stems contain the signal after
+		 * applying pan, gain, and volume of the instrument and its
+		 * components or only the note velocity and layer gain,
+		 * similar to Preferences::JackTrackOutputMode.*/
+		void setStemsPostFader( bool bPostFader ) {
+			m_bStemsPostFader = bPostFader;
+		}
+		bool getStemsPostFader() const {
+			return m_bStemsPostFader;
+		}
+		bool hasStems() const {
+			return ! m_stems.empty();
+		}
+
+		/** \return Buffer the Sampler mixes @a pInstrument into or
+		 * nullptr in case no stem is written for it.*/
+		float* getStemOut_L( std::shared_ptr<Instrument> pInstrument );
+		float* getStemOut_R( std::shared_ptr<Instrument> pInstrument );
+		/** Zeroes the first @a nFrames frames of all instrument stems.*/
+		void clearStemBuffers( unsigned nFrames );
 
+	private:
+		friend void* diskWriterDriver_thread( void *param );
+
+		struct Stem {
+			QString sFilename;
+			/** Either an instrument stem holding its own buffers or
+			 * a component stem reading the ones of #pComponent.*/
+			std::shared_ptr<Instrument> pInstrument;
+			DrumkitComponent* pComponent;
+			float* pOut_L;
+			float* pOut_R;
+		};
+
+		std::vector<Stem> m_stems;
+		/** Position of the stem of each instrument in #m_stems,
+		 * indexed by its ID.*/
+		std::map<int, int> m_instrumentStems;
+		bool m_bStemsPostFader;
 
 };
 
@@ -95,7 +95,9 @@ float* FakeDriver::getOut_R()
 void FakeDriver::processCallback()
 {
 	while ( m_processCallback( m_nBufferSize, nullptr ) == 0 ) {
-		// process...
+		if ( m_cycleCallback && ! m_cycleCallback() ) {
+			break;
+		}
 	}
 }
 
@@ -24,12 +24,17 @@
 #define FAKE_DRIVER_H
 
 #include <core/IO/AudioOutput.h>
+#include <functional>
 #include <inttypes.h>
 
 namespace H2Core
 {
 /**
  * Fake audio driver. Used only for profiling.
+ *
+ * It has no thread of its own. Instead, AudioEngine::play() renders
+ * buffers by calling processCallback() till the end of the song is
+ * reached or the cycle callback asks to stop.
  */
 /** \ingroup docCore docAudioDriver */
 /** \ingroup docCore docMIDI */
@@ -53,8 +58,16 @@ public:
 
 	void processCallback();
 
+	/** @a callback is invoked after each buffer rendered by
+	 * processCallback(). Returning false stops the rendering. Pass
+	 * nullptr to render till the end of the song again.*/
+	void setCycleCallback( std::function<bool()> callback ) {
+		m_cycleCallback = callback;
+	}
+
 private:
 	audioProcessCallback m_processCallback;
+	std::function<bool()> m_cycleCallback;
 	unsigned m_nBufferSize;
 	float* m_pOut_L;
 	float* m_pOut_R;
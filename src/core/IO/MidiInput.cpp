@@ -372,32 +372,34 @@ void MidiInput::handleNoteOffMessage( const MidiMessage& msg, bool CymbalChoke )
 		fStep = 1;
 	}
 
-	bool use_note_off = Hydrogen::get_instance()->getAudioEngine()->getSampler()->isInstrumentPlaying( pInstr );
-	if(use_note_off){
-		if ( Preferences::get_instance()->__playselectedinstrument ){
-			Hydrogen::get_instance()->getAudioEngine()->getSampler()->midiKeyboardNoteOff( msg.m_nData1 );
-		}
-		else
-		{
-			if ( pInstrList->size() < nInstrument +1 ) {
-				return;
-			}
-			
-			Note *pOffNote = new Note( pInstr,
-										0.0,
-										0.0,
-										0.0,
-										-1,
-										0 );
-			pOffNote->set_note_off( true );
-			Hydrogen::get_instance()->getAudioEngine()->getSampler()->noteOn( pOffNote );
-			delete pOffNote;
-		}
-		
-		if(Preferences::get_instance()->getRecordEvents()) {
-			Hydrogen::get_instance()->getAudioEngine()->getSampler()->setPlayingNotelength( pInstr, notelength * fStep, __noteOnTick );
-		}
+	if ( !Preferences::get_instance()->__playselectedinstrument &&
+		 pInstrList->size() < nInstrument +1 ) {
+		return;
+	}
+
+	// The playing notes of the Sampler must only be accessed by the
+	// audio thread. It checks whether the instrument is still
+	// playing and records the note length while processing the
+	// command.
+	Note *pOffNote = new Note( pInstr,
+								0.0,
+								0.0,
+								0.0,
+								-1,
+								0 );
+	pOffNote->set_note_off( true );
+
+	int nKey = -1;
+	if ( Preferences::get_instance()->__playselectedinstrument ){
+		nKey = msg.m_nData1;
+	}
+
+	long nLength = -1;
+	if(Preferences::get_instance()->getRecordEvents()) {
+		nLength = notelength * fStep;
 	}
+
+	pHydrogen->getAudioEngine()->midiNoteOff( pOffNote, nKey, nLength, __noteOnTick );
 }
 
 
@@ -38,6 +38,8 @@
 #include "core/CoreActionController.h"
 #include "core/EventQueue.h"
 #include "core/Hydrogen.h"
+#include "core/AudioEngine/AudioEngine.h"
+#include "core/AudioEngine/EngineMetrics.h"
 #include "core/Basics/Song.h"
 #include "core/MidiAction.h"
 
@@ -756,6 +758,50 @@ void OscServer::SONG_EDITOR_TOGGLE_GRID_CELL_Handler(lo_arg **argv, int argc) {
 								 static_cast<int>(std::round( argv[1]->f )) );
 }
 
+void OscServer::ENGINE_METRICS_Handler(lo_arg **argv, int argc) {
+
+	auto pAudioEngine = H2Core::Hydrogen::get_instance()->getAudioEngine();
+	const auto snapshot = pAudioEngine->getMetrics().snapshot();
+	OscServer* pOscServer = OscServer::get_instance();
+
+	lo_message counters = lo_message_new();
+	lo_message_add_int64( counters, snapshot.nCycles );
+	lo_message_add_int64( counters, snapshot.nXRuns );
+	lo_message_add_int64( counters, snapshot.nMissedBuffers );
+	lo_message_add_int64( counters, snapshot.nVoicesStolen );
+	lo_message_add_int32( counters, snapshot.nActiveVoices );
+	lo_message_add_int32( counters, snapshot.nMaxActiveVoices );
+	pOscServer->broadcastMessage( "/Hydrogen/ENGINE_METRICS/COUNTERS", counters );
+	lo_message_free( counters );
+
+	for ( int nStage = 0; nStage < H2Core::EngineMetrics::nStages; ++nStage ) {
+		const auto& stage = snapshot.stages[ nStage ];
+		lo_message reply = lo_message_new();
+		lo_message_add_int64( reply, stage.nCount );
+		lo_message_add_float( reply, stage.meanUs() );
+		lo_message_add_float( reply, stage.percentileUs( 50 ) );
+		lo_message_add_float( reply, stage.percentileUs( 99 ) );
+		lo_message_add_float( reply, stage.nMaxNs / 1000.0 );
+
+		QByteArray path = QString( "/Hydrogen/ENGINE_METRICS/STAGE/%1" )
+			.arg( H2Core::EngineMetrics::getStageName( nStage ) ).toLatin1();
+		pOscServer->broadcastMessage( path.data(), reply );
+		lo_message_free( reply );
+	}
+}
+
+void OscServer::ENGINE_METRICS_WRITE_Handler(lo_arg **argv, int argc) {
+
+	auto pAudioEngine = H2Core::Hydrogen::get_instance()->getAudioEngine();
+	pAudioEngine->getMetrics().writeToFile( QString::fromUtf8( &argv[0]->s ) );
+}
+
+void OscServer::ENGINE_METRICS_RESET_Handler(lo_arg **argv, int argc) {
+
+	auto pAudioEngine = H2Core::Hydrogen::get_instance()->getAudioEngine();
+	pAudioEngine->getMetrics().reset();
+}
+
 // -------------------------------------------------------------------
 // Helper functions
 
@@ -1038,6 +1084,12 @@ bool OscServer::init()
 	m_pServerThread->add_method("/Hydrogen/REMOVE_PATTERN", "f", REMOVE_PATTERN_Handler);
 	m_pServerThread->add_method("/Hydrogen/SONG_EDITOR_TOGGLE_GRID_CELL", "ff", SONG_EDITOR_TOGGLE_GRID_CELL_Handler);
 
+	m_pServerThread->add_method("/Hydrogen/ENGINE_METRICS", "", ENGINE_METRICS_Handler);
+	m_pServerThread->add_method("/Hydrogen/ENGINE_METRICS", "f", ENGINE_METRICS_Handler);
+	m_pServerThread->add_method("/Hydrogen/ENGINE_METRICS_WRITE", "s", ENGINE_METRICS_WRITE_Handler);
+	m_pServerThread->add_method("/Hydrogen/ENGINE_METRICS_RESET", "", ENGINE_METRICS_RESET_Handler);
+	m_pServerThread->add_method("/Hydrogen/ENGINE_METRICS_RESET", "f", ENGINE_METRICS_RESET_Handler);
+
 	m_bInitialized = true;
 	
 	return true;
@@ -178,6 +178,7 @@ class OscServer : public H2Core::Object<OscServer>
 		 * - NEW_SONG_Handler()
 		 * - OPEN_SONG_Handler()
 		 * - SAVE_SONG_AS_Handler()
+		 * - ENGINE_METRICS_WRITE_Handler()
 		 *
 		 * The generic_handler() will be registered to match all paths
 		 * and types.
@@ -757,6 +758,38 @@ class OscServer : public H2Core::Object<OscServer>
 		 * \param argc Number of arguments passed by the OSC message.
 		 */
 		static void SONG_EDITOR_TOGGLE_GRID_CELL_Handler(lo_arg **argv, int argc);
+		/**
+		 * Sends the current H2Core::EngineMetrics to all registered
+		 * clients.
+		 *
+		 * The counters are sent to
+		 * \e /Hydrogen/ENGINE_METRICS/COUNTERS as "hhhhii" (cycles,
+		 * xruns, missed buffers, stolen voices, active voices,
+		 * maximum active voices) and each stage to
+		 * \e /Hydrogen/ENGINE_METRICS/STAGE/<name> as "hffff"
+		 * (count, mean, 50th and 99th percentile, and maximum in
+		 * microseconds).
+		 *
+		 * \param argv Unused pointer to a vector of arguments passed
+		 * by the OSC message.
+		 * \param argc Unused number of arguments passed by the OSC
+		 * message.*/
+		static void ENGINE_METRICS_Handler(lo_arg **argv, int argc);
+		/**
+		 * Triggers H2Core::EngineMetrics::writeToFile().
+		 *
+		 * \param argv The "s" field does contain the absolute path.
+		 * \param argc Number of arguments passed by the OSC message.
+		 */
+		static void ENGINE_METRICS_WRITE_Handler(lo_arg **argv, int argc);
+		/**
+		 * Triggers H2Core::EngineMetrics::reset().
+		 *
+		 * \param argv Unused pointer to a vector of arguments passed
+		 * by the OSC message.
+		 * \param argc Unused number of arguments passed by the OSC
+		 * message.*/
+		static void ENGINE_METRICS_RESET_Handler(lo_arg **argv, int argc);
 		/** 
 		 * Catches any incoming messages and display them. 
 		 *
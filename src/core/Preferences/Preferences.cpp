@@ -142,6 +142,18 @@ Preferences::Preferences()
 	m_bUseMetronome = false;
 	m_fMetronomeVolume = 0.5;
 	m_nMaxNotes = 256;
+	m_nMaxNotesPerInstrument = 0;
+	m_nMaxNotesPerMuteGroup = 0;
+	m_voiceStealingPolicy = VoiceAllocator::Policy::oldest;
+	m_nSamplerWorkerThreads = 0;
+	m_nExportWorkerThreads = 0;
+	m_nSampleStreamingPreloadMs = 0;
+	m_bConvertSampleRate = false;
+	m_bUseSampleCache = false;
+	m_nSampleCacheSizeMb = 2048;
+	m_bSelectiveSampleLoading = false;
+	m_fExportCompressionLevel = -1;
+	m_bExportDither = false;
 	m_nBufferSize = 1024;
 	m_nSampleRate = 44100;
 
@@ -317,6 +329,11 @@ void Preferences::loadPreferences( bool bGlobal )
 			m_nLastOpenTab =  LocalFileMng::readXmlInt( rootNode, "lastOpenTab", 0 );
 			m_bUseRelativeFilenamesForPlaylists = LocalFileMng::readXmlBool( rootNode, "useRelativeFilenamesForPlaylists", false );
 			m_bHideKeyboardCursor = LocalFileMng::readXmlBool( rootNode, "hideKeyboardCursorWhenUnused", false );
+			m_bUseSampleCache = LocalFileMng::readXmlBool( rootNode, "useSampleCache", false );
+			m_nSampleCacheSizeMb = LocalFileMng::readXmlInt( rootNode, "sampleCacheSizeMb", 2048, false, false );
+			m_bSelectiveSampleLoading = LocalFileMng::readXmlBool( rootNode, "selectiveSampleLoading", false, false );
+			m_fExportCompressionLevel = LocalFileMng::readXmlFloat( rootNode, "exportCompressionLevel", -1, false, false );
+			m_bExportDither = LocalFileMng::readXmlBool( rootNode, "exportDither", false, false );
 			m_bPatternFollowsSong = LocalFileMng::readXmlBool( rootNode, "patternFollowsSong", false );
 
 			//restore the right m_bsetlash value
@@ -407,6 +424,28 @@ void Preferences::loadPreferences( bool bGlobal )
 				m_bUseMetronome = LocalFileMng::readXmlBool( audioEngineNode, "use_metronome", m_bUseMetronome );
 				m_fMetronomeVolume = LocalFileMng::readXmlFloat( audioEngineNode, "metronome_volume", 0.5f );
 				m_nMaxNotes = LocalFileMng::readXmlInt( audioEngineNode, "maxNotes", m_nMaxNotes );
+				m_nMaxNotesPerInstrument = LocalFileMng::readXmlInt( audioEngineNode, "max_notes_per_instrument", m_nMaxNotesPerInstrument );
+				m_nMaxNotesPerMuteGroup = LocalFileMng::readXmlInt( audioEngineNode, "max_notes_per_mute_group", m_nMaxNotesPerMuteGroup );
+				int nVoiceStealingPolicy = LocalFileMng::readXmlInt( audioEngineNode, "voice_stealing_policy", 0 );
+				switch ( nVoiceStealingPolicy ) {
+				case 0:
+					m_voiceStealingPolicy = VoiceAllocator::Policy::oldest;
+					break;
+				case 1:
+					m_voiceStealingPolicy = VoiceAllocator::Policy::quietest;
+					break;
+				case 2:
+					m_voiceStealingPolicy = VoiceAllocator::Policy::oldestReleased;
+					break;
+				default:
+					WARNINGLOG( QString( "Unknown voice_stealing_policy value [%1]. Using VoiceAllocator::Policy::oldest instead." )
+								.arg( nVoiceStealingPolicy ) );
+					m_voiceStealingPolicy = VoiceAllocator::Policy::oldest;
+				}
+				m_nSamplerWorkerThreads = LocalFileMng::readXmlInt( audioEngineNode, "sampler_worker_threads", m_nSamplerWorkerThreads );
+				m_nExportWorkerThreads = LocalFileMng::readXmlInt( audioEngineNode, "export_worker_threads", m_nExportWorkerThreads );
+				m_nSampleStreamingPreloadMs = LocalFileMng::readXmlInt( audioEngineNode, "sample_streaming_preload_ms", m_nSampleStreamingPreloadMs );
+				m_bConvertSampleRate = LocalFileMng::readXmlBool( audioEngineNode, "convert_sample_rate", m_bConvertSampleRate );
 				m_nBufferSize = LocalFileMng::readXmlInt( audioEngineNode, "buffer_size", m_nBufferSize );
 				m_nSampleRate = LocalFileMng::readXmlInt( audioEngineNode, "samplerate", m_nSampleRate );
 
@@ -830,6 +869,11 @@ void Preferences::savePreferences()
 
 	LocalFileMng::writeXmlString( rootNode, "useRelativeFilenamesForPlaylists", m_bUseRelativeFilenamesForPlaylists ? "true": "false" );
 	LocalFileMng::writeXmlBool( rootNode, "hideKeyboardCursorWhenUnused", m_bHideKeyboardCursor );
+	LocalFileMng::writeXmlBool( rootNode, "useSampleCache", m_bUseSampleCache );
+	LocalFileMng::writeXmlString( rootNode, "sampleCacheSizeMb", QString::number( m_nSampleCacheSizeMb ) );
+	LocalFileMng::writeXmlBool( rootNode, "selectiveSampleLoading", m_bSelectiveSampleLoading );
+	LocalFileMng::writeXmlString( rootNode, "exportCompressionLevel", QString::number( m_fExportCompressionLevel ) );
+	LocalFileMng::writeXmlBool( rootNode, "exportDither", m_bExportDither );
 	LocalFileMng::writeXmlBool( rootNode, "patternFollowsSong", m_bPatternFollowsSong );
 	
 	// instrument input mode
@@ -908,6 +952,13 @@ void Preferences::savePreferences()
 		LocalFileMng::writeXmlString( audioEngineNode, "use_metronome", m_bUseMetronome ? "true": "false" );
 		LocalFileMng::writeXmlString( audioEngineNode, "metronome_volume", QString("%1").arg( m_fMetronomeVolume ) );
 		LocalFileMng::writeXmlString( audioEngineNode, "maxNotes", QString("%1").arg( m_nMaxNotes ) );
+		LocalFileMng::writeXmlString( audioEngineNode, "max_notes_per_instrument", QString("%1").arg( m_nMaxNotesPerInstrument ) );
+		LocalFileMng::writeXmlString( audioEngineNode, "max_notes_per_mute_group", QString("%1").arg( m_nMaxNotesPerMuteGroup ) );
+		LocalFileMng::writeXmlString( audioEngineNode, "voice_stealing_policy", QString("%1").arg( static_cast<int>( m_voiceStealingPolicy ) ) );
+		LocalFileMng::writeXmlString( audioEngineNode, "sampler_worker_threads", QString("%1").arg( m_nSamplerWorkerThreads ) );
+		LocalFileMng::writeXmlString( audioEngineNode, "export_worker_threads", QString("%1").arg( m_nExportWorkerThreads ) );
+		LocalFileMng::writeXmlString( audioEngineNode, "sample_streaming_preload_ms", QString("%1").arg( m_nSampleStreamingPreloadMs ) );
+		LocalFileMng::writeXmlBool( audioEngineNode, "convert_sample_rate", m_bConvertSampleRate );
 		LocalFileMng::writeXmlString( audioEngineNode, "buffer_size", QString("%1").arg( m_nBufferSize ) );
 		LocalFileMng::writeXmlString( audioEngineNode, "samplerate", QString("%1").arg( m_nSampleRate ) );
 
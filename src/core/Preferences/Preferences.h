@@ -32,6 +32,7 @@
 #include <core/MidiAction.h>
 #include <core/Globals.h>
 #include <core/Object.h>
+#include <core/Sampler/VoiceAllocator.h>
 
 #include <QStringList>
 #include <QDomDocument>
@@ -180,13 +181,88 @@ public:
 	 */
 	QString				m_sAudioDriver;
 	/** If set to true, samples of the metronome will be added to
-	 * #H2Core::AudioEngine::m_songNoteQueue and thus played back on a
+	 * #H2Core::AudioEngine::m_pNoteScheduler and thus played back on a
 	 * regular basis.*/
 	bool				m_bUseMetronome;
 	/// Metronome volume FIXME: remove this volume!!
 	float				m_fMetronomeVolume;
 	/// max notes
 	unsigned			m_nMaxNotes;
+	/**
+	 * Maximum number of notes a single instrument may play at the
+	 * same time. 0 - the default - does not limit them.
+	 */
+	int					m_nMaxNotesPerInstrument;
+	/**
+	 * Maximum number of notes the instruments of a single mute
+	 * group may play at the same time. 0 - the default - does not
+	 * limit them.
+	 */
+	int					m_nMaxNotesPerMuteGroup;
+	/** Which notes are faded out first once one of the limits
+	 * above is exceeded.*/
+	VoiceAllocator::Policy	m_voiceStealingPolicy;
+	/**
+	 * Number of helper threads the Sampler distributes the
+	 * rendering of the playing notes onto. 0 - the default -
+	 * renders all of them within the audio thread. Only read when
+	 * the audio engine is created.
+	 */
+	int					m_nSamplerWorkerThreads;
+	/**
+	 * Number of helper threads rendering the voices of different
+	 * instruments in parallel during exports in case
+	 * #m_nSamplerWorkerThreads is 0. Since the instruments are
+	 * written to separate stems, those are rendered in parallel as
+	 * well. 0 - the default - renders everything within the thread
+	 * of the DiskWriterDriver.
+	 */
+	int					m_nExportWorkerThreads;
+	/**
+	 * Length in milliseconds of the part of long drumkit samples
+	 * kept in memory. The remainder is streamed from disk by the
+	 * SampleStreamer while the sample is played back. 0 - the
+	 * default - loads all samples completely. Only read when the
+	 * audio engine is created.
+	 */
+	int					m_nSampleStreamingPreloadMs;
+	/**
+	 * Whether samples whose sample rate differs from the one of the
+	 * audio driver are converted by the SampleConverter once they
+	 * are played for the first time. Notes played without pitch
+	 * shift do not have to be resampled afterwards. Only read when
+	 * the audio engine is created.
+	 */
+	bool				m_bConvertSampleRate;
+	/**
+	 * Whether decoded and transformed samples of instruments are
+	 * stored in and mapped from the SampleCache.
+	 */
+	bool				m_bUseSampleCache;
+	/**
+	 * Maximum size of the SampleCache in megabytes. The least
+	 * recently used entries are removed once it is exceeded. 0
+	 * disables the limit.
+	 */
+	int					m_nSampleCacheSizeMb;
+	/**
+	 * Whether songs only load the layers their patterns can select
+	 * (see SampleUsage). All other layers are loaded by the
+	 * LazySampleLoader once they are played.
+	 */
+	bool				m_bSelectiveSampleLoading;
+	/**
+	 * Compression level used when exporting FLAC and Ogg/Vorbis
+	 * files, ranging from 0 (fast, large files) to 1 (slow, small
+	 * files). Negative values leave the default of libsndfile in
+	 * place.
+	 */
+	float				m_fExportCompressionLevel;
+	/**
+	 * Whether exports to 8, 16, or 24 bit PCM files are dithered
+	 * instead of being rounded to the target bit depth.
+	 */
+	bool				m_bExportDither;
 	/** 
 	 * Buffer size of the audio.
 	 *
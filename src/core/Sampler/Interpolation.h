@@ -118,6 +118,170 @@ namespace Interpolation
 			return( a0 * mu * mu2 + a1 * mu2 + a2 * mu + a3 );
 	};
 
+	/**
+	 * Compile-time dispatch of the interpolation functions above.
+	 *
+	 * All modes share the four-point signature so the rendering kernels
+	 * can be instantiated once per #InterpolateMode instead of
+	 * branching on the mode for every single frame.
+	 */
+	template <InterpolateMode mode>
+	inline float interpolate( float y0, float y1, float y2, float y3, double mu );
+
+	template <>
+	inline float interpolate<InterpolateMode::Linear>( float y0, float y1, float y2, float y3, double mu )
+	{
+			return y1 * ( 1 - mu ) + y2 * mu;
+	};
+
+	template <>
+	inline float interpolate<InterpolateMode::Cosine>( float y0, float y1, float y2, float y3, double mu )
+	{
+			return cosine_Interpolate( y1, y2, mu );
+	};
+
+	template <>
+	inline float interpolate<InterpolateMode::Third>( float y0, float y1, float y2, float y3, double mu )
+	{
+			return third_Interpolate( y0, y1, y2, y3, mu );
+	};
+
+	template <>
+	inline float interpolate<InterpolateMode::Cubic>( float y0, float y1, float y2, float y3, double mu )
+	{
+			return cubic_Interpolate( y0, y1, y2, y3, mu );
+	};
+
+	template <>
+	inline float interpolate<InterpolateMode::Hermite>( float y0, float y1, float y2, float y3, double mu )
+	{
+			return hermite_Interpolate( y0, y1, y2, y3, mu );
+	};
+
+	/** Frame @a nPos of @a pData or 0 if it lies outside of the sample. */
+	inline float frameOrZero( const float* pData, int nSampleFrames, int nPos )
+	{
+			return ( nPos >= 0 && nPos < nSampleFrames ) ? pData[ nPos ] : 0.0f;
+	};
+
+	/**
+	 * Resample a single channel of a sample.
+	 *
+	 * Writes @a nFrames frames to @a pOut, the k-th of them being the
+	 * interpolated value of @a pData at position @a fSamplePos + k *
+	 * @a fStep. Frames outside of the sample are treated as silence.
+	 *
+	 * The output range is split into three regions: a prologue and an
+	 * epilogue in which one of the four frames required by the
+	 * interpolation might lie outside of the sample and which are
+	 * therefore bounds checked, and a body in between accessing
+	 * @a pData without any checks. The sample position is computed
+	 * from the frame index rather than accumulated, so the body has
+	 * no loop-carried dependency and can be vectorised by the
+	 * compiler.
+	 *
+	 * \param pData Channel data of the sample.
+	 * \param nSampleFrames Number of frames in @a pData.
+	 * \param fSamplePos Position in @a pData of the first output frame.
+	 * \param fStep Increment of the sample position per output frame
+	 *   (has to be positive).
+	 * \param pOut Output buffer able to hold @a nFrames values.
+	 * \param nFrames Number of frames to render.
+	 */
+	template <InterpolateMode mode>
+	inline void resample( const float* pData, int nSampleFrames, double fSamplePos,
+						  double fStep, float* pOut, int nFrames )
+	{
+			int nFrame = 0;
+
+			// Prologue: the frame preceding the sample position is
+			// still in front of the sample.
+			for ( ; nFrame < nFrames; ++nFrame ) {
+				double fPos = fSamplePos + nFrame * fStep;
+				if ( fPos >= 1.0 ) {
+					break;
+				}
+				int nPos = static_cast<int>( fPos );
+				pOut[ nFrame ] = interpolate<mode>( frameOrZero( pData, nSampleFrames, nPos - 1 ),
+													 frameOrZero( pData, nSampleFrames, nPos ),
+													 frameOrZero( pData, nSampleFrames, nPos + 1 ),
+													 frameOrZero( pData, nSampleFrames, nPos + 2 ),
+													 fPos - nPos );
+			}
+
+			// All four frames are available as long as
+			// floor( fPos ) + 2 < nSampleFrames, which is equivalent to
+			// fPos < nSampleFrames - 2.
+			const double fLimit = static_cast<double>( nSampleFrames - 2 );
+			int nBodyEnd = nFrame;
+			if ( fStep > 0 && fSamplePos + nFrame * fStep < fLimit ) {
+				double fBodyFrames = std::ceil( ( fLimit - fSamplePos ) / fStep );
+				nBodyEnd = fBodyFrames < static_cast<double>( nFrames ) ?
+					static_cast<int>( fBodyFrames ) : nFrames;
+				if ( nBodyEnd < nFrame ) {
+					nBodyEnd = nFrame;
+				}
+				// Correct for rounding errors in the division above.
+				while ( nBodyEnd > nFrame && fSamplePos + ( nBodyEnd - 1 ) * fStep >= fLimit ) {
+					--nBodyEnd;
+				}
+				while ( nBodyEnd < nFrames && fSamplePos + nBodyEnd * fStep < fLimit ) {
+					++nBodyEnd;
+				}
+			}
+
+			// Body: no bounds checks required.
+			for ( ; nFrame < nBodyEnd; ++nFrame ) {
+				double fPos = fSamplePos + nFrame * fStep;
+				int nPos = static_cast<int>( fPos );
+				pOut[ nFrame ] = interpolate<mode>( pData[ nPos - 1 ], pData[ nPos ],
+													 pData[ nPos + 1 ], pData[ nPos + 2 ],
+													 fPos - nPos );
+			}
+
+			// Epilogue: approaching and running past the end of the
+			// sample.
+			for ( ; nFrame < nFrames; ++nFrame ) {
+				double fPos = fSamplePos + nFrame * fStep;
+				int nPos = static_cast<int>( fPos );
+				if ( nPos - 1 >= nSampleFrames ) {
+					pOut[ nFrame ] = 0.0f;
+					continue;
+				}
+				pOut[ nFrame ] = interpolate<mode>( frameOrZero( pData, nSampleFrames, nPos - 1 ),
+													 frameOrZero( pData, nSampleFrames, nPos ),
+													 frameOrZero( pData, nSampleFrames, nPos + 1 ),
+													 frameOrZero( pData, nSampleFrames, nPos + 2 ),
+													 fPos - nPos );
+			}
+	};
+
+	/**
+	 * Runtime entry point of resample() selecting the kernel
+	 * instantiated for @a mode.
+	 */
+	inline void resample( InterpolateMode mode, const float* pData, int nSampleFrames,
+						  double fSamplePos, double fStep, float* pOut, int nFrames )
+	{
+			switch ( mode ) {
+			case InterpolateMode::Linear:
+				resample<InterpolateMode::Linear>( pData, nSampleFrames, fSamplePos, fStep, pOut, nFrames );
+				break;
+			case InterpolateMode::Cosine:
+				resample<InterpolateMode::Cosine>( pData, nSampleFrames, fSamplePos, fStep, pOut, nFrames );
+				break;
+			case InterpolateMode::Third:
+				resample<InterpolateMode::Third>( pData, nSampleFrames, fSamplePos, fStep, pOut, nFrames );
+				break;
+			case InterpolateMode::Cubic:
+				resample<InterpolateMode::Cubic>( pData, nSampleFrames, fSamplePos, fStep, pOut, nFrames );
+				break;
+			case InterpolateMode::Hermite:
+				resample<InterpolateMode::Hermite>( pData, nSampleFrames, fSamplePos, fStep, pOut, nFrames );
+				break;
+			}
+	};
+
 };
 
 }
@@ -0,0 +1,115 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#include <core/Sampler/LazySampleLoader.h>
+#include <core/AudioEngine/AudioEngine.h>
+#include <core/AudioEngine/EngineContext.h>
+#include <core/Basics/InstrumentLayer.h>
+#include <core/Basics/Sample.h>
+#include <core/Helpers/SamplePool.h>
+
+namespace H2Core
+{
+
+LazySampleLoader::LazySampleLoader()
+	: m_requests( nMaxRequests )
+	, m_bOfflineMode( false )
+{
+	m_worker.start( [this]() { workerLoop(); } );
+}
+
+LazySampleLoader::~LazySampleLoader()
+{
+	m_worker.stop();
+
+	// Release the layers of pending requests.
+	Request request;
+	while ( m_requests.pop( &request ) ) {
+	}
+}
+
+std::shared_ptr<Sample> LazySampleLoader::load( const std::shared_ptr<InstrumentLayer>& pLayer,
+												 float fBpm, const EngineContext& context )
+{
+	auto pSample = pLayer->get_sample();
+	if ( pSample == nullptr || ! pSample->is_empty() ) {
+		return pSample;
+	}
+
+	// Samples which could not be loaded are not requested again.
+	if ( ! pSample->request_load() ) {
+		return nullptr;
+	}
+
+	if ( m_bOfflineMode.load( std::memory_order_relaxed ) ) {
+		// Rendering is not bound to real time.
+		auto pLoaded = SamplePool::load( pSample, fBpm );
+		if ( pLoaded != nullptr ) {
+			pLayer->set_sample( pLoaded );
+		}
+		return pLoaded;
+	}
+
+	Request request = { pLayer, pSample, fBpm, context.pAudioEngine };
+	if ( ! m_requests.push( request ) ) {
+		// Allow for another attempt later on.
+		pSample->withdraw_load_request();
+		return nullptr;
+	}
+
+	m_worker.wakeUp();
+	return nullptr;
+}
+
+void LazySampleLoader::workerLoop()
+{
+	while ( ! m_worker.isQuitting() ) {
+		Request request;
+		if ( ! m_requests.pop( &request ) ) {
+			m_worker.wait();
+			continue;
+		}
+
+		// The empty sample is never modified. Only its file and
+		// transformations are read.
+		auto pLoaded = SamplePool::load( request.pSample, request.fBpm );
+		if ( pLoaded == nullptr ) {
+			ERRORLOG( QString( "Unable to load [%1] on demand" )
+					  .arg( request.pSample->get_filepath() ) );
+			continue;
+		}
+
+		if ( ! m_worker.lock( request.pAudioEngine ) ) {
+			break;
+		}
+		// The layer might have been assigned another sample in the
+		// meantime.
+		if ( request.pLayer->get_sample() == request.pSample ) {
+			request.pLayer->set_sample( pLoaded );
+		}
+		request.pAudioEngine->unlock();
+
+		// The empty sample is freed here instead of in the audio
+		// thread.
+	}
+}
+
+};
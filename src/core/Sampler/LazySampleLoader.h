@@ -0,0 +1,109 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#ifndef LAZY_SAMPLE_LOADER_H
+#define LAZY_SAMPLE_LOADER_H
+
+#include <core/Object.h>
+#include <core/Helpers/BackgroundWorker.h>
+#include <core/Helpers/LockFreeQueue.h>
+
+#include <atomic>
+#include <memory>
+
+namespace H2Core
+{
+
+class AudioEngine;
+struct EngineContext;
+class InstrumentLayer;
+class Sample;
+
+/**
+ * Loads layers left unloaded when their song was loaded.
+ *
+ * With Preferences::m_bSelectiveSampleLoading set, songs only load
+ * the layers their patterns can select (see SampleUsage). The
+ * remaining layers hold an empty sample created by
+ * Sample::create_unloaded(). Once such a layer is played
+ * nevertheless, e.g. by MIDI input, load() hands it to a background
+ * thread. The thread loads the sample using SamplePool::load() and
+ * replaces the empty one of the layer. In the meantime the Sampler
+ * plays the closest layer already loaded instead.
+ *
+ * load() neither locks nor allocates in realtime mode and must be
+ * called from the audio thread while holding the lock of the
+ * AudioEngine. The background thread takes the lock for replacing
+ * the sample of the layer only.
+ *
+ * \ingroup docCore docAudioEngine
+ */
+class LazySampleLoader : public H2Core::Object<LazySampleLoader>
+{
+	H2_OBJECT(LazySampleLoader)
+public:
+	/** Maximum number of pending requests.*/
+	static constexpr int nMaxRequests = 1024;
+
+	LazySampleLoader();
+	~LazySampleLoader();
+
+	/**
+	 * Requests the empty sample of @a pLayer to be loaded.
+	 *
+	 * \param pLayer Layer holding a sample created by
+	 * Sample::create_unloaded().
+	 * \param fBpm Tempo transformations of the sample target.
+	 * \param context Context of the current cycle.
+	 *
+	 * \return Loaded sample if it is available right away and
+	 * nullptr if it is loaded in the background.
+	 */
+	std::shared_ptr<Sample> load( const std::shared_ptr<InstrumentLayer>& pLayer,
+								  float fBpm, const EngineContext& context );
+
+	/** In offline mode load() loads samples right away to keep
+	 * the rendered output deterministic. See
+	 * AudioEngine::setOfflineMode().*/
+	void setOfflineMode( bool bOffline ) {
+		m_bOfflineMode = bOffline;
+	}
+
+private:
+	struct Request {
+		std::shared_ptr<InstrumentLayer> pLayer;
+		/** Empty sample of #pLayer at the time of the request.*/
+		std::shared_ptr<Sample> pSample;
+		float fBpm;
+		AudioEngine* pAudioEngine;
+	};
+
+	void workerLoop();
+
+	LockFreeQueue<Request> m_requests;
+
+	std::atomic<bool> m_bOfflineMode;
+	BackgroundWorker m_worker;
+};
+
+};
+
+#endif
@@ -0,0 +1,166 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#include <core/Sampler/RenderPlan.h>
+
+#include <core/Basics/DrumkitComponent.h>
+#include <core/Basics/Instrument.h>
+#include <core/Basics/InstrumentComponent.h>
+#include <core/Basics/InstrumentLayer.h>
+#include <core/Basics/Song.h>
+
+namespace H2Core
+{
+
+RenderPlan::RenderPlan()
+	: m_bCompiled( false )
+	, m_nRevision( 0 )
+	, m_pSong( nullptr )
+	, m_nSongComponents( 0 )
+	, m_bPanCompiled( false )
+	, m_fPan( 0 )
+	, m_nPanLawType( 0 )
+	, m_fPanLawKNorm( 0 )
+	, m_fPan_L( 1 )
+	, m_fPan_R( 1 )
+	, m_nCycle( 0 )
+{
+	m_components.reserve( nReservedComponents );
+}
+
+RenderPlan::~RenderPlan()
+{
+}
+
+bool RenderPlan::isUpToDate( Instrument* pInstr, Song* pSong ) const
+{
+	if ( ! m_bCompiled || m_nRevision != InstrumentComponent::get_revision() ||
+		 m_pSong != pSong || m_nSongComponents != pSong->getComponents()->size() ) {
+		return false;
+	}
+
+	// Components are added and removed by editing the vector
+	// directly.
+	auto pComponents = pInstr->get_components();
+	if ( pComponents->size() != m_components.size() ) {
+		return false;
+	}
+	for ( int ii = 0; ii < m_components.size(); ++ii ) {
+		if ( ( *pComponents )[ ii ] != m_components[ ii ].pComponent ) {
+			return false;
+		}
+	}
+	return true;
+}
+
+void RenderPlan::compile( Instrument* pInstr, Song* pSong, int nMaxLayers )
+{
+	// Retrieved first, so changes done while compiling are picked
+	// up in the next cycle.
+	m_nRevision = InstrumentComponent::get_revision();
+	m_pSong = pSong;
+
+	auto pSongComponents = pSong->getComponents();
+	m_nSongComponents = pSongComponents->size();
+	DrumkitComponent* pFirstCompo = pSongComponents->empty() ? nullptr : pSongComponents->front();
+
+	// Does not allocate as long as the capacity was reserved
+	// beforehand.
+	m_components.resize( pInstr->get_components()->size() );
+	for ( int ii = 0; ii < m_components.size(); ++ii ) {
+		Component& component = m_components[ ii ];
+		component.pComponent = pInstr->get_components()->at( ii );
+		component.nComponentID = component.pComponent->get_drumkit_componentID();
+
+		if ( pInstr->is_preview_instrument() || pInstr->is_metronome_instrument() ) {
+			component.pMainCompo = pFirstCompo;
+		} else if ( component.nComponentID >= 0 ) {
+			component.pMainCompo = pSong->getComponent( component.nComponentID );
+		} else {
+			// Invalid component found. This is possible on loading
+			// older or broken song files.
+			component.pMainCompo = pFirstCompo;
+		}
+
+		component.nMainCompoIndex = -1;
+		for ( int nCompo = 0; nCompo < pSongComponents->size(); ++nCompo ) {
+			if ( pSongComponents->at( nCompo ) == component.pMainCompo ) {
+				component.nMainCompoIndex = nCompo;
+				break;
+			}
+		}
+
+		component.pTrackOut_L = nullptr;
+		component.pTrackOut_R = nullptr;
+
+		compileVelocityLayers( &component, nMaxLayers );
+	}
+
+	m_bCompiled = true;
+}
+
+void RenderPlan::reserve( int nComponents )
+{
+	m_components.reserve( nComponents );
+}
+
+void RenderPlan::compileVelocityLayers( Component* pComponent, int nMaxLayers )
+{
+	for ( int nBucket = 0; nBucket < nVelocityBuckets; ++nBucket ) {
+		const float fLower = static_cast<float>( nBucket ) / nVelocityBuckets;
+		const float fUpper = static_cast<float>( nBucket + 1 ) / nVelocityBuckets;
+
+		// The first layer matching any velocity of the range is the
+		// one Sampler::renderNote() selects. It can only be stored if
+		// it does so for all velocities of the range.
+		int nSelectedLayer = -1;
+		for ( int nLayer = 0; nLayer < nMaxLayers; ++nLayer ) {
+			auto pLayer = pComponent->pComponent->get_layer( nLayer );
+			if ( pLayer == nullptr || pLayer->get_start_velocity() > fUpper ||
+				 pLayer->get_end_velocity() < fLower ) {
+				continue;
+			}
+			if ( pLayer->get_start_velocity() <= fLower && pLayer->get_end_velocity() >= fUpper ) {
+				nSelectedLayer = nLayer;
+			}
+			break;
+		}
+		pComponent->velocityLayers[ nBucket ] = nSelectedLayer;
+	}
+}
+
+bool RenderPlan::isPanUpToDate( float fPan, Song* pSong ) const
+{
+	return m_bPanCompiled && m_fPan == fPan && m_nPanLawType == pSong->getPanLawType() &&
+		m_fPanLawKNorm == pSong->getPanLawKNorm();
+}
+
+void RenderPlan::setPan( float fPan, Song* pSong, float fPan_L, float fPan_R )
+{
+	m_bPanCompiled = true;
+	m_fPan = fPan;
+	m_nPanLawType = pSong->getPanLawType();
+	m_fPanLawKNorm = pSong->getPanLawKNorm();
+	m_fPan_L = fPan_L;
+	m_fPan_R = fPan_R;
+}
+
+};
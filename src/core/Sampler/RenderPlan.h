@@ -0,0 +1,200 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#ifndef RENDER_PLAN_H
+#define RENDER_PLAN_H
+
+#include <core/Object.h>
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+namespace H2Core
+{
+
+class DrumkitComponent;
+class Instrument;
+class InstrumentComponent;
+class Song;
+
+/**
+ * Everything Sampler::renderNote() needs to know about an
+ * Instrument apart from the note itself.
+ *
+ * Resolving the drumkit components, evaluating the pan law, picking
+ * the velocity layer, and looking up the JACK track outputs used to
+ * be done for each note and each cycle. Instead, the plan of an
+ * instrument is compiled the first time one of its notes is
+ * rendered and only recompiled once either the components of the
+ * instrument, the components of the Song, or
+ * InstrumentComponent::get_revision() changed. The latter covers all
+ * edits of layers and component IDs. Pan and track outputs are
+ * checked and refreshed by Sampler::updateRenderPlan() once per
+ * cycle.
+ *
+ * Plans are owned by their Instrument and, like the Sampler itself,
+ * must only be accessed by the audio thread while holding the
+ * AudioEngine lock. They are updated before the voices are rendered,
+ * so the VoiceRenderPool workers only read them. Since compilation
+ * happens within the process cycle, the storage of the components
+ * is reserved up front - see reserve() - and compile() does not
+ * allocate.
+ *
+ * \ingroup docCore docAudioEngine
+ */
+class RenderPlan : public H2Core::Object<RenderPlan>
+{
+	H2_OBJECT(RenderPlan)
+public:
+	/** Number of equally sized velocity ranges of
+	 * Component::velocityLayers. Since it is a power of two, the
+	 * range a velocity belongs to is computed exactly.*/
+	static const int nVelocityBuckets = 128;
+	/** Number of components a plan can hold without allocating
+	 * when constructed.*/
+	static const int nReservedComponents = 16;
+
+	struct Component {
+		std::shared_ptr<InstrumentComponent> pComponent;
+		/** InstrumentComponent::get_drumkit_componentID() of
+		 * #pComponent.*/
+		int nComponentID;
+		/** Component of the Song the voices are mixed into.*/
+		DrumkitComponent* pMainCompo;
+		/** Position of #pMainCompo within Song::getComponents().*/
+		int nMainCompoIndex;
+		/** Layer the #Instrument::VELOCITY algorithm selects for all
+		 * velocities within each range or -1 if it depends on the
+		 * exact velocity.*/
+		int velocityLayers[ nVelocityBuckets ];
+		/** JACK track or stem outputs of the current cycle. nullptr
+		 * if there are none.*/
+		float* pTrackOut_L;
+		float* pTrackOut_R;
+
+		/** \return Layer selected for @a fVelocity by the
+		 * #Instrument::VELOCITY algorithm or -1 if the layers have to
+		 * be searched.*/
+		int getVelocityLayer( float fVelocity ) const;
+	};
+
+	RenderPlan();
+	~RenderPlan();
+
+	/** \return Whether the plan was compiled for @a pInstr in @a
+	 * pSong and neither of them changed since.*/
+	bool isUpToDate( Instrument* pInstr, Song* pSong ) const;
+	/**
+	 * Resolves the components of @a pInstr in @a pSong and fills
+	 * their velocity tables.
+	 *
+	 * \param nMaxLayers Number of layers searched per component.
+	 */
+	void compile( Instrument* pInstr, Song* pSong, int nMaxLayers );
+	/** Ensures compile() does not have to allocate for instruments
+	 * holding up to @a nComponents components. Must not be called
+	 * by the audio thread.*/
+	void reserve( int nComponents );
+
+	/** One entry per component of the instrument in the same
+	 * order.*/
+	const std::vector<Component>& getComponents() const;
+	std::vector<Component>& getComponents();
+
+	/** \return Whether the pan gains were computed for @a fPan and
+	 * the pan law currently used by @a pSong.*/
+	bool isPanUpToDate( float fPan, Song* pSong ) const;
+	/** Stores the gains @a fPan_L and @a fPan_R the pan law of @a
+	 * pSong yields for the instrument pan @a fPan.*/
+	void setPan( float fPan, Song* pSong, float fPan_L, float fPan_R );
+	/** Gains of notes not panned on their own.*/
+	float getPan_L() const;
+	float getPan_R() const;
+
+	/** Cycle of the Sampler the plan was last updated in.*/
+	unsigned getCycle() const;
+	void setCycle( unsigned nCycle );
+
+private:
+	void compileVelocityLayers( Component* pComponent, int nMaxLayers );
+
+	bool m_bCompiled;
+	/** InstrumentComponent::get_revision() at the time of
+	 * compilation.*/
+	unsigned m_nRevision;
+	Song* m_pSong;
+	/** Size of Song::getComponents() at the time of compilation.*/
+	int m_nSongComponents;
+	std::vector<Component> m_components;
+
+	bool m_bPanCompiled;
+	float m_fPan;
+	int m_nPanLawType;
+	float m_fPanLawKNorm;
+	float m_fPan_L;
+	float m_fPan_R;
+
+	unsigned m_nCycle;
+};
+
+inline int RenderPlan::Component::getVelocityLayer( float fVelocity ) const
+{
+	if ( ! ( fVelocity >= 0 && fVelocity <= 1 ) ) {
+		return -1;
+	}
+	return velocityLayers[ std::min( static_cast<int>( fVelocity * nVelocityBuckets ),
+									 nVelocityBuckets - 1 ) ];
+}
+
+inline const std::vector<RenderPlan::Component>& RenderPlan::getComponents() const
+{
+	return m_components;
+}
+
+inline std::vector<RenderPlan::Component>& RenderPlan::getComponents()
+{
+	return m_components;
+}
+
+inline float RenderPlan::getPan_L() const
+{
+	return m_fPan_L;
+}
+
+inline float RenderPlan::getPan_R() const
+{
+	return m_fPan_R;
+}
+
+inline unsigned RenderPlan::getCycle() const
+{
+	return m_nCycle;
+}
+
+inline void RenderPlan::setCycle( unsigned nCycle )
+{
+	m_nCycle = nCycle;
+}
+
+};
+
+#endif
@@ -0,0 +1,122 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#include <core/Sampler/SampleConverter.h>
+#include <core/AudioEngine/AudioEngine.h>
+#include <core/AudioEngine/EngineContext.h>
+#include <core/Basics/Sample.h>
+
+namespace H2Core
+{
+
+SampleConverter::SampleConverter()
+	: m_requests( nMaxRequests )
+	, m_bOfflineMode( false )
+{
+	m_worker.start( [this]() { workerLoop(); } );
+}
+
+SampleConverter::~SampleConverter()
+{
+	m_worker.stop();
+
+	// Release the samples of pending requests.
+	Request request;
+	while ( m_requests.pop( &request ) ) {
+	}
+}
+
+std::shared_ptr<Sample> SampleConverter::getConverted( const std::shared_ptr<Sample>& pSample,
+														const EngineContext& context )
+{
+	const int nSampleRate = static_cast<int>( context.nSampleRate );
+	if ( pSample->get_sample_rate() == nSampleRate || pSample->is_streamed() ||
+		 pSample->is_empty() ) {
+		return nullptr;
+	}
+
+	auto pConverted = pSample->get_converted( nSampleRate );
+	if ( pConverted != nullptr ) {
+		return pConverted;
+	}
+
+	if ( m_bOfflineMode.load( std::memory_order_relaxed ) ) {
+		// Rendering is not bound to real time. A result still
+		// pending in the background is dropped.
+		const unsigned nRequest = pSample->request_conversion( nSampleRate, true );
+		pSample->set_converted( pSample->convert_sample_rate( nSampleRate ), nRequest );
+		return pSample->get_converted( nSampleRate );
+	}
+
+	const unsigned nRequest = pSample->request_conversion( nSampleRate );
+	if ( nRequest == 0 ) {
+		// Still in progress.
+		return nullptr;
+	}
+
+	// Copying the references neither allocates nor copies the data.
+	Request request = { pSample, pSample->get_shared_data(), pSample->get_filepath(),
+						pSample->get_frames(), pSample->get_sample_rate(),
+						nSampleRate, nRequest, context.pAudioEngine };
+	if ( ! m_requests.push( request ) ) {
+		// Allow for another attempt later on.
+		pSample->set_converted( nullptr, nRequest );
+		return nullptr;
+	}
+
+	m_worker.wakeUp();
+	return nullptr;
+}
+
+void SampleConverter::workerLoop()
+{
+	while ( ! m_worker.isQuitting() ) {
+		Request request;
+		if ( ! m_requests.pop( &request ) ) {
+			m_worker.wait();
+			continue;
+		}
+
+		// The request keeps the data alive. Since samples replace
+		// instead of modifying shared data, it can be read without
+		// locking the AudioEngine.
+		auto pConverted = Sample::convert_sample_rate( request.sFilepath, request.pData,
+													   request.nFrames, request.nDataSampleRate,
+													   request.nSampleRate );
+		if ( ! m_worker.lock( request.pAudioEngine ) ) {
+			break;
+		}
+		const bool bStored = request.pSample->set_converted( pConverted, request.nRequest );
+		request.pAudioEngine->unlock();
+
+		if ( ! bStored ) {
+			INFOLOG( QString( "Conversion of [%1] to [%2] Hz dropped" )
+					 .arg( request.sFilepath )
+					 .arg( request.nSampleRate ) );
+		}
+
+		// Samples of removed instruments, outdated conversions, and
+		// replaced data are freed here instead of in the audio
+		// thread.
+	}
+}
+
+};
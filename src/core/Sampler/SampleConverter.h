@@ -0,0 +1,116 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#ifndef SAMPLE_CONVERTER_H
+#define SAMPLE_CONVERTER_H
+
+#include <core/Object.h>
+#include <core/Basics/Sample.h>
+#include <core/Helpers/BackgroundWorker.h>
+#include <core/Helpers/LockFreeQueue.h>
+
+#include <atomic>
+#include <memory>
+
+namespace H2Core
+{
+
+class AudioEngine;
+struct EngineContext;
+
+/**
+ * Converts samples to the sample rate of the audio driver.
+ *
+ * Samples recorded at a different rate than the one the driver runs
+ * at have to be resampled while being played back, even if no pitch
+ * shift is applied. Once a voice asks for such a sample using
+ * getConverted(), a background thread creates a copy at the sample
+ * rate of the driver using Sample::convert_sample_rate() and stores
+ * it alongside the original using Sample::set_converted(). Voices
+ * starting afterwards play back the copy and do not require
+ * resampling anymore unless their pitch is shifted.
+ *
+ * The copy is dropped as soon as the data of the original changes.
+ * A change of the sample rate of the driver causes a new conversion
+ * to be requested.
+ *
+ * getConverted() neither locks nor allocates and must be called from
+ * the audio thread while holding the lock of the AudioEngine. Each
+ * request holds a reference to the data of the original (see
+ * Sample::Data), which stays valid even if the sample is changed or
+ * deleted in the meantime. The background thread thus reads it
+ * without any lock and only locks the AudioEngine to store the
+ * result.
+ *
+ * \ingroup docCore docAudioEngine
+ */
+class SampleConverter : public H2Core::Object<SampleConverter>
+{
+	H2_OBJECT(SampleConverter)
+public:
+	/** Maximum number of pending conversions.*/
+	static constexpr int nMaxRequests = 1024;
+
+	SampleConverter();
+	~SampleConverter();
+
+	/**
+	 * \return Copy of @a pSample at the sample rate of @a context
+	 * or nullptr if it is not available yet. In the latter case the
+	 * conversion is requested and the original has to be used for
+	 * the time being.
+	 */
+	std::shared_ptr<Sample> getConverted( const std::shared_ptr<Sample>& pSample,
+										  const EngineContext& context );
+
+	/** In offline mode getConverted() converts samples right away
+	 * to keep the rendered output deterministic. See
+	 * AudioEngine::setOfflineMode().*/
+	void setOfflineMode( bool bOffline ) {
+		m_bOfflineMode = bOffline;
+	}
+
+private:
+	struct Request {
+		std::shared_ptr<Sample> pSample;
+		/** Data of #pSample at the time of the request.*/
+		std::shared_ptr<const Sample::Data> pData;
+		QString sFilepath;
+		int nFrames;
+		int nDataSampleRate;
+		/** Target sample rate.*/
+		int nSampleRate;
+		/** Obtained from Sample::request_conversion().*/
+		unsigned nRequest;
+		AudioEngine* pAudioEngine;
+	};
+
+	void workerLoop();
+
+	LockFreeQueue<Request> m_requests;
+
+	std::atomic<bool> m_bOfflineMode;
+	BackgroundWorker m_worker;
+};
+
+};
+
+#endif
@@ -0,0 +1,327 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#include <core/Sampler/SampleStreamer.h>
+#include <core/Basics/Sample.h>
+
+#include <algorithm>
+#include <sndfile.h>
+#include <thread>
+
+namespace H2Core
+{
+
+/** Number of frames read from disk at once.*/
+static const int nChunkFrames = 4096;
+
+/** Number of frames at the end of the resident part of a sample
+ * which are read by the stream as well. While a process cycle does
+ * not span more than that, the Sampler can switch from the resident
+ * data to the stream at any point.*/
+static const int nOverlapFrames = SampleStreamer::nStreamFrames / 4;
+
+struct SampleStream {
+	enum class State {
+		/** Available in SampleStreamer::m_freeStreams.*/
+		Free,
+		/** Handed out by open(), waiting for the background
+		 * thread to open the file.*/
+		Opening,
+		Active,
+		/** Handed back by close(), waiting for the background
+		 * thread to close the file.*/
+		Closing
+	};
+
+	std::atomic<State> state;
+	std::shared_ptr<Sample> pSample;
+	/** Total number of frames of #pSample.*/
+	int nFrames;
+	/** First frame of #pSample read into the stream.*/
+	int nStartFrame;
+	/** All frames before this one were read. Written by the
+	 * background thread only.*/
+	std::atomic<int> nWriteFrame;
+	/** All frames before this one were already rendered. Written
+	 * by the Sampler only.*/
+	std::atomic<int> nConsumedFrame;
+	/** Both hold 2 * SampleStreamer::nStreamFrames values. Only
+	 * #data_L is used for mono samples.*/
+	std::vector<float> data_L;
+	std::vector<float> data_R;
+	/** Whether #pSample is mono (see Sample::is_mono()).*/
+	bool bMono;
+
+	SNDFILE* pFile;
+	int nChannels;
+};
+
+std::atomic<int> SampleStreamer::m_nPreloadMs( 0 );
+
+SampleStreamer::SampleStreamer( int nStreams, int nPreloadMs )
+	: m_freeStreams( std::max( nStreams, 1 ) )
+	, m_nUnderruns( 0 )
+	, m_bOfflineMode( false )
+{
+	for ( int ii = 0; ii < nStreams; ++ii ) {
+		auto pStream = new SampleStream;
+		pStream->state.store( SampleStream::State::Free );
+		pStream->nFrames = 0;
+		pStream->nStartFrame = 0;
+		pStream->bMono = false;
+		pStream->nWriteFrame.store( 0 );
+		pStream->nConsumedFrame.store( 0 );
+		pStream->data_L.resize( 2 * nStreamFrames, 0 );
+		pStream->data_R.resize( 2 * nStreamFrames, 0 );
+		pStream->pFile = nullptr;
+		pStream->nChannels = 0;
+
+		m_streams.push_back( pStream );
+		m_freeStreams.push( pStream );
+	}
+	m_readBuffer.resize( nChunkFrames * 2 );
+
+	m_nPreloadMs = std::max( nPreloadMs, 0 );
+	m_worker.start( [this]() { ioLoop(); } );
+
+	INFOLOG( QString( "[%1] streams, [%2] ms preload" ).arg( nStreams ).arg( nPreloadMs ) );
+}
+
+SampleStreamer::~SampleStreamer()
+{
+	m_nPreloadMs = 0;
+
+	m_worker.stop();
+
+	for ( auto pStream : m_streams ) {
+		auto state = pStream->state.load();
+		if ( state == SampleStream::State::Opening || state == SampleStream::State::Active ) {
+			WARNINGLOG( "Stream still in use" );
+		}
+		closeFile( pStream );
+		delete pStream;
+	}
+}
+
+int SampleStreamer::getPreloadMs()
+{
+	return m_nPreloadMs.load();
+}
+
+SampleStream* SampleStreamer::open( std::shared_ptr<Sample> pSample )
+{
+	SampleStream* pStream;
+	if ( pSample == nullptr || ! m_freeStreams.pop( &pStream ) ) {
+		return nullptr;
+	}
+
+	// The previous sample was already released by the background
+	// thread. Assigning the new one does not free anything.
+	pStream->pSample = pSample;
+	pStream->nFrames = pSample->get_frames();
+	pStream->nStartFrame = std::max( pSample->get_resident_frames() - nOverlapFrames, 0 );
+	pStream->bMono = pSample->is_mono();
+	pStream->nWriteFrame.store( pStream->nStartFrame, std::memory_order_relaxed );
+	pStream->nConsumedFrame.store( pStream->nStartFrame, std::memory_order_relaxed );
+	pStream->state.store( SampleStream::State::Opening, std::memory_order_release );
+
+	m_worker.wakeUp();
+	return pStream;
+}
+
+void SampleStreamer::close( SampleStream* pStream )
+{
+	if ( pStream == nullptr ) {
+		return;
+	}
+
+	pStream->state.store( SampleStream::State::Closing, std::memory_order_release );
+	m_worker.wakeUp();
+}
+
+SampleStreamer::Window SampleStreamer::getWindow( SampleStream* pStream,
+												  const std::shared_ptr<Sample>& pSample,
+												  int nStart, int nEnd )
+{
+	Window resident = { pSample->get_data_l(), pSample->get_data_r(),
+						0, pSample->get_resident_frames() };
+	if ( nEnd <= resident.nFrames ) {
+		return resident;
+	}
+
+	if ( pStream == nullptr || nStart < pStream->nStartFrame ) {
+		// Either all streams are busy or the voice started before
+		// the stream was opened.
+		if ( nStart < pSample->get_frames() ) {
+			++m_nUnderruns;
+		}
+		return resident;
+	}
+
+	if ( nStart > pStream->nConsumedFrame.load( std::memory_order_relaxed ) ) {
+		pStream->nConsumedFrame.store( nStart, std::memory_order_release );
+		m_worker.wakeUp();
+	}
+
+	const int nRequired = std::min( nEnd, pStream->nFrames );
+	int nWritten = pStream->nWriteFrame.load( std::memory_order_acquire );
+	if ( nWritten < nRequired && m_bOfflineMode.load( std::memory_order_relaxed ) ) {
+		// The background thread always proceeds, even if the file
+		// can not be read anymore.
+		m_worker.wakeUp();
+		while ( nWritten < nRequired ) {
+			std::this_thread::yield();
+			nWritten = pStream->nWriteFrame.load( std::memory_order_acquire );
+		}
+	}
+	if ( nWritten < nRequired ) {
+		++m_nUnderruns;
+	}
+
+	const int nOffset = nStart % nStreamFrames;
+	const float* pData_R = pStream->bMono ? &pStream->data_L[ nOffset ] : &pStream->data_R[ nOffset ];
+	Window window = { &pStream->data_L[ nOffset ], pData_R,
+					  nStart, std::max( nWritten - nStart, 0 ) };
+	return window;
+}
+
+void SampleStreamer::ioLoop()
+{
+	int nReportedUnderruns = 0;
+
+	while ( ! m_worker.isQuitting() ) {
+		bool bBusy = false;
+
+		for ( auto pStream : m_streams ) {
+			switch ( pStream->state.load( std::memory_order_acquire ) ) {
+			case SampleStream::State::Opening: {
+				openFile( pStream );
+				// In case the stream was closed in the meantime it
+				// will be cleaned up during the next iteration.
+				auto expected = SampleStream::State::Opening;
+				pStream->state.compare_exchange_strong( expected, SampleStream::State::Active );
+				bBusy = true;
+				break;
+			}
+			case SampleStream::State::Active:
+				if ( fill( pStream ) ) {
+					bBusy = true;
+				}
+				break;
+			case SampleStream::State::Closing:
+				closeFile( pStream );
+				pStream->state.store( SampleStream::State::Free, std::memory_order_release );
+				m_freeStreams.push( pStream );
+				break;
+			case SampleStream::State::Free:
+				break;
+			}
+		}
+
+		const int nUnderruns = m_nUnderruns.load();
+		if ( nUnderruns != nReportedUnderruns ) {
+			WARNINGLOG( QString( "Streamed data arrived too late [%1] times. Consider increasing the preload." )
+						.arg( nUnderruns - nReportedUnderruns ) );
+			nReportedUnderruns = nUnderruns;
+		}
+
+		if ( ! bBusy ) {
+			m_worker.wait();
+		}
+	}
+}
+
+void SampleStreamer::openFile( SampleStream* pStream )
+{
+	const QString sPath = pStream->pSample->get_filepath();
+
+	SF_INFO soundInfo = {0};
+	pStream->pFile = sf_open( sPath.toLocal8Bit(), SFM_READ, &soundInfo );
+	if ( pStream->pFile == nullptr ) {
+		ERRORLOG( QString( "Unable to open [%1]" ).arg( sPath ) );
+		return;
+	}
+	pStream->nChannels = soundInfo.channels;
+
+	if ( sf_seek( pStream->pFile, pStream->nStartFrame, SEEK_SET ) < 0 ) {
+		ERRORLOG( QString( "Unable to seek to frame [%1] in [%2]" )
+				  .arg( pStream->nStartFrame ).arg( sPath ) );
+		closeFile( pStream );
+		return;
+	}
+
+	if ( m_readBuffer.size() < static_cast<size_t>( nChunkFrames * pStream->nChannels ) ) {
+		m_readBuffer.resize( nChunkFrames * pStream->nChannels );
+	}
+}
+
+bool SampleStreamer::fill( SampleStream* pStream )
+{
+	const int nWritten = pStream->nWriteFrame.load( std::memory_order_relaxed );
+	const int nLimit = std::min( pStream->nFrames,
+								 pStream->nConsumedFrame.load( std::memory_order_acquire ) + nStreamFrames );
+	if ( nWritten >= nLimit ) {
+		return false;
+	}
+
+	const int nFrames = std::min( nLimit - nWritten, nChunkFrames );
+	int nRead = 0;
+	if ( pStream->pFile != nullptr ) {
+		nRead = static_cast<int>( sf_readf_float( pStream->pFile, m_readBuffer.data(), nFrames ) );
+	}
+
+	// Frames which could not be read - e.g. because the file changed
+	// on disk - are rendered as silence.
+	const int nChannels = pStream->nChannels;
+	const bool bMono = pStream->bMono;
+	for ( int ii = 0; ii < nFrames; ++ii ) {
+		float fVal_L = 0;
+		float fVal_R = 0;
+		if ( ii < nRead ) {
+			fVal_L = m_readBuffer[ ii * nChannels ];
+			fVal_R = nChannels > 1 ? m_readBuffer[ ii * nChannels + 1 ] : fVal_L;
+		}
+
+		const int nIndex = ( nWritten + ii ) % nStreamFrames;
+		pStream->data_L[ nIndex ] = fVal_L;
+		pStream->data_L[ nIndex + nStreamFrames ] = fVal_L;
+		if ( ! bMono ) {
+			pStream->data_R[ nIndex ] = fVal_R;
+			pStream->data_R[ nIndex + nStreamFrames ] = fVal_R;
+		}
+	}
+
+	pStream->nWriteFrame.store( nWritten + nFrames, std::memory_order_release );
+	return true;
+}
+
+void SampleStreamer::closeFile( SampleStream* pStream )
+{
+	if ( pStream->pFile != nullptr ) {
+		sf_close( pStream->pFile );
+		pStream->pFile = nullptr;
+	}
+	// Samples of removed instruments are freed here instead of
+	// within the audio thread.
+	pStream->pSample = nullptr;
+}
+
+};
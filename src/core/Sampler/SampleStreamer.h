@@ -0,0 +1,160 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#ifndef SAMPLE_STREAMER_H
+#define SAMPLE_STREAMER_H
+
+#include <core/Object.h>
+#include <core/Helpers/BackgroundWorker.h>
+#include <core/Helpers/LockFreeQueue.h>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace H2Core
+{
+
+class Sample;
+
+/**
+ * Ring buffer feeding a single voice with the frames of a streamed
+ * sample. Its layout is private to the SampleStreamer.
+ */
+struct SampleStream;
+
+/**
+ * Plays back samples which are only partially held in memory.
+ *
+ * In streaming mode Sample::load() only keeps the first
+ * Preferences::m_nSampleStreamingPreloadMs milliseconds of long
+ * samples in memory. Once a voice using such a sample starts, the
+ * Sampler asks for a stream using open() and a background thread
+ * starts reading the remainder of the file into the stream's ring
+ * buffer right away. The resident part covers the time required to
+ * do so.
+ *
+ * Each ring buffer holds every frame twice, at its position modulo
+ * #nStreamFrames and #nStreamFrames frames later. This way
+ * getWindow() can always provide a contiguous view on the data and
+ * the resampling kernels of the Sampler read through it just like
+ * through the data of a fully loaded sample.
+ *
+ * open(), close(), and getWindow() neither lock nor allocate and
+ * may be called from the audio thread as well as from the
+ * VoiceRenderPool. Files are opened, read, and closed and the
+ * samples of finished streams released by the background thread
+ * only.
+ *
+ * \ingroup docCore docAudioEngine
+ */
+class SampleStreamer : public H2Core::Object<SampleStreamer>
+{
+	H2_OBJECT(SampleStreamer)
+public:
+	/** Frames of a sample the Sampler can read from.*/
+	struct Window {
+		/** Left channel. Index 0 corresponds to frame #nOffset of
+		 * the sample.*/
+		const float* pData_L;
+		/** Right channel. Equals #pData_L for mono samples.*/
+		const float* pData_R;
+		int nOffset;
+		/** Number of valid frames.*/
+		int nFrames;
+	};
+
+	/** Capacity of the ring buffer of each stream in frames.*/
+	static constexpr int nStreamFrames = 1 << 15;
+
+	/**
+	 * \param nStreams Number of voices which can stream at the same
+	 * time.
+	 * \param nPreloadMs Length of the part of each sample kept in
+	 * memory.
+	 */
+	SampleStreamer( int nStreams, int nPreloadMs );
+	~SampleStreamer();
+
+	/** \return Length of the resident part of streamed samples in
+	 * milliseconds or 0 if no SampleStreamer exists and samples
+	 * have to be loaded completely.*/
+	static int getPreloadMs();
+
+	/**
+	 * Starts reading the non-resident part of @a pSample.
+	 *
+	 * \return nullptr if all streams are in use. The voice will
+	 * fall silent after the resident part in that case.
+	 */
+	SampleStream* open( std::shared_ptr<Sample> pSample );
+	/** Hands @a pStream back to the streamer. It must not be used
+	 * afterwards.*/
+	void close( SampleStream* pStream );
+
+	/**
+	 * Provides the data required to render the frames from @a
+	 * nStart up to @a nEnd (exclusive) of @a pSample.
+	 *
+	 * Frames before @a nStart are considered consumed and may be
+	 * overwritten by the background thread. Subsequent calls for
+	 * the same stream thus must not decrease @a nStart.
+	 *
+	 * \param pStream Stream opened for @a pSample or nullptr.
+	 */
+	Window getWindow( SampleStream* pStream, const std::shared_ptr<Sample>& pSample,
+					  int nStart, int nEnd );
+
+	/** In offline mode getWindow() waits for the background thread
+	 * to read the requested frames instead of counting an underrun.
+	 * See AudioEngine::setOfflineMode().*/
+	void setOfflineMode( bool bOffline ) {
+		m_bOfflineMode = bOffline;
+	}
+
+	/** Number of render cycles for which the streamed data did not
+	 * arrive in time.*/
+	int getUnderruns() const {
+		return m_nUnderruns.load();
+	}
+
+private:
+	void ioLoop();
+	void openFile( SampleStream* pStream );
+	/** \return Whether any frames were read.*/
+	bool fill( SampleStream* pStream );
+	void closeFile( SampleStream* pStream );
+
+	std::vector<SampleStream*> m_streams;
+	LockFreeQueue<SampleStream*> m_freeStreams;
+	/** Interleaved frames read from disk.*/
+	std::vector<float> m_readBuffer;
+
+	std::atomic<int> m_nUnderruns;
+	std::atomic<bool> m_bOfflineMode;
+	BackgroundWorker m_worker;
+
+	static std::atomic<int> m_nPreloadMs;
+};
+
+};
+
+#endif
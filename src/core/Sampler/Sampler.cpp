@@ -20,15 +20,19 @@
  *
  */
 
+#include <algorithm>
 #include <cassert>
 #include <cmath>
 #include <cstdlib>
 
 #include <core/IO/AudioOutput.h>
+#include <core/IO/DiskWriterDriver.h>
 #include <core/IO/JackAudioDriver.h>
 
 #include <core/Basics/Adsr.h>
 #include <core/AudioEngine/AudioEngine.h>
+#include <core/AudioEngine/EngineContext.h>
+#include <core/AudioEngine/EngineMetrics.h>
 #include <core/Globals.h>
 #include <core/Hydrogen.h>
 #include <core/Basics/DrumkitComponent.h>
@@ -47,6 +51,12 @@
 
 #include <core/FX/Effects.h>
 #include <core/Sampler/Sampler.h>
+#include <core/Sampler/VoiceAllocator.h>
+#include <core/Sampler/VoiceRenderPool.h>
+#include <core/Sampler/SampleStreamer.h>
+#include <core/Sampler/LazySampleLoader.h>
+#include <core/Sampler/SampleConverter.h>
+#include <core/AudioEngine/NotePool.h>
 
 #include <iostream>
 #include <QDebug>
@@ -66,9 +76,20 @@ static std::shared_ptr<Instrument> createInstrument(int id, const QString& filep
 	return pInstrument;
 }
 
-Sampler::Sampler()
+Sampler::Sampler( NotePool* pNotePool )
 		: m_pMainOut_L( nullptr )
 		, m_pMainOut_R( nullptr )
+		, m_pVoiceAllocator( nullptr )
+		, m_pNotePool( pNotePool )
+		, m_pVoiceRenderPool( nullptr )
+		, m_bExportRenderPool( false )
+		, m_pSampleStreamer( nullptr )
+		, m_pSampleConverter( nullptr )
+		, m_pLazySampleLoader( nullptr )
+		, m_pFilterQueue( nullptr )
+		, m_nVoiceRenderFrames( 0 )
+		, m_pVoiceRenderContext( nullptr )
+		, m_nRenderPlanCycle( 0 )
 		, m_pPreviewInstrument( nullptr )
 		, m_interpolateMode( Interpolation::InterpolateMode::Linear )
 {
@@ -77,6 +98,10 @@ Sampler::Sampler()
 	m_pMainOut_L = new float[ MAX_BUFFER_SIZE ];
 	m_pMainOut_R = new float[ MAX_BUFFER_SIZE ];
 
+	for ( int nFX = 0; nFX < MAX_FX; ++nFX ) {
+		m_pFX[ nFX ] = nullptr;
+	}
+
 	m_nMaxLayers = InstrumentComponent::getMaxLayers();
 
 	QString sEmptySampleFilename = Filesystem::empty_sample_path();
@@ -88,6 +113,31 @@ Sampler::Sampler()
 	// dummy instrument used for playback track
 	m_pPlaybackTrackInstrument = createInstrument( PLAYBACK_INSTR_ID, sEmptySampleFilename, 0.8 );
 	m_nPlayBackSamplePosition = 0;
+
+	auto pPref = Preferences::get_instance();
+
+	// Stolen voices keep playing while they are faded out. The
+	// NotePool does not hand out more than twice the maximum number
+	// of notes either.
+	const int nMaxVoices = 2 * pPref->m_nMaxNotes;
+	m_playingNotesQueue.reserve( nMaxVoices );
+	m_voiceEnded.reserve( nMaxVoices );
+	m_pVoiceAllocator = new VoiceAllocator( nMaxVoices );
+	m_pFilterQueue = new FilterQueue();
+
+	if ( pPref->m_nSamplerWorkerThreads > 0 ) {
+		createVoiceRenderPool( pPref->m_nSamplerWorkerThreads );
+	}
+
+	if ( pPref->m_nSampleStreamingPreloadMs > 0 ) {
+		m_pSampleStreamer = new SampleStreamer( nMaxStreams, pPref->m_nSampleStreamingPreloadMs );
+	}
+
+	if ( pPref->m_bConvertSampleRate ) {
+		m_pSampleConverter = new SampleConverter();
+	}
+
+	m_pLazySampleLoader = new LazySampleLoader();
 }
 
 
@@ -98,8 +148,31 @@ Sampler::~Sampler()
 	delete[] m_pMainOut_L;
 	delete[] m_pMainOut_R;
 
+	deleteVoiceRenderPool();
+	delete m_pFilterQueue;
+
 	m_pPreviewInstrument = nullptr;
 	m_pPlaybackTrackInstrument = nullptr;
+
+	delete m_pVoiceAllocator;
+
+	// All notes have to be stopped at this point.
+	delete m_pSampleStreamer;
+	delete m_pSampleConverter;
+	delete m_pLazySampleLoader;
+}
+
+void Sampler::releaseNote( Note* pNote )
+{
+	if ( m_pSampleStreamer != nullptr ) {
+		for ( auto& [ nComponent, selectedLayer ] : *pNote->get_layers_selected() ) {
+			if ( selectedLayer.pStream != nullptr ) {
+				m_pSampleStreamer->close( selectedLayer.pStream );
+				selectedLayer.pStream = nullptr;
+			}
+		}
+	}
+	m_pNotePool->release( pNote );
 }
 
 /** set default k for pan law with -4.5dB center compensation, given L^k + R^k = const
@@ -107,11 +180,63 @@ Sampler::~Sampler()
  */
 float const Sampler::K_NORM_DEFAULT = 1.33333333333333;
 
-void Sampler::process( uint32_t nFrames, std::shared_ptr<Song> pSong )
+void Sampler::setOfflineMode( bool bOffline )
+{
+	if ( m_pSampleStreamer != nullptr ) {
+		m_pSampleStreamer->setOfflineMode( bOffline );
+	}
+	if ( m_pSampleConverter != nullptr ) {
+		m_pSampleConverter->setOfflineMode( bOffline );
+	}
+	m_pLazySampleLoader->setOfflineMode( bOffline );
+}
+
+void Sampler::setExportWorkerThreads( int nWorkers )
+{
+	if ( m_bExportRenderPool ) {
+		deleteVoiceRenderPool();
+		m_bExportRenderPool = false;
+	}
+	if ( nWorkers > 0 && m_pVoiceRenderPool == nullptr ) {
+		createVoiceRenderPool( nWorkers );
+		m_bExportRenderPool = true;
+	}
+}
+
+void Sampler::createVoiceRenderPool( int nWorkers )
+{
+	// Stolen voices keep playing while they are faded out.
+	const int nMaxVoices = 2 * Preferences::get_instance()->m_nMaxNotes;
+
+	m_pVoiceRenderPool = new VoiceRenderPool( nWorkers );
+
+	// Reserve enough space to not allocate anything in the audio
+	// thread unless the maximum number of notes is increased at
+	// runtime.
+	for ( int ii = 0; ii < m_pVoiceRenderPool->getPartitionCount(); ++ii ) {
+		auto pMix = new VoiceMix();
+		pMix->voices.reserve( nMaxVoices );
+		m_voiceMixes.push_back( pMix );
+	}
+	m_instrumentPartitions.reserve( nMaxVoices );
+}
+
+void Sampler::deleteVoiceRenderPool()
+{
+	// Join the workers before freeing their buffers.
+	delete m_pVoiceRenderPool;
+	m_pVoiceRenderPool = nullptr;
+	for ( auto pMix : m_voiceMixes ) {
+		delete pMix;
+	}
+	m_voiceMixes.clear();
+}
+
+void Sampler::process( uint32_t nFrames, const EngineContext& context )
 {
 	//infoLog( "[process]" );
-	AudioOutput* pAudioOutpout = Hydrogen::get_instance()->getAudioOutput();
-	assert( pAudioOutpout );
+	assert( context.pAudioDriver );
+	Song* pSong = context.pSong;
 
 	memset( m_pMainOut_L, 0, nFrames * sizeof( float ) );
 	memset( m_pMainOut_R, 0, nFrames * sizeof( float ) );
@@ -119,37 +244,43 @@ void Sampler::process( uint32_t nFrames, std::shared_ptr<Song> pSong )
 	// Track output queues are zeroed by
 	// audioEngine_process_clearAudioBuffers()
 
-	// Max notes limit
-	int m_nMaxNotes = Preferences::get_instance()->m_nMaxNotes;
-	while ( ( int )m_playingNotesQueue.size() > m_nMaxNotes ) {
-		Note * pOldNote = m_playingNotesQueue[ 0 ];
-		m_playingNotesQueue.erase( m_playingNotesQueue.begin() );
-		 pOldNote->get_instrument()->dequeue();
-		delete  pOldNote;	// FIXME: send note-off instead of removing the note from the list?
+	// Voice limits. Stolen voices are faded out and end on their own
+	// within the next cycles.
+	const int nStolen = m_pVoiceAllocator->steal( m_playingNotesQueue, context );
+	if ( nStolen > 0 && context.pMetrics != nullptr ) {
+		context.pMetrics->voicesStolen( nStolen );
 	}
 
+	updateRenderPlans( context );
+
+#ifdef H2CORE_HAVE_LADSPA
+	for ( int nFX = 0; nFX < MAX_FX; ++nFX ) {
+		m_pFX[ nFX ] = Effects::get_instance()->getLadspaFX( nFX );
+	}
+#endif
+
 	for ( auto& pComponent : *pSong->getComponents() ) {
 		pComponent->reset_outs(nFrames);
 	}
 
-	// eseguo tutte le note nella lista di note in esecuzione
-	unsigned i = 0;
 	Note* pNote;
-	while ( i < m_playingNotesQueue.size() ) {
-		pNote = m_playingNotesQueue[ i ];		// recupero una nuova nota
-		if ( renderNote( pNote, nFrames, pSong ) ) {	// la nota e' finita
-			m_playingNotesQueue.erase( m_playingNotesQueue.begin() + i );
-			pNote->get_instrument()->dequeue();
-			m_queuedNoteOffs.push_back( pNote );
-		} else {
-			++i; // carico la prox nota
+	if ( m_pVoiceRenderPool != nullptr &&
+		 pSong->getComponents()->size() <= nMaxVoiceMixComponents ) {
+		renderVoicesParallel( nFrames, context );
+	} else {
+		// eseguo tutte le note nella lista di note in esecuzione
+		m_voiceEnded.assign( m_playingNotesQueue.size(), false );
+		for ( int nVoice = 0; nVoice < m_playingNotesQueue.size(); ++nVoice ) {
+			m_voiceEnded[ nVoice ] = renderNote( m_playingNotesQueue[ nVoice ], nFrames, context );
 		}
+		flushFilterQueue( m_pFilterQueue, context );
+		removeEndedVoices();
 	}
 
 	//Queue midi note off messages for notes that have a length specified for them
 	while ( !m_queuedNoteOffs.empty() ) {
 		pNote =  m_queuedNoteOffs[0];
-		MidiOutput* pMidiOut = Hydrogen::get_instance()->getMidiOutput();
+		MidiOutput* pMidiOut = context.pMidiOutput;
 		
 		if( pMidiOut != nullptr && !pNote->get_instrument()->is_muted() ){
 			pMidiOut->handleQueueNoteOff(	pNote->get_instrument()->get_midi_out_channel(), 
@@ -160,13 +291,272 @@ void Sampler::process( uint32_t nFrames, std::shared_ptr<Song> pSong )
 		m_queuedNoteOffs.erase( m_queuedNoteOffs.begin() );
 		
 		if( pNote != nullptr ){
-			delete pNote;
+			releaseNote( pNote );
 		}
 		
 		pNote = nullptr;
 	}//while
 
-	processPlaybackTrack(nFrames);
+	processPlaybackTrack( nFrames, context );
+}
+
+Sampler::VoiceMix::VoiceMix()
+{
+	pMainOut_L = new float[ MAX_BUFFER_SIZE ];
+	pMainOut_R = new float[ MAX_BUFFER_SIZE ];
+	pComponentOuts_L = new float[ nMaxVoiceMixComponents * MAX_BUFFER_SIZE ];
+	pComponentOuts_R = new float[ nMaxVoiceMixComponents * MAX_BUFFER_SIZE ];
+	pFXOuts_L = new float[ MAX_FX * MAX_BUFFER_SIZE ];
+	pFXOuts_R = new float[ MAX_FX * MAX_BUFFER_SIZE ];
+	components.reserve( nMaxVoiceMixComponents );
+	pFilterQueue = new FilterQueue();
+	nFailedVoices = 0;
+	pFailedNote = nullptr;
+	sFailureReason = nullptr;
+}
+
+Sampler::VoiceMix::~VoiceMix()
+{
+	delete[] pMainOut_L;
+	delete[] pMainOut_R;
+	delete[] pComponentOuts_L;
+	delete[] pComponentOuts_R;
+	delete[] pFXOuts_L;
+	delete[] pFXOuts_R;
+	delete pFilterQueue;
+}
+
+void Sampler::VoiceMix::reset( uint32_t nFrames )
+{
+	memset( pMainOut_L, 0, nFrames * sizeof( float ) );
+	memset( pMainOut_R, 0, nFrames * sizeof( float ) );
+	for ( int nComponent = 0; nComponent < components.size(); ++nComponent ) {
+		memset( getComponentOut_L( nComponent ), 0, nFrames * sizeof( float ) );
+		memset( getComponentOut_R( nComponent ), 0, nFrames * sizeof( float ) );
+	}
+	for ( int nFX = 0; nFX < MAX_FX; ++nFX ) {
+		memset( getFXOut_L( nFX ), 0, nFrames * sizeof( float ) );
+		memset( getFXOut_R( nFX ), 0, nFrames * sizeof( float ) );
+	}
+	nFailedVoices = 0;
+	pFailedNote = nullptr;
+	sFailureReason = nullptr;
+}
+
+bool Sampler::isVoiceStarted( Note* pNote ) const
+{
+	auto pInstr = pNote->get_instrument();
+	if ( pInstr == nullptr ) {
+		return false;
+	}
+
+	for ( const auto& pCompo : *pInstr->get_components() ) {
+		if ( pNote->get_specific_compo_id() != -1 &&
+			 pNote->get_specific_compo_id() != pCompo->get_drumkit_componentID() ) {
+			continue;
+		}
+		auto pSelectedLayer = pNote->get_layer_selected( pCompo->get_drumkit_componentID() );
+		if ( pSelectedLayer == nullptr || pSelectedLayer->SelectedLayer == -1 ||
+			 ! pSelectedLayer->isStarted() ) {
+			return false;
+		}
+	}
+	return true;
+}
+
+void Sampler::updateRenderPlans( const EngineContext& context )
+{
+	++m_nRenderPlanCycle;
+	for ( auto pNote : m_playingNotesQueue ) {
+		auto pInstr = pNote->get_instrument();
+		if ( pInstr != nullptr ) {
+			updateRenderPlan( pInstr, context );
+		}
+	}
+}
+
+void Sampler::updateRenderPlan( std::shared_ptr<Instrument> pInstr, const EngineContext& context )
+{
+	RenderPlan* pPlan = pInstr->getRenderPlan();
+	if ( pPlan->getCycle() == m_nRenderPlanCycle ) {
+		return;
+	}
+	pPlan->setCycle( m_nRenderPlanCycle );
+
+	Song* pSong = context.pSong;
+	if ( ! pPlan->isUpToDate( pInstr.get(), pSong ) ) {
+		pPlan->compile( pInstr.get(), pSong, m_nMaxLayers );
+	}
+
+	const float fPan = pInstr->getPan();
+	if ( ! pPlan->isPanUpToDate( fPan, pSong ) ) {
+		const float fPan_L = panLaw( fPan, context.pSong );
+		const float fPan_R = panLaw( -fPan, context.pSong );
+		pPlan->setPan( fPan, pSong, fPan_L, fPan_R );
+	}
+
+	// The port buffers of the JACK track outputs change each
+	// cycle.
+	for ( auto& component : pPlan->getComponents() ) {
+		component.pTrackOut_L = nullptr;
+		component.pTrackOut_R = nullptr;
+#ifdef H2CORE_HAVE_JACK
+		if ( context.pTrackOutDriver != nullptr ) {
+			component.pTrackOut_L = context.pTrackOutDriver->getTrackOut_L( pInstr, component.pComponent );
+			component.pTrackOut_R = context.pTrackOutDriver->getTrackOut_R( pInstr, component.pComponent );
+		}
+#endif
+		if ( context.pStemDriver != nullptr ) {
+			component.pTrackOut_L = context.pStemDriver->getStemOut_L( pInstr );
+			component.pTrackOut_R = context.pStemDriver->getStemOut_R( pInstr );
+		}
+	}
+}
+
+void Sampler::renderVoicesParallel( uint32_t nFrames, const EngineContext& context )
+{
+	Song* pSong = context.pSong;
+
+	// None of the containers below exceed the capacity reserved in
+	// the constructor as long as the maximum number of notes was
+	// not changed in the meantime.
+	m_voiceEnded.assign( m_playingNotesQueue.size(), false );
+	m_instrumentPartitions.clear();
+	for ( auto pMix : m_voiceMixes ) {
+		pMix->voices.clear();
+		pMix->components.clear();
+		for ( auto& pComponent : *pSong->getComponents() ) {
+			pMix->components.push_back( pComponent.get() );
+		}
+	}
+
+	for ( int nVoice = 0; nVoice < m_playingNotesQueue.size(); ++nVoice ) {
+		Note* pNote = m_playingNotesQueue[ nVoice ];
+
+		if ( ! isVoiceStarted( pNote ) ) {
+			m_voiceEnded[ nVoice ] = renderNote( pNote, nFrames, context );
+			continue;
+		}
+
+		// All voices of an instrument end up in the same
+		// partition. New instruments are assigned to the one
+		// holding the fewest voices so far.
+		Instrument* pInstr = pNote->get_instrument().get();
+		int nPartition = -1;
+		for ( const auto& entry : m_instrumentPartitions ) {
+			if ( entry.first == pInstr ) {
+				nPartition = entry.second;
+				break;
+			}
+		}
+		if ( nPartition == -1 ) {
+			nPartition = 0;
+			for ( int ii = 1; ii < m_voiceMixes.size(); ++ii ) {
+				if ( m_voiceMixes[ ii ]->voices.size() <
+					 m_voiceMixes[ nPartition ]->voices.size() ) {
+					nPartition = ii;
+				}
+			}
+			m_instrumentPartitions.push_back( std::make_pair( pInstr, nPartition ) );
+		}
+		m_voiceMixes[ nPartition ]->voices.push_back( nVoice );
+	}
+	// The voices rendered so far might share their instruments with
+	// the ones of the partitions.
+	flushFilterQueue( m_pFilterQueue, context );
+
+	m_nVoiceRenderFrames = nFrames;
+	m_pVoiceRenderContext = &context;
+	m_pVoiceRenderPool->run( renderVoicePartition, this );
+	m_pVoiceRenderContext = nullptr;
+
+	// The workers must neither lock nor allocate and leave logging to
+	// the calling thread.
+	for ( auto pMix : m_voiceMixes ) {
+		if ( pMix->voices.empty() || pMix->nFailedVoices == 0 ) {
+			continue;
+		}
+		auto pInstr = pMix->pFailedNote->get_instrument();
+		WARNINGLOG( QString( "[%1] voices could not be rendered. First one: instrument [%2]: %3" )
+					.arg( pMix->nFailedVoices )
+					.arg( pInstr != nullptr ? pInstr->get_name() : QString( "NULL" ) )
+					.arg( pMix->sFailureReason ) );
+	}
+
+	// Reduction. Always done in partition order to keep the
+	// summation deterministic.
+	for ( auto pMix : m_voiceMixes ) {
+		if ( pMix->voices.empty() ) {
+			continue;
+		}
+
+		for ( uint32_t nFrame = 0; nFrame < nFrames; ++nFrame ) {
+			m_pMainOut_L[ nFrame ] += pMix->pMainOut_L[ nFrame ];
+			m_pMainOut_R[ nFrame ] += pMix->pMainOut_R[ nFrame ];
+		}
+
+		for ( int nComponent = 0; nComponent < pMix->components.size(); ++nComponent ) {
+			float* pOut_L = pMix->components[ nComponent ]->get_out_buffer_L();
+			float* pOut_R = pMix->components[ nComponent ]->get_out_buffer_R();
+			float* pMixOut_L = pMix->getComponentOut_L( nComponent );
+			float* pMixOut_R = pMix->getComponentOut_R( nComponent );
+			for ( uint32_t nFrame = 0; nFrame < nFrames; ++nFrame ) {
+				pOut_L[ nFrame ] += pMixOut_L[ nFrame ];
+				pOut_R[ nFrame ] += pMixOut_R[ nFrame ];
+			}
+		}
+
+#ifdef H2CORE_HAVE_LADSPA
+		for ( unsigned nFX = 0; nFX < MAX_FX; ++nFX ) {
+			LadspaFX *pFX = m_pFX[ nFX ];
+			if ( pFX == nullptr ) {
+				continue;
+			}
+			float* pMixOut_L = pMix->getFXOut_L( nFX );
+			float* pMixOut_R = pMix->getFXOut_R( nFX );
+			for ( uint32_t nFrame = 0; nFrame < nFrames; ++nFrame ) {
+				pFX->m_pBuffer_L[ nFrame ] += pMixOut_L[ nFrame ];
+				pFX->m_pBuffer_R[ nFrame ] += pMixOut_R[ nFrame ];
+			}
+		}
+#endif
+	}
+
+	removeEndedVoices();
+}
+
+void Sampler::removeEndedVoices()
+{
+	int nRemaining = 0;
+	for ( int nVoice = 0; nVoice < m_playingNotesQueue.size(); ++nVoice ) {
+		Note* pNote = m_playingNotesQueue[ nVoice ];
+		if ( m_voiceEnded[ nVoice ] && ! pNote->filter_sustain() ) {
+			pNote->get_instrument()->dequeue();
+			m_queuedNoteOffs.push_back( pNote );
+		} else {
+			m_playingNotesQueue[ nRemaining ] = pNote;
+			++nRemaining;
+		}
+	}
+	m_playingNotesQueue.resize( nRemaining );
+}
+
+void Sampler::renderVoicePartition( void* pContext, int nPartition )
+{
+	Sampler* pSampler = static_cast<Sampler*>( pContext );
+	VoiceMix* pMix = pSampler->m_voiceMixes[ nPartition ];
+	if ( pMix->voices.empty() ) {
+		return;
+	}
+
+	pMix->reset( pSampler->m_nVoiceRenderFrames );
+	for ( int nVoice : pMix->voices ) {
+		pSampler->m_voiceEnded[ nVoice ] =
+			pSampler->renderNote( pSampler->m_playingNotesQueue[ nVoice ],
+								  pSampler->m_nVoiceRenderFrames,
+								  *pSampler->m_pVoiceRenderContext, pMix );
+	}
+	pSampler->flushFilterQueue( pMix->pFilterQueue, *pSampler->m_pVoiceRenderContext );
 }
 
 
@@ -227,8 +617,6 @@ void Sampler::noteOff(Note* pNote )
 			pNote->get_adsr()->release();
 		}
 	}
-	
-	delete pNote;
 }
 
 
@@ -362,7 +750,7 @@ float Sampler::ratioConstKNormPanLaw( float fPan, float k) {
 }
 
 // function to direct the computation to the selected pan law.
-inline float Sampler::panLaw( float fPan, std::shared_ptr<Song> pSong ) {
+inline float Sampler::panLaw( float fPan, Song* pSong ) {
 	int nPanLawType = pSong->getPanLawType();
 	if ( nPanLawType == RATIO_STRAIGHT_POLYGONAL ) {
 		return ratioStraightPolygonalPanLaw( fPan );
@@ -405,18 +793,48 @@ inline float Sampler::panLaw( float fPan, std::shared_ptr<Song> pSong ) {
 
 //------------------------------------------------------------------
 
+int Sampler::findLoadedLayer( std::shared_ptr<InstrumentComponent> pCompo, float fVelocity ) const
+{
+	float fShortestDistance = 0;
+	int nNearestLayer = -1;
+	for ( int nLayer = 0; nLayer < m_nMaxLayers; ++nLayer ) {
+		auto pLayer = pCompo->get_layer( nLayer );
+		if ( pLayer == nullptr || pLayer->get_sample() == nullptr ||
+			 pLayer->get_sample()->is_empty() ) {
+			continue;
+		}
+
+		float fDistance = 0;
+		if ( fVelocity < pLayer->get_start_velocity() ) {
+			fDistance = pLayer->get_start_velocity() - fVelocity;
+		} else if ( fVelocity > pLayer->get_end_velocity() ) {
+			fDistance = fVelocity - pLayer->get_end_velocity();
+		}
+		if ( nNearestLayer == -1 || fDistance < fShortestDistance ) {
+			fShortestDistance = fDistance;
+			nNearestLayer = nLayer;
+		}
+	}
+	return nNearestLayer;
+}
+
 /// Render a note
 /// Return false: the note is not ended
 /// Return true: the note is ended
-bool Sampler::renderNote( Note* pNote, unsigned nBufferSize, std::shared_ptr<Song> pSong )
+bool Sampler::renderNote( Note* pNote, unsigned nBufferSize, const EngineContext& context, VoiceMix* pMix )
 {
 	//infoLog( "[renderNote] instr: " + pNote->getInstrument()->m_sName );
+	Song* pSong = context.pSong;
 	assert( pSong );
 
+	// Set again by the VoiceFilter for all components whose filter
+	// keeps ringing after this cycle.
+	for ( auto& [ nComponent, selectedLayer ] : *pNote->get_layers_selected() ) {
+		selectedLayer.filter.bSustain = false;
+	}
+
 	unsigned int nFramepos;
-	Hydrogen* pHydrogen = Hydrogen::get_instance();
-	auto pAudioDriver = pHydrogen->getAudioOutput();
-	auto pAudioEngine = pHydrogen->getAudioEngine();
+	AudioEngine* pAudioEngine = context.pAudioEngine;
 	if ( pAudioEngine->getState() == AudioEngine::State::Playing ) {
 		nFramepos = pAudioEngine->getFrames();
 	} else {
@@ -426,10 +844,22 @@ bool Sampler::renderNote( Note* pNote, unsigned nBufferSize, std::shared_ptr<Son
 
 	auto pInstr = pNote->get_instrument();
 	if ( !pInstr ) {
-		ERRORLOG( "NULL instrument" );
+		if ( pMix != nullptr ) {
+			pMix->voiceFailed( pNote, "NULL instrument" );
+		} else {
+			ERRORLOG( "NULL instrument" );
+		}
 		return 1;
 	}
 
+	// Notes started within this cycle might belong to an instrument
+	// the plan was not updated for yet. Those are always rendered
+	// on the calling thread.
+	if ( pInstr->getRenderPlan()->getCycle() != m_nRenderPlanCycle ) {
+		updateRenderPlan( pInstr, context );
+	}
+	const RenderPlan* pPlan = pInstr->getRenderPlan();
+
 	// new instrument and note pan interaction--------------------------
 	// notePan moves the RESULTANT pan in a smaller pan range centered at instrumentPan
 
@@ -450,43 +880,37 @@ bool Sampler::renderNote( Note* pNote, unsigned nBufferSize, std::shared_ptr<Son
 	*	if instrPan is sided, notePan moves the signal in a progressively smaller pan range centered at instrPan;
 	*	if instrPan is HARD-sided, notePan doesn't have any effect.
 	*/
-	float fPan = pInstr->getPan() + pNote->getPan() * ( 1 - fabs( pInstr->getPan() ) );
-	
-	// Pass fPan to the Pan Law
-	float fPan_L = panLaw( fPan, pSong );
-	float fPan_R = panLaw( -fPan, pSong );
+	// The pan law is only evaluated for notes panned on their own.
+	float fPan_L = pPlan->getPan_L();
+	float fPan_R = pPlan->getPan_R();
+	if ( pNote->getPan() != 0 ) {
+		float fPan = pInstr->getPan() + pNote->getPan() * ( 1 - fabs( pInstr->getPan() ) );
+
+		// Pass fPan to the Pan Law
+		fPan_L = panLaw( fPan, pSong );
+		fPan_R = panLaw( -fPan, pSong );
+	}
 	//---------------------------------------------------------
 
-	bool nReturnValues [pInstr->get_components()->size()];
+	const std::vector<RenderPlan::Component>& components = pPlan->getComponents();
+	bool nReturnValues [components.size()];
 	
-	for(int i = 0; i < pInstr->get_components()->size(); i++){
+	for(int i = 0; i < components.size(); i++){
 		nReturnValues[i] = false;
 	}
 	
 	int nReturnValueIndex = 0;
 	int nAlreadySelectedLayer = -1;
 
-	for (const auto& pCompo : *pInstr->get_components()) {
+	for ( const auto& component : components ) {
 		nReturnValues[nReturnValueIndex] = false;
-		DrumkitComponent* pMainCompo = nullptr;
+		const auto& pCompo = component.pComponent;
+		DrumkitComponent* pMainCompo = component.pMainCompo;
 
-		if( pNote->get_specific_compo_id() != -1 && pNote->get_specific_compo_id() != pCompo->get_drumkit_componentID() ) {
+		if( pNote->get_specific_compo_id() != -1 && pNote->get_specific_compo_id() != component.nComponentID ) {
 			continue;
 		}
 
-		if(		pInstr->is_preview_instrument()
-			||	pInstr->is_metronome_instrument()){
-			pMainCompo = pHydrogen->getSong()->getComponents()->front();
-		} else {
-			int nComponentID = pCompo->get_drumkit_componentID();
-			if ( nComponentID >= 0 ) {
-				pMainCompo = pHydrogen->getSong()->getComponent( nComponentID );
-			} else {
-				/* Invalid component found. This is possible on loading older or broken song files. */
-				pMainCompo = pHydrogen->getSong()->getComponents()->front();
-			}
-		}
-
 		assert(pMainCompo);
 
 		float fLayerGain = 1.0;
@@ -494,11 +918,15 @@ bool Sampler::renderNote( Note* pNote, unsigned nBufferSize, std::shared_ptr<Son
 
 		// scelgo il sample da usare in base alla velocity
 		std::shared_ptr<Sample> pSample;
-		SelectedLayerInfo *pSelectedLayer = pNote->get_layer_selected( pCompo->get_drumkit_componentID() );
+		SelectedLayerInfo *pSelectedLayer = pNote->get_layer_selected( component.nComponentID );
 
 		if ( !pSelectedLayer ) {
-			QString dummy = QString( "NULL Layer Information for instrument %1. Component: %2" ).arg( pInstr->get_name() ).arg( pCompo->get_drumkit_componentID() );
-			WARNINGLOG( dummy );
+			if ( pMix != nullptr ) {
+				pMix->voiceFailed( pNote, "NULL Layer Information" );
+			} else {
+				QString dummy = QString( "NULL Layer Information for instrument %1. Component: %2" ).arg( pInstr->get_name() ).arg( component.nComponentID );
+				WARNINGLOG( dummy );
+			}
 			nReturnValues[nReturnValueIndex] = true;
 			continue;
 		}
@@ -517,6 +945,20 @@ bool Sampler::renderNote( Note* pNote, unsigned nBufferSize, std::shared_ptr<Son
 		else {
 			switch ( pInstr->sample_selection_alg() ) {
 				case Instrument::VELOCITY:
+					// Most velocities are resolved by the table of
+					// the plan. Only those close to the boundary of
+					// a layer require a search.
+					if ( int nLayer = component.getVelocityLayer( pNote->get_velocity() );
+						 nLayer != -1 ) {
+						auto pLayer = pCompo->get_layer( nLayer );
+						pSelectedLayer->SelectedLayer = nLayer;
+
+						pSample = pLayer->get_sample();
+						fLayerGain = pLayer->get_gain();
+						fLayerPitch = pLayer->get_pitch();
+						break;
+					}
+
 					for ( unsigned nLayer = 0; nLayer < m_nMaxLayers; ++nLayer ) {
 						auto pLayer = pCompo->get_layer( nLayer );
 						if ( pLayer == nullptr ) continue;
@@ -737,15 +1179,75 @@ bool Sampler::renderNote( Note* pNote, unsigned nBufferSize, std::shared_ptr<Son
 					break;
 			}
 		}
+		// Layers not loaded along with the song are requested in
+		// the background. Until then, notes are played by the
+		// closest layer already loaded. Voices select their layers
+		// in the audio thread only (see renderVoicesParallel()).
+		if ( pSample != nullptr && pSample->is_empty() ) {
+			auto pLayer = pCompo->get_layer( pSelectedLayer->SelectedLayer );
+			pSample = nullptr;
+			if ( pLayer != nullptr ) {
+				pSample = m_pLazySampleLoader->load( pLayer, pSong->getBpm(), context );
+			}
+			if ( pSample == nullptr ) {
+				const int nLoadedLayer = findLoadedLayer( pCompo, pNote->get_velocity() );
+				if ( nLoadedLayer != -1 ) {
+					auto pLoadedLayer = pCompo->get_layer( nLoadedLayer );
+					pSelectedLayer->SelectedLayer = nLoadedLayer;
+
+					pSample = pLoadedLayer->get_sample();
+					fLayerGain = pLoadedLayer->get_gain();
+					fLayerPitch = pLoadedLayer->get_pitch();
+				}
+			}
+		}
+
 		if ( !pSample ) {
-			QString dummy = QString( "NULL sample for instrument %1. Note velocity: %2" ).arg( pInstr->get_name() ).arg( pNote->get_velocity() );
-			WARNINGLOG( dummy );
+			if ( pMix != nullptr ) {
+				pMix->voiceFailed( pNote, "NULL sample" );
+			} else {
+				QString dummy = QString( "NULL sample for instrument %1. Note velocity: %2" ).arg( pInstr->get_name() ).arg( pNote->get_velocity() );
+				WARNINGLOG( dummy );
+			}
 			nReturnValues[nReturnValueIndex] = true;
 			continue;
 		}
 
-		if ( pSelectedLayer->SamplePosition >= pSample->get_frames() ) {
-			WARNINGLOG( "sample position out of bounds. The layer has been resized during note play?" );
+		// Samples converted to the sample rate of the driver do not
+		// have to be resampled unless the note is pitched. As the
+		// frames of both versions do not line up, each note sticks to
+		// the version it started with.
+		if ( m_pSampleConverter != nullptr ) {
+			if ( ! pSelectedLayer->isStarted() ) {
+				auto pConverted = m_pSampleConverter->getConverted( pSample, context );
+				pSelectedLayer->bConverted = pConverted != nullptr;
+				if ( pConverted != nullptr ) {
+					pSample = pConverted;
+				}
+			}
+			else if ( pSelectedLayer->bConverted ) {
+				auto pConverted = pSample->get_converted( context.nSampleRate );
+				if ( pConverted != nullptr ) {
+					pSample = pConverted;
+				} else {
+					// The conversion was dropped while the note was
+					// playing. Continue with the original data.
+					pSelectedLayer->SamplePosition *=
+						static_cast<float>( pSample->get_sample_rate() ) / context.nSampleRate;
+					pSelectedLayer->bConverted = false;
+				}
+			}
+		}
+
+		// Past the end of the sample, the voice keeps rendering as long
+		// as its resonant filter is ringing.
+		if ( pSelectedLayer->SamplePosition >= pSample->get_frames() &&
+			 ! ( pInstr->is_filter_active() && pSelectedLayer->filter.isRinging() ) ) {
+			if ( pMix != nullptr ) {
+				pMix->voiceFailed( pNote, "sample position out of bounds" );
+			} else {
+				WARNINGLOG( "sample position out of bounds. The layer has been resized during note play?" );
+			}
 			nReturnValues[nReturnValueIndex] = true;
 			continue;
 		}
@@ -760,7 +1262,11 @@ bool Sampler::renderNote( Note* pNote, unsigned nBufferSize, std::shared_ptr<Son
 				int noteStartInFramesNoHumanize = ( int )pNote->get_position() * pAudioEngine->getTickSize();
 				if ( noteStartInFramesNoHumanize > ( int )( nFramepos + nBufferSize ) ) {
 					// this note is not valid. it's in the future...let's skip it....
-					ERRORLOG( QString( "Note pos in the future?? Current frames: %1, note frame pos: %2" ).arg( nFramepos ).arg(noteStartInFramesNoHumanize ) );
+					if ( pMix != nullptr ) {
+						pMix->voiceFailed( pNote, "Note pos in the future" );
+					} else {
+						ERRORLOG( QString( "Note pos in the future?? Current frames: %1, note frame pos: %2" ).arg( nFramepos ).arg(noteStartInFramesNoHumanize ) );
+					}
 					//pNote->dumpInfo();
 					nReturnValues[nReturnValueIndex] = true;
 					continue;
@@ -777,10 +1283,14 @@ bool Sampler::renderNote( Note* pNote, unsigned nBufferSize, std::shared_ptr<Son
 		float cost_track_L = 1.0f;
 		float cost_track_R = 1.0f;
 
+		// The per-instrument outputs are either the JACK track
+		// outputs or the stems written during an export.
+		const bool bTrackOutPostFader = context.bTrackOutPostFader;
+
 		assert(pMainCompo);
 		
-		bool isMutedForExport = (pHydrogen->getIsExportSessionActive() && !pInstr->is_currently_exported());
-		bool isMutedBecauseOfSolo = (isAnyInstrumentSoloed() && !pInstr->is_soloed());
+		bool isMutedForExport = (context.bIsExportSessionActive && !pInstr->is_currently_exported());
+		bool isMutedBecauseOfSolo = (context.bIsAnyInstrumentSoloed && !pInstr->is_soloed());
 		
 		/*
 		 *  Is instrument muted?
@@ -794,7 +1304,7 @@ bool Sampler::renderNote( Note* pNote, unsigned nBufferSize, std::shared_ptr<Son
 		if ( isMutedForExport || pInstr->is_muted() || pSong->getIsMuted() || pMainCompo->is_muted() || isMutedBecauseOfSolo) {	
 			cost_L = 0.0;
 			cost_R = 0.0;
-			if ( Preferences::get_instance()->m_JackTrackOutputMode == Preferences::JackTrackOutputMode::postFader ) {
+			if ( bTrackOutPostFader ) {
 				cost_track_L = 0.0;
 				cost_track_R = 0.0;
 			}
@@ -814,7 +1324,7 @@ bool Sampler::renderNote( Note* pNote, unsigned nBufferSize, std::shared_ptr<Son
 			cost_L = cost_L * pMainCompo->get_volume(); // Component volument
 
 			cost_L = cost_L * pInstr->get_volume();		// instrument volume
-			if ( Preferences::get_instance()->m_JackTrackOutputMode == Preferences::JackTrackOutputMode::postFader ) {
+			if ( bTrackOutPostFader ) {
 				cost_track_L = cost_L * 2;
 			}
 			cost_L = cost_L * pSong->getVolume();	// song volume
@@ -827,14 +1337,14 @@ bool Sampler::renderNote( Note* pNote, unsigned nBufferSize, std::shared_ptr<Son
 			cost_R = cost_R * pMainCompo->get_volume(); // Component volument
 
 			cost_R = cost_R * pInstr->get_volume();		// instrument volume
-			if ( Preferences::get_instance()->m_JackTrackOutputMode == Preferences::JackTrackOutputMode::postFader ) {
+			if ( bTrackOutPostFader ) {
 				cost_track_R = cost_R * 2;
 			}
 			cost_R = cost_R * pSong->getVolume();	// song pan
 		}
 
 		// direct track outputs only use velocity
-		if ( Preferences::get_instance()->m_JackTrackOutputMode == Preferences::JackTrackOutputMode::preFader ) {
+		if ( ! bTrackOutPostFader ) {
 			cost_track_L = cost_track_L * pNote->get_velocity();
 			cost_track_L = cost_track_L * fLayerGain;
 			cost_track_R = cost_track_L;
@@ -848,41 +1358,46 @@ bool Sampler::renderNote( Note* pNote, unsigned nBufferSize, std::shared_ptr<Son
 		float fTotalPitch = pNote->get_total_pitch() + fLayerPitch;
 
 		//_INFOLOG( "total pitch: " + to_string( fTotalPitch ) );
-		if( (int) pSelectedLayer->SamplePosition == 0  && !pInstr->is_muted() )
+		if( ! pSelectedLayer->isStarted() && !pInstr->is_muted() )
 		{
-			if( Hydrogen::get_instance()->getMidiOutput() != nullptr ){
-				Hydrogen::get_instance()->getMidiOutput()->handleQueueNote( pNote );
+			if( context.pMidiOutput != nullptr ){
+				context.pMidiOutput->handleQueueNote( pNote );
 			}
 		}
 
-		if ( fTotalPitch == 0.0 && pSample->get_sample_rate() == pAudioDriver->getSampleRate() ) { // NO RESAMPLE
-			nReturnValues[nReturnValueIndex] = renderNoteNoResample( pSample, pNote, pSelectedLayer, pCompo, pMainCompo, nBufferSize, nInitialSilence, cost_L, cost_R, cost_track_L, cost_track_R, pSong );
+		// Streamed samples are only accessible through the
+		// SampleStreamer::Window used by renderNoteResample().
+		if ( fTotalPitch == 0.0 && pSample->get_sample_rate() == context.nSampleRate &&
+			 ! pSample->is_streamed() ) { // NO RESAMPLE
+			nReturnValues[nReturnValueIndex] = renderNoteNoResample( pSample, pNote, pSelectedLayer, component, nBufferSize, nInitialSilence, cost_L, cost_R, cost_track_L, cost_track_R, context, pMix );
 		}
 		else { // RESAMPLE
-			nReturnValues[nReturnValueIndex] = renderNoteResample( pSample, pNote, pSelectedLayer, pCompo, pMainCompo, nBufferSize, nInitialSilence, cost_L, cost_R, cost_track_L, cost_track_R, fLayerPitch, pSong );
+			nReturnValues[nReturnValueIndex] = renderNoteResample( pSample, pNote, pSelectedLayer, component, nBufferSize, nInitialSilence, cost_L, cost_R, cost_track_L, cost_track_R, fLayerPitch, context, pMix );
 		}
 
 		nReturnValueIndex++;
 	}
-	for ( unsigned i = 0 ; i < pInstr->get_components()->size() ; i++ ) {
+	for ( unsigned i = 0 ; i < components.size() ; i++ ) {
 		if ( !nReturnValues[i] ) {
-			return false;
+			// Voices whose envelope is done - e.g. stolen ones - would
+			// only render silence from here on. A resonant filter
+			// still ringing is taken into account by
+			// removeEndedVoices().
+			return pNote->get_adsr()->get_state() == ADSR::IDLE;
 		}
 	}
 	return true;
 }
 
-bool Sampler::processPlaybackTrack(int nBufferSize)
+bool Sampler::processPlaybackTrack( int nBufferSize, const EngineContext& context )
 {
-	Hydrogen* pHydrogen = Hydrogen::get_instance();
-	auto pAudioDriver = Hydrogen::get_instance()->getAudioOutput();
-	auto pAudioEngine = Hydrogen::get_instance()->getAudioEngine();
-	std::shared_ptr<Song> pSong = pHydrogen->getSong();
+	AudioEngine* pAudioEngine = context.pAudioEngine;
+	Song* pSong = context.pSong;
 
 
 	if ( !pSong->getPlaybackTrackEnabled()
 		 || pAudioEngine->getState() != AudioEngine::State::Playing
-		 || pHydrogen->getMode() != Song::Mode::Song )
+		 || pSong->getMode() != Song::Mode::Song )
 	{
 		return false;
 	}
@@ -904,7 +1419,7 @@ bool Sampler::processPlaybackTrack(int nBufferSize)
 	int nAvail_bytes = 0;
 	int	nInitialBufferPos = 0;
 
-	if(pSample->get_sample_rate() == pAudioDriver->getSampleRate()){
+	if(pSample->get_sample_rate() == context.nSampleRate){
 		//No resampling	
 		m_nPlayBackSamplePosition = pAudioEngine->getFrames();
 	
@@ -951,7 +1466,7 @@ bool Sampler::processPlaybackTrack(int nBufferSize)
 		double	fSamplePos = 0;
 		int		nSampleFrames = pSample->get_frames();
 		float	fStep = 1;
-		fStep *= ( float )pSample->get_sample_rate() / pAudioDriver->getSampleRate(); // Adjust for audio driver sample rate
+		fStep *= ( float )pSample->get_sample_rate() / context.nSampleRate; // Adjust for audio driver sample rate
 		
 		
 		if( pAudioEngine->getFrames() == 0){
@@ -1038,19 +1553,19 @@ bool Sampler::renderNoteNoResample(
 	std::shared_ptr<Sample> pSample,
 	Note *pNote,
 	SelectedLayerInfo *pSelectedLayerInfo,
-	std::shared_ptr<InstrumentComponent> pCompo,
-	DrumkitComponent *pDrumCompo,
+	const RenderPlan::Component& component,
 	int nBufferSize,
 	int nInitialSilence,
 	float cost_L,
 	float cost_R,
 	float cost_track_L,
 	float cost_track_R,
-	std::shared_ptr<Song> pSong
+	const EngineContext& context,
+	VoiceMix* pMix
 )
 {
-	auto pAudioDriver = Hydrogen::get_instance()->getAudioOutput();
-	auto pAudioEngine = Hydrogen::get_instance()->getAudioEngine();
+	Song* pSong = context.pSong;
+	AudioEngine* pAudioEngine = context.pAudioEngine;
 	bool retValue = true; // the note is ended
 
 	int nNoteLength = -1;
@@ -1064,92 +1579,68 @@ bool Sampler::renderNoteNoResample(
 		// imposto il numero dei bytes disponibili uguale al buffersize
 		nAvail_bytes = nBufferSize - nInitialSilence;
 		retValue = false; // the note is not ended yet
-	} else if ( pNote->get_instrument()->is_filter_active() && pNote->filter_sustain() ) {
+	} else if ( pNote->get_instrument()->is_filter_active() && pSelectedLayerInfo->filter.isRinging() ) {
 		// If filter is causing note to ring, process more samples.
 		nAvail_bytes = nBufferSize - nInitialSilence;
 	}
 
 	int nInitialBufferPos = nInitialSilence;
 	int nInitialSamplePos = ( int )pSelectedLayerInfo->SamplePosition;
-	int nSamplePos = nInitialSamplePos;
 	int nTimes = nInitialBufferPos + nAvail_bytes;
 
 	auto pSample_data_L = pSample->get_data_l();
 	auto pSample_data_R = pSample->get_data_r();
 
-	float fInstrPeak_L = pNote->get_instrument()->get_peak_l(); // this value will be reset to 0 by the mixer..
-	float fInstrPeak_R = pNote->get_instrument()->get_peak_r(); // this value will be reset to 0 by the mixer..
-
-	float fADSRValue;
-	float fVal_L;
-	float fVal_R;
-
-#ifdef H2CORE_HAVE_JACK
-	float *		pTrackOutL = nullptr;
-	float *		pTrackOutR = nullptr;
-
-	if ( Preferences::get_instance()->m_bJackTrackOuts ) {
-		auto pJackAudioDriver = dynamic_cast<JackAudioDriver*>( pAudioDriver );
-		if( pJackAudioDriver ) {
-			pTrackOutL = pJackAudioDriver->getTrackOut_L( pNote->get_instrument(), pCompo );
-			pTrackOutR = pJackAudioDriver->getTrackOut_R( pNote->get_instrument(), pCompo );
-		}
+	float buffer_L[MAX_BUFFER_SIZE];
+	float buffer_R[MAX_BUFFER_SIZE];
+	float envelope[MAX_BUFFER_SIZE];
+
+	// The sample position is only updated at the end of the cycle, so
+	// whether the note exceeded its length can be decided up front.
+	bool bNoteLengthReached = ( nNoteLength != -1 ) &&
+		( nNoteLength <= pSelectedLayerInfo->SamplePosition );
+	auto pADSR = pNote->get_adsr();
+	if ( bNoteLengthReached ) {
+		pADSR->release();
 	}
-#endif
-
-	for ( int nBufferPos = nInitialBufferPos; nBufferPos < nTimes; ++nBufferPos ) {
-		if ( ( nNoteLength != -1 ) && ( nNoteLength <= pSelectedLayerInfo->SamplePosition ) ) {
-						if ( pNote->get_adsr()->release() == 0 ) {
-				retValue = true;	// the note is ended
-			}
-		}
-
-		fADSRValue = pNote->get_adsr()->get_value( 1 );
-		fVal_L = pSample_data_L[ nSamplePos ] * fADSRValue;
-		fVal_R = pSample_data_R[ nSamplePos ] * fADSRValue;
-
-		// Low pass resonant filter
-		if ( pNote->get_instrument()->is_filter_active() ) {
-			pNote->compute_lr_values( &fVal_L, &fVal_R );
-		}
-
-#ifdef H2CORE_HAVE_JACK
-		if(  pTrackOutL ) {
-			 pTrackOutL[nBufferPos] += fVal_L * cost_track_L;
-		}
-		if( pTrackOutR ) {
-			pTrackOutR[nBufferPos] += fVal_R * cost_track_R;
-		}
-#endif
 
-		fVal_L = fVal_L * cost_L;
-		fVal_R = fVal_R * cost_R;
-
-		// update instr peak
-		if ( fVal_L > fInstrPeak_L ) {
-			fInstrPeak_L = fVal_L;
-		}
-		if ( fVal_R > fInstrPeak_R ) {
-			fInstrPeak_R = fVal_R;
+	// ADSR envelope. Frames past the end of the sample, rendered
+	// while the resonant filter is still ringing, are silent.
+	pADSR->get_values( &envelope[ nInitialBufferPos ], nAvail_bytes, 1 );
+	const int nSampleFrames = std::min( nAvail_bytes,
+										std::max( pSample->get_frames() - nInitialSamplePos, 0 ) );
+	// Mono samples are rendered into the left buffer only, which
+	// is panned into both channels by the output costs.
+	const bool bMono = pSample_data_L == pSample_data_R;
+	for ( int ii = 0; ii < nSampleFrames; ++ii ) {
+		buffer_L[ nInitialBufferPos + ii ] =
+			pSample_data_L[ nInitialSamplePos + ii ] * envelope[ nInitialBufferPos + ii ];
+	}
+	std::fill( &buffer_L[ nInitialBufferPos + nSampleFrames ], &buffer_L[ nTimes ], 0.0f );
+	if ( ! bMono ) {
+		for ( int ii = 0; ii < nSampleFrames; ++ii ) {
+			buffer_R[ nInitialBufferPos + ii ] =
+				pSample_data_R[ nInitialSamplePos + ii ] * envelope[ nInitialBufferPos + ii ];
 		}
+		std::fill( &buffer_R[ nInitialBufferPos + nSampleFrames ], &buffer_R[ nTimes ], 0.0f );
+	}
+	const float* pBuffer_R = bMono ? buffer_L : buffer_R;
 
-		pDrumCompo->set_outs( nBufferPos, fVal_L, fVal_R );
-
-		// to main mix
-		m_pMainOut_L[nBufferPos] += fVal_L;
-		m_pMainOut_R[nBufferPos] += fVal_R;
-
-		++nSamplePos;
+	if ( bNoteLengthReached && pADSR->release() == 0 ) {
+		retValue = true;	// the note is ended
 	}
-	if ( pNote->get_instrument()->is_filter_active() && pNote->filter_sustain() ) {
-		// Note is still ringing, do not end.
-		retValue = false;
+
+	// The effects are fed with the plain sample below.
+	VoiceOutput output = createVoiceOutput( pNote, component, nInitialBufferPos, nAvail_bytes,
+											cost_L, cost_R, cost_track_L, cost_track_R, false,
+											context, pMix );
+	if ( pNote->get_instrument()->is_filter_active() ) {
+		queueFilteredVoice( output, &pSelectedLayerInfo->filter, buffer_L, pBuffer_R, context );
+	} else {
+		mixVoice( output, buffer_L, pBuffer_R, context );
 	}
 
 	pSelectedLayerInfo->SamplePosition += nAvail_bytes;
-	pNote->get_instrument()->set_peak_l( fInstrPeak_L );
-	pNote->get_instrument()->set_peak_r( fInstrPeak_R );
-
 
 #ifdef H2CORE_HAVE_LADSPA
 	// LADSPA
@@ -1157,21 +1648,21 @@ bool Sampler::renderNoteNoResample(
 	if (pNote->get_instrument()->is_muted() || pSong->getIsMuted() ) return retValue;
 	float masterVol =  pSong->getVolume();
 	for ( unsigned nFX = 0; nFX < MAX_FX; ++nFX ) {
-		LadspaFX *pFX = Effects::get_instance()->getLadspaFX( nFX );
+		LadspaFX *pFX = m_pFX[ nFX ];
 
 		float fLevel = pNote->get_instrument()->get_fx_level( nFX );
 
 		if ( ( pFX ) && ( fLevel != 0.0 ) ) {
 			fLevel = fLevel * pFX->getVolume();
-			float *pBuf_L = pFX->m_pBuffer_L;
-			float *pBuf_R = pFX->m_pBuffer_R;
+			float *pBuf_L = pMix != nullptr ? pMix->getFXOut_L( nFX ) : pFX->m_pBuffer_L;
+			float *pBuf_R = pMix != nullptr ? pMix->getFXOut_R( nFX ) : pFX->m_pBuffer_R;
 
 			float fFXCost_L = fLevel * masterVol;
 			float fFXCost_R = fLevel * masterVol;
 
 			int nBufferPos = nInitialBufferPos;
 			int nSamplePos = nInitialSamplePos;
-			for ( int i = 0; i < nAvail_bytes; ++i ) {
+			for ( int i = 0; i < nSampleFrames; ++i ) {
 				pBuf_L[ nBufferPos ] += pSample_data_L[ nSamplePos ] * fFXCost_L;
 				pBuf_R[ nBufferPos ] += pSample_data_R[ nSamplePos ] * fFXCost_R;
 				++nSamplePos;
@@ -1189,8 +1680,7 @@ bool Sampler::renderNoteResample(
 	std::shared_ptr<Sample> pSample,
 	Note *pNote,
 	SelectedLayerInfo *pSelectedLayerInfo,
-	std::shared_ptr<InstrumentComponent> pCompo,
-	DrumkitComponent *pDrumCompo,
+	const RenderPlan::Component& component,
 	int nBufferSize,
 	int nInitialSilence,
 	float cost_L,
@@ -1198,11 +1688,12 @@ bool Sampler::renderNoteResample(
 	float cost_track_L,
 	float cost_track_R,
 	float fLayerPitch,
-	std::shared_ptr<Song> pSong
+	const EngineContext& context,
+	VoiceMix* pMix
 )
 {
-	auto pAudioDriver = Hydrogen::get_instance()->getAudioOutput();
-	auto pAudioEngine = Hydrogen::get_instance()->getAudioEngine();
+	Song* pSong = context.pSong;
+	AudioEngine* pAudioEngine = context.pAudioEngine;
 
 	int nNoteLength = -1;
 	if ( pNote->get_length() != -1 ) {
@@ -1216,7 +1707,7 @@ bool Sampler::renderNoteResample(
 
 	float fStep = Note::pitchToFrequency( fNotePitch );
 //	_ERRORLOG( QString("pitch: %1, step: %2" ).arg(fNotePitch).arg( fStep) );
-	fStep *= ( float )pSample->get_sample_rate() / pAudioDriver->getSampleRate(); // Adjust for audio driver sample rate
+	fStep *= ( float )pSample->get_sample_rate() / context.nSampleRate; // Adjust for audio driver sample rate
 
 	// verifico il numero di frame disponibili ancora da eseguire
 	int nAvail_bytes = ( int )( ( float )( pSample->get_frames() - pSelectedLayerInfo->SamplePosition ) / fStep );
@@ -1227,7 +1718,7 @@ bool Sampler::renderNoteResample(
 		// imposto il numero dei bytes disponibili uguale al buffersize
 		nAvail_bytes = nBufferSize - nInitialSilence;
 		retValue = false; // the note is not ended yet
-	} else if ( pNote->get_instrument()->is_filter_active() && pNote->filter_sustain() ) {
+	} else if ( pNote->get_instrument()->is_filter_active() && pSelectedLayerInfo->filter.isRinging() ) {
 		// If filter is causing note to ring, process more samples.
 		nAvail_bytes = nBufferSize - nInitialSilence;
 	}
@@ -1240,150 +1731,200 @@ bool Sampler::renderNoteResample(
 	auto pSample_data_L = pSample->get_data_l();
 	auto pSample_data_R = pSample->get_data_r();
 
-	float fInstrPeak_L = pNote->get_instrument()->get_peak_l(); // this value will be reset to 0 by the mixer..
-	float fInstrPeak_R = pNote->get_instrument()->get_peak_r(); // this value will be reset to 0 by the mixer..
-
-	float fADSRValue = 1.0;
-	float fVal_L;
-	float fVal_R;
 	int nSampleFrames = pSample->get_frames();
 
-
-#ifdef H2CORE_HAVE_JACK
-	float *		pTrackOutL = nullptr;
-	float *		pTrackOutR = nullptr;
-
-	if ( Preferences::get_instance()->m_bJackTrackOuts ) {
-		auto pJackAudioDriver = dynamic_cast<JackAudioDriver*>( pAudioDriver );
-		if( pJackAudioDriver ) {
-			pTrackOutL = pJackAudioDriver->getTrackOut_L( pNote->get_instrument(), pCompo );
-			pTrackOutR = pJackAudioDriver->getTrackOut_R( pNote->get_instrument(), pCompo );
+	// Only the beginning of streamed samples is kept in memory. The
+	// remainder is read from the stream opened once the voice
+	// starts and the positions passed to the interpolation are
+	// relative to the window it provides.
+	double fWindowPos = fSamplePos;
+	if ( pSample->is_streamed() && m_pSampleStreamer != nullptr ) {
+		if ( pSelectedLayerInfo->pStream == nullptr ) {
+			pSelectedLayerInfo->pStream = m_pSampleStreamer->open( pSample );
 		}
+		auto window = m_pSampleStreamer->getWindow( pSelectedLayerInfo->pStream, pSample,
+													std::max( static_cast<int>( fSamplePos ) - 1, 0 ),
+													static_cast<int>( fSamplePos + nAvail_bytes * fStep ) + 3 );
+		pSample_data_L = window.pData_L;
+		pSample_data_R = window.pData_R;
+		nSampleFrames = window.nFrames;
+		fWindowPos -= window.nOffset;
+	} else if ( pSample->is_streamed() ) {
+		nSampleFrames = pSample->get_resident_frames();
 	}
-#endif
+
 
 	float buffer_L[MAX_BUFFER_SIZE];
 	float buffer_R[MAX_BUFFER_SIZE];
 
 
 	// Main rendering loop.
-	// With some re-work, more of this could likely be vectorised fairly easily.
-	//   - assert no buffer aliasing
-	//   - template and multiple instantiations for is_filter_active x each interpolation method
-	//   - iterate LP IIR filter coefficients to longer IIR filter to fit vector width
 	//
+	// The interpolation mode is resolved once per note and the
+	// resampling itself is done by kernels instantiated for each
+	// Interpolation::InterpolateMode (see Interpolation::resample()).
+	// The envelope and the resonant filter are applied in separate
+	// passes afterwards, keeping the interpolation free of any
+	// per-frame branching.
+	//
+	// Mono samples are interpolated only once into the left buffer,
+	// which is panned into both channels by the output costs.
+	const bool bMono = pSample_data_L == pSample_data_R;
+	Interpolation::resample( m_interpolateMode, pSample_data_L, nSampleFrames, fWindowPos, fStep,
+							 &buffer_L[ nInitialBufferPos ], nAvail_bytes );
+	if ( ! bMono ) {
+		Interpolation::resample( m_interpolateMode, pSample_data_R, nSampleFrames, fWindowPos, fStep,
+								 &buffer_R[ nInitialBufferPos ], nAvail_bytes );
+	}
+	const float* pBuffer_R = bMono ? buffer_L : buffer_R;
+
+	// The sample position is only updated at the end of the cycle, so
+	// whether the note exceeded its length can be decided up front.
+	bool bNoteLengthReached = ( nNoteLength != -1 ) &&
+		( nNoteLength <= pSelectedLayerInfo->SamplePosition );
+	if ( bNoteLengthReached ) {
+		pNote->get_adsr()->release();
+	}
+
+	// ADSR envelope
+	auto pADSR = pNote->get_adsr();
+	float envelope[MAX_BUFFER_SIZE];
+	pADSR->get_values( &envelope[ nInitialBufferPos ], nAvail_bytes, fStep );
 	for ( int nBufferPos = nInitialBufferPos; nBufferPos < nTimes; ++nBufferPos ) {
-		if ( ( nNoteLength != -1 ) && ( nNoteLength <= pSelectedLayerInfo->SamplePosition ) ) {
-			if ( pNote->get_adsr()->release() == 0 ) {
-				if (!retValue) {
-					retValue = 1;	// the note is ended
-				}
-			}
+		buffer_L[nBufferPos] *= envelope[nBufferPos];
+	}
+	if ( ! bMono ) {
+		for ( int nBufferPos = nInitialBufferPos; nBufferPos < nTimes; ++nBufferPos ) {
+			buffer_R[nBufferPos] *= envelope[nBufferPos];
 		}
+	}
 
-		int nSamplePos = ( int )fSamplePos;
-		double fDiff = fSamplePos - nSamplePos;
-		if ( ( nSamplePos - 1 ) >= nSampleFrames ) {
-			//we reach the last audioframe.
-			//set this last frame to zero do nothing wrong.
-			fVal_L = 0.0;
-			fVal_R = 0.0;
-		} else {
-			// Gather frame samples
-			float l0, l1, l2, l3, r0, r1, r2, r3;
-			// Short-circuit: the common case is that all required frames are within the sample.
-			if ( nSamplePos >= 1 && nSamplePos + 2 < nSampleFrames ) {
-				l0 = pSample_data_L[ nSamplePos-1 ];
-				l1 = pSample_data_L[ nSamplePos ];
-				l2 = pSample_data_L[ nSamplePos+1 ];
-				l3 = pSample_data_L[ nSamplePos+2 ];
-				r0 = pSample_data_R[ nSamplePos-1 ];
-				r1 = pSample_data_R[ nSamplePos ];
-				r2 = pSample_data_R[ nSamplePos+1 ];
-				r3 = pSample_data_R[ nSamplePos+2 ];
-			} else {
-				l0 = l1 = l2 = l3 = r0 = r1 = r2 = r3 = 0.0;
-				// Some required frames are off the beginning or end of the sample.
-				if ( nSamplePos >= 1 && nSamplePos < nSampleFrames + 1 ) {
-					l0 = pSample_data_L[ nSamplePos-1 ];
-					r0 = pSample_data_R[ nSamplePos-1 ];
-				}
-				// Each successive frame may be past the end of the sample so check individually.
-				if ( nSamplePos < nSampleFrames ) {
-					l1 = pSample_data_L[ nSamplePos ];
-					r1 = pSample_data_R[ nSamplePos ];
-					if ( nSamplePos+1 < nSamplePos ) {
-						l2 = pSample_data_L[ nSamplePos+1 ];
-						r2 = pSample_data_R[ nSamplePos+1 ];
-						if ( nSamplePos+2 < nSamplePos ) {
-							l3 = pSample_data_L[ nSamplePos+2 ];
-							r3 = pSample_data_R[ nSamplePos+2 ];
-						}
-					}
-				}
-			}
+	if ( bNoteLengthReached && pADSR->release() == 0 ) {
+		retValue = true;	// the note is ended
+	}
 
-			// Interpolate frame values from Sample domain to audio output range
-			switch ( m_interpolateMode ) {
-			case Interpolation::InterpolateMode::Linear:
-				fVal_L = l1 * (1 - fDiff ) + l2 * fDiff;
-				fVal_R = r1 * (1 - fDiff ) + r2 * fDiff;
-				break;
-			case Interpolation::InterpolateMode::Cosine:
-				fVal_L = Interpolation::cosine_Interpolate( l1, l2, fDiff);
-				fVal_R = Interpolation::cosine_Interpolate( r1, r2, fDiff);
-				break;
-			case Interpolation::InterpolateMode::Third:
-				fVal_L = Interpolation::third_Interpolate( l0, l1, l2, l3, fDiff);
-				fVal_R = Interpolation::third_Interpolate( r0, r1, r2, r3, fDiff);
-				break;
-			case Interpolation::InterpolateMode::Cubic:
-				fVal_L = Interpolation::cubic_Interpolate( l0, l1, l2, l3, fDiff);
-				fVal_R = Interpolation::cubic_Interpolate( r0, r1, r2, r3, fDiff);
-				break;
-			case Interpolation::InterpolateMode::Hermite:
-				fVal_L = Interpolation::hermite_Interpolate( l0, l1, l2, l3, fDiff);
-				fVal_R = Interpolation::hermite_Interpolate( r0, r1, r2, r3, fDiff);
-				break;
-			}
-		}
+	VoiceOutput output = createVoiceOutput( pNote, component, nInitialBufferPos, nAvail_bytes,
+											cost_L, cost_R, cost_track_L, cost_track_R, true,
+											context, pMix );
+	if ( pNote->get_instrument()->is_filter_active() ) {
+		queueFilteredVoice( output, &pSelectedLayerInfo->filter, buffer_L, pBuffer_R, context );
+	} else {
+		mixVoice( output, buffer_L, pBuffer_R, context );
+	}
 
-		// ADSR envelope
-		fADSRValue = pNote->get_adsr()->get_value( fStep );
-		fVal_L = fVal_L * fADSRValue;
-		fVal_R = fVal_R * fADSRValue;
-		// Low pass resonant filter
-		if ( pNote->get_instrument()->is_filter_active() ) {
-			pNote->compute_lr_values( &fVal_L, &fVal_R );
+	pSelectedLayerInfo->SamplePosition += nAvail_bytes * fStep;
+
+	return retValue;
+}
+
+Sampler::VoiceOutput Sampler::createVoiceOutput( Note* pNote,
+												 const RenderPlan::Component& component,
+												 int nOffset, int nFrames,
+												 float cost_L, float cost_R,
+												 float cost_track_L, float cost_track_R,
+												 bool bSendToFX,
+												 const EngineContext& context,
+												 VoiceMix* pMix )
+{
+	VoiceOutput output;
+	output.pNote = pNote;
+	output.nOffset = nOffset;
+	output.nFrames = nFrames;
+	output.fCost_L = cost_L;
+	output.fCost_R = cost_R;
+	output.fCostTrack_L = cost_track_L;
+	output.fCostTrack_R = cost_track_R;
+	output.bSendToFX = bSendToFX;
+	output.pMix = pMix;
+
+	// Looked up once per cycle by updateRenderPlan().
+	output.pTrackOut_L = component.pTrackOut_L;
+	output.pTrackOut_R = component.pTrackOut_R;
+
+	// Buses the voice is mixed into. The components of the
+	// partitions are stored in the same order as the ones of the
+	// song.
+	output.pMainOut_L = m_pMainOut_L;
+	output.pMainOut_R = m_pMainOut_R;
+	output.pCompoOut_L = component.pMainCompo->get_out_buffer_L();
+	output.pCompoOut_R = component.pMainCompo->get_out_buffer_R();
+	if ( pMix != nullptr ) {
+		output.pMainOut_L = pMix->pMainOut_L;
+		output.pMainOut_R = pMix->pMainOut_R;
+		if ( component.nMainCompoIndex >= 0 &&
+			 component.nMainCompoIndex < pMix->components.size() ) {
+			output.pCompoOut_L = pMix->getComponentOut_L( component.nMainCompoIndex );
+			output.pCompoOut_R = pMix->getComponentOut_R( component.nMainCompoIndex );
 		}
+	}
 
-		buffer_L[nBufferPos] = fVal_L;
-		buffer_R[nBufferPos] = fVal_R;
+	return output;
+}
 
-		fSamplePos += fStep;
+void Sampler::queueFilteredVoice( const VoiceOutput& output, FilterState* pState,
+								  const float* pBuffer_L, const float* pBuffer_R,
+								  const EngineContext& context )
+{
+	FilterQueue* pQueue = output.pMix != nullptr ? output.pMix->pFilterQueue : m_pFilterQueue;
+	auto pInstr = output.pNote->get_instrument();
+
+	int nVoice = pQueue->filter.add( pState, pInstr->get_filter_cutoff(),
+									 pInstr->get_filter_resonance(),
+									 output.nOffset, output.nFrames );
+	if ( nVoice == -1 ) {
+		flushFilterQueue( pQueue, context );
+		nVoice = pQueue->filter.add( pState, pInstr->get_filter_cutoff(),
+									 pInstr->get_filter_resonance(),
+									 output.nOffset, output.nFrames );
 	}
-	if ( pNote->get_instrument()->is_filter_active() && pNote->filter_sustain() ) {
-		// Note is still ringing, do not end.
-		retValue = false;
+
+	memcpy( &pQueue->filter.getBuffer_L( nVoice )[ output.nOffset ], &pBuffer_L[ output.nOffset ],
+			output.nFrames * sizeof( float ) );
+	memcpy( &pQueue->filter.getBuffer_R( nVoice )[ output.nOffset ], &pBuffer_R[ output.nOffset ],
+			output.nFrames * sizeof( float ) );
+	pQueue->outputs[ nVoice ] = output;
+}
+
+void Sampler::flushFilterQueue( FilterQueue* pQueue, const EngineContext& context )
+{
+	if ( pQueue->filter.getVoiceCount() == 0 ) {
+		return;
+	}
+
+	pQueue->filter.process();
+	for ( int nVoice = 0; nVoice < pQueue->filter.getVoiceCount(); ++nVoice ) {
+		mixVoice( pQueue->outputs[ nVoice ], pQueue->filter.getBuffer_L( nVoice ),
+				  pQueue->filter.getBuffer_R( nVoice ), context );
 	}
+	pQueue->filter.clear();
+}
+
+void Sampler::mixVoice( const VoiceOutput& output, const float* pBuffer_L,
+						const float* pBuffer_R, const EngineContext& context )
+{
+	auto pInstr = output.pNote->get_instrument();
+	float fInstrPeak_L = pInstr->get_peak_l(); // this value will be reset to 0 by the mixer..
+	float fInstrPeak_R = pInstr->get_peak_r(); // this value will be reset to 0 by the mixer..
+
+	float fVal_L;
+	float fVal_R;
 
 	// Mix rendered sample buffer to track and mixer output
-	for ( int nBufferPos = nInitialBufferPos; nBufferPos < nTimes; ++nBufferPos ) {
+	const int nTimes = output.nOffset + output.nFrames;
+	for ( int nBufferPos = output.nOffset; nBufferPos < nTimes; ++nBufferPos ) {
 
-		fVal_L = buffer_L[nBufferPos];
-		fVal_R = buffer_R[nBufferPos];
+		fVal_L = pBuffer_L[nBufferPos];
+		fVal_R = pBuffer_R[nBufferPos];
 
-#ifdef H2CORE_HAVE_JACK
-		if ( pTrackOutL ) {
-			pTrackOutL[nBufferPos] += fVal_L * cost_track_L;
+		if ( output.pTrackOut_L ) {
+			output.pTrackOut_L[nBufferPos] += fVal_L * output.fCostTrack_L;
 		}
-		if ( pTrackOutR ) {
-			pTrackOutR[nBufferPos] += fVal_R * cost_track_R;
+		if ( output.pTrackOut_R ) {
+			output.pTrackOut_R[nBufferPos] += fVal_R * output.fCostTrack_R;
 		}
-#endif
 
-		fVal_L = fVal_L * cost_L;
-		fVal_R = fVal_R * cost_R;
+		fVal_L = fVal_L * output.fCost_L;
+		fVal_R = fVal_R * output.fCost_R;
 
 		// update instr peak
 		if ( fVal_L > fInstrPeak_L ) {
@@ -1393,74 +1934,68 @@ bool Sampler::renderNoteResample(
 			fInstrPeak_R = fVal_R;
 		}
 
-		pDrumCompo->set_outs( nBufferPos, fVal_L, fVal_R );
+		output.pCompoOut_L[nBufferPos] += fVal_L;
+		output.pCompoOut_R[nBufferPos] += fVal_R;
 
 		// to main mix
-		m_pMainOut_L[nBufferPos] += fVal_L;
-		m_pMainOut_R[nBufferPos] += fVal_R;
-
+		output.pMainOut_L[nBufferPos] += fVal_L;
+		output.pMainOut_R[nBufferPos] += fVal_R;
 	}
 
-	pSelectedLayerInfo->SamplePosition += nAvail_bytes * fStep;
-	pNote->get_instrument()->set_peak_l( fInstrPeak_L );
-	pNote->get_instrument()->set_peak_r( fInstrPeak_R );
-
+	pInstr->set_peak_l( fInstrPeak_L );
+	pInstr->set_peak_r( fInstrPeak_R );
 
 #ifdef H2CORE_HAVE_LADSPA
 	// LADSPA
-	// change the below return logic if you add code after that ifdef
-	if ( pNote->get_instrument()->is_muted() || pSong->getIsMuted() ) {
-		return retValue;
+	if ( ! output.bSendToFX || pInstr->is_muted() || context.pSong->getIsMuted() ) {
+		return;
 	}
-	float masterVol = pSong->getVolume();
+	float masterVol = context.pSong->getVolume();
 	for ( unsigned nFX = 0; nFX < MAX_FX; ++nFX ) {
-		LadspaFX *pFX = Effects::get_instance()->getLadspaFX( nFX );
-		float fLevel = pNote->get_instrument()->get_fx_level( nFX );
+		LadspaFX *pFX = m_pFX[ nFX ];
+		float fLevel = pInstr->get_fx_level( nFX );
 		if ( ( pFX ) && ( fLevel != 0.0 ) ) {
 			fLevel = fLevel * pFX->getVolume();
 
-			float *pBuf_L = pFX->m_pBuffer_L;
-			float *pBuf_R = pFX->m_pBuffer_R;
+			float *pBuf_L = output.pMix != nullptr ? output.pMix->getFXOut_L( nFX ) : pFX->m_pBuffer_L;
+			float *pBuf_R = output.pMix != nullptr ? output.pMix->getFXOut_R( nFX ) : pFX->m_pBuffer_R;
 
 			float fFXCost_L = fLevel * masterVol;
 			float fFXCost_R = fLevel * masterVol;
 
-			int nBufferPos = nInitialBufferPos;
-			for ( int i = 0; i < nAvail_bytes; ++i ) {
-
-				fVal_L = buffer_L[ nBufferPos ];
-				fVal_R = buffer_R[ nBufferPos ];
-
-				pBuf_L[ nBufferPos ] += fVal_L * fFXCost_L;
-				pBuf_R[ nBufferPos ] += fVal_R * fFXCost_R;
-				++nBufferPos;
+			for ( int nBufferPos = output.nOffset; nBufferPos < nTimes; ++nBufferPos ) {
+				pBuf_L[ nBufferPos ] += pBuffer_L[ nBufferPos ] * fFXCost_L;
+				pBuf_R[ nBufferPos ] += pBuffer_R[ nBufferPos ] * fFXCost_R;
 			}
 		}
 	}
+	// ~LADSPA
 #endif
-	return retValue;
 }
 
 
 void Sampler::stopPlayingNotes( std::shared_ptr<Instrument> pInstr )
 {
 	if ( pInstr ) { // stop all notes using this instrument
-		for ( unsigned i = 0; i < m_playingNotesQueue.size(); ) {
-			Note *pNote = m_playingNotesQueue[ i ];
+		int nRemaining = 0;
+		for ( int nVoice = 0; nVoice < m_playingNotesQueue.size(); ++nVoice ) {
+			Note *pNote = m_playingNotesQueue[ nVoice ];
 			assert( pNote );
 			if ( pNote->get_instrument() == pInstr ) {
-				delete pNote;
+				releaseNote( pNote );
 				pInstr->dequeue();
-				m_playingNotesQueue.erase( m_playingNotesQueue.begin() + i );
+			} else {
+				m_playingNotesQueue[ nRemaining ] = pNote;
+				++nRemaining;
 			}
-			++i;
 		}
+		m_playingNotesQueue.resize( nRemaining );
 	} else { // stop all notes
 		// delete all copied notes in the playing notes queue
 		for ( unsigned i = 0; i < m_playingNotesQueue.size(); ++i ) {
 			Note *pNote = m_playingNotesQueue[i];
 			pNote->get_instrument()->dequeue();
-			delete pNote;
+			releaseNote( pNote );
 		}
 		m_playingNotesQueue.clear();
 	}
@@ -1478,10 +2013,12 @@ void Sampler::preview_sample(std::shared_ptr<Sample> pSample, int length )
 
 		pLayer->set_sample( pSample );
 
-		Note *pPreviewNote = new Note( m_pPreviewInstrument, 0, 1.0, 0.f, length, 0 );
+		Note *pPreviewNote = m_pNotePool->acquire( m_pPreviewInstrument, 0, 1.0, 0.f, length, 0 );
 
 		stopPlayingNotes( m_pPreviewInstrument );
-		noteOn( pPreviewNote );
+		if ( pPreviewNote != nullptr ) {
+			noteOn( pPreviewNote );
+		}
 
 	}
 
@@ -1501,9 +2038,11 @@ void Sampler::preview_instrument( std::shared_ptr<Instrument> pInstr )
 	m_pPreviewInstrument = pInstr;
 	pInstr->set_is_preview_instrument(true);
 
-	Note *pPreviewNote = new Note( m_pPreviewInstrument, 0, 1.0, 0.f, MAX_NOTES, 0 );
+	Note *pPreviewNote = m_pNotePool->acquire( m_pPreviewInstrument, 0, 1.0, 0.f, MAX_NOTES, 0 );
 
-	noteOn( pPreviewNote );	// exclusive note
+	if ( pPreviewNote != nullptr ) {
+		noteOn( pPreviewNote );	// exclusive note
+	}
 	Hydrogen::get_instance()->getAudioEngine()->unlock();
 }
 
@@ -1549,26 +2088,19 @@ void Sampler::setPlayingNotelength( std::shared_ptr<Instrument> pInstrument, uns
 							if( !Preferences::get_instance()->__playselectedinstrument ){
 								if ( pNote->get_instrument() == pInstrument
 								&& pNote->get_position() == noteOnTick ) {
-									pHydrogen->getAudioEngine()->lock( RIGHT_HERE );
-
 									if ( ticks >  patternsize ) {
 										ticks = patternsize - noteOnTick;
 									}
 									pNote->set_length( ticks );
-									Hydrogen::get_instance()->setIsModified( true );
-									pHydrogen->getAudioEngine()->unlock(); // unlock the audio engine
 								}
 							}else
 							{
 								if ( pNote->get_instrument() == pHydrogen->getSong()->getInstrumentList()->get( pHydrogen->getSelectedInstrumentNumber())
 								&& pNote->get_position() == noteOnTick ) {
-									Hydrogen::get_instance()->getAudioEngine()->lock( RIGHT_HERE );
 									if ( ticks >  patternsize ) {
 										ticks = patternsize - noteOnTick;
 									}
 									pNote->set_length( ticks );
-									pHydrogen->setIsModified( true );
-									pHydrogen->getAudioEngine()->unlock(); // unlock the audio engine
 								}
 							}
 						}
@@ -1580,24 +2112,6 @@ void Sampler::setPlayingNotelength( std::shared_ptr<Instrument> pInstrument, uns
 	EventQueue::get_instance()->push_event( EVENT_PATTERN_MODIFIED, -1 );
 }
 
-bool Sampler::isAnyInstrumentSoloed() const
-{
-	Hydrogen*		pHydrogen = Hydrogen::get_instance();
-	std::shared_ptr<Song> 			pSong = pHydrogen->getSong();
-	InstrumentList* pInstrList = pSong->getInstrumentList();
-	bool			bAnyInstrumentIsSoloed = false;
-	
-	for(int i=0; i < pInstrList->size(); i++) {
-		std::shared_ptr<Instrument> pInstr = pInstrList->get( i );
-		
-		if( pInstr->is_soloed() )	{
-			bAnyInstrumentIsSoloed = true;
-		}
-	}
-	
-	return bAnyInstrumentIsSoloed;
-}
-
 bool Sampler::isInstrumentPlaying( std::shared_ptr<Instrument> instrument )
 {
 	if ( instrument ) { // stop all notes using this instrument
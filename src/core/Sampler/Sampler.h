@@ -27,6 +27,8 @@
 #include <core/Object.h>
 #include <core/Globals.h>
 #include <core/Sampler/Interpolation.h>
+#include <core/Sampler/RenderPlan.h>
+#include <core/Sampler/VoiceFilter.h>
 
 #include <inttypes.h>
 #include <vector>
@@ -41,8 +43,17 @@ class Sample;
 class DrumkitComponent;
 class Instrument;
 struct SelectedLayerInfo;
+struct FilterState;
 class InstrumentComponent;
 class AudioOutput;
+class VoiceRenderPool;
+class VoiceAllocator;
+class SampleStreamer;
+class SampleConverter;
+class LazySampleLoader;
+class NotePool;
+class LadspaFX;
+struct EngineContext;
 
 ///
 /// Waveform based sampler.
@@ -169,16 +180,27 @@ public:
 	 *
 	 * It is called by AudioEngine::AudioEngine() and stored in
 	 * AudioEngine::m_pSampler.
+	 *
+	 * \param pNotePool Pool all notes are returned to once they are
+	 * done playing.
 	 */
-	Sampler();
+	Sampler( NotePool* pNotePool );
 	~Sampler();
 
-	void process( uint32_t nFrames, std::shared_ptr<Song> pSong );
+	/**
+	 * Renders all playing notes.
+	 *
+	 * \param context State of the engine the notes are rendered
+	 * with. It is passed on to all render functions and has to
+	 * outlive the call.
+	 */
+	void process( uint32_t nFrames, const EngineContext& context );
 
 	/// Start playing a note
 	void noteOn( Note * pNote );
 
-	/// Stop playing a note.
+	/// Stop playing all notes of the instrument of @a pNote. The
+	/// Sampler does not take ownership of @a pNote.
 	void noteOff( Note *pNote );
 	void midiKeyboardNoteOff( int key );
 
@@ -191,6 +213,15 @@ public:
 	void preview_sample( std::shared_ptr<Sample> pSample, int length );
 	void preview_instrument( std::shared_ptr<Instrument> pInstr );
 
+	/**
+	 * Sets the length of the note of @a pInstrument starting at @a
+	 * noteOnTick in the current pattern to @a ticks.
+	 *
+	 * Called by the audio thread for recorded MIDI note-off messages
+	 * and must be called while holding the AudioEngine lock. The
+	 * Song was already marked modified when recording the note
+	 * itself.
+	 */
 	void setPlayingNotelength( std::shared_ptr<Instrument> pInstrument, unsigned long ticks, unsigned long noteOnTick );
 	bool isInstrumentPlaying( std::shared_ptr<Instrument> pInstr );
 
@@ -208,6 +239,19 @@ public:
 
 	Interpolation::InterpolateMode getInterpolateMode(){ return m_interpolateMode; }
 
+	/** See AudioEngine::setOfflineMode().*/
+	void setOfflineMode( bool bOffline );
+
+	/**
+	 * Renders the voices of different instruments - and thus the
+	 * stems of an export - on @a nWorkers additional threads in case
+	 * Preferences::m_nSamplerWorkerThreads did not create a
+	 * #m_pVoiceRenderPool already. 0 drops these threads again.
+	 *
+	 * Must not be called while an audio driver is running.
+	 */
+	void setExportWorkerThreads( int nWorkers );
+
 	/**
 	 * Loading of the playback track.
 	 *
@@ -218,9 +262,256 @@ public:
 	 */
 	void reinitializePlaybackTrack();
 	
+	/** Maximum number of drumkit components a song may contain
+	 * for its voices to be rendered by the #m_pVoiceRenderPool.*/
+	static const int nMaxVoiceMixComponents = 16;
+	/** Maximum number of voices streaming their samples from disk
+	 * at the same time.*/
+	static const int nMaxStreams = 64;
+
 private:
+	struct FilterQueue;
+
+	/**
+	 * Private accumulation buses of a single partition of the
+	 * #m_pVoiceRenderPool.
+	 *
+	 * They mirror #m_pMainOut_L, #m_pMainOut_R, the outs of the
+	 * DrumkitComponent of the current Song, and the LADSPA send
+	 * buffers. All of them are allocated once in the constructor.
+	 */
+	struct VoiceMix {
+		VoiceMix();
+		~VoiceMix();
+
+		/** Zeroes the first @a nFrames frames of all buses.*/
+		void reset( uint32_t nFrames );
+
+		/** Bus of the component at position @a nComponent in
+		 * #components.*/
+		float* getComponentOut_L( int nComponent ) {
+			return &pComponentOuts_L[ nComponent * MAX_BUFFER_SIZE ];
+		}
+		float* getComponentOut_R( int nComponent ) {
+			return &pComponentOuts_R[ nComponent * MAX_BUFFER_SIZE ];
+		}
+		float* getFXOut_L( int nFX ) {
+			return &pFXOuts_L[ nFX * MAX_BUFFER_SIZE ];
+		}
+		float* getFXOut_R( int nFX ) {
+			return &pFXOuts_R[ nFX * MAX_BUFFER_SIZE ];
+		}
+
+		float* pMainOut_L;
+		float* pMainOut_R;
+		/** #nMaxVoiceMixComponents consecutive buffers.*/
+		float* pComponentOuts_L;
+		float* pComponentOuts_R;
+		/** #MAX_FX consecutive buffers.*/
+		float* pFXOuts_L;
+		float* pFXOuts_R;
+
+		/** Components of the Song currently rendered.*/
+		std::vector<DrumkitComponent*> components;
+		/** Indices in #m_playingNotesQueue of the voices assigned
+		 * to this partition.*/
+		std::vector<int> voices;
+		/** Filtered voices of this partition.*/
+		FilterQueue* pFilterQueue;
+
+		/** Records that @a pNote could not be rendered. Logging is
+		 * left to the audio thread, see renderVoicesParallel().*/
+		void voiceFailed( Note* pNote, const char* sReason ) {
+			if ( nFailedVoices == 0 ) {
+				pFailedNote = pNote;
+				sFailureReason = sReason;
+			}
+			++nFailedVoices;
+		}
+		/** Number of voices which could not be rendered during the
+		 * current cycle along with the first of them.*/
+		int nFailedVoices;
+		Note* pFailedNote;
+		const char* sFailureReason;
+	};
+
+	/** Block of a voice rendered during the current cycle and the
+	 * buses it is mixed into, see mixVoice().*/
+	struct VoiceOutput {
+		Note* pNote;
+		/** First frame of the block.*/
+		int nOffset;
+		int nFrames;
+		float fCost_L;
+		float fCost_R;
+		float fCostTrack_L;
+		float fCostTrack_R;
+		/** Either JACK track or stem outputs. May be nullptr.*/
+		float* pTrackOut_L;
+		float* pTrackOut_R;
+		float* pCompoOut_L;
+		float* pCompoOut_R;
+		float* pMainOut_L;
+		float* pMainOut_R;
+		/** Whether the block is sent to the LADSPA effects as
+		 * well.*/
+		bool bSendToFX;
+		/** Partition the voice is rendered in. If nullptr, the
+		 * shared LADSPA buffers are used.*/
+		VoiceMix* pMix;
+	};
+
+	/**
+	 * Voices with an active resonant filter rendered during the
+	 * current cycle.
+	 *
+	 * They are filtered together by the VoiceFilter and mixed only
+	 * afterwards, see flushFilterQueue().
+	 */
+	struct FilterQueue {
+		VoiceFilter filter;
+		/** Output of the voice queued at the same position in
+		 * #filter.*/
+		VoiceOutput outputs[ VoiceFilter::nMaxVoices ];
+	};
+	/** Filtered voices rendered on the calling thread.*/
+	FilterQueue* m_pFilterQueue;
+
+	/**
+	 * Collects the buses the block of @a nFrames frames starting at
+	 * @a nOffset rendered for @a pNote playing @a component is mixed
+	 * into.
+	 *
+	 * \param bSendToFX Whether the block is sent to the LADSPA
+	 * effects by mixVoice().
+	 */
+	VoiceOutput createVoiceOutput( Note* pNote,
+								   const RenderPlan::Component& component,
+								   int nOffset, int nFrames,
+								   float cost_L, float cost_R,
+								   float cost_track_L, float cost_track_R,
+								   bool bSendToFX,
+								   const EngineContext& context,
+								   VoiceMix* pMix );
+	/** Adds the voice - rendered into the first @a output.nOffset
+	 * + @a output.nFrames frames of @a pBuffer_L and @a pBuffer_R -
+	 * to the queue of its partition. The queue is flushed in case
+	 * it is full.*/
+	void queueFilteredVoice( const VoiceOutput& output, FilterState* pState,
+							 const float* pBuffer_L, const float* pBuffer_R,
+							 const EngineContext& context );
+	/** Filters all voices in @a pQueue and mixes them.*/
+	void flushFilterQueue( FilterQueue* pQueue, const EngineContext& context );
+	/** Mixes a rendered voice into the buses in @a output.*/
+	void mixVoice( const VoiceOutput& output, const float* pBuffer_L,
+				   const float* pBuffer_R, const EngineContext& context );
+
+	/** Voices in the order they were started. Finished ones are
+	 * dropped in a single pass per cycle, see removeEndedVoices().*/
 	std::vector<Note*> m_playingNotesQueue;
 	std::vector<Note*> m_queuedNoteOffs;
+
+	/** Fades out voices exceeding the voice limits.*/
+	VoiceAllocator* m_pVoiceAllocator;
+
+	/** Closes the streams opened for @a pNote and hands it back to
+	 * the #m_pNotePool.*/
+	void releaseNote( Note* pNote );
+
+	/** Owned by the AudioEngine.*/
+	NotePool* m_pNotePool;
+
+	/**
+	 * Optional helper threads rendering the playing notes in
+	 * parallel. Created in the constructor if
+	 * Preferences::m_nSamplerWorkerThreads is larger than zero or
+	 * by setExportWorkerThreads() and nullptr otherwise.
+	 */
+	VoiceRenderPool* m_pVoiceRenderPool;
+	/** Whether #m_pVoiceRenderPool was created by
+	 * setExportWorkerThreads().*/
+	bool m_bExportRenderPool;
+	/** Creates #m_pVoiceRenderPool and one VoiceMix per
+	 * partition.*/
+	void createVoiceRenderPool( int nWorkers );
+	/** Joins the workers of #m_pVoiceRenderPool and frees their
+	 * buffers.*/
+	void deleteVoiceRenderPool();
+	/**
+	 * Reads the non-resident part of long samples from disk. Created
+	 * in the constructor if Preferences::m_nSampleStreamingPreloadMs
+	 * is larger than zero and nullptr otherwise.
+	 */
+	SampleStreamer* m_pSampleStreamer;
+	/**
+	 * Converts samples to the sample rate of the audio driver.
+	 * Created in the constructor if
+	 * Preferences::m_bConvertSampleRate is set and nullptr
+	 * otherwise.
+	 */
+	SampleConverter* m_pSampleConverter;
+	/**
+	 * Loads layers left unloaded by
+	 * Preferences::m_bSelectiveSampleLoading once they are played.
+	 * Always created since the preference may be changed at
+	 * runtime.
+	 */
+	LazySampleLoader* m_pLazySampleLoader;
+	/** One entry per partition of #m_pVoiceRenderPool.*/
+	std::vector<VoiceMix*> m_voiceMixes;
+	/** Whether the note at the corresponding position in
+	 * #m_playingNotesQueue did end during the current cycle.*/
+	std::vector<char> m_voiceEnded;
+
+	/**
+	 * Removes all notes flagged in #m_voiceEnded from
+	 * #m_playingNotesQueue and queues their note-offs unless their
+	 * resonant filter is still ringing. The order of the remaining
+	 * ones is preserved.
+	 */
+	void removeEndedVoices();
+	/** Partition each instrument got assigned to in the current
+	 * cycle.*/
+	std::vector<std::pair<Instrument*, int>> m_instrumentPartitions;
+	uint32_t m_nVoiceRenderFrames;
+	/** Context of the process() call the partitions are rendered
+	 * in.*/
+	const EngineContext* m_pVoiceRenderContext;
+
+	/**
+	 * Renders all playing notes using #m_pVoiceRenderPool.
+	 *
+	 * Voices are grouped by their instrument, so instrument peaks
+	 * and JACK track outputs are never touched by more than one
+	 * thread. Each partition filters its voices on its own. Notes which did not start
+	 * yet still have to select their layer - which involves
+	 * song-wide round robin state, random numbers, and MIDI output
+	 * - and are rendered serially on the calling thread
+	 * beforehand. The private buses of all partitions are summed
+	 * into the shared ones in partition order afterwards, which
+	 * keeps the result independent of the thread scheduling.
+	 */
+	void renderVoicesParallel( uint32_t nFrames, const EngineContext& context );
+	/** VoiceRenderPool::Job rendering a single partition.*/
+	static void renderVoicePartition( void* pContext, int nPartition );
+	/** Whether @a pNote did already select its layers and start
+	 * playing back.*/
+	bool isVoiceStarted( Note* pNote ) const;
+
+	/** Brings the RenderPlan of all instruments in
+	 * #m_playingNotesQueue up to date. Called at the beginning of
+	 * each cycle, before any voice is rendered.*/
+	void updateRenderPlans( const EngineContext& context );
+	/** Recompiles the RenderPlan of @a pInstr if necessary and
+	 * refreshes its pan gains and track outputs. Does nothing if it
+	 * was already updated in the current cycle.*/
+	void updateRenderPlan( std::shared_ptr<Instrument> pInstr, const EngineContext& context );
+	/** Incremented by updateRenderPlans() each cycle.*/
+	unsigned m_nRenderPlanCycle;
+	/** LADSPA effects of the current cycle. Retrieved by process()
+	 * so the #m_pVoiceRenderPool does not access the Effects
+	 * singleton.*/
+	LadspaFX* m_pFX[ MAX_FX ];
 	
 	/// Instrument used for the playback track feature.
 	std::shared_ptr<Instrument> m_pPlaybackTrackInstrument;
@@ -239,15 +530,23 @@ private:
 	
 	/** function to direct the computation to the selected pan law function
 	 */
-	float panLaw( float fPan, std::shared_ptr<Song> pSong );
+	float panLaw( float fPan, Song* pSong );
 
 
 
-	bool processPlaybackTrack(int nBufferSize);
+	bool processPlaybackTrack( int nBufferSize, const EngineContext& context );
 	
-	bool isAnyInstrumentSoloed() const;
-	
-	bool renderNote( Note* pNote, unsigned nBufferSize, std::shared_ptr<Song> pSong );
+	/**
+	 * @param pMix Private buses of a #m_pVoiceRenderPool partition
+	 * the note is rendered into. If set to nullptr, it is mixed into
+	 * the shared ones instead.
+	 */
+	bool renderNote( Note* pNote, unsigned nBufferSize, const EngineContext& context, VoiceMix* pMix = nullptr );
+	/** \return Layer of @a pCompo holding a loaded sample whose
+	 * velocity range is closest to @a fVelocity or -1 if there is
+	 * none. Played while the selected one is loaded by the
+	 * #m_pLazySampleLoader.*/
+	int findLoadedLayer( std::shared_ptr<InstrumentComponent> pCompo, float fVelocity ) const;
 
 	Interpolation::InterpolateMode m_interpolateMode;
 
@@ -255,23 +554,22 @@ private:
 		std::shared_ptr<Sample> pSample,
 		Note *pNote,
 		SelectedLayerInfo *pSelectedLayerInfo,
-		std::shared_ptr<InstrumentComponent> pCompo,
-		DrumkitComponent *pDrumCompo,
+		const RenderPlan::Component& component,
 		int nBufferSize,
 		int nInitialSilence,
 		float cost_L,
 		float cost_R,
 		float cost_track_L,
 		float cost_track_R,
-		std::shared_ptr<Song> pSong
+		const EngineContext& context,
+		VoiceMix* pMix
 	);
 
 	bool renderNoteResample(
 		std::shared_ptr<Sample> pSample,
 		Note *pNote,
 		SelectedLayerInfo *pSelectedLayerInfo,
-		std::shared_ptr<InstrumentComponent> pCompo,
-		DrumkitComponent *pDrumCompo,
+		const RenderPlan::Component& component,
 		int nBufferSize,
 		int nInitialSilence,
 		float cost_L,
@@ -279,7 +577,8 @@ private:
 		float cost_track_L,
 		float cost_track_R,
 		float fLayerPitch,
-		std::shared_ptr<Song> pSong
+		const EngineContext& context,
+		VoiceMix* pMix
 	);
 };
 
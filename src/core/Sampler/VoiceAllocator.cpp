@@ -0,0 +1,189 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#include <core/Sampler/VoiceAllocator.h>
+
+#include <core/AudioEngine/EngineContext.h>
+#include <core/Basics/Adsr.h>
+#include <core/Basics/Instrument.h>
+#include <core/Basics/Note.h>
+
+namespace H2Core
+{
+
+VoiceAllocator::VoiceAllocator( int nMaxVoices )
+	: m_nCounted( 0 )
+{
+	m_counted.reserve( nMaxVoices );
+	m_instrumentVoices.reserve( nMaxVoices );
+	m_muteGroupVoices.reserve( nMaxVoices );
+}
+
+VoiceAllocator::~VoiceAllocator()
+{
+}
+
+template<typename Key>
+static int* findCount( std::vector<std::pair<Key, int>>& counts, Key key )
+{
+	for ( auto& entry : counts ) {
+		if ( entry.first == key ) {
+			return &entry.second;
+		}
+	}
+	return nullptr;
+}
+
+int VoiceAllocator::steal( const std::vector<Note*>& voices, const EngineContext& context )
+{
+	m_counted.assign( voices.size(), false );
+	m_nCounted = 0;
+	m_instrumentVoices.clear();
+	m_muteGroupVoices.clear();
+
+	for ( int nVoice = 0; nVoice < voices.size(); ++nVoice ) {
+		Note* pNote = voices[ nVoice ];
+		const auto state = pNote->get_adsr()->get_state();
+		if ( state == ADSR::FADE_OUT || state == ADSR::IDLE ) {
+			continue;
+		}
+		m_counted[ nVoice ] = true;
+		++m_nCounted;
+
+		Instrument* pInstr = pNote->get_instrument().get();
+		int* pCount = findCount( m_instrumentVoices, pInstr );
+		if ( pCount != nullptr ) {
+			++( *pCount );
+		} else {
+			m_instrumentVoices.push_back( std::make_pair( pInstr, 1 ) );
+		}
+
+		const int nMuteGroup = pInstr->get_mute_group();
+		if ( nMuteGroup != -1 ) {
+			pCount = findCount( m_muteGroupVoices, nMuteGroup );
+			if ( pCount != nullptr ) {
+				++( *pCount );
+			} else {
+				m_muteGroupVoices.push_back( std::make_pair( nMuteGroup, 1 ) );
+			}
+		}
+	}
+
+	const Policy policy = context.voiceStealingPolicy;
+	int nStolen = 0;
+
+	while ( m_nCounted > context.nMaxNotes ) {
+		stealVoice( voices, pickVoice( voices, policy, nullptr, -1 ) );
+		++nStolen;
+	}
+
+	if ( context.nMaxNotesPerInstrument > 0 ) {
+		for ( const auto& entry : m_instrumentVoices ) {
+			while ( entry.second > context.nMaxNotesPerInstrument ) {
+				stealVoice( voices, pickVoice( voices, policy, entry.first, -1 ) );
+				++nStolen;
+			}
+		}
+	}
+
+	if ( context.nMaxNotesPerMuteGroup > 0 ) {
+		for ( const auto& entry : m_muteGroupVoices ) {
+			while ( entry.second > context.nMaxNotesPerMuteGroup ) {
+				stealVoice( voices, pickVoice( voices, policy, nullptr, entry.first ) );
+				++nStolen;
+			}
+		}
+	}
+
+	return nStolen;
+}
+
+int VoiceAllocator::pickVoice( const std::vector<Note*>& voices, Policy policy,
+							   Instrument* pInstrument, int nMuteGroup ) const
+{
+	int nOldest = -1;
+	int nQuietest = -1;
+	float fQuietestLevel = 0;
+	for ( int nVoice = 0; nVoice < voices.size(); ++nVoice ) {
+		if ( ! m_counted[ nVoice ] ) {
+			continue;
+		}
+		Note* pNote = voices[ nVoice ];
+		Instrument* pInstr = pNote->get_instrument().get();
+		if ( ( pInstrument != nullptr && pInstr != pInstrument ) ||
+			 ( nMuteGroup != -1 && pInstr->get_mute_group() != nMuteGroup ) ) {
+			continue;
+		}
+
+		if ( nOldest == -1 ) {
+			nOldest = nVoice;
+		}
+
+		switch ( policy ) {
+		case Policy::oldest:
+			return nVoice;
+		case Policy::oldestReleased:
+			if ( pNote->get_adsr()->get_state() == ADSR::RELEASE ) {
+				return nVoice;
+			}
+			break;
+		case Policy::quietest: {
+			// Ties are resolved in favor of the older voice.
+			const float fLevel = getLevel( pNote );
+			if ( nQuietest == -1 || fLevel < fQuietestLevel ) {
+				nQuietest = nVoice;
+				fQuietestLevel = fLevel;
+			}
+			break;
+		}
+		}
+	}
+
+	return nQuietest != -1 ? nQuietest : nOldest;
+}
+
+void VoiceAllocator::stealVoice( const std::vector<Note*>& voices, int nVoice )
+{
+	// Since the limits are only checked for counted voices, there
+	// always is one to pick.
+	Note* pNote = voices[ nVoice ];
+	pNote->get_adsr()->fade_out( nFadeOutFrames );
+
+	m_counted[ nVoice ] = false;
+	--m_nCounted;
+
+	Instrument* pInstr = pNote->get_instrument().get();
+	--( *findCount( m_instrumentVoices, pInstr ) );
+	if ( pInstr->get_mute_group() != -1 ) {
+		--( *findCount( m_muteGroupVoices, pInstr->get_mute_group() ) );
+	}
+}
+
+float VoiceAllocator::getLevel( Note* pNote )
+{
+	auto pADSR = pNote->get_adsr();
+	const float fEnvelope = pADSR->get_state() == ADSR::ATTACK ?
+		1.0 : pADSR->get_current_value();
+	auto pInstr = pNote->get_instrument();
+	return fEnvelope * pNote->get_velocity() * pInstr->get_gain() * pInstr->get_volume();
+}
+
+};
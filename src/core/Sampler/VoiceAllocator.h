@@ -0,0 +1,125 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#ifndef VOICE_ALLOCATOR_H
+#define VOICE_ALLOCATOR_H
+
+#include <core/Object.h>
+
+#include <utility>
+#include <vector>
+
+namespace H2Core
+{
+
+class Instrument;
+class Note;
+struct EngineContext;
+
+/**
+ * Decides which voices of the Sampler have to make room once one of
+ * the voice limits is exceeded.
+ *
+ * Besides the overall limit, Preferences::m_nMaxNotes, the number of
+ * voices can be limited per instrument and per mute group. Stolen
+ * voices are not removed at once - which would cause a click - but
+ * faded out within #nFadeOutFrames using ADSR::fade_out(). Once
+ * faded out, the Sampler drops them like any other finished note.
+ * Voices which are already fading out do not count toward any of
+ * the limits.
+ *
+ * All buffers are allocated in the constructor, so steal() may be
+ * called from within the audio thread.
+ *
+ * \ingroup docCore docAudioEngine
+ */
+class VoiceAllocator : public H2Core::Object<VoiceAllocator>
+{
+	H2_OBJECT(VoiceAllocator)
+public:
+	/** Which voice is stolen first.*/
+	enum class Policy {
+		/** The one started first.*/
+		oldest = 0,
+		/** The one with the lowest current level - the value of its
+		 * envelope times its velocity and the gain and volume of its
+		 * instrument. Voices still in their attack phase are
+		 * considered to be at full level.*/
+		quietest = 1,
+		/** The oldest one which was already released - e.g. by a
+		 * note-off or its mute group - and the oldest one in case
+		 * none was.*/
+		oldestReleased = 2
+	};
+
+	/** Number of frames stolen voices are faded out within.*/
+	static const int nFadeOutFrames = 256;
+
+	/**
+	 * \param nMaxVoices Number of voices space is reserved for. As
+	 * long as steal() is not called with more voices, it does not
+	 * allocate.
+	 */
+	explicit VoiceAllocator( int nMaxVoices );
+	~VoiceAllocator();
+
+	/**
+	 * Fades out voices till none of the limits stored in @a
+	 * context is exceeded anymore.
+	 *
+	 * \param voices Playing notes in the order they were started.
+	 *
+	 * \return Number of voices stolen.
+	 */
+	int steal( const std::vector<Note*>& voices, const EngineContext& context );
+
+private:
+	/**
+	 * \return Position in @a voices of the voice to steal next
+	 * among the counted ones matching @a pInstrument and @a
+	 * nMuteGroup or -1 if there is none.
+	 *
+	 * \param pInstrument If nullptr, voices of all instruments are
+	 * considered.
+	 * \param nMuteGroup If -1, voices of all mute groups are
+	 * considered.
+	 */
+	int pickVoice( const std::vector<Note*>& voices, Policy policy,
+				   Instrument* pInstrument, int nMuteGroup ) const;
+	/** Fades out the voice at position @a nVoice and stops counting
+	 * it.*/
+	void stealVoice( const std::vector<Note*>& voices, int nVoice );
+
+	static float getLevel( Note* pNote );
+
+	/** Whether the voice at the same position in the voices passed
+	 * to steal() counts toward the limits.*/
+	std::vector<char> m_counted;
+	int m_nCounted;
+	/** Counted voices of each instrument.*/
+	std::vector<std::pair<Instrument*, int>> m_instrumentVoices;
+	/** Counted voices of each mute group.*/
+	std::vector<std::pair<int, int>> m_muteGroupVoices;
+};
+
+};
+
+#endif
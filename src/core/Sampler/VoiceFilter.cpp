@@ -0,0 +1,178 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#include <core/Sampler/VoiceFilter.h>
+
+#include <core/Basics/Note.h>
+
+#include <algorithm>
+
+namespace H2Core
+{
+
+VoiceFilter::VoiceFilter()
+	: m_nVoices( 0 )
+{
+	m_pBuffers_L = new float[ nMaxVoices * MAX_BUFFER_SIZE ];
+	m_pBuffers_R = new float[ nMaxVoices * MAX_BUFFER_SIZE ];
+	m_pLanes = new float[ 2 * nLanes * MAX_BUFFER_SIZE ];
+}
+
+VoiceFilter::~VoiceFilter()
+{
+	delete[] m_pBuffers_L;
+	delete[] m_pBuffers_R;
+	delete[] m_pLanes;
+}
+
+int VoiceFilter::add( FilterState* pState, float fCutoff, float fResonance, int nOffset, int nFrames )
+{
+	if ( m_nVoices == nMaxVoices ) {
+		return -1;
+	}
+
+	Voice& voice = m_voices[ m_nVoices ];
+	voice.pState = pState;
+	voice.fCutoff = fCutoff;
+	voice.fResonance = fResonance;
+	voice.nOffset = nOffset;
+	voice.nFrames = nFrames;
+
+	return m_nVoices++;
+}
+
+void VoiceFilter::clear()
+{
+	m_nVoices = 0;
+}
+
+void VoiceFilter::process()
+{
+	for ( int nFirst = 0; nFirst < m_nVoices; nFirst += nLanes ) {
+		processLanes( nFirst, std::min( m_nVoices - nFirst, nLanes ) );
+	}
+}
+
+void VoiceFilter::processLanes( int nFirst, int nVoices )
+{
+	// Structure of arrays holding one voice per lane. Unused lanes
+	// do not process any frame.
+	float lowPass_L[ nLanes ] = {};
+	float lowPass_R[ nLanes ] = {};
+	float bandPass_L[ nLanes ] = {};
+	float bandPass_R[ nLanes ] = {};
+	float cutoff[ nLanes ] = {};
+	float cutoffStep[ nLanes ] = {};
+	float resonance[ nLanes ] = {};
+	float resonanceStep[ nLanes ] = {};
+	int frames[ nLanes ] = {};
+
+	int nFrames = 0;
+	for ( int nLane = 0; nLane < nVoices; ++nLane ) {
+		const Voice& voice = m_voices[ nFirst + nLane ];
+		const FilterState* pState = voice.pState;
+		lowPass_L[ nLane ] = pState->fLowPass_L;
+		lowPass_R[ nLane ] = pState->fLowPass_R;
+		bandPass_L[ nLane ] = pState->fBandPass_L;
+		bandPass_R[ nLane ] = pState->fBandPass_R;
+
+		// The first block of a voice is filtered with constant
+		// coefficients.
+		cutoff[ nLane ] = pState->fCutoff < 0 ? voice.fCutoff : pState->fCutoff;
+		resonance[ nLane ] = pState->fResonance < 0 ? voice.fResonance : pState->fResonance;
+		if ( voice.nFrames > 0 ) {
+			cutoffStep[ nLane ] = ( voice.fCutoff - cutoff[ nLane ] ) / voice.nFrames;
+			resonanceStep[ nLane ] = ( voice.fResonance - resonance[ nLane ] ) / voice.nFrames;
+		}
+
+		frames[ nLane ] = voice.nFrames;
+		nFrames = std::max( nFrames, voice.nFrames );
+	}
+
+	// Interleave the blocks. Frames of lanes which are already done
+	// are set to zero to not process garbage.
+	for ( int nLane = 0; nLane < nLanes; ++nLane ) {
+		const float* pBuffer_L = nullptr;
+		const float* pBuffer_R = nullptr;
+		if ( nLane < nVoices ) {
+			pBuffer_L = &getBuffer_L( nFirst + nLane )[ m_voices[ nFirst + nLane ].nOffset ];
+			pBuffer_R = &getBuffer_R( nFirst + nLane )[ m_voices[ nFirst + nLane ].nOffset ];
+		}
+		for ( int ii = 0; ii < frames[ nLane ]; ++ii ) {
+			m_pLanes[ 2 * ii * nLanes + nLane ] = pBuffer_L[ ii ];
+			m_pLanes[ ( 2 * ii + 1 ) * nLanes + nLane ] = pBuffer_R[ ii ];
+		}
+		for ( int ii = frames[ nLane ]; ii < nFrames; ++ii ) {
+			m_pLanes[ 2 * ii * nLanes + nLane ] = 0;
+			m_pLanes[ ( 2 * ii + 1 ) * nLanes + nLane ] = 0;
+		}
+	}
+
+	for ( int ii = 0; ii < nFrames; ++ii ) {
+		// Both channels share a single buffer, so the compiler
+		// knows they do not overlap.
+		float* pFrame_L = &m_pLanes[ 2 * ii * nLanes ];
+		float* pFrame_R = &m_pLanes[ ( 2 * ii + 1 ) * nLanes ];
+
+		// Branch-free, so it is vectorized. Lanes past the end of
+		// their block use a cutoff of 0 and a resonance of 1, which
+		// leaves their state untouched.
+		for ( int nLane = 0; nLane < nLanes; ++nLane ) {
+			cutoff[ nLane ] += cutoffStep[ nLane ];
+			resonance[ nLane ] += resonanceStep[ nLane ];
+			const bool bActive = ii < frames[ nLane ];
+			const float fCutoff = bActive ? cutoff[ nLane ] : 0.0f;
+			const float fResonance = bActive ? resonance[ nLane ] : 1.0f;
+
+			bandPass_L[ nLane ] = fResonance * bandPass_L[ nLane ] +
+				fCutoff * ( pFrame_L[ nLane ] - lowPass_L[ nLane ] );
+			lowPass_L[ nLane ] += fCutoff * bandPass_L[ nLane ];
+			bandPass_R[ nLane ] = fResonance * bandPass_R[ nLane ] +
+				fCutoff * ( pFrame_R[ nLane ] - lowPass_R[ nLane ] );
+			lowPass_R[ nLane ] += fCutoff * bandPass_R[ nLane ];
+
+			pFrame_L[ nLane ] = lowPass_L[ nLane ];
+			pFrame_R[ nLane ] = lowPass_R[ nLane ];
+		}
+	}
+
+	for ( int nLane = 0; nLane < nVoices; ++nLane ) {
+		const Voice& voice = m_voices[ nFirst + nLane ];
+		float* pBuffer_L = &getBuffer_L( nFirst + nLane )[ voice.nOffset ];
+		float* pBuffer_R = &getBuffer_R( nFirst + nLane )[ voice.nOffset ];
+		for ( int ii = 0; ii < voice.nFrames; ++ii ) {
+			pBuffer_L[ ii ] = m_pLanes[ 2 * ii * nLanes + nLane ];
+			pBuffer_R[ ii ] = m_pLanes[ ( 2 * ii + 1 ) * nLanes + nLane ];
+		}
+
+		FilterState* pState = voice.pState;
+		pState->fLowPass_L = lowPass_L[ nLane ];
+		pState->fLowPass_R = lowPass_R[ nLane ];
+		pState->fBandPass_L = bandPass_L[ nLane ];
+		pState->fBandPass_R = bandPass_R[ nLane ];
+		// Avoid drifting away due to the accumulated steps.
+		pState->fCutoff = voice.fCutoff;
+		pState->fResonance = voice.fResonance;
+		pState->bSustain = pState->isRinging();
+	}
+}
+
+};
@@ -0,0 +1,128 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#ifndef VOICE_FILTER_H
+#define VOICE_FILTER_H
+
+#include <core/Object.h>
+#include <core/Globals.h>
+
+namespace H2Core
+{
+
+struct FilterState;
+
+/**
+ * Resonant low pass filter of the Sampler applied to several voices
+ * at once.
+ *
+ * Instead of being filtered frame by frame while they are rendered,
+ * the blocks of all voices of an instrument with an active filter
+ * are queued using add() and processed together by process(). The
+ * parameters of the voices are gathered into a structure of arrays
+ * and #nLanes voices are filtered side by side, one per lane. As the
+ * lanes do not depend on each other, the compiler turns the inner
+ * loop into SIMD instructions.
+ *
+ * The cutoff and resonance of each voice are ramped linearly within
+ * the block from the ones used for its previous block to the
+ * current ones, so automating them does not cause zipper noise.
+ *
+ * All buffers are allocated in the constructor, so the filter may be
+ * used from within the audio thread.
+ *
+ * \ingroup docCore docAudioEngine
+ */
+class VoiceFilter : public H2Core::Object<VoiceFilter>
+{
+	H2_OBJECT(VoiceFilter)
+public:
+	/** Number of voices filtered side by side.*/
+	static const int nLanes = 4;
+	/** Number of voices which can be queued at once.*/
+	static const int nMaxVoices = 4 * nLanes;
+
+	VoiceFilter();
+	~VoiceFilter();
+
+	/**
+	 * Queues a block of a voice.
+	 *
+	 * The block has to be written to getBuffer_L() and
+	 * getBuffer_R() before process() is called.
+	 *
+	 * \param pState Filter state of the voice. It is updated by
+	 * process().
+	 * \param fCutoff Cutoff reached at the end of the block.
+	 * \param fResonance Resonance reached at the end of the block.
+	 * \param nOffset First frame of the block in the buffers.
+	 * \param nFrames Length of the block.
+	 *
+	 * \return Position of the voice in the queue or -1 if it is
+	 * full.
+	 */
+	int add( FilterState* pState, float fCutoff, float fResonance, int nOffset, int nFrames );
+
+	/** Buffers of #MAX_BUFFER_SIZE frames holding the block of the
+	 * voice at position @a nVoice.*/
+	float* getBuffer_L( int nVoice ) {
+		return &m_pBuffers_L[ nVoice * MAX_BUFFER_SIZE ];
+	}
+	float* getBuffer_R( int nVoice ) {
+		return &m_pBuffers_R[ nVoice * MAX_BUFFER_SIZE ];
+	}
+
+	int getVoiceCount() const {
+		return m_nVoices;
+	}
+
+	/** Filters the blocks of all queued voices in place and updates
+	 * their FilterState. The queue is left untouched.*/
+	void process();
+	/** Empties the queue.*/
+	void clear();
+
+private:
+	struct Voice {
+		FilterState* pState;
+		float fCutoff;
+		float fResonance;
+		int nOffset;
+		int nFrames;
+	};
+
+	/** Filters the voices starting at position @a nFirst in lanes
+	 * 0 to @a nVoices - 1.*/
+	void processLanes( int nFirst, int nVoices );
+
+	Voice m_voices[ nMaxVoices ];
+	int m_nVoices;
+	/** #nMaxVoices consecutive buffers.*/
+	float* m_pBuffers_L;
+	float* m_pBuffers_R;
+	/** Frames of all lanes interleaved. Each frame holds the left
+	 * channel of all lanes followed by the right one.*/
+	float* m_pLanes;
+};
+
+};
+
+#endif
@@ -0,0 +1,175 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#include <core/Sampler/VoiceRenderPool.h>
+
+#include <sched.h>
+#include <thread>
+
+namespace H2Core
+{
+
+/** Number of polls a worker spends busy-waiting for the next job
+ * before going to sleep. Roughly covers the gap between two
+ * consecutive process cycles at small buffer sizes.*/
+static const int nSpinIterations = 20000;
+
+VoiceRenderPool::VoiceRenderPool( int nWorkers )
+	: m_job( nullptr )
+	, m_pContext( nullptr )
+	, m_nGeneration( 0 )
+	, m_nPending( 0 )
+	, m_nSleeping( 0 )
+	, m_bQuit( false )
+{
+	pthread_mutex_init( &m_mutex, nullptr );
+	pthread_cond_init( &m_wakeup, nullptr );
+
+	// Busy-waiting workers sharing a core with the audio thread
+	// would only get in its way.
+	int nCores = static_cast<int>( std::thread::hardware_concurrency() );
+	if ( nCores > 0 && nWorkers > nCores - 1 ) {
+		WARNINGLOG( QString( "Only [%1] cores available. Reducing the number of voice render workers from [%2] to [%3]" )
+					.arg( nCores ).arg( nWorkers ).arg( nCores - 1 ) );
+		nWorkers = nCores - 1;
+	}
+
+	// Sized up front since the workers keep a pointer to their
+	// entry.
+	m_workers.resize( nWorkers );
+
+	for ( int ii = 0; ii < nWorkers; ++ii ) {
+		Worker* pWorker = &m_workers[ ii ];
+		pWorker->pPool = this;
+		pWorker->nPartition = ii + 1;
+
+		pthread_attr_t attr;
+		pthread_attr_init( &attr );
+		if ( pthread_create( &pWorker->thread, &attr, workerThread, pWorker ) != 0 ) {
+			ERRORLOG( QString( "Unable to create voice render worker [%1]" ).arg( ii ) );
+			pthread_attr_destroy( &attr );
+			m_workers.resize( ii );
+			break;
+		}
+		pthread_attr_destroy( &attr );
+
+#ifdef __linux__
+		// Pin the workers to distinct cores starting with the second
+		// one. The audio thread is created by the driver and is not
+		// pinned. Keeping the workers off the first core merely
+		// leaves one core to it and the rest of the system as long
+		// as there are fewer workers than cores. Failing to pin is
+		// not critical.
+		if ( nCores > 1 ) {
+			cpu_set_t cpuSet;
+			CPU_ZERO( &cpuSet );
+			CPU_SET( ( ii + 1 ) % nCores, &cpuSet );
+			if ( pthread_setaffinity_np( pWorker->thread, sizeof( cpu_set_t ), &cpuSet ) != 0 ) {
+				WARNINGLOG( QString( "Unable to pin voice render worker [%1]" ).arg( ii ) );
+			}
+		}
+#endif
+	}
+
+	INFOLOG( QString( "Using [%1] voice render workers" ).arg( m_workers.size() ) );
+}
+
+VoiceRenderPool::~VoiceRenderPool()
+{
+	m_bQuit = true;
+	pthread_mutex_lock( &m_mutex );
+	pthread_cond_broadcast( &m_wakeup );
+	pthread_mutex_unlock( &m_mutex );
+
+	for ( auto& worker : m_workers ) {
+		pthread_join( worker.thread, nullptr );
+	}
+
+	pthread_cond_destroy( &m_wakeup );
+	pthread_mutex_destroy( &m_mutex );
+}
+
+void VoiceRenderPool::run( Job job, void* pContext )
+{
+	if ( m_workers.empty() ) {
+		job( pContext, 0 );
+		return;
+	}
+
+	m_job = job;
+	m_pContext = pContext;
+	m_nPending = m_workers.size();
+	m_nGeneration.fetch_add( 1 );
+
+	// The mutex is only touched if at least one of the workers
+	// already went to sleep.
+	if ( m_nSleeping.load() > 0 ) {
+		pthread_mutex_lock( &m_mutex );
+		pthread_cond_broadcast( &m_wakeup );
+		pthread_mutex_unlock( &m_mutex );
+	}
+
+	job( pContext, 0 );
+
+	while ( m_nPending.load( std::memory_order_acquire ) > 0 ) {
+		sched_yield();
+	}
+}
+
+void* VoiceRenderPool::workerThread( void* pParam )
+{
+	Worker* pWorker = static_cast<Worker*>( pParam );
+	pWorker->pPool->workerLoop( pWorker->nPartition );
+	return nullptr;
+}
+
+void VoiceRenderPool::workerLoop( int nPartition )
+{
+	unsigned nSeenGeneration = 0;
+
+	while ( true ) {
+		int nSpin = 0;
+		while ( m_nGeneration.load( std::memory_order_acquire ) == nSeenGeneration &&
+				! m_bQuit.load() && nSpin < nSpinIterations ) {
+			++nSpin;
+		}
+
+		if ( m_nGeneration.load() == nSeenGeneration && ! m_bQuit.load() ) {
+			pthread_mutex_lock( &m_mutex );
+			m_nSleeping.fetch_add( 1 );
+			while ( m_nGeneration.load() == nSeenGeneration && ! m_bQuit.load() ) {
+				pthread_cond_wait( &m_wakeup, &m_mutex );
+			}
+			m_nSleeping.fetch_sub( 1 );
+			pthread_mutex_unlock( &m_mutex );
+		}
+
+		if ( m_bQuit.load() ) {
+			return;
+		}
+
+		nSeenGeneration = m_nGeneration.load();
+		m_job( m_pContext, nPartition );
+		m_nPending.fetch_sub( 1, std::memory_order_release );
+	}
+}
+
+};
@@ -0,0 +1,104 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#ifndef VOICE_RENDER_POOL_H
+#define VOICE_RENDER_POOL_H
+
+#include <core/Object.h>
+
+#include <atomic>
+#include <vector>
+#include <pthread.h>
+
+namespace H2Core
+{
+
+/**
+ * Set of helper threads the Sampler distributes its voices onto.
+ *
+ * All threads are created in the constructor and joined in the
+ * destructor, so run() itself neither allocates nor creates
+ * anything and may be called from within the audio callback.
+ *
+ * The pool provides getPartitionCount() partitions. Partition 0 is
+ * always processed by the thread calling run() while each of the
+ * remaining ones is handed to a dedicated worker. Workers busy-wait
+ * for a short while after finishing a job and only fall back to a
+ * condition variable when no new job arrived in the meantime. This
+ * way consecutive process cycles do not pay for a full wakeup.
+ *
+ * \ingroup docCore docAudioEngine
+ */
+class VoiceRenderPool : public H2Core::Object<VoiceRenderPool>
+{
+	H2_OBJECT(VoiceRenderPool)
+public:
+	/** Callback rendering partition @a nPartition. */
+	typedef void (*Job)( void* pContext, int nPartition );
+
+	/**
+	 * @param nWorkers Number of threads to spawn in addition to
+	 * the calling one.
+	 */
+	VoiceRenderPool( int nWorkers );
+	~VoiceRenderPool();
+
+	/** Number of partitions the work has to be split into. */
+	int getPartitionCount() const {
+		return m_workers.size() + 1;
+	}
+
+	/**
+	 * Invokes @a job for all partitions and returns after every
+	 * single one is done.
+	 */
+	void run( Job job, void* pContext );
+
+private:
+	struct Worker {
+		VoiceRenderPool* pPool;
+		int nPartition;
+		pthread_t thread;
+	};
+
+	static void* workerThread( void* pParam );
+	void workerLoop( int nPartition );
+
+	std::vector<Worker> m_workers;
+
+	Job m_job;
+	void* m_pContext;
+
+	/** Incremented once per run() to signal a new job.*/
+	std::atomic<unsigned> m_nGeneration;
+	/** Number of workers which did not finish the current job yet.*/
+	std::atomic<int> m_nPending;
+	/** Number of workers waiting on #m_wakeup.*/
+	std::atomic<int> m_nSleeping;
+	std::atomic<bool> m_bQuit;
+
+	pthread_mutex_t m_mutex;
+	pthread_cond_t m_wakeup;
+};
+
+};
+
+#endif
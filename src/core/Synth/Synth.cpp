@@ -22,6 +22,7 @@
 
 
 #include <core/Synth/Synth.h>
+#include <core/AudioEngine/EngineContext.h>
 #include <core/Basics/Note.h>
 #include <core/Globals.h>
 
@@ -90,8 +91,7 @@ void Synth::noteOff( Note* pNote )
 
 
 
-// perche' viene passata anche la canzone? E' davvero necessaria?
-void Synth::process( uint32_t nFrames )
+void Synth::process( uint32_t nFrames, const EngineContext& context )
 {
 	//INFOLOG( "process" );
 
@@ -104,7 +104,7 @@ void Synth::process( uint32_t nFrames )
 		//pPlayingNote->dumpInfo();
 
 		float fAmplitude = pPlayingNote->get_velocity();
-		float fFrequency = TWOPI * 220.0 / 44100.0;
+		float fFrequency = TWOPI * 220.0 / context.nSampleRate;
 
 		for ( uint i = 0; i < nFrames; ++i ) {
 			float fVal = sin( m_fTheta ) * fAmplitude;
@@ -34,6 +34,7 @@ namespace H2Core
 {
 class Note;
 class AudioOutput;
+struct EngineContext;
 
 ///
 /// A simple synthetizer...
@@ -61,7 +62,9 @@ public:
 	/// Stop playing a note.
 	void noteOff( Note* pNote );
 
-	void process( uint32_t nFrames );
+	/** \param context State of the engine the notes are rendered
+	 * with.*/
+	void process( uint32_t nFrames, const EngineContext& context );
 	void setAudioOutput( AudioOutput* pAudioOutput );
 
 	int getPlayingNotesNumber() {
@@ -58,6 +58,7 @@ class EventListener
 		virtual void actionModeChangeEvent( int nValue ){ UNUSED( nValue ); }
     	virtual void updateSongEditorEvent( int nValue ){ UNUSED( nValue ); }
 		virtual void columnChangedEvent( int nValue ){ UNUSED( nValue ); }
+		virtual void sampleLoadingProgressEvent( int nValue ){ UNUSED( nValue ); }
 
 		virtual ~EventListener() {}
 };
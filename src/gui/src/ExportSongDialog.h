@@ -74,19 +74,13 @@ private:
 	void		saveSettingsToPreferences();
 	void		restoreSettingsFromPreferences();
 	
-	bool		currentInstrumentHasNotes();
-	QString		findUniqueExportFilenameForInstrument( std::shared_ptr<H2Core::Instrument> pInstrument );
-
-	void		exportTracks();
 	bool 		validateUserInput();
 	QString		createDefaultFilename();
 
 	void		closeExport();
 	
 	bool					m_bExporting;
-	bool					m_bExportTrackouts;
 	bool					m_bOverwriteFiles;
-	uint					m_nInstrument;
 	QString					m_sExtension;
 	bool					m_bOldRubberbandBatchMode;
 	bool					m_bOldTimeLineBPMMode;
@@ -677,6 +677,10 @@ void HydrogenApp::onEventQueueTimer()
 			case EVENT_COLUMN_CHANGED:
 				pListener->columnChangedEvent( event.value );
 				break;
+
+			case EVENT_SAMPLE_LOADING_PROGRESS:
+				pListener->sampleLoadingProgressEvent( event.value );
+				break;
 				
 			default:
 				ERRORLOG( QString("[onEventQueueTimer] Unhandled event: %1").arg( event.type ) );
@@ -282,7 +282,7 @@ void LayerPreview::mousePressEvent(QMouseEvent *ev)
 
 		Note * pNote = new Note( m_pInstrument, nPosition, fVelocity, fPan, nLength, fPitch );
 		pNote->set_specific_compo_id( m_nSelectedComponent );
-		Hydrogen::get_instance()->getAudioEngine()->getSampler()->noteOn(pNote);
+		Hydrogen::get_instance()->getAudioEngine()->previewNote( pNote );
 		
 		for ( int i = 0; i < InstrumentComponent::getMaxLayers(); i++ ) {
 			auto pCompo = m_pInstrument->get_component(m_nSelectedComponent);
@@ -313,7 +313,7 @@ void LayerPreview::mousePressEvent(QMouseEvent *ev)
 			if ( pLayer ) {
 				Note *note = new Note( m_pInstrument , nPosition, m_pInstrument->get_component(m_nSelectedComponent)->get_layer( m_nSelectedLayer )->get_end_velocity() - 0.01, fPan, nLength, fPitch );
 				note->set_specific_compo_id( m_nSelectedComponent );
-				Hydrogen::get_instance()->getAudioEngine()->getSampler()->noteOn(note);
+				Hydrogen::get_instance()->getAudioEngine()->previewNote( note );
 				
 				int x1 = (int)( pLayer->get_start_velocity() * width() );
 				int x2 = (int)( pLayer->get_end_velocity() * width() );
@@ -138,13 +138,15 @@ void WaveDisplay::updateDisplay( std::shared_ptr<H2Core::InstrumentLayer> pLayer
 		float fGain = height() / 2.0 * pLayer->get_gain();
 
 		auto pSampleData = pLayer->get_sample()->get_data_l();
+		// The tail of streamed samples is not held in memory.
+		int nResidentFrames = pLayer->get_sample()->get_resident_frames();
 
 		int nSamplePos =0;
 		int nVal;
 		for ( int i = 0; i < width(); ++i ){
 			nVal = 0;
 			for ( int j = 0; j < nScaleFactor; ++j ) {
-				if ( j < nSampleLength ) {
+				if ( j < nSampleLength && nSamplePos < nResidentFrames ) {
 					int newVal = (int)( pSampleData[ nSamplePos ] * fGain );
 					if ( newVal > nVal ) {
 						nVal = newVal;
@@ -306,7 +306,7 @@ void Mixer::noteOnClicked( MixerLine* ref )
 	
 	const float fPitch = pInstr->get_pitch_offset();
 	Note *pNote = new Note( pInstr, 0, 1.0, 0.f, -1, fPitch );
-	pHydrogen->getAudioEngine()->getSampler()->noteOn(pNote);
+	pHydrogen->getAudioEngine()->previewNote( pNote );
 }
 
 
@@ -324,7 +324,7 @@ void Mixer::noteOnClicked( MixerLine* ref )
 
 	const float fPitch = 0.0f;
 	Note *pNote = new Note( pInstr, 0, 1.0, 0.f,-1, fPitch );
-	pHydrogen->getAudioEngine()->getSampler()->noteOff(pNote);
+	pHydrogen->getAudioEngine()->previewNoteOff( pNote );
 }
 
 
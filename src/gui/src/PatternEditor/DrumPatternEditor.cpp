@@ -302,7 +302,7 @@ void DrumPatternEditor::addOrDeleteNoteAction(	int nColumn,
 					  && pNote->get_octave() == oldOctaveKeyVal
 					  && pNote->get_velocity() == oldVelocity
 					  && pNote->get_probability() == fProbability ) ) {
-				notes->erase( it );
+				pPattern->remove_note( pNote );
 				delete pNote;
 				bFound = true;
 				break;
@@ -348,8 +348,10 @@ void DrumPatternEditor::addOrDeleteNoteAction(	int nColumn,
 		// hear note
 		if ( listen && !isNoteOff ) {
 			fPitch = pSelectedInstrument->get_pitch_offset();
-			Note *pNote2 = new Note( pSelectedInstrument, 0, fVelocity, fPan, nLength, fPitch);
-			m_pAudioEngine->getSampler()->noteOn(pNote2);
+			Note *pNote2 = m_pAudioEngine->getNotePool()->acquire( pSelectedInstrument, 0, fVelocity, fPan, nLength, fPitch );
+			if ( pNote2 != nullptr ) {
+				m_pAudioEngine->getSampler()->noteOn(pNote2);
+			}
 		}
 	}
 	pHydrogen->setIsModified( true );
@@ -1432,7 +1434,7 @@ void DrumPatternEditor::functionPasteNotesUndoAction(std::list<H2Core::Pattern*>
 					Note *pFoundNote = it->second;
 					if (pFoundNote->get_instrument() == pNote->get_instrument())
 					{
-						notes->erase(it);
+						pat->remove_note( pFoundNote );
 						delete pFoundNote;
 						break;
 					}
@@ -1537,7 +1539,7 @@ void DrumPatternEditor::functionFillNotesUndoAction( QStringList noteList, int n
 			assert( pNote );
 			if ( pNote->get_instrument() == pSelectedInstrument ) {
 				// the note exists...remove it!
-				notes->erase( it );
+				pPattern->remove_note( pNote );
 				delete pNote;
 				break;
 			}
@@ -494,7 +494,8 @@ void PatternEditor::deselectAndOverwriteNotes( std::vector< H2Core::Note *> &sel
 				++it;
 			} else if ( pSelectedNote->match( pNote ) && pNote->get_position() == pSelectedNote->get_position() ) {
 				// Something else occupying the same position (which may or may not be an exact duplicate)
-				it = pNotes->erase( it );
+				++it;
+				m_pPattern->remove_note( pNote );
 			} else {
 				// Any other note
 				++it;
@@ -231,7 +231,7 @@ void InstrumentLine::mousePressEvent(QMouseEvent *ev)
 		const float fPitch = pInstr->get_pitch_offset();
 
 		Note *pNote = new Note( pInstr, 0, velocity, fPan, nLength, fPitch);
-		Hydrogen::get_instance()->getAudioEngine()->getSampler()->noteOn(pNote);
+		Hydrogen::get_instance()->getAudioEngine()->previewNote( pNote );
 	}
 	else if (ev->button() == Qt::RightButton ) {
 		m_pFunctionPopup->popup( QPoint( ev->globalX(), ev->globalY() ) );
@@ -408,7 +408,7 @@ void PianoRollEditor::addOrRemoveNote( int nColumn, int nRealColumn, int nLine,
 			const float fPitch = pSelectedInstrument->get_pitch_offset();
 			Note *pNote2 = new Note( pSelectedInstrument, 0, fVelocity, fPan, nLength, fPitch );
 			pNote2->set_key_octave( notekey, octave );
-			m_pAudioEngine->getSampler()->noteOn( pNote2 );
+			m_pAudioEngine->previewNote( pNote2 );
 		}
 	}
 
@@ -216,6 +216,8 @@ void TargetWaveDisplay::updateDisplay( std::shared_ptr<H2Core::InstrumentLayer>
 
 		auto pSampleDatal = pLayer->get_sample()->get_data_l();
 		auto pSampleDatar = pLayer->get_sample()->get_data_r();
+		// The tail of streamed samples is not held in memory.
+		int nResidentFrames = pLayer->get_sample()->get_resident_frames();
 		int nSamplePos = 0;
 		int nVall;
 		int nValr;
@@ -223,7 +225,7 @@ void TargetWaveDisplay::updateDisplay( std::shared_ptr<H2Core::InstrumentLayer>
 			nVall = 0;
 			nValr = 0;
 			for ( int j = 0; j < nScaleFactor; ++j ) {
-				if ( j < nSampleLength ) {
+				if ( j < nSampleLength && nSamplePos < nResidentFrames ) {
 					if ( pSampleDatal[ nSamplePos ] < 0 ){
 						int newVal = static_cast<int>( pSampleDatal[ nSamplePos ] * -fGain );
 						nVall = newVal;
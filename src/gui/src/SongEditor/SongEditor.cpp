@@ -1757,6 +1757,8 @@ void SongEditorPatternList::deletePatternFromList( QString patternFilename, QStr
 	//Lock because PatternList will be modified
 	m_pAudioEngine->lock( RIGHT_HERE );
 
+	// Clearing the next patterns above is done asynchronously.
+	m_pAudioEngine->getNextPatterns()->del( pattern );
 	PatternList *list = m_pAudioEngine->getPlayingPatterns();
 	list->del( pattern );
 	// se esiste, seleziono il primo pattern
@@ -25,6 +25,7 @@
 #include <core/Basics/Adsr.h>
 #include <stdio.h>
 #include <memory>
+#include <vector>
 
 CPPUNIT_TEST_SUITE_REGISTRATION( ADSRTest );
 
@@ -73,3 +74,67 @@ void ADSRTest::testRelease()
 	/* Idle */
 	CPPUNIT_ASSERT_DOUBLES_EQUAL( 0.0, m_adsr->get_value( 2.0 ), delta );
 }
+
+void ADSRTest::testFadeOut()
+{
+	m_adsr->get_value( 1.1 ); // move past Attack
+	m_adsr->get_value( 2.1 ); // move past Decay
+	m_adsr->get_value( 0.1 ); // calculate and store sustain
+
+	/* Fade out linearly regardless of the release duration */
+	m_adsr->fade_out( 4 );
+	CPPUNIT_ASSERT( m_adsr->get_state() == ADSR::FADE_OUT );
+	CPPUNIT_ASSERT_DOUBLES_EQUAL( 0.8, m_adsr->get_value( 1.0 ), delta );
+	CPPUNIT_ASSERT_DOUBLES_EQUAL( 0.6, m_adsr->get_value( 1.0 ), delta );
+
+	/* Releasing does not interrupt the fade out */
+	CPPUNIT_ASSERT_DOUBLES_EQUAL( 0.6, m_adsr->release(), delta );
+	CPPUNIT_ASSERT_DOUBLES_EQUAL( 0.4, m_adsr->get_value( 1.0 ), delta );
+	CPPUNIT_ASSERT_DOUBLES_EQUAL( 0.2, m_adsr->get_value( 1.0 ), delta );
+
+	/* Idle */
+	CPPUNIT_ASSERT( m_adsr->get_state() == ADSR::IDLE );
+	CPPUNIT_ASSERT_DOUBLES_EQUAL( 0.0, m_adsr->get_value( 1.0 ), delta );
+}
+
+void ADSRTest::testBlockValues()
+{
+	/* Blocks of various sizes yield the same envelope as single
+	 * frames, including the transitions between all states. */
+	for ( int nBlockSize : { 1, 7, 64 } ) {
+		ADSR reference( 10, 50, 0.4, 300 );
+		ADSR block( 10, 50, 0.4, 300 );
+		std::vector<float> values( nBlockSize );
+
+		bool bReleased = false;
+		for ( int nFrame = 0; nFrame < 1400; nFrame += nBlockSize ) {
+			if ( nFrame >= 600 && ! bReleased ) {
+				reference.release();
+				block.release();
+				bReleased = true;
+			}
+			block.get_values( values.data(), nBlockSize, 0.5 );
+			for ( int ii = 0; ii < nBlockSize; ++ii ) {
+				CPPUNIT_ASSERT_DOUBLES_EQUAL( reference.get_value( 0.5 ), values[ ii ], 0.001 );
+			}
+			CPPUNIT_ASSERT( reference.get_state() == block.get_state() );
+			CPPUNIT_ASSERT_DOUBLES_EQUAL( reference.get_current_value(),
+										  block.get_current_value(), 0.001 );
+		}
+		CPPUNIT_ASSERT( block.get_state() == ADSR::IDLE );
+	}
+
+	/* Fade out */
+	m_adsr->get_value( 1.1 ); // move past Attack
+	m_adsr->get_value( 2.1 ); // move past Decay
+	m_adsr->get_value( 0.1 ); // calculate and store sustain
+	m_adsr->fade_out( 4 );
+
+	float values[ 6 ];
+	m_adsr->get_values( values, 6, 1.0 );
+	const float expected[ 6 ] = { 0.8, 0.6, 0.4, 0.2, 0.0, 0.0 };
+	for ( int ii = 0; ii < 6; ++ii ) {
+		CPPUNIT_ASSERT_DOUBLES_EQUAL( expected[ ii ], values[ ii ], delta );
+	}
+	CPPUNIT_ASSERT( m_adsr->get_state() == ADSR::IDLE );
+}
@@ -33,6 +33,8 @@ class ADSRTest : public CppUnit::TestCase {
 	CPPUNIT_TEST_SUITE( ADSRTest );
 	CPPUNIT_TEST( testAttack );
 	CPPUNIT_TEST( testRelease );
+	CPPUNIT_TEST( testFadeOut );
+	CPPUNIT_TEST( testBlockValues );
 	CPPUNIT_TEST_SUITE_END();
 
 	private:
@@ -43,6 +45,8 @@ class ADSRTest : public CppUnit::TestCase {
 	
 	void testAttack();
 	void testRelease();
+	void testFadeOut();
+	void testBlockValues();
 };
 
 #endif
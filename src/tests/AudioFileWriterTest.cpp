@@ -0,0 +1,138 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <core/Helpers/Filesystem.h>
+#include <core/IO/AudioFileWriter.h>
+
+#include <algorithm>
+#include <vector>
+
+using namespace H2Core;
+
+class AudioFileWriterTest : public CppUnit::TestCase {
+	CPPUNIT_TEST_SUITE( AudioFileWriterTest );
+	CPPUNIT_TEST( testWrite );
+	CPPUNIT_TEST( testDither );
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void testWrite()
+	{
+		const QString sPath = Filesystem::tmp_file_path( "writer.wav" );
+		const int nBlockFrames = 256;
+		const int nFrames = 100000;
+
+		SF_INFO soundInfo = {0};
+		soundInfo.samplerate = 44100;
+		soundInfo.channels = 2;
+		soundInfo.format = SF_FORMAT_WAV | SF_FORMAT_FLOAT;
+		SNDFILE* pFile = sf_open( sPath.toLocal8Bit(), SFM_WRITE, &soundInfo );
+		CPPUNIT_ASSERT( pFile != nullptr );
+
+		// Use less blocks than buffers written to make write() wait
+		// for the writer thread.
+		std::vector<float> data_L( nBlockFrames ), data_R( nBlockFrames );
+		{
+			AudioFileWriter writer( pFile, nBlockFrames, 2 );
+			int nWritten = 0;
+			while ( nWritten < nFrames ) {
+				const int nBlock = std::min( 1 + nWritten % nBlockFrames, nFrames - nWritten );
+				for ( int ii = 0; ii < nBlock; ++ii ) {
+					// Values exceeding [-1,1] are clipped.
+					data_L[ ii ] = ( nWritten + ii ) % 3 == 0 ? 2.0f : 0.5f;
+					data_R[ ii ] = -( nWritten + ii ) / static_cast<float>( nFrames );
+				}
+				writer.write( data_L.data(), data_R.data(), nBlock );
+				nWritten += nBlock;
+			}
+			CPPUNIT_ASSERT( writer.finish() );
+		}
+		sf_close( pFile );
+
+		soundInfo = {0};
+		pFile = sf_open( sPath.toLocal8Bit(), SFM_READ, &soundInfo );
+		CPPUNIT_ASSERT( pFile != nullptr );
+		CPPUNIT_ASSERT_EQUAL( static_cast<sf_count_t>( nFrames ), soundInfo.frames );
+
+		std::vector<float> data( nFrames * 2 );
+		CPPUNIT_ASSERT_EQUAL( static_cast<sf_count_t>( nFrames ),
+							  sf_readf_float( pFile, data.data(), nFrames ) );
+		sf_close( pFile );
+		for ( int ii = 0; ii < nFrames; ++ii ) {
+			CPPUNIT_ASSERT_EQUAL( ii % 3 == 0 ? 1.0f : 0.5f, data[ ii * 2 ] );
+			CPPUNIT_ASSERT_EQUAL( -ii / static_cast<float>( nFrames ), data[ ii * 2 + 1 ] );
+		}
+
+		Filesystem::rm( sPath );
+	}
+
+	void testDither()
+	{
+		const QString sPath = Filesystem::tmp_file_path( "writer-dither.wav" );
+		const int nBlockFrames = 512;
+		const int nFrames = 44100;
+		// Lies between two 16 bit values.
+		const float fValue = ( 1000 + 0.3f ) / 32767;
+
+		SF_INFO soundInfo = {0};
+		soundInfo.samplerate = 44100;
+		soundInfo.channels = 2;
+		soundInfo.format = SF_FORMAT_WAV | SF_FORMAT_PCM_16;
+		SNDFILE* pFile = sf_open( sPath.toLocal8Bit(), SFM_WRITE, &soundInfo );
+		CPPUNIT_ASSERT( pFile != nullptr );
+
+		std::vector<float> data_L( nBlockFrames, fValue ), data_R( nBlockFrames, -fValue );
+		{
+			AudioFileWriter writer( pFile, nBlockFrames, 4, 16 );
+			for ( int nWritten = 0; nWritten < nFrames; nWritten += nBlockFrames ) {
+				writer.write( data_L.data(), data_R.data(),
+							  std::min( nBlockFrames, nFrames - nWritten ) );
+			}
+			CPPUNIT_ASSERT( writer.finish() );
+		}
+		sf_close( pFile );
+
+		soundInfo = {0};
+		pFile = sf_open( sPath.toLocal8Bit(), SFM_READ, &soundInfo );
+		CPPUNIT_ASSERT( pFile != nullptr );
+		std::vector<short> data( nFrames * 2 );
+		CPPUNIT_ASSERT_EQUAL( static_cast<sf_count_t>( nFrames ),
+							  sf_readf_short( pFile, data.data(), nFrames ) );
+		sf_close( pFile );
+
+		// The dither noise does not exceed 1 LSB and averages out.
+		double fSum_L = 0, fSum_R = 0;
+		for ( int ii = 0; ii < nFrames; ++ii ) {
+			CPPUNIT_ASSERT( data[ ii * 2 ] >= 999 && data[ ii * 2 ] <= 1002 );
+			CPPUNIT_ASSERT( data[ ii * 2 + 1 ] >= -1002 && data[ ii * 2 + 1 ] <= -999 );
+			fSum_L += data[ ii * 2 ];
+			fSum_R += data[ ii * 2 + 1 ];
+		}
+		CPPUNIT_ASSERT_DOUBLES_EQUAL( 1000.3, fSum_L / nFrames, 0.05 );
+		CPPUNIT_ASSERT_DOUBLES_EQUAL( -1000.3, fSum_R / nFrames, 0.05 );
+
+		Filesystem::rm( sPath );
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( AudioFileWriterTest );
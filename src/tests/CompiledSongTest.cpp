@@ -0,0 +1,151 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+#include <core/AudioEngine/CompiledSong.h>
+#include <core/Basics/Note.h>
+#include <core/Basics/Pattern.h>
+#include <core/Basics/PatternList.h>
+
+using namespace H2Core;
+
+class CompiledSongTest : public CppUnit::TestCase {
+	CPPUNIT_TEST_SUITE( CompiledSongTest );
+	CPPUNIT_TEST( testCompilation );
+	CPPUNIT_TEST( testRecompilation );
+	CPPUNIT_TEST_SUITE_END();
+
+	Note* addNote( Pattern* pPattern, int nPosition )
+	{
+		Note* pNote = new Note( nullptr, nPosition, 1.0f, 0.f, -1, 0 );
+		pPattern->insert_note( pNote );
+		return pNote;
+	}
+
+public:
+	void testCompilation()
+	{
+		Pattern pattern1;
+		Pattern pattern2;
+		Pattern virtualPattern;
+		Note* pNote1a = addNote( &pattern1, 48 );
+		Note* pNote1b = addNote( &pattern1, 0 );
+		Note* pNote2 = addNote( &pattern2, 48 );
+		Note* pVirtualNote = addNote( &virtualPattern, 24 );
+
+		pattern2.virtual_patterns_add( &virtualPattern );
+		pattern2.flattened_virtual_patterns_compute();
+
+		// The virtual pattern is referenced directly as well.
+		PatternList column;
+		column.add( &pattern1 );
+		column.add( &pattern2 );
+		column.add( &virtualPattern );
+
+		std::vector<PatternList*> columns = { &column };
+		CompiledSong compiledSong;
+		CPPUNIT_ASSERT( ! compiledSong.selectColumn( 0, &column ) );
+		compiledSong.compile( &columns );
+		CPPUNIT_ASSERT( compiledSong.selectColumn( 0, &column ) );
+
+		const auto& patterns = compiledSong.getPatterns();
+		CPPUNIT_ASSERT_EQUAL( 3, static_cast<int>( patterns.size() ) );
+		CPPUNIT_ASSERT( patterns[ 0 ] == &pattern1 );
+		CPPUNIT_ASSERT( patterns[ 1 ] == &pattern2 );
+		CPPUNIT_ASSERT( patterns[ 2 ] == &virtualPattern );
+
+		const auto& events = compiledSong.getEvents();
+		CPPUNIT_ASSERT_EQUAL( 4, static_cast<int>( events.size() ) );
+		CPPUNIT_ASSERT( events[ 0 ].pNote == pNote1b );
+		CPPUNIT_ASSERT( events[ 1 ].pNote == pVirtualNote );
+		CPPUNIT_ASSERT( events[ 2 ].pNote == pNote1a );
+		CPPUNIT_ASSERT( events[ 3 ].pNote == pNote2 );
+		CPPUNIT_ASSERT_EQUAL( 48, events[ 3 ].nTick );
+
+		CPPUNIT_ASSERT_EQUAL( 0, compiledSong.seek( 0 ) );
+		CPPUNIT_ASSERT_EQUAL( 1, compiledSong.seek( 1 ) );
+		CPPUNIT_ASSERT_EQUAL( 2, compiledSong.seek( 48 ) );
+		CPPUNIT_ASSERT_EQUAL( 4, compiledSong.seek( 49 ) );
+		// Relocation
+		CPPUNIT_ASSERT_EQUAL( 1, compiledSong.seek( 24 ) );
+
+		column.del( &virtualPattern );
+		column.del( &pattern2 );
+		column.del( &pattern1 );
+	}
+
+	void testRecompilation()
+	{
+		Pattern pattern1;
+		Pattern pattern2;
+		addNote( &pattern1, 0 );
+		addNote( &pattern2, 12 );
+
+		PatternList column1;
+		column1.add( &pattern1 );
+		PatternList column2;
+		column2.add( &pattern2 );
+
+		std::vector<PatternList*> columns = { &column1, &column2 };
+		CompiledSong compiledSong;
+		compiledSong.compile( &columns );
+		CPPUNIT_ASSERT( compiledSong.selectColumn( 0, &column1 ) );
+		CPPUNIT_ASSERT_EQUAL( 1, static_cast<int>( compiledSong.getEvents().size() ) );
+		CPPUNIT_ASSERT( compiledSong.selectColumn( 1, &column2 ) );
+		CPPUNIT_ASSERT_EQUAL( 12, compiledSong.getEvents()[ 0 ].nTick );
+
+		// Editing a pattern only invalidates the columns containing
+		// it. Selecting them does not compile.
+		Note* pNote = addNote( &pattern1, 6 );
+		CPPUNIT_ASSERT( ! compiledSong.selectColumn( 0, &column1 ) );
+		CPPUNIT_ASSERT( compiledSong.getEvents().empty() );
+		CPPUNIT_ASSERT( compiledSong.selectColumn( 1, &column2 ) );
+		compiledSong.compile( &columns );
+		CPPUNIT_ASSERT( compiledSong.selectColumn( 0, &column1 ) );
+		CPPUNIT_ASSERT_EQUAL( 2, static_cast<int>( compiledSong.getEvents().size() ) );
+		CPPUNIT_ASSERT( compiledSong.getEvents()[ 1 ].pNote == pNote );
+
+		pattern1.remove_note( pNote );
+		delete pNote;
+		CPPUNIT_ASSERT( ! compiledSong.selectColumn( 0, &column1 ) );
+		compiledSong.compile( &columns );
+		CPPUNIT_ASSERT( compiledSong.selectColumn( 0, &column1 ) );
+		CPPUNIT_ASSERT_EQUAL( 1, static_cast<int>( compiledSong.getEvents().size() ) );
+
+		// So does altering the column itself.
+		column1.add( &pattern2 );
+		CPPUNIT_ASSERT( ! compiledSong.selectColumn( 0, &column1 ) );
+		compiledSong.compile( &columns );
+		CPPUNIT_ASSERT( compiledSong.selectColumn( 0, &column1 ) );
+		CPPUNIT_ASSERT_EQUAL( 2, static_cast<int>( compiledSong.getPatterns().size() ) );
+		CPPUNIT_ASSERT_EQUAL( 2, static_cast<int>( compiledSong.getEvents().size() ) );
+
+		// Deleting any pattern invalidates all columns.
+		delete new Pattern();
+		CPPUNIT_ASSERT( ! compiledSong.selectColumn( 1, &column2 ) );
+
+		column1.del( &pattern2 );
+		column1.del( &pattern1 );
+		column2.del( &pattern2 );
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( CompiledSongTest );
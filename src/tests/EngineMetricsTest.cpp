@@ -0,0 +1,97 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+#include <core/AudioEngine/EngineMetrics.h>
+
+using namespace H2Core;
+
+class EngineMetricsTest : public CppUnit::TestCase {
+	CPPUNIT_TEST_SUITE( EngineMetricsTest );
+	CPPUNIT_TEST( testRecord );
+	CPPUNIT_TEST( testCounters );
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void testRecord()
+	{
+		EngineMetrics metrics;
+		metrics.beginCycle( 10000000 );
+
+		// Durations of about 5 us and 3 ms.
+		const int64_t nNow = EngineMetrics::now();
+		for ( int ii = 0; ii < 99; ++ii ) {
+			metrics.record( EngineMetrics::STAGE_SAMPLER, EngineMetrics::now() - 5000 );
+		}
+		metrics.record( EngineMetrics::STAGE_SAMPLER, EngineMetrics::now() - 3000000 );
+		CPPUNIT_ASSERT( metrics.record( EngineMetrics::STAGE_SYNTH, nNow ) >= nNow );
+
+		const auto snapshot = metrics.snapshot();
+		const auto& sampler = snapshot.stages[ EngineMetrics::STAGE_SAMPLER ];
+		CPPUNIT_ASSERT_EQUAL( uint64_t( 100 ), sampler.nCount );
+		CPPUNIT_ASSERT( sampler.nMaxNs >= 3000000 );
+		CPPUNIT_ASSERT( sampler.meanUs() >= 34.95 );
+		// 5 us end up in the bucket [4, 8) us.
+		CPPUNIT_ASSERT( sampler.buckets[ 3 ] + sampler.buckets[ 4 ] >= 99 );
+		CPPUNIT_ASSERT( sampler.percentileUs( 50 ) <= 16 );
+		CPPUNIT_ASSERT( sampler.percentileUs( 100 ) >= 3000 );
+		CPPUNIT_ASSERT_EQUAL( uint64_t( 1 ), snapshot.stages[ EngineMetrics::STAGE_SYNTH ].nCount );
+		CPPUNIT_ASSERT_EQUAL( uint64_t( 0 ), snapshot.stages[ EngineMetrics::STAGE_PEAKS ].nCount );
+
+		const QString sReport = EngineMetrics::toString( snapshot );
+		CPPUNIT_ASSERT( sReport.contains( "\nsampler\t100\t" ) );
+	}
+
+	void testCounters()
+	{
+		EngineMetrics metrics;
+
+		// A cycle exceeding its deadline is only an xrun while
+		// rendering in realtime.
+		metrics.beginCycle( 1000 );
+		metrics.endCycle( EngineMetrics::now() - 2000, false );
+		metrics.beginCycle( 1000 );
+		metrics.endCycle( EngineMetrics::now() - 2000, true );
+		metrics.missedBuffer();
+		metrics.voicesStolen( 3 );
+		metrics.setActiveVoices( 12 );
+		metrics.setActiveVoices( 4 );
+
+		auto snapshot = metrics.snapshot();
+		CPPUNIT_ASSERT_EQUAL( uint64_t( 2 ), snapshot.nCycles );
+		CPPUNIT_ASSERT_EQUAL( uint64_t( 1 ), snapshot.nXRuns );
+		CPPUNIT_ASSERT_EQUAL( uint64_t( 1 ), snapshot.nMissedBuffers );
+		CPPUNIT_ASSERT_EQUAL( uint64_t( 3 ), snapshot.nVoicesStolen );
+		CPPUNIT_ASSERT_EQUAL( 4, snapshot.nActiveVoices );
+		CPPUNIT_ASSERT_EQUAL( 12, snapshot.nMaxActiveVoices );
+
+		// Resetting is deferred till the next cycle.
+		metrics.reset();
+		CPPUNIT_ASSERT_EQUAL( uint64_t( 2 ), metrics.snapshot().nCycles );
+		metrics.beginCycle( 1000 );
+		snapshot = metrics.snapshot();
+		CPPUNIT_ASSERT_EQUAL( uint64_t( 0 ), snapshot.nCycles );
+		CPPUNIT_ASSERT_EQUAL( uint64_t( 0 ), snapshot.stages[ EngineMetrics::STAGE_CYCLE ].nCount );
+		CPPUNIT_ASSERT_EQUAL( 0, snapshot.nMaxActiveVoices );
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( EngineMetricsTest );
@@ -26,6 +26,7 @@
 #include <core/EventQueue.h>
 #include <core/Helpers/Filesystem.h>
 #include <core/Hydrogen.h>
+#include <core/Preferences/Preferences.h>
 #include <core/Basics/Adsr.h>
 #include <core/Basics/AutomationPath.h>
 #include <core/Basics/Drumkit.h>
@@ -45,8 +46,12 @@
 #include "assertions/File.h"
 #include "assertions/AudioFile.h"
 
+#include <sndfile.h>
+
 #include <chrono>
+#include <cmath>
 #include <memory>
+#include <vector>
 
 using namespace H2Core;
 
@@ -54,8 +59,13 @@ using namespace H2Core;
  * \brief Export Hydrogon song to audio file
  * \param songFile Path to Hydrogen file
  * \param fileName Output file name
+ * \param bStems Whether to write post-fader stems of all
+ * instruments and components along with the mix
+ * \param fInstrumentVolume Factor applied to the volume of all
+ * instruments
  **/
-void exportSong( const QString &songFile, const QString &fileName )
+void exportSong( const QString &songFile, const QString &fileName, bool bStems = false,
+				 float fInstrumentVolume = 1.0 )
 {
 	auto t0 = std::chrono::high_resolution_clock::now();
 
@@ -74,10 +84,17 @@ void exportSong( const QString &songFile, const QString &fileName )
 	InstrumentList *pInstrumentList = pSong->getInstrumentList();
 	for (auto i = 0; i < pInstrumentList->size(); i++) {
 		pInstrumentList->get(i)->set_currently_exported( true );
+		if ( fInstrumentVolume != 1.0 ) {
+			pInstrumentList->get(i)->set_volume( pInstrumentList->get(i)->get_volume() * fInstrumentVolume );
+		}
 	}
 
 	pHydrogen->startExportSession( 44100, 16 );
-	pHydrogen->startExportSong( fileName );
+	if ( bStems ) {
+		pHydrogen->startExportStems( fileName, true, true, true );
+	} else {
+		pHydrogen->startExportSong( fileName );
+	}
 
 	bool done = false;
 	while ( ! done ) {
@@ -97,6 +114,25 @@ void exportSong( const QString &songFile, const QString &fileName )
 	___INFOLOG( QString("Audio export took %1 seconds").arg(t) );
 }
 
+/**
+ * \brief Read all samples of an audio file
+ * \param fileName Path to the audio file
+ * \param samples Interleaved samples normalized to [-1,1]
+ * \return Number of frames read
+ **/
+sf_count_t readAudioFile( const QString &fileName, std::vector<float>& samples )
+{
+	SF_INFO info = {0};
+	std::unique_ptr<SNDFILE, decltype(&sf_close)>
+		pFile{ sf_open( fileName.toLocal8Bit().data(), SFM_READ, &info ), sf_close };
+	CPPUNIT_ASSERT_MESSAGE( fileName.toStdString(), pFile != nullptr );
+
+	samples.resize( info.frames * info.channels );
+	const sf_count_t nFrames = sf_readf_float( pFile.get(), samples.data(), info.frames );
+	CPPUNIT_ASSERT_EQUAL( info.frames, nFrames );
+	return nFrames;
+}
+
 /**
  * \brief Export Hydrogon song to MIDI file
  * \param songFile Path to Hydrogen file
@@ -120,6 +156,8 @@ void exportMIDI( const QString &songFile, const QString &fileName, SMFWriter& wr
 class FunctionalTest : public CppUnit::TestCase {
 	CPPUNIT_TEST_SUITE( FunctionalTest );
 	CPPUNIT_TEST( testExportAudio );
+	CPPUNIT_TEST( testExportStems );
+	CPPUNIT_TEST( testExportParallel );
 	CPPUNIT_TEST( testExportMIDISMF0 );
 	CPPUNIT_TEST( testExportMIDISMF1Single );
 	CPPUNIT_TEST( testExportMIDISMF1Multi );
@@ -226,6 +264,80 @@ class FunctionalTest : public CppUnit::TestCase {
 		Filesystem::rm( outFile );
 	}
 
+	void testExportStems()
+	{
+		auto songFile = H2TEST_FILE("functional/test.h2song");
+		auto outFile = Filesystem::tmp_file_path("stems.wav");
+		auto refFile = H2TEST_FILE("functional/test.ref.flac");
+
+		// Writing the stems must not alter the main mix.
+		exportSong( songFile, outFile, true );
+		H2TEST_ASSERT_AUDIO_FILES_EQUAL( refFile, outFile );
+		Filesystem::rm( outFile );
+
+		auto pHydrogen = Hydrogen::get_instance();
+		auto stemFiles = pHydrogen->getStemFilenames( outFile, true );
+		CPPUNIT_ASSERT( stemFiles.size() > 1 );
+		for ( const auto& sStemFile : stemFiles ) {
+			Filesystem::rm( sStemFile );
+		}
+
+		// Post-fader stems are rendered at twice the instrument level
+		// and without the song volume. The instruments are attenuated
+		// in order to keep the louder stems from clipping.
+		exportSong( songFile, outFile, true, 0.25 );
+
+		std::vector<float> mix;
+		const sf_count_t nFrames = readAudioFile( outFile, mix );
+		CPPUNIT_ASSERT( nFrames > 0 );
+
+		// As the song does not contain any FX, the instrument stems
+		// have to add up to the mix. Component stems are listed last
+		// and cover the same notes.
+		const auto instrumentStemFiles = pHydrogen->getStemFilenames( outFile, false );
+		const float fScale = pHydrogen->getSong()->getVolume() / 2;
+		std::vector<float> sum( mix.size(), 0 );
+		for ( const auto& sStemFile : instrumentStemFiles ) {
+			std::vector<float> stem;
+			CPPUNIT_ASSERT_EQUAL( nFrames, readAudioFile( sStemFile, stem ) );
+			for ( size_t ii = 0; ii < stem.size(); ++ii ) {
+				sum[ ii ] += stem[ ii ] * fScale;
+			}
+		}
+
+		// Every file is quantized to 16 bit on its own.
+		const float fTolerance = ( fScale * instrumentStemFiles.size() + 2 ) / 32768;
+		for ( size_t ii = 0; ii < mix.size(); ++ii ) {
+			if ( std::fabs( sum[ ii ] - mix[ ii ] ) > fTolerance ) {
+				CPPUNIT_FAIL( QString( "Stems differ from mix at sample %1: %2 != %3" )
+							  .arg( ii ).arg( sum[ ii ] ).arg( mix[ ii ] ).toStdString() );
+			}
+		}
+
+		Filesystem::rm( outFile );
+		for ( const auto& sStemFile : stemFiles ) {
+			Filesystem::rm( sStemFile );
+		}
+	}
+
+	void testExportParallel()
+	{
+		auto songFile = H2TEST_FILE("functional/test.h2song");
+		auto outFile = Filesystem::tmp_file_path("parallel.wav");
+		auto refFile = H2TEST_FILE("functional/test.ref.flac");
+
+		// Rendering the instruments on separate threads must not
+		// alter the result.
+		auto pPref = Preferences::get_instance();
+		const int nOldExportWorkerThreads = pPref->m_nExportWorkerThreads;
+		pPref->m_nExportWorkerThreads = 3;
+		exportSong( songFile, outFile );
+		pPref->m_nExportWorkerThreads = nOldExportWorkerThreads;
+
+		H2TEST_ASSERT_AUDIO_FILES_EQUAL( refFile, outFile );
+		Filesystem::rm( outFile );
+	}
+
 	void testExportMIDISMF1Single()
 	{
 		auto songFile = H2TEST_FILE("functional/test.h2song");
@@ -0,0 +1,101 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+#include <core/Helpers/LockFreeQueue.h>
+
+#include <thread>
+#include <vector>
+
+using namespace H2Core;
+
+class LockFreeQueueTest : public CppUnit::TestCase {
+	CPPUNIT_TEST_SUITE( LockFreeQueueTest );
+	CPPUNIT_TEST( testCapacity );
+	CPPUNIT_TEST( testMultipleProducers );
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void testCapacity()
+	{
+		LockFreeQueue<int> queue( 3 );
+		CPPUNIT_ASSERT_EQUAL( 4, static_cast<int>( queue.getCapacity() ) );
+
+		int nValue = -1;
+		CPPUNIT_ASSERT( ! queue.pop( &nValue ) );
+
+		// Wrap around the ring several times.
+		for ( int nRound = 0; nRound < 3; ++nRound ) {
+			for ( int ii = 0; ii < 4; ++ii ) {
+				CPPUNIT_ASSERT( queue.push( ii ) );
+			}
+			CPPUNIT_ASSERT( ! queue.push( 4 ) );
+
+			for ( int ii = 0; ii < 4; ++ii ) {
+				CPPUNIT_ASSERT( queue.pop( &nValue ) );
+				CPPUNIT_ASSERT_EQUAL( ii, nValue );
+			}
+			CPPUNIT_ASSERT( ! queue.pop( &nValue ) );
+		}
+	}
+
+	void testMultipleProducers()
+	{
+		const int nProducers = 4;
+		const int nValuesPerProducer = 10000;
+		LockFreeQueue<int> queue( 64 );
+
+		std::vector<std::thread> producers;
+		for ( int nProducer = 0; nProducer < nProducers; ++nProducer ) {
+			producers.emplace_back( [&queue, nProducer, nValuesPerProducer]() {
+				for ( int ii = 0; ii < nValuesPerProducer; ++ii ) {
+					while ( ! queue.push( nProducer * nValuesPerProducer + ii ) ) {
+						std::this_thread::yield();
+					}
+				}
+			} );
+		}
+
+		// Every value has to arrive exactly once and the values of
+		// each producer in the order they were pushed.
+		std::vector<int> lastValues( nProducers, -1 );
+		int nReceived = 0;
+		int nValue;
+		while ( nReceived < nProducers * nValuesPerProducer ) {
+			if ( ! queue.pop( &nValue ) ) {
+				std::this_thread::yield();
+				continue;
+			}
+			int nProducer = nValue / nValuesPerProducer;
+			int nIndex = nValue % nValuesPerProducer;
+			CPPUNIT_ASSERT_EQUAL( lastValues[ nProducer ] + 1, nIndex );
+			lastValues[ nProducer ] = nIndex;
+			++nReceived;
+		}
+
+		for ( auto& producer : producers ) {
+			producer.join();
+		}
+		CPPUNIT_ASSERT( ! queue.pop( &nValue ) );
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( LockFreeQueueTest );
@@ -14,6 +14,7 @@
 #include <core/Basics/Pattern.h>
 #include <core/Basics/PatternList.h>
 #include <core/Basics/Playlist.h>
+#include <core/Basics/PreparedDrumkit.h>
 #include <core/Basics/Sample.h>
 #include <core/Basics/Song.h>
 
@@ -447,6 +448,16 @@ void MemoryLeakageTest::testLoading() {
 		H2Core::Hydrogen::get_instance()->loadDrumkit( pDrumkit2 );
 		H2Core::Hydrogen::get_instance()->loadDrumkit( pDrumkit );
 		CPPUNIT_ASSERT( nLoaded == H2Core::Base::getAliveObjectCount() );
+
+		// The previous kit is freed along with the prepared one.
+		{
+			auto pPrepared = H2Core::Hydrogen::get_instance()->prepareDrumkit( pDrumkit );
+			CPPUNIT_ASSERT( pPrepared != nullptr );
+			CPPUNIT_ASSERT( H2Core::Hydrogen::get_instance()->commitDrumkit( pPrepared, true, true ) == 0 );
+			CPPUNIT_ASSERT( pPrepared->isSwappedIn() );
+			CPPUNIT_ASSERT( H2Core::Hydrogen::get_instance()->commitDrumkit( pPrepared, true, true ) == -1 );
+		}
+		CPPUNIT_ASSERT( nLoaded == H2Core::Base::getAliveObjectCount() );
 	}
 }
 
@@ -0,0 +1,113 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+#include <core/AudioEngine/NotePool.h>
+#include <core/Basics/Note.h>
+#include <core/Basics/Instrument.h>
+#include <core/Basics/InstrumentComponent.h>
+
+using namespace H2Core;
+
+class NotePoolTest : public CppUnit::TestCase {
+	CPPUNIT_TEST_SUITE( NotePoolTest );
+	CPPUNIT_TEST( testRecycling );
+	CPPUNIT_TEST( testExhaustion );
+	CPPUNIT_TEST_SUITE_END();
+
+	std::shared_ptr<Instrument> createInstrument()
+	{
+		auto pInstr = std::make_shared<Instrument>( 1, "Snare", nullptr );
+		pInstr->get_components()->push_back( std::make_shared<InstrumentComponent>( 0 ) );
+		pInstr->get_components()->push_back( std::make_shared<InstrumentComponent>( 2 ) );
+		return pInstr;
+	}
+
+	void testRecycling()
+	{
+		NotePool pool( 2 );
+		CPPUNIT_ASSERT_EQUAL( 2, pool.getCapacity() );
+		CPPUNIT_ASSERT_EQUAL( 2, pool.getAvailable() );
+
+		auto pInstr = createInstrument();
+		Note original( pInstr, 12, 0.7f, 0.25f, 48, 2.0f );
+		original.set_probability( 0.5f );
+
+		Note* pCopy = pool.acquire( &original );
+		CPPUNIT_ASSERT( pCopy->is_pooled() );
+		CPPUNIT_ASSERT_EQUAL( 1, pool.getAvailable() );
+		CPPUNIT_ASSERT( pCopy->get_instrument() == pInstr );
+		CPPUNIT_ASSERT_EQUAL( 12, pCopy->get_position() );
+		CPPUNIT_ASSERT_EQUAL( 0.7f, pCopy->get_velocity() );
+		CPPUNIT_ASSERT_EQUAL( 0.25f, pCopy->getPan() );
+		CPPUNIT_ASSERT_EQUAL( 48, pCopy->get_length() );
+		CPPUNIT_ASSERT_EQUAL( 2.0f, pCopy->get_pitch() );
+		CPPUNIT_ASSERT_EQUAL( 0.5f, pCopy->get_probability() );
+		CPPUNIT_ASSERT( pCopy->get_adsr() != pInstr->get_adsr() );
+
+		// Layer information is available for all components.
+		CPPUNIT_ASSERT( pCopy->get_layer_selected( 0 ) != nullptr );
+		CPPUNIT_ASSERT( pCopy->get_layer_selected( 2 ) != nullptr );
+		CPPUNIT_ASSERT( pCopy->get_layer_selected( 1 ) == nullptr );
+
+		pCopy->get_layer_selected( 2 )->SelectedLayer = 3;
+		pCopy->get_layer_selected( 2 )->SamplePosition = 1000;
+		pool.release( pCopy );
+		CPPUNIT_ASSERT_EQUAL( 2, pool.getAvailable() );
+
+		// The same note is handed out again with fresh state. Free
+		// notes are recycled in first-in first-out order.
+		Note* pOther = pool.acquire( pInstr, 0, 1.0f, 0.f, -1, 0 );
+		Note* pRecycled = pool.acquire( pInstr, 0, 1.0f, 0.f, -1, 0 );
+		CPPUNIT_ASSERT( pOther != pCopy );
+		CPPUNIT_ASSERT( pRecycled == pCopy );
+		CPPUNIT_ASSERT_EQUAL( 0, pRecycled->get_position() );
+		CPPUNIT_ASSERT_EQUAL( 1.0f, pRecycled->get_probability() );
+		CPPUNIT_ASSERT_EQUAL( -1, pRecycled->get_layer_selected( 2 )->SelectedLayer );
+		CPPUNIT_ASSERT_EQUAL( 0.f, pRecycled->get_layer_selected( 2 )->SamplePosition );
+		pool.release( pRecycled );
+		pool.release( pOther );
+		CPPUNIT_ASSERT_EQUAL( 2, pool.getAvailable() );
+	}
+
+	void testExhaustion()
+	{
+		NotePool pool( 1 );
+		auto pInstr = createInstrument();
+
+		Note* pFirst = pool.acquire( pInstr, 0, 1.0f, 0.f, -1, 0 );
+		CPPUNIT_ASSERT( pFirst->is_pooled() );
+		CPPUNIT_ASSERT_EQUAL( 0, pool.getAvailable() );
+
+		// An exhausted pool does not allocate.
+		CPPUNIT_ASSERT( pool.acquire( pInstr, 0, 1.0f, 0.f, -1, 0 ) == nullptr );
+		CPPUNIT_ASSERT( pool.acquire( pFirst ) == nullptr );
+
+		// Notes not owned by the pool are deleted.
+		pool.release( new Note( pInstr, 0, 1.0f, 0.f, -1, 0 ) );
+		CPPUNIT_ASSERT_EQUAL( 0, pool.getAvailable() );
+
+		pool.release( pFirst );
+		CPPUNIT_ASSERT_EQUAL( 1, pool.getAvailable() );
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( NotePoolTest );
@@ -0,0 +1,240 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+#include <core/AudioEngine/NoteScheduler.h>
+#include <core/Basics/Note.h>
+
+#include <memory>
+#include <vector>
+
+using namespace H2Core;
+
+class NoteSchedulerTest : public CppUnit::TestCase {
+	CPPUNIT_TEST_SUITE( NoteSchedulerTest );
+	CPPUNIT_TEST( testOrdering );
+	CPPUNIT_TEST( testLateAndDistantNotes );
+	CPPUNIT_TEST( testBackwardRelocation );
+	CPPUNIT_TEST( testTickSizeChange );
+	CPPUNIT_TEST( testCapacity );
+	CPPUNIT_TEST_SUITE_END();
+
+	std::vector<std::unique_ptr<Note>> m_notes;
+
+	Note* createNote( int nPosition, int nHumanizeDelay = 0 )
+	{
+		m_notes.push_back( std::make_unique<Note>( nullptr, nPosition, 1.0f, 0.f, -1, 0 ) );
+		m_notes.back()->set_humanize_delay( nHumanizeDelay );
+		return m_notes.back().get();
+	}
+
+public:
+	void tearDown()
+	{
+		m_notes.clear();
+	}
+
+	void testOrdering()
+	{
+		NoteScheduler scheduler( 8, 16 );
+		scheduler.setBucketSize( 100 );
+		const float fTickSize = 10;
+
+		Note* pLater = createNote( 5 );
+		Note* pEarly = createNote( 2 );
+		Note* pHumanized = createNote( 2, 20 );
+		Note* pSimultaneous = createNote( 2 );
+		Note* pAhead = createNote( 11, -20 );
+		Note* pNext = createNote( 12 );
+
+		scheduler.push( pLater, fTickSize );
+		scheduler.push( pEarly, fTickSize );
+		scheduler.push( pHumanized, fTickSize );
+		scheduler.push( pSimultaneous, fTickSize );
+		scheduler.push( pAhead, fTickSize );
+		scheduler.push( pNext, fTickSize );
+		CPPUNIT_ASSERT_EQUAL( 6, scheduler.size() );
+
+		// Notes are ordered by onset including positive humanize
+		// delays, but only negative ones determine whether they are
+		// due.
+		std::vector<Note*> notes;
+		scheduler.popDue( 100, fTickSize, notes );
+		CPPUNIT_ASSERT_EQUAL( 5, static_cast<int>( notes.size() ) );
+		CPPUNIT_ASSERT( notes[ 0 ] == pEarly );
+		CPPUNIT_ASSERT( notes[ 1 ] == pSimultaneous );
+		CPPUNIT_ASSERT( notes[ 2 ] == pHumanized );
+		CPPUNIT_ASSERT( notes[ 3 ] == pLater );
+		CPPUNIT_ASSERT( notes[ 4 ] == pAhead );
+
+		scheduler.popDue( 100, fTickSize, notes );
+		CPPUNIT_ASSERT( notes.empty() );
+
+		scheduler.popDue( 200, fTickSize, notes );
+		CPPUNIT_ASSERT_EQUAL( 1, static_cast<int>( notes.size() ) );
+		CPPUNIT_ASSERT( notes[ 0 ] == pNext );
+		CPPUNIT_ASSERT( scheduler.isEmpty() );
+	}
+
+	void testLateAndDistantNotes()
+	{
+		NoteScheduler scheduler( 4, 16 );
+		scheduler.setBucketSize( 100 );
+		const float fTickSize = 1;
+
+		std::vector<Note*> notes;
+		scheduler.popDue( 1000, fTickSize, notes );
+		CPPUNIT_ASSERT( notes.empty() );
+
+		// Notes pushed for an already processed cycle, e.g. realtime
+		// ones, are played in the next one.
+		Note* pLate = createNote( 850 );
+		scheduler.push( pLate, fTickSize );
+
+		// Notes more than a whole turn of the ring ahead must neither
+		// be returned early nor get lost.
+		Note* pDistant = createNote( 1050 + 4 * 100 );
+		Note* pDistant2 = createNote( 1050 + 40 * 100 );
+		scheduler.push( pDistant, fTickSize );
+		scheduler.push( pDistant2, fTickSize );
+
+		scheduler.popDue( 1100, fTickSize, notes );
+		CPPUNIT_ASSERT_EQUAL( 1, static_cast<int>( notes.size() ) );
+		CPPUNIT_ASSERT( notes[ 0 ] == pLate );
+
+		int nFound = 0;
+		for ( long long nEnd = 1200; nEnd <= 6000; nEnd += 100 ) {
+			scheduler.popDue( nEnd, fTickSize, notes );
+			for ( auto pNote : notes ) {
+				CPPUNIT_ASSERT( pNote->get_position() < nEnd );
+				CPPUNIT_ASSERT( pNote->get_position() >= nEnd - 100 );
+				++nFound;
+			}
+		}
+		CPPUNIT_ASSERT_EQUAL( 2, nFound );
+		CPPUNIT_ASSERT( scheduler.isEmpty() );
+
+		// Transport relocated backwards.
+		Note* pRelocated = createNote( 50 );
+		scheduler.push( pRelocated, fTickSize );
+		scheduler.popDue( 100, fTickSize, notes );
+		CPPUNIT_ASSERT_EQUAL( 1, static_cast<int>( notes.size() ) );
+		CPPUNIT_ASSERT( notes[ 0 ] == pRelocated );
+
+		Note* pCleared = createNote( 5000 );
+		scheduler.push( pCleared, fTickSize );
+		scheduler.popAll( notes );
+		CPPUNIT_ASSERT_EQUAL( 1, static_cast<int>( notes.size() ) );
+		CPPUNIT_ASSERT( scheduler.isEmpty() );
+	}
+
+	void testBackwardRelocation()
+	{
+		NoteScheduler scheduler( 8, 16 );
+		scheduler.setBucketSize( 100 );
+		const float fTickSize = 1;
+
+		std::vector<Note*> notes;
+		scheduler.popDue( 5000, fTickSize, notes );
+		CPPUNIT_ASSERT( notes.empty() );
+
+		// Transport moved backwards, e.g. playback started at the
+		// beginning of the song after realtime notes were played. All
+		// notes of the lookahead are pushed behind the cursor but
+		// must only be returned once they are due.
+		Note* pDue = createNote( 50 );
+		Note* pNext = createNote( 150 );
+		Note* pLater = createNote( 720 );
+		scheduler.push( pDue, fTickSize );
+		scheduler.push( pNext, fTickSize );
+		scheduler.push( pLater, fTickSize );
+
+		scheduler.popDue( 100, fTickSize, notes );
+		CPPUNIT_ASSERT_EQUAL( 1, static_cast<int>( notes.size() ) );
+		CPPUNIT_ASSERT( notes[ 0 ] == pDue );
+
+		scheduler.popDue( 200, fTickSize, notes );
+		CPPUNIT_ASSERT_EQUAL( 1, static_cast<int>( notes.size() ) );
+		CPPUNIT_ASSERT( notes[ 0 ] == pNext );
+
+		for ( long long nEnd = 300; nEnd <= 700; nEnd += 100 ) {
+			scheduler.popDue( nEnd, fTickSize, notes );
+			CPPUNIT_ASSERT( notes.empty() );
+		}
+		scheduler.popDue( 800, fTickSize, notes );
+		CPPUNIT_ASSERT_EQUAL( 1, static_cast<int>( notes.size() ) );
+		CPPUNIT_ASSERT( notes[ 0 ] == pLater );
+		CPPUNIT_ASSERT( scheduler.isEmpty() );
+	}
+
+	void testTickSizeChange()
+	{
+		NoteScheduler scheduler( 8, 16 );
+		scheduler.setBucketSize( 64 );
+
+		Note* pNote = createNote( 48 );
+		scheduler.push( pNote, 10 );
+
+		std::vector<Note*> notes;
+		scheduler.popDue( 256, 10, notes );
+		CPPUNIT_ASSERT( notes.empty() );
+
+		// A tempo change moves the note into the current cycle.
+		scheduler.popDue( 256, 5, notes );
+		CPPUNIT_ASSERT_EQUAL( 1, static_cast<int>( notes.size() ) );
+		CPPUNIT_ASSERT( notes[ 0 ] == pNote );
+
+		// Changing the bucket size keeps all notes.
+		Note* pOther = createNote( 100 );
+		scheduler.push( pOther, 5 );
+		scheduler.setBucketSize( 128 );
+		scheduler.popDue( 384, 5, notes );
+		CPPUNIT_ASSERT( notes.empty() );
+		scheduler.popDue( 512, 5, notes );
+		CPPUNIT_ASSERT_EQUAL( 1, static_cast<int>( notes.size() ) );
+		CPPUNIT_ASSERT( notes[ 0 ] == pOther );
+	}
+
+	void testCapacity()
+	{
+		NoteScheduler scheduler( 2, 3 );
+		scheduler.setBucketSize( 100 );
+		const float fTickSize = 1;
+
+		// All notes may end up in the same bucket.
+		for ( int ii = 0; ii < 3; ++ii ) {
+			CPPUNIT_ASSERT( scheduler.push( createNote( 10 * ii ), fTickSize ) );
+		}
+		CPPUNIT_ASSERT( ! scheduler.push( createNote( 50 ), fTickSize ) );
+		CPPUNIT_ASSERT_EQUAL( 3, scheduler.size() );
+
+		// Entries are reused once their notes were returned.
+		std::vector<Note*> notes;
+		scheduler.popDue( 100, fTickSize, notes );
+		CPPUNIT_ASSERT_EQUAL( 3, static_cast<int>( notes.size() ) );
+		CPPUNIT_ASSERT( scheduler.push( createNote( 150 ), fTickSize ) );
+		scheduler.popAll( notes );
+		CPPUNIT_ASSERT_EQUAL( 1, static_cast<int>( notes.size() ) );
+		CPPUNIT_ASSERT( scheduler.isEmpty() );
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( NoteSchedulerTest );
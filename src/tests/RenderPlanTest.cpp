@@ -0,0 +1,181 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+#include <core/Basics/DrumkitComponent.h>
+#include <core/Basics/Instrument.h>
+#include <core/Basics/InstrumentComponent.h>
+#include <core/Basics/InstrumentLayer.h>
+#include <core/Basics/Song.h>
+#include <core/Sampler/RenderPlan.h>
+
+#include <memory>
+
+using namespace H2Core;
+
+class RenderPlanTest : public CppUnit::TestCase {
+	CPPUNIT_TEST_SUITE( RenderPlanTest );
+	CPPUNIT_TEST( testVelocityLayers );
+	CPPUNIT_TEST( testComponents );
+	CPPUNIT_TEST( testInvalidation );
+	CPPUNIT_TEST_SUITE_END();
+
+	std::shared_ptr<Song> m_pSong;
+	std::shared_ptr<Instrument> m_pInstrument;
+
+	static std::shared_ptr<InstrumentLayer> createLayer( float fStart, float fEnd )
+	{
+		auto pLayer = std::make_shared<InstrumentLayer>( std::shared_ptr<Sample>() );
+		pLayer->set_start_velocity( fStart );
+		pLayer->set_end_velocity( fEnd );
+		return pLayer;
+	}
+
+	/** Layer selected by the search done in Sampler::renderNote().*/
+	int searchLayer( float fVelocity ) const
+	{
+		auto pCompo = m_pInstrument->get_components()->front();
+		for ( int nLayer = 0; nLayer < InstrumentComponent::getMaxLayers(); ++nLayer ) {
+			auto pLayer = pCompo->get_layer( nLayer );
+			if ( pLayer != nullptr && fVelocity >= pLayer->get_start_velocity() &&
+				 fVelocity <= pLayer->get_end_velocity() ) {
+				return nLayer;
+			}
+		}
+		return -1;
+	}
+
+public:
+	void setUp() override
+	{
+		m_pSong = std::make_shared<Song>( "RenderPlanTest", "test", 120, 0.5 );
+		m_pSong->getComponents()->push_back( new DrumkitComponent( 0, "Main" ) );
+		m_pSong->getComponents()->push_back( new DrumkitComponent( 3, "Room" ) );
+
+		// Overlapping layers at 0.3, a hole between 0.7 and 0.72,
+		// and a gap in the layer indices.
+		auto pCompo = std::make_shared<InstrumentComponent>( 3 );
+		pCompo->set_layer( createLayer( 0.0, 0.3 ), 0 );
+		pCompo->set_layer( createLayer( 0.3, 0.7 ), 1 );
+		pCompo->set_layer( createLayer( 0.72, 1.0 ), 3 );
+
+		m_pInstrument = std::make_shared<Instrument>( 0, "Kick" );
+		m_pInstrument->get_components()->push_back( pCompo );
+	}
+
+	void tearDown() override
+	{
+		m_pInstrument = nullptr;
+		m_pSong = nullptr;
+	}
+
+	void testVelocityLayers()
+	{
+		RenderPlan plan;
+		plan.compile( m_pInstrument.get(), m_pSong.get(), InstrumentComponent::getMaxLayers() );
+		const auto& component = plan.getComponents().front();
+
+		CPPUNIT_ASSERT_EQUAL( 0, component.getVelocityLayer( 0.1 ) );
+		CPPUNIT_ASSERT_EQUAL( 1, component.getVelocityLayer( 0.5 ) );
+		CPPUNIT_ASSERT_EQUAL( 3, component.getVelocityLayer( 1.0 ) );
+		// Holes and boundaries are left to the search.
+		CPPUNIT_ASSERT_EQUAL( -1, component.getVelocityLayer( 0.71 ) );
+		CPPUNIT_ASSERT_EQUAL( -1, component.getVelocityLayer( 0.3 ) );
+		CPPUNIT_ASSERT_EQUAL( -1, component.getVelocityLayer( 1.5 ) );
+
+		// Whenever the table holds a layer it is the one the search
+		// would have found.
+		for ( int ii = 0; ii <= 10000; ++ii ) {
+			const float fVelocity = ii / 10000.0;
+			const int nLayer = component.getVelocityLayer( fVelocity );
+			if ( nLayer != -1 ) {
+				CPPUNIT_ASSERT_EQUAL( searchLayer( fVelocity ), nLayer );
+			}
+		}
+	}
+
+	void testComponents()
+	{
+		auto pOrphan = std::make_shared<InstrumentComponent>( 7 );
+		m_pInstrument->get_components()->push_back( pOrphan );
+
+		RenderPlan plan;
+		plan.compile( m_pInstrument.get(), m_pSong.get(), InstrumentComponent::getMaxLayers() );
+		const auto& components = plan.getComponents();
+		CPPUNIT_ASSERT_EQUAL( size_t( 2 ), components.size() );
+
+		CPPUNIT_ASSERT( components[ 0 ].pComponent == m_pInstrument->get_components()->front() );
+		CPPUNIT_ASSERT_EQUAL( 3, components[ 0 ].nComponentID );
+		CPPUNIT_ASSERT( components[ 0 ].pMainCompo == m_pSong->getComponents()->at( 1 ) );
+		CPPUNIT_ASSERT_EQUAL( 1, components[ 0 ].nMainCompoIndex );
+
+		CPPUNIT_ASSERT( components[ 1 ].pComponent == pOrphan );
+		CPPUNIT_ASSERT( components[ 1 ].pMainCompo == nullptr );
+		CPPUNIT_ASSERT_EQUAL( -1, components[ 1 ].nMainCompoIndex );
+		for ( int nBucket = 0; nBucket < RenderPlan::nVelocityBuckets; ++nBucket ) {
+			CPPUNIT_ASSERT_EQUAL( -1, components[ 1 ].velocityLayers[ nBucket ] );
+		}
+	}
+
+	void testInvalidation()
+	{
+		const int nMaxLayers = InstrumentComponent::getMaxLayers();
+		RenderPlan plan;
+		CPPUNIT_ASSERT( ! plan.isUpToDate( m_pInstrument.get(), m_pSong.get() ) );
+		plan.compile( m_pInstrument.get(), m_pSong.get(), nMaxLayers );
+		CPPUNIT_ASSERT( plan.isUpToDate( m_pInstrument.get(), m_pSong.get() ) );
+
+		// Layer edits
+		auto pCompo = m_pInstrument->get_components()->front();
+		pCompo->get_layer( 1 )->set_end_velocity( 0.72 );
+		CPPUNIT_ASSERT( ! plan.isUpToDate( m_pInstrument.get(), m_pSong.get() ) );
+		plan.compile( m_pInstrument.get(), m_pSong.get(), nMaxLayers );
+		CPPUNIT_ASSERT_EQUAL( 1, plan.getComponents().front().getVelocityLayer( 0.71 ) );
+
+		pCompo->set_layer( nullptr, 3 );
+		CPPUNIT_ASSERT( ! plan.isUpToDate( m_pInstrument.get(), m_pSong.get() ) );
+		plan.compile( m_pInstrument.get(), m_pSong.get(), nMaxLayers );
+		CPPUNIT_ASSERT_EQUAL( -1, plan.getComponents().front().getVelocityLayer( 0.9 ) );
+
+		// Components of the instrument and the song
+		m_pInstrument->get_components()->front() = std::make_shared<InstrumentComponent>( pCompo );
+		CPPUNIT_ASSERT( ! plan.isUpToDate( m_pInstrument.get(), m_pSong.get() ) );
+		plan.compile( m_pInstrument.get(), m_pSong.get(), nMaxLayers );
+		CPPUNIT_ASSERT( plan.isUpToDate( m_pInstrument.get(), m_pSong.get() ) );
+
+		m_pSong->getComponents()->push_back( new DrumkitComponent( 4, "Overheads" ) );
+		CPPUNIT_ASSERT( ! plan.isUpToDate( m_pInstrument.get(), m_pSong.get() ) );
+		plan.compile( m_pInstrument.get(), m_pSong.get(), nMaxLayers );
+
+		m_pSong->getComponents()->back()->set_id( 5 );
+		CPPUNIT_ASSERT( ! plan.isUpToDate( m_pInstrument.get(), m_pSong.get() ) );
+
+		// Pan
+		CPPUNIT_ASSERT( ! plan.isPanUpToDate( 0.5, m_pSong.get() ) );
+		plan.setPan( 0.5, m_pSong.get(), 0.25, 0.75 );
+		CPPUNIT_ASSERT( plan.isPanUpToDate( 0.5, m_pSong.get() ) );
+		CPPUNIT_ASSERT( ! plan.isPanUpToDate( 0.4, m_pSong.get() ) );
+		m_pSong->setPanLawKNorm( 2 * m_pSong->getPanLawKNorm() );
+		CPPUNIT_ASSERT( ! plan.isPanUpToDate( 0.5, m_pSong.get() ) );
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( RenderPlanTest );
@@ -0,0 +1,203 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+#include "TestHelper.h"
+
+#include <core/Basics/Sample.h>
+#include <core/Helpers/Filesystem.h>
+#include <core/Helpers/SampleCache.h>
+#include <core/Preferences/Preferences.h>
+
+#include <QDateTime>
+#include <QFile>
+
+using namespace H2Core;
+
+class SampleCacheTest : public CppUnit::TestCase {
+	CPPUNIT_TEST_SUITE( SampleCacheTest );
+	CPPUNIT_TEST( testLoad );
+	CPPUNIT_TEST( testTransformedLoad );
+	CPPUNIT_TEST( testMonoLoad );
+	CPPUNIT_TEST( testEvict );
+	CPPUNIT_TEST_SUITE_END();
+
+	QString m_sPath;
+	bool m_bUseSampleCache;
+
+	static QString entryPath( const QString& sKey ) {
+		return Filesystem::sample_cache_dir() + sKey + ".h2sc";
+	}
+
+	static void checkEqual( std::shared_ptr<Sample> pExpected, std::shared_ptr<Sample> pSample ) {
+		CPPUNIT_ASSERT( pSample != nullptr );
+		CPPUNIT_ASSERT_EQUAL( pExpected->get_frames(), pSample->get_frames() );
+		CPPUNIT_ASSERT_EQUAL( pExpected->get_sample_rate(), pSample->get_sample_rate() );
+		for ( int ii = 0; ii < pExpected->get_frames(); ++ii ) {
+			CPPUNIT_ASSERT_EQUAL( pExpected->get_data_l()[ ii ], pSample->get_data_l()[ ii ] );
+			CPPUNIT_ASSERT_EQUAL( pExpected->get_data_r()[ ii ], pSample->get_data_r()[ ii ] );
+		}
+	}
+
+public:
+	void setUp() override
+	{
+		m_sPath = H2TEST_FILE( "drumkits/baseKit/snare.wav" );
+		m_bUseSampleCache = Preferences::get_instance()->m_bUseSampleCache;
+		Preferences::get_instance()->m_bUseSampleCache = true;
+	}
+
+	void tearDown() override
+	{
+		Preferences::get_instance()->m_bUseSampleCache = m_bUseSampleCache;
+	}
+
+	void testLoad()
+	{
+		const QString sKey = SampleCache::getKey( m_sPath );
+		CPPUNIT_ASSERT( ! sKey.isEmpty() );
+		QFile::remove( entryPath( sKey ) );
+
+		// Only samples of instruments are cached.
+		auto pReference = Sample::load( m_sPath );
+		CPPUNIT_ASSERT( pReference != nullptr );
+		CPPUNIT_ASSERT( ! QFile::exists( entryPath( sKey ) ) );
+
+		auto pSample = Sample::load( m_sPath, true );
+		CPPUNIT_ASSERT( QFile::exists( entryPath( sKey ) ) );
+		checkEqual( pReference, pSample );
+
+		// Modifications of mapped data must not end up in the cache.
+		Sample::VelocityEnvelope velocity;
+		velocity.emplace_back( 0, 91 );
+		velocity.emplace_back( 841, 91 );
+		pSample->apply( Sample::Loops(), Sample::Rubberband(), velocity,
+						Sample::PanEnvelope(), 120 );
+		CPPUNIT_ASSERT( pSample->get_data_l()[ pSample->get_frames() / 2 ] == 0 );
+
+		checkEqual( pReference, Sample::load( m_sPath, true ) );
+
+		QFile::remove( entryPath( sKey ) );
+	}
+
+	void testTransformedLoad()
+	{
+		Sample::Loops loops;
+		loops.start_frame = 100;
+		loops.loop_frame = 200;
+		loops.end_frame = 1000;
+		loops.count = 2;
+		Sample::VelocityEnvelope velocity;
+		velocity.emplace_back( 0, 0 );
+		velocity.emplace_back( 841, 45 );
+
+		const QString sKey = SampleCache::getKey( m_sPath, loops, Sample::Rubberband(), velocity,
+												  Sample::PanEnvelope(), 120 );
+		CPPUNIT_ASSERT( sKey != SampleCache::getKey( m_sPath ) );
+		QFile::remove( entryPath( sKey ) );
+
+		auto pReference = Sample::load( m_sPath, loops, Sample::Rubberband(), velocity,
+										Sample::PanEnvelope(), 120 );
+		CPPUNIT_ASSERT( QFile::exists( entryPath( sKey ) ) );
+
+		auto pSample = Sample::load( m_sPath, loops, Sample::Rubberband(), velocity,
+									 Sample::PanEnvelope(), 120 );
+		checkEqual( pReference, pSample );
+		CPPUNIT_ASSERT( pSample->get_loops() == loops );
+		CPPUNIT_ASSERT( pSample->get_is_modified() );
+		CPPUNIT_ASSERT_EQUAL( velocity.size(), pSample->get_velocity_envelope()->size() );
+		CPPUNIT_ASSERT_EQUAL( 45, pSample->get_velocity_envelope()->at( 1 ).value );
+
+		QFile::remove( entryPath( sKey ) );
+	}
+
+	void testMonoLoad()
+	{
+		const QString sPath = H2TEST_FILE( "drumkits/baseKit/kick.wav" );
+		const QString sKey = SampleCache::getKey( sPath );
+		CPPUNIT_ASSERT( ! sKey.isEmpty() );
+		QFile::remove( entryPath( sKey ) );
+
+		auto pReference = Sample::load( sPath );
+		CPPUNIT_ASSERT( pReference != nullptr );
+		CPPUNIT_ASSERT( pReference->is_mono() );
+
+		// Mono samples are stored with a single channel and stay mono
+		// when mapped again.
+		auto pSample = Sample::load( sPath, true );
+		CPPUNIT_ASSERT( pSample->is_mono() );
+		CPPUNIT_ASSERT( QFile( entryPath( sKey ) ).size() <
+						2 * static_cast<qint64>( pSample->get_frames() ) * sizeof( float ) );
+
+		pSample = Sample::load( sPath, true );
+		CPPUNIT_ASSERT( pSample->is_mono() );
+		checkEqual( pReference, pSample );
+
+		QFile::remove( entryPath( sKey ) );
+	}
+
+	void testEvict()
+	{
+		auto pPref = Preferences::get_instance();
+		const int nOldSampleCacheSizeMb = pPref->m_nSampleCacheSizeMb;
+		pPref->m_nSampleCacheSizeMb = 0;
+
+		const QString sKickPath = H2TEST_FILE( "drumkits/baseKit/kick.wav" );
+		const QString sSnareKey = SampleCache::getKey( m_sPath );
+		const QString sKickKey = SampleCache::getKey( sKickPath );
+		CPPUNIT_ASSERT( Sample::load( m_sPath, true ) != nullptr );
+		CPPUNIT_ASSERT( Sample::load( sKickPath, true ) != nullptr );
+		CPPUNIT_ASSERT( QFile::exists( entryPath( sSnareKey ) ) );
+		CPPUNIT_ASSERT( QFile::exists( entryPath( sKickKey ) ) );
+
+		// The snare was used less recently.
+		QFile snare( entryPath( sSnareKey ) );
+		CPPUNIT_ASSERT( snare.open( QIODevice::ReadOnly ) );
+		CPPUNIT_ASSERT( snare.setFileTime( QDateTime::currentDateTimeUtc().addDays( -1 ),
+										   QFileDevice::FileModificationTime ) );
+		snare.close();
+
+		SampleCache::evict( QFile( entryPath( sKickKey ) ).size() );
+		CPPUNIT_ASSERT( ! QFile::exists( entryPath( sSnareKey ) ) );
+		CPPUNIT_ASSERT( QFile::exists( entryPath( sKickKey ) ) );
+
+		// Mapping an entry marks it as used.
+		CPPUNIT_ASSERT( Sample::load( m_sPath, true ) != nullptr );
+		CPPUNIT_ASSERT( snare.open( QIODevice::ReadOnly ) );
+		CPPUNIT_ASSERT( snare.setFileTime( QDateTime::currentDateTimeUtc().addDays( -2 ),
+										   QFileDevice::FileModificationTime ) );
+		snare.close();
+		QFile kick( entryPath( sKickKey ) );
+		CPPUNIT_ASSERT( kick.open( QIODevice::ReadOnly ) );
+		CPPUNIT_ASSERT( kick.setFileTime( QDateTime::currentDateTimeUtc().addDays( -1 ),
+										  QFileDevice::FileModificationTime ) );
+		kick.close();
+		CPPUNIT_ASSERT( Sample::load( m_sPath, true ) != nullptr );
+		SampleCache::evict( QFile( entryPath( sSnareKey ) ).size() );
+		CPPUNIT_ASSERT( QFile::exists( entryPath( sSnareKey ) ) );
+		CPPUNIT_ASSERT( ! QFile::exists( entryPath( sKickKey ) ) );
+
+		QFile::remove( entryPath( sSnareKey ) );
+		pPref->m_nSampleCacheSizeMb = nOldSampleCacheSizeMb;
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( SampleCacheTest );
@@ -0,0 +1,78 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+#include "TestHelper.h"
+
+#include <core/Basics/Sample.h>
+#include <core/Helpers/SampleLoader.h>
+
+using namespace H2Core;
+
+class SampleLoaderTest : public CppUnit::TestCase {
+	CPPUNIT_TEST_SUITE( SampleLoaderTest );
+	CPPUNIT_TEST( testLoad );
+	CPPUNIT_TEST( testCancel );
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void testLoad()
+	{
+		const QStringList paths = { H2TEST_FILE( "drumkits/baseKit/crash.wav" ),
+									H2TEST_FILE( "drumkits/baseKit/snare.wav" ),
+									H2TEST_FILE( "drumkits/baseKit/does_not_exist.wav" ) };
+
+		SampleLoader sampleLoader( 2 );
+		for ( const auto& sPath : paths ) {
+			sampleLoader.add( sPath );
+		}
+		// Registering a file twice must not load it twice.
+		sampleLoader.add( paths[ 0 ] );
+		CPPUNIT_ASSERT( sampleLoader.run() );
+
+		for ( const auto& sPath : paths ) {
+			auto pExpected = Sample::load( sPath );
+			auto pSample = sampleLoader.getSample( sPath );
+			if ( pExpected == nullptr ) {
+				CPPUNIT_ASSERT( pSample == nullptr );
+				continue;
+			}
+			CPPUNIT_ASSERT( pSample != nullptr );
+			CPPUNIT_ASSERT_EQUAL( pExpected->get_frames(), pSample->get_frames() );
+			for ( int ii = 0; ii < pExpected->get_frames(); ++ii ) {
+				CPPUNIT_ASSERT_EQUAL( pExpected->get_data_l()[ ii ], pSample->get_data_l()[ ii ] );
+				CPPUNIT_ASSERT_EQUAL( pExpected->get_data_r()[ ii ], pSample->get_data_r()[ ii ] );
+			}
+		}
+		CPPUNIT_ASSERT( sampleLoader.getSample( "unknown.wav" ) == nullptr );
+	}
+
+	void testCancel()
+	{
+		SampleLoader sampleLoader;
+		sampleLoader.add( H2TEST_FILE( "drumkits/baseKit/crash.wav" ) );
+		sampleLoader.cancel();
+		CPPUNIT_ASSERT( ! sampleLoader.run() );
+		CPPUNIT_ASSERT( sampleLoader.getSample( H2TEST_FILE( "drumkits/baseKit/crash.wav" ) ) == nullptr );
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( SampleLoaderTest );
@@ -0,0 +1,101 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+#include <cppunit/extensions/HelperMacros.h>
+#include "TestHelper.h"
+
+#include <core/Basics/Sample.h>
+#include <core/Helpers/Filesystem.h>
+#include <core/Helpers/SamplePool.h>
+
+using namespace H2Core;
+
+class SamplePoolTest : public CppUnit::TestCase {
+	CPPUNIT_TEST_SUITE( SamplePoolTest );
+	CPPUNIT_TEST( testSharing );
+	CPPUNIT_TEST( testTransforms );
+	CPPUNIT_TEST_SUITE_END();
+
+	/** Copy of a sample not used by any other test.*/
+	QString m_sPath;
+
+public:
+	void setUp() override
+	{
+		m_sPath = Filesystem::tmp_file_path( "pool.wav" );
+		CPPUNIT_ASSERT( Filesystem::file_copy( H2TEST_FILE( "drumkits/baseKit/snare.wav" ),
+											   m_sPath, true ) );
+	}
+
+	void tearDown() override
+	{
+		Filesystem::rm( m_sPath );
+	}
+
+	void testSharing()
+	{
+		const QString sPath = m_sPath;
+		const auto start = SamplePool::getStatistics();
+
+		auto pSample = SamplePool::load( sPath );
+		CPPUNIT_ASSERT( pSample != nullptr );
+		auto pOther = SamplePool::load( sPath );
+		CPPUNIT_ASSERT( pSample == pOther );
+
+		auto loaded = SamplePool::getStatistics();
+		CPPUNIT_ASSERT_EQUAL( start.nMisses + 1, loaded.nMisses );
+		CPPUNIT_ASSERT_EQUAL( start.nHits + 1, loaded.nHits );
+		CPPUNIT_ASSERT( loaded.nResidentBytes > start.nResidentBytes );
+
+		// The pool does not keep samples alive on its own.
+		pSample = nullptr;
+		pOther = nullptr;
+		auto released = SamplePool::getStatistics();
+		CPPUNIT_ASSERT_EQUAL( start.nResidentBytes, released.nResidentBytes );
+
+		pSample = SamplePool::load( sPath );
+		CPPUNIT_ASSERT( pSample != nullptr );
+		CPPUNIT_ASSERT_EQUAL( start.nMisses + 2, SamplePool::getStatistics().nMisses );
+
+		CPPUNIT_ASSERT( SamplePool::load( H2TEST_FILE( "drumkits/baseKit/kick.wav" ) ) != pSample );
+		CPPUNIT_ASSERT( SamplePool::load( "PathDoesNotExist" ) == nullptr );
+	}
+
+	void testTransforms()
+	{
+		const QString sPath = m_sPath;
+		Sample::VelocityEnvelope velocity;
+		velocity.emplace_back( 0, 0 );
+		velocity.emplace_back( 841, 45 );
+
+		auto pPlain = SamplePool::load( sPath );
+		auto pTransformed = SamplePool::load( sPath, Sample::Loops(), Sample::Rubberband(),
+											  velocity, Sample::PanEnvelope(), 120 );
+		CPPUNIT_ASSERT( pTransformed != nullptr );
+		CPPUNIT_ASSERT( pTransformed != pPlain );
+		CPPUNIT_ASSERT( pTransformed->get_is_modified() );
+
+		auto pOther = SamplePool::load( sPath, Sample::Loops(), Sample::Rubberband(),
+										velocity, Sample::PanEnvelope(), 120 );
+		CPPUNIT_ASSERT( pTransformed == pOther );
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( SamplePoolTest );
@@ -0,0 +1,113 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+#include "TestHelper.h"
+
+#include <core/Basics/Sample.h>
+#include <core/Sampler/SampleStreamer.h>
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+using namespace H2Core;
+
+class SampleStreamerTest : public CppUnit::TestCase {
+	CPPUNIT_TEST_SUITE( SampleStreamerTest );
+	CPPUNIT_TEST( testStreamedLoad );
+	CPPUNIT_TEST( testStream );
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void testStreamedLoad()
+	{
+		QString sPath = H2TEST_FILE( "drumkits/baseKit/crash.wav" );
+
+		// Without a SampleStreamer samples are always loaded completely.
+		auto pSample = Sample::load( sPath, true );
+		CPPUNIT_ASSERT( pSample != nullptr );
+		CPPUNIT_ASSERT( ! pSample->is_streamed() );
+
+		SampleStreamer streamer( 1, 100 );
+		auto pStreamedSample = Sample::load( sPath, true );
+		CPPUNIT_ASSERT( pStreamedSample->is_streamed() );
+		CPPUNIT_ASSERT_EQUAL( pSample->get_frames(), pStreamedSample->get_frames() );
+		CPPUNIT_ASSERT_EQUAL( pSample->get_sample_rate() / 10,
+							  pStreamedSample->get_resident_frames() );
+		for ( int ii = 0; ii < pStreamedSample->get_resident_frames(); ++ii ) {
+			CPPUNIT_ASSERT_EQUAL( pSample->get_data_l()[ ii ], pStreamedSample->get_data_l()[ ii ] );
+			CPPUNIT_ASSERT_EQUAL( pSample->get_data_r()[ ii ], pStreamedSample->get_data_r()[ ii ] );
+		}
+
+		// Only samples of instrument layers are streamed.
+		CPPUNIT_ASSERT( ! Sample::load( sPath )->is_streamed() );
+	}
+
+	void testStream()
+	{
+		QString sPath = H2TEST_FILE( "drumkits/baseKit/crash.wav" );
+		auto pSample = Sample::load( sPath );
+
+		SampleStreamer streamer( 1, 100 );
+		auto pStreamedSample = Sample::load( sPath, true );
+		CPPUNIT_ASSERT( pStreamedSample->is_streamed() );
+
+		auto pStream = streamer.open( pStreamedSample );
+		CPPUNIT_ASSERT( pStream != nullptr );
+		// All streams are in use.
+		CPPUNIT_ASSERT( streamer.open( pStreamedSample ) == nullptr );
+
+		// Read through the whole sample in chunks the size of a
+		// typical process cycle. Frames arriving too late are not
+		// checked but waited for.
+		const int nFrames = pSample->get_frames();
+		const int nChunkSize = 1024;
+		int nPos = 0;
+		while ( nPos < nFrames ) {
+			int nEnd = std::min( nPos + nChunkSize, nFrames );
+			auto window = streamer.getWindow( pStream, pStreamedSample, nPos, nEnd );
+			int nAvailable = std::min( window.nOffset + window.nFrames, nEnd );
+			for ( int ii = nPos; ii < nAvailable; ++ii ) {
+				CPPUNIT_ASSERT_EQUAL( pSample->get_data_l()[ ii ], window.pData_L[ ii - window.nOffset ] );
+				CPPUNIT_ASSERT_EQUAL( pSample->get_data_r()[ ii ], window.pData_R[ ii - window.nOffset ] );
+			}
+			if ( nAvailable > nPos ) {
+				nPos = nAvailable;
+			} else {
+				std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+			}
+		}
+
+		// The stream becomes available again once the background
+		// thread closed it.
+		streamer.close( pStream );
+		pStream = nullptr;
+		for ( int ii = 0; ii < 1000 && pStream == nullptr; ++ii ) {
+			std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+			pStream = streamer.open( pStreamedSample );
+		}
+		CPPUNIT_ASSERT( pStream != nullptr );
+		streamer.close( pStream );
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( SampleStreamerTest );
@@ -25,9 +25,16 @@
 
 #include <core/Basics/Sample.h>
 
+#include <algorithm>
+#include <cmath>
+
 class SampleTest : public CppUnit::TestCase {
 	CPPUNIT_TEST_SUITE( SampleTest );
 	CPPUNIT_TEST( testLoadInvalidSample );
+	CPPUNIT_TEST( testConvertSampleRate );
+	CPPUNIT_TEST( testConversionRequests );
+	CPPUNIT_TEST( testMonoSample );
+	CPPUNIT_TEST( testSharedData );
 
 	CPPUNIT_TEST_SUITE_END();
 
@@ -45,6 +52,154 @@ class SampleTest : public CppUnit::TestCase {
 		pSample = H2Core::Sample::load( H2TEST_FILE("drumkits/baseKit/drumkit.xml") );
 		CPPUNIT_ASSERT(pSample == nullptr);
 	}
+
+	/** One second of a sine at @a fFrequency in the left and at @a
+	 * fFrequency_R in the right channel.*/
+	static std::shared_ptr<H2Core::Sample> createSine( int nSampleRate, float fFrequency_L,
+													   float fFrequency_R )
+	{
+		float* pData_L = new float[ nSampleRate ];
+		float* pData_R = new float[ nSampleRate ];
+		for ( int ii = 0; ii < nSampleRate; ++ii ) {
+			pData_L[ ii ] = 0.5 * std::sin( 2 * M_PI * fFrequency_L * ii / nSampleRate );
+			pData_R[ ii ] = 0.5 * std::sin( 2 * M_PI * fFrequency_R * ii / nSampleRate );
+		}
+		return std::make_shared<H2Core::Sample>( H2TEST_FILE( "sine.wav" ), nSampleRate,
+												 nSampleRate, pData_L, pData_R );
+	}
+
+	static float peak( const float* pData, int nStart, int nEnd )
+	{
+		float fPeak = 0;
+		for ( int ii = nStart; ii < nEnd; ++ii ) {
+			fPeak = std::max( fPeak, std::fabs( pData[ ii ] ) );
+		}
+		return fPeak;
+	}
+
+	void testConvertSampleRate()
+	{
+		auto pSample = createSine( 44100, 1000, 18000 );
+
+		auto pUp = pSample->convert_sample_rate( 48000 );
+		CPPUNIT_ASSERT( pUp != nullptr );
+		CPPUNIT_ASSERT_EQUAL( 48000, pUp->get_sample_rate() );
+		CPPUNIT_ASSERT_EQUAL( 48000, pUp->get_frames() );
+		// Away from the edges the converted signal matches the one
+		// sampled at the target rate.
+		for ( int ii = 1000; ii < 47000; ++ii ) {
+			CPPUNIT_ASSERT_DOUBLES_EQUAL( 0.5 * std::sin( 2 * M_PI * 1000 * ii / 48000 ),
+										  pUp->get_data_l()[ ii ], 1e-4 );
+		}
+		CPPUNIT_ASSERT_DOUBLES_EQUAL( 0.5, peak( pUp->get_data_r(), 1000, 47000 ), 0.01 );
+
+		// Frequencies above the Nyquist frequency of the target rate
+		// are removed.
+		auto pDown = pSample->convert_sample_rate( 22050 );
+		CPPUNIT_ASSERT( pDown != nullptr );
+		CPPUNIT_ASSERT_EQUAL( 22050, pDown->get_frames() );
+		CPPUNIT_ASSERT_DOUBLES_EQUAL( 0.5, peak( pDown->get_data_l(), 1000, 21000 ), 0.01 );
+		CPPUNIT_ASSERT( peak( pDown->get_data_r(), 1000, 21000 ) < 1e-3 );
+	}
+
+	void testConversionRequests()
+	{
+		auto pSample = createSine( 44100, 1000, 1000 );
+		CPPUNIT_ASSERT( pSample->get_converted( 48000 ) == nullptr );
+
+		const unsigned nRequest = pSample->request_conversion( 48000 );
+		CPPUNIT_ASSERT( nRequest != 0 );
+		// Already pending.
+		CPPUNIT_ASSERT_EQUAL( 0u, pSample->request_conversion( 48000 ) );
+
+		CPPUNIT_ASSERT( pSample->set_converted( pSample->convert_sample_rate( 48000 ), nRequest ) );
+		CPPUNIT_ASSERT( pSample->get_converted( 48000 ) != nullptr );
+		CPPUNIT_ASSERT( pSample->get_converted( 96000 ) == nullptr );
+
+		// Results of outdated requests are dropped.
+		const unsigned nOutdated = pSample->request_conversion( 96000 );
+		const unsigned nCurrent = pSample->request_conversion( 96000, true );
+		CPPUNIT_ASSERT( ! pSample->set_converted( pSample->convert_sample_rate( 96000 ), nOutdated ) );
+		CPPUNIT_ASSERT( pSample->set_converted( pSample->convert_sample_rate( 96000 ), nCurrent ) );
+		CPPUNIT_ASSERT( pSample->get_converted( 96000 ) != nullptr );
+
+		// Changing the data drops the converted copy.
+		const unsigned nPending = pSample->request_conversion( 48000 );
+		pSample->unload();
+		CPPUNIT_ASSERT( pSample->get_converted( 96000 ) == nullptr );
+		CPPUNIT_ASSERT( ! pSample->set_converted( pSample->convert_sample_rate( 48000 ), nPending ) );
+		CPPUNIT_ASSERT( pSample->convert_sample_rate( 48000 ) == nullptr );
+	}
+
+	void testMonoSample()
+	{
+		auto pStereo = H2Core::Sample::load( H2TEST_FILE( "drumkits/baseKit/snare.wav" ) );
+		CPPUNIT_ASSERT( pStereo != nullptr );
+		CPPUNIT_ASSERT( ! pStereo->is_mono() );
+
+		// Both channels share the data of mono files.
+		auto pMono = H2Core::Sample::load( H2TEST_FILE( "drumkits/baseKit/kick.wav" ) );
+		CPPUNIT_ASSERT( pMono != nullptr );
+		CPPUNIT_ASSERT( pMono->is_mono() );
+		CPPUNIT_ASSERT( pMono->get_data_l() == pMono->get_data_r() );
+
+		auto pCopy = std::make_shared<H2Core::Sample>( pMono );
+		CPPUNIT_ASSERT( pCopy->is_mono() );
+		CPPUNIT_ASSERT( pCopy->get_data_l() != pMono->get_data_l() );
+
+		auto pConverted = pMono->convert_sample_rate( 48000 );
+		CPPUNIT_ASSERT( pConverted != nullptr );
+		CPPUNIT_ASSERT( pConverted->is_mono() );
+
+		// The velocity envelope is applied only once to the shared
+		// data.
+		H2Core::Sample::VelocityEnvelope velocity;
+		velocity.emplace_back( 0, 45 );
+		velocity.emplace_back( 841, 45 );
+		pCopy->apply( H2Core::Sample::Loops(), H2Core::Sample::Rubberband(), velocity,
+					  H2Core::Sample::PanEnvelope(), 120 );
+		CPPUNIT_ASSERT( pCopy->is_mono() );
+		const float fGain = ( 91 - 45 ) / 91.0F;
+		for ( int ii = 0; ii < pCopy->get_frames() - 1; ii += 97 ) {
+			CPPUNIT_ASSERT_DOUBLES_EQUAL( pMono->get_data_l()[ ii ] * fGain,
+										  pCopy->get_data_l()[ ii ], 1e-6 );
+		}
+
+		// Panning splits the channels.
+		H2Core::Sample::PanEnvelope pan;
+		pan.emplace_back( 0, 0 );
+		pan.emplace_back( 841, 0 );
+		pCopy->apply( H2Core::Sample::Loops(), H2Core::Sample::Rubberband(),
+					  H2Core::Sample::VelocityEnvelope(), pan, 120 );
+		CPPUNIT_ASSERT( ! pCopy->is_mono() );
+		CPPUNIT_ASSERT( pCopy->get_data_l() != pCopy->get_data_r() );
+	}
+
+	void testSharedData()
+	{
+		auto pSample = createSine( 44100, 1000, 1000 );
+		auto pData = pSample->get_shared_data();
+		CPPUNIT_ASSERT( pData != nullptr );
+		CPPUNIT_ASSERT( pData->pData_L == pSample->get_data_l() );
+		const float fValue = pData->pData_L[ 10 ];
+
+		// Shared data is replaced instead of being modified in place.
+		H2Core::Sample::VelocityEnvelope velocity;
+		velocity.emplace_back( 0, 45 );
+		velocity.emplace_back( 841, 45 );
+		pSample->apply( H2Core::Sample::Loops(), H2Core::Sample::Rubberband(), velocity,
+						H2Core::Sample::PanEnvelope(), 120 );
+		CPPUNIT_ASSERT( pData->pData_L != pSample->get_data_l() );
+		CPPUNIT_ASSERT_EQUAL( fValue, pData->pData_L[ 10 ] );
+
+		// The data stays valid after the sample is gone.
+		const QString sFilepath = pSample->get_filepath();
+		pSample = nullptr;
+		auto pConverted = H2Core::Sample::convert_sample_rate( sFilepath, pData, 44100, 44100, 48000 );
+		CPPUNIT_ASSERT( pConverted != nullptr );
+		CPPUNIT_ASSERT_EQUAL( 48000, pConverted->get_frames() );
+		CPPUNIT_ASSERT_DOUBLES_EQUAL( 0.5, peak( pConverted->get_data_l(), 1000, 47000 ), 0.01 );
+	}
 };
 
 CPPUNIT_TEST_SUITE_REGISTRATION( SampleTest );
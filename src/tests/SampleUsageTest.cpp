@@ -0,0 +1,181 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+#include <cppunit/extensions/HelperMacros.h>
+#include "TestHelper.h"
+
+#include <core/Basics/Instrument.h>
+#include <core/Basics/InstrumentComponent.h>
+#include <core/Basics/InstrumentLayer.h>
+#include <core/Basics/InstrumentList.h>
+#include <core/Basics/Note.h>
+#include <core/Basics/Pattern.h>
+#include <core/Basics/PatternList.h>
+#include <core/Basics/Sample.h>
+#include <core/Basics/Song.h>
+#include <core/Helpers/SampleLoader.h>
+#include <core/Helpers/SampleUsage.h>
+
+#include <memory>
+
+using namespace H2Core;
+
+class SampleUsageTest : public CppUnit::TestCase {
+	CPPUNIT_TEST_SUITE( SampleUsageTest );
+	CPPUNIT_TEST( testVelocities );
+	CPPUNIT_TEST( testComponents );
+	CPPUNIT_TEST( testHumanize );
+	CPPUNIT_TEST( testLoading );
+	CPPUNIT_TEST_SUITE_END();
+
+	std::shared_ptr<Song> m_pSong;
+	std::shared_ptr<Instrument> m_pInstrument;
+	std::shared_ptr<Instrument> m_pUnused;
+	Pattern* m_pPattern;
+
+	static std::shared_ptr<InstrumentLayer> createLayer( float fStart, float fEnd )
+	{
+		auto pLayer = std::make_shared<InstrumentLayer>(
+			Sample::create_unloaded( H2TEST_FILE( "drumkits/baseKit/snare.wav" ) ) );
+		pLayer->set_start_velocity( fStart );
+		pLayer->set_end_velocity( fEnd );
+		return pLayer;
+	}
+
+	static std::shared_ptr<InstrumentComponent> createComponent( int nID )
+	{
+		// A hole between 0.6 and 0.62.
+		auto pCompo = std::make_shared<InstrumentComponent>( nID );
+		pCompo->set_layer( createLayer( 0.0, 0.3 ), 0 );
+		pCompo->set_layer( createLayer( 0.3, 0.6 ), 1 );
+		pCompo->set_layer( createLayer( 0.62, 0.9 ), 2 );
+		pCompo->set_layer( createLayer( 0.95, 1.0 ), 3 );
+		return pCompo;
+	}
+
+	void addNote( float fVelocity, int nComponent = -1 )
+	{
+		Note* pNote = new Note( m_pInstrument, m_pPattern->get_notes()->size(), fVelocity, 0, -1, 0 );
+		pNote->set_specific_compo_id( nComponent );
+		m_pPattern->insert_note( pNote );
+	}
+
+	bool isUsed( const SampleUsage& usage, std::shared_ptr<Instrument> pInstrument,
+				 int nComponent, int nLayer ) const
+	{
+		return usage.isLayerUsed( pInstrument, pInstrument->get_components()->at( nComponent ),
+								  nLayer );
+	}
+
+public:
+	void setUp() override
+	{
+		m_pSong = std::make_shared<Song>( "SampleUsageTest", "test", 120, 0.5 );
+
+		m_pInstrument = std::make_shared<Instrument>( 0, "Snare" );
+		m_pInstrument->get_components()->push_back( createComponent( 0 ) );
+		m_pInstrument->get_components()->push_back( createComponent( 1 ) );
+		m_pUnused = std::make_shared<Instrument>( 1, "Unused" );
+		m_pUnused->get_components()->push_back( createComponent( 0 ) );
+
+		InstrumentList* pInstruments = new InstrumentList();
+		pInstruments->add( m_pInstrument );
+		pInstruments->add( m_pUnused );
+		m_pSong->setInstrumentList( pInstruments );
+
+		m_pPattern = new Pattern();
+		PatternList* pPatterns = new PatternList();
+		pPatterns->add( m_pPattern );
+		m_pSong->setPatternList( pPatterns );
+	}
+
+	void tearDown() override
+	{
+		m_pInstrument = nullptr;
+		m_pUnused = nullptr;
+		m_pSong = nullptr;
+	}
+
+	void testVelocities()
+	{
+		addNote( 0.5 );
+		// Falls into the hole and is played by the layer starting
+		// closest to it.
+		addNote( 0.61 );
+
+		SampleUsage usage( m_pSong );
+		CPPUNIT_ASSERT( ! isUsed( usage, m_pInstrument, 0, 0 ) );
+		CPPUNIT_ASSERT( isUsed( usage, m_pInstrument, 0, 1 ) );
+		CPPUNIT_ASSERT( isUsed( usage, m_pInstrument, 0, 2 ) );
+		CPPUNIT_ASSERT( ! isUsed( usage, m_pInstrument, 0, 3 ) );
+		CPPUNIT_ASSERT( ! isUsed( usage, m_pInstrument, 0, 4 ) );
+
+		for ( int nLayer = 0; nLayer < 4; ++nLayer ) {
+			CPPUNIT_ASSERT( ! isUsed( usage, m_pUnused, 0, nLayer ) );
+		}
+	}
+
+	void testComponents()
+	{
+		addNote( 0.1, 1 );
+		addNote( 1.0 );
+
+		SampleUsage usage( m_pSong );
+		CPPUNIT_ASSERT( ! isUsed( usage, m_pInstrument, 0, 0 ) );
+		CPPUNIT_ASSERT( isUsed( usage, m_pInstrument, 0, 3 ) );
+		CPPUNIT_ASSERT( isUsed( usage, m_pInstrument, 1, 0 ) );
+		CPPUNIT_ASSERT( isUsed( usage, m_pInstrument, 1, 3 ) );
+	}
+
+	void testHumanize()
+	{
+		addNote( 0.5 );
+		m_pSong->setHumanizeVelocityValue( 0.2 );
+
+		// Humanization mostly lowers the velocity.
+		SampleUsage usage( m_pSong );
+		CPPUNIT_ASSERT( isUsed( usage, m_pInstrument, 0, 0 ) );
+		CPPUNIT_ASSERT( isUsed( usage, m_pInstrument, 0, 1 ) );
+		CPPUNIT_ASSERT( ! isUsed( usage, m_pInstrument, 0, 2 ) );
+	}
+
+	void testLoading()
+	{
+		addNote( 0.5, 0 );
+
+		SampleLoader sampleLoader;
+		SampleUsage usage( m_pSong );
+		const int nLeftOut = usage.addUsedLayers( m_pSong->getInstrumentList(), &sampleLoader, 120 );
+		CPPUNIT_ASSERT( sampleLoader.run() );
+		CPPUNIT_ASSERT_EQUAL( 11, nLeftOut );
+
+		auto pCompo = m_pInstrument->get_components()->front();
+		CPPUNIT_ASSERT( ! pCompo->get_layer( 1 )->get_sample()->is_empty() );
+		CPPUNIT_ASSERT( pCompo->get_layer( 0 )->get_sample()->is_empty() );
+		CPPUNIT_ASSERT( m_pInstrument->get_components()->at( 1 )->get_layer( 1 )->get_sample()->is_empty() );
+		CPPUNIT_ASSERT( m_pUnused->get_components()->front()->get_layer( 1 )->get_sample()->is_empty() );
+
+		// Empty samples are not registered again.
+		SampleLoader otherLoader;
+		CPPUNIT_ASSERT_EQUAL( 11, usage.addUsedLayers( m_pSong->getInstrumentList(), &otherLoader, 120 ) );
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( SampleUsageTest );
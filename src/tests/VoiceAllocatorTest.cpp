@@ -0,0 +1,169 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+#include <core/AudioEngine/EngineContext.h>
+#include <core/Basics/Adsr.h>
+#include <core/Basics/Instrument.h>
+#include <core/Basics/Note.h>
+#include <core/Sampler/VoiceAllocator.h>
+
+#include <vector>
+
+using namespace H2Core;
+
+class VoiceAllocatorTest : public CppUnit::TestCase {
+	CPPUNIT_TEST_SUITE( VoiceAllocatorTest );
+	CPPUNIT_TEST( testOldest );
+	CPPUNIT_TEST( testQuietest );
+	CPPUNIT_TEST( testOldestReleased );
+	CPPUNIT_TEST( testInstrumentAndMuteGroupLimits );
+	CPPUNIT_TEST_SUITE_END();
+
+	std::vector<Note*> m_voices;
+
+	/** Adds a voice of @a pInstr which already reached its sustain
+	 * level.*/
+	Note* addVoice( std::shared_ptr<Instrument> pInstr )
+	{
+		Note* pNote = new Note( pInstr, 0, 1.0f, 0.f, -1, 0 );
+		pNote->get_adsr()->attack();
+		pNote->get_adsr()->get_value( 1 );
+		pNote->get_adsr()->get_value( 1 );
+		m_voices.push_back( pNote );
+		return pNote;
+	}
+
+	static bool isStolen( Note* pNote )
+	{
+		return pNote->get_adsr()->get_state() == ADSR::FADE_OUT;
+	}
+
+	static EngineContext createContext( VoiceAllocator::Policy policy, int nMaxNotes )
+	{
+		EngineContext context;
+		context.nMaxNotes = nMaxNotes;
+		context.voiceStealingPolicy = policy;
+		return context;
+	}
+
+public:
+	void tearDown() override
+	{
+		for ( auto pNote : m_voices ) {
+			delete pNote;
+		}
+		m_voices.clear();
+	}
+
+	void testOldest()
+	{
+		auto pInstr = std::make_shared<Instrument>( 1, "Kick" );
+		for ( int ii = 0; ii < 4; ++ii ) {
+			addVoice( pInstr );
+		}
+
+		VoiceAllocator allocator( 8 );
+		auto context = createContext( VoiceAllocator::Policy::oldest, 2 );
+		CPPUNIT_ASSERT_EQUAL( 2, allocator.steal( m_voices, context ) );
+		CPPUNIT_ASSERT( isStolen( m_voices[ 0 ] ) );
+		CPPUNIT_ASSERT( isStolen( m_voices[ 1 ] ) );
+		CPPUNIT_ASSERT( ! isStolen( m_voices[ 2 ] ) );
+		CPPUNIT_ASSERT( ! isStolen( m_voices[ 3 ] ) );
+
+		// Voices fading out do not count toward the limit.
+		CPPUNIT_ASSERT_EQUAL( 0, allocator.steal( m_voices, context ) );
+	}
+
+	void testQuietest()
+	{
+		auto pInstr = std::make_shared<Instrument>( 1, "Kick" );
+		addVoice( pInstr );
+		Note* pQuiet = addVoice( pInstr );
+		addVoice( pInstr );
+		pQuiet->get_adsr()->release();
+		pQuiet->get_adsr()->get_value( 500 );
+		pQuiet->get_adsr()->get_value( 1 );
+
+		VoiceAllocator allocator( 8 );
+		auto context = createContext( VoiceAllocator::Policy::quietest, 2 );
+		CPPUNIT_ASSERT_EQUAL( 1, allocator.steal( m_voices, context ) );
+		CPPUNIT_ASSERT( ! isStolen( m_voices[ 0 ] ) );
+		CPPUNIT_ASSERT( isStolen( pQuiet ) );
+		CPPUNIT_ASSERT( ! isStolen( m_voices[ 2 ] ) );
+
+		// Voices in their attack phase are not considered quiet.
+		Note* pNew = new Note( pInstr, 0, 1.0f, 0.f, -1, 0 );
+		pNew->get_adsr()->attack();
+		m_voices.push_back( pNew );
+		CPPUNIT_ASSERT_EQUAL( 1, allocator.steal( m_voices, context ) );
+		CPPUNIT_ASSERT( isStolen( m_voices[ 0 ] ) );
+		CPPUNIT_ASSERT( ! isStolen( pNew ) );
+	}
+
+	void testOldestReleased()
+	{
+		auto pInstr = std::make_shared<Instrument>( 1, "Kick" );
+		addVoice( pInstr );
+		addVoice( pInstr );
+		Note* pReleased = addVoice( pInstr );
+		pReleased->get_adsr()->release();
+
+		VoiceAllocator allocator( 8 );
+		auto context = createContext( VoiceAllocator::Policy::oldestReleased, 2 );
+		CPPUNIT_ASSERT_EQUAL( 1, allocator.steal( m_voices, context ) );
+		CPPUNIT_ASSERT( isStolen( pReleased ) );
+
+		// Without released voices the oldest one is stolen.
+		context.nMaxNotes = 1;
+		CPPUNIT_ASSERT_EQUAL( 1, allocator.steal( m_voices, context ) );
+		CPPUNIT_ASSERT( isStolen( m_voices[ 0 ] ) );
+		CPPUNIT_ASSERT( ! isStolen( m_voices[ 1 ] ) );
+	}
+
+	void testInstrumentAndMuteGroupLimits()
+	{
+		auto pKick = std::make_shared<Instrument>( 1, "Kick" );
+		auto pOpenHat = std::make_shared<Instrument>( 2, "Open Hat" );
+		auto pClosedHat = std::make_shared<Instrument>( 3, "Closed Hat" );
+		pOpenHat->set_mute_group( 1 );
+		pClosedHat->set_mute_group( 1 );
+
+		addVoice( pKick );
+		addVoice( pOpenHat );
+		addVoice( pKick );
+		addVoice( pClosedHat );
+		addVoice( pKick );
+
+		VoiceAllocator allocator( 8 );
+		auto context = createContext( VoiceAllocator::Policy::oldest, 16 );
+		context.nMaxNotesPerInstrument = 2;
+		context.nMaxNotesPerMuteGroup = 1;
+		CPPUNIT_ASSERT_EQUAL( 2, allocator.steal( m_voices, context ) );
+		CPPUNIT_ASSERT( isStolen( m_voices[ 0 ] ) );
+		CPPUNIT_ASSERT( isStolen( m_voices[ 1 ] ) );
+		CPPUNIT_ASSERT( ! isStolen( m_voices[ 2 ] ) );
+		CPPUNIT_ASSERT( ! isStolen( m_voices[ 3 ] ) );
+		CPPUNIT_ASSERT( ! isStolen( m_voices[ 4 ] ) );
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( VoiceAllocatorTest );
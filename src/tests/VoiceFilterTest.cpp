@@ -0,0 +1,178 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+#include <core/Basics/Note.h>
+#include <core/Sampler/VoiceFilter.h>
+
+#include <cmath>
+#include <vector>
+
+using namespace H2Core;
+
+class VoiceFilterTest : public CppUnit::TestCase {
+	CPPUNIT_TEST_SUITE( VoiceFilterTest );
+	CPPUNIT_TEST( testLanes );
+	CPPUNIT_TEST( testSmoothing );
+	CPPUNIT_TEST( testTail );
+	CPPUNIT_TEST_SUITE_END();
+
+	/** Per-frame filter the VoiceFilter replaced.*/
+	static void filter( FilterState* pState, float fCutoff, float fResonance,
+						float* pValue_L, float* pValue_R )
+	{
+		pState->fBandPass_L = fResonance * pState->fBandPass_L +
+			fCutoff * ( *pValue_L - pState->fLowPass_L );
+		pState->fLowPass_L += fCutoff * pState->fBandPass_L;
+		pState->fBandPass_R = fResonance * pState->fBandPass_R +
+			fCutoff * ( *pValue_R - pState->fLowPass_R );
+		pState->fLowPass_R += fCutoff * pState->fBandPass_R;
+		*pValue_L = pState->fLowPass_L;
+		*pValue_R = pState->fLowPass_R;
+	}
+
+	static float input( int nVoice, int nFrame, bool bRight )
+	{
+		return std::sin( 0.05f * ( nVoice + 1 ) * nFrame + ( bRight ? 1.0f : 0.0f ) );
+	}
+
+public:
+	void testLanes()
+	{
+		// More voices than lanes, starting at different offsets and
+		// holding blocks of different length.
+		const int nVoices = VoiceFilter::nLanes + 3;
+		VoiceFilter voiceFilter;
+		std::vector<FilterState> states( nVoices );
+		std::vector<FilterState> references( nVoices );
+
+		for ( int nCycle = 0; nCycle < 3; ++nCycle ) {
+			for ( int nVoice = 0; nVoice < nVoices; ++nVoice ) {
+				const int nOffset = nVoice * 5;
+				const int nFrames = 256 - nVoice * 17;
+				const float fCutoff = 0.1f + 0.1f * nVoice;
+				const float fResonance = 0.9f - 0.05f * nVoice;
+
+				int nPosition = voiceFilter.add( &states[ nVoice ], fCutoff, fResonance,
+												 nOffset, nFrames );
+				CPPUNIT_ASSERT_EQUAL( nVoice, nPosition );
+				for ( int ii = 0; ii < nFrames; ++ii ) {
+					voiceFilter.getBuffer_L( nVoice )[ nOffset + ii ] = input( nVoice, ii, false );
+					voiceFilter.getBuffer_R( nVoice )[ nOffset + ii ] = input( nVoice, ii, true );
+				}
+			}
+			voiceFilter.process();
+
+			for ( int nVoice = 0; nVoice < nVoices; ++nVoice ) {
+				const int nOffset = nVoice * 5;
+				const int nFrames = 256 - nVoice * 17;
+				const float fCutoff = 0.1f + 0.1f * nVoice;
+				const float fResonance = 0.9f - 0.05f * nVoice;
+				for ( int ii = 0; ii < nFrames; ++ii ) {
+					float fValue_L = input( nVoice, ii, false );
+					float fValue_R = input( nVoice, ii, true );
+					filter( &references[ nVoice ], fCutoff, fResonance, &fValue_L, &fValue_R );
+					CPPUNIT_ASSERT_DOUBLES_EQUAL(
+						fValue_L, voiceFilter.getBuffer_L( nVoice )[ nOffset + ii ], 1e-5 );
+					CPPUNIT_ASSERT_DOUBLES_EQUAL(
+						fValue_R, voiceFilter.getBuffer_R( nVoice )[ nOffset + ii ], 1e-5 );
+				}
+				CPPUNIT_ASSERT_DOUBLES_EQUAL( references[ nVoice ].fLowPass_L,
+											  states[ nVoice ].fLowPass_L, 1e-5 );
+				CPPUNIT_ASSERT_DOUBLES_EQUAL( references[ nVoice ].fBandPass_R,
+											  states[ nVoice ].fBandPass_R, 1e-5 );
+			}
+			voiceFilter.clear();
+		}
+	}
+
+	void testSmoothing()
+	{
+		const int nFrames = 64;
+		VoiceFilter voiceFilter;
+		FilterState state;
+
+		// The first block is filtered using constant coefficients.
+		voiceFilter.add( &state, 0.5f, 0.2f, 0, nFrames );
+		for ( int ii = 0; ii < nFrames; ++ii ) {
+			voiceFilter.getBuffer_L( 0 )[ ii ] = 1.0f;
+			voiceFilter.getBuffer_R( 0 )[ ii ] = 1.0f;
+		}
+		voiceFilter.process();
+		voiceFilter.clear();
+		CPPUNIT_ASSERT_EQUAL( 0.5f, state.fCutoff );
+		CPPUNIT_ASSERT_EQUAL( 0.2f, state.fResonance );
+
+		// Afterwards, the coefficients are ramped.
+		FilterState reference = state;
+		voiceFilter.add( &state, 0.1f, 0.6f, 0, nFrames );
+		for ( int ii = 0; ii < nFrames; ++ii ) {
+			voiceFilter.getBuffer_L( 0 )[ ii ] = -1.0f;
+			voiceFilter.getBuffer_R( 0 )[ ii ] = -1.0f;
+		}
+		voiceFilter.process();
+		for ( int ii = 0; ii < nFrames; ++ii ) {
+			const float fRamp = static_cast<float>( ii + 1 ) / nFrames;
+			float fValue_L = -1.0f;
+			float fValue_R = -1.0f;
+			filter( &reference, 0.5f + fRamp * ( 0.1f - 0.5f ), 0.2f + fRamp * ( 0.6f - 0.2f ),
+					&fValue_L, &fValue_R );
+			CPPUNIT_ASSERT_DOUBLES_EQUAL( fValue_L, voiceFilter.getBuffer_L( 0 )[ ii ], 1e-4 );
+		}
+		CPPUNIT_ASSERT_EQUAL( 0.1f, state.fCutoff );
+		CPPUNIT_ASSERT_EQUAL( 0.6f, state.fResonance );
+	}
+
+	void testTail()
+	{
+		const int nFrames = 128;
+		VoiceFilter voiceFilter;
+		FilterState state;
+		CPPUNIT_ASSERT( ! state.isRinging() );
+
+		voiceFilter.add( &state, 0.2f, 0.8f, 0, nFrames );
+		for ( int ii = 0; ii < nFrames; ++ii ) {
+			voiceFilter.getBuffer_L( 0 )[ ii ] = 1.0f;
+			voiceFilter.getBuffer_R( 0 )[ ii ] = 1.0f;
+		}
+		voiceFilter.process();
+		voiceFilter.clear();
+		CPPUNIT_ASSERT( state.bSustain );
+
+		// Silence decays.
+		int nCycles = 0;
+		while ( state.bSustain && nCycles < 100 ) {
+			voiceFilter.add( &state, 0.2f, 0.8f, 0, nFrames );
+			for ( int ii = 0; ii < nFrames; ++ii ) {
+				voiceFilter.getBuffer_L( 0 )[ ii ] = 0.0f;
+				voiceFilter.getBuffer_R( 0 )[ ii ] = 0.0f;
+			}
+			voiceFilter.process();
+			voiceFilter.clear();
+			++nCycles;
+		}
+		CPPUNIT_ASSERT( nCycles > 0 );
+		CPPUNIT_ASSERT( ! state.bSustain );
+		CPPUNIT_ASSERT( ! state.isRinging() );
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( VoiceFilterTest );
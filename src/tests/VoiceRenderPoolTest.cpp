@@ -0,0 +1,78 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2008-2021 The hydrogen development team [hydrogen-devel@lists.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see https://www.gnu.org/licenses
+ *
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+#include <core/Sampler/VoiceRenderPool.h>
+
+#include <vector>
+#include <unistd.h>
+
+using namespace H2Core;
+
+class VoiceRenderPoolTest : public CppUnit::TestCase {
+	CPPUNIT_TEST_SUITE( VoiceRenderPoolTest );
+	CPPUNIT_TEST( testAllPartitionsRendered );
+	CPPUNIT_TEST_SUITE_END();
+
+	struct Context {
+		std::vector<int> runs;
+		std::vector<float> buffers;
+	};
+
+	static void job( void* pContext, int nPartition )
+	{
+		auto pJob = static_cast<Context*>( pContext );
+		pJob->runs[ nPartition ]++;
+		pJob->buffers[ nPartition ] += 0.5 * nPartition;
+	}
+
+	void testAllPartitionsRendered()
+	{
+		const int nRuns = 500;
+
+		for ( int nWorkers = 0; nWorkers < 4; ++nWorkers ) {
+			VoiceRenderPool pool( nWorkers );
+			CPPUNIT_ASSERT( pool.getPartitionCount() >= 1 );
+			CPPUNIT_ASSERT( pool.getPartitionCount() <= nWorkers + 1 );
+
+			Context context;
+			context.runs.resize( pool.getPartitionCount(), 0 );
+			context.buffers.resize( pool.getPartitionCount(), 0 );
+
+			for ( int ii = 0; ii < nRuns; ++ii ) {
+				pool.run( job, &context );
+
+				// Let the workers fall asleep once in a while.
+				if ( ii % 100 == 0 ) {
+					usleep( 10000 );
+				}
+			}
+
+			for ( int nPartition = 0; nPartition < pool.getPartitionCount(); ++nPartition ) {
+				CPPUNIT_ASSERT_EQUAL( nRuns, context.runs[ nPartition ] );
+				CPPUNIT_ASSERT_DOUBLES_EQUAL( 0.5 * nPartition * nRuns,
+											  context.buffers[ nPartition ], 1e-3 );
+			}
+		}
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( VoiceRenderPoolTest );